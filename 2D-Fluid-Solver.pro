@@ -3,4 +3,6 @@ include(config.pri)
 TEMPLATE = subdirs
 CONFIG  += ordered
 SUBDIRS  = tests \
-           main
+           main \
+           batch \
+           benchmarks
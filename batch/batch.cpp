@@ -0,0 +1,383 @@
+#include <QElapsedTimer>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Checkpoint.h"
+#include "FluidSolver.h"
+#include "FrameExporter.h"
+#include "FrameSnapshot.h"
+#include "Grid.h"
+#include "ParticleSystem.h"
+#include "Scenario.h"
+
+using namespace std;
+
+
+// Settings for a batch run, as parsed from the command line.
+struct BatchSettings {
+  unsigned frames;         // Number of frames to simulate.
+  string scenarioPath;     // Scenario file to set up, if not empty.
+  float width;             // Simulation width, in cells.
+  float height;            // Simulation height, in cells.
+  FluidSolver::PressureSolverType pressureSolver; // Pressure solver to use,
+                                                  // or COUNT for the
+                                                  // scenario's.
+  unsigned threads;        // Solver threads, or 0 for one per core.
+  ParticleSystem::Integrator integrator; // Particle integrator to use.
+  string statsPath;        // Per-frame statistics CSV, if not empty.
+  string outputDirectory;  // Field output directory, if not empty.
+  unsigned outputInterval; // Write fields every this many frames.
+  unsigned outputQueue;    // Frames that may wait to be written.
+  FrameExporter::OverflowPolicy outputPolicy; // What to do when it is full.
+  bool compressOutput;     // Compress written frames.
+  FieldCodec::Mode outputCodec; // How compressed frames are encoded.
+  float velocityTolerance; // Largest velocity error in lossy frames.
+  string tracePath;        // Chrome trace of the solver stages, if not empty.
+  string checkpointPath;   // Checkpoint file to write, if not empty.
+  unsigned checkpointInterval; // Checkpoint every this many frames, or 0.
+  string restartPath;      // Checkpoint to resume from, if not empty.
+};
+
+
+// Prints the command line usage.
+static void printUsage(const char *program)
+{
+  fprintf(stderr,
+	  "Usage: %s [options]\n"
+	  "Runs the fluid simulation without a display.\n\n"
+	  "  --frames N        Number of frames to simulate (default 100).\n"
+	  "  --scenario FILE   Set up the scene and settings described in FILE\n"
+	  "                    (see solver/Scenario.h) instead of the default\n"
+	  "                    scene.\n"
+	  "  --size W H        Simulation size in cells, without --scenario\n"
+	  "                    (default 64 64).\n"
+	  "  --solver NAME     Pressure solver: diagonal, mic, multigrid or\n"
+	  "                    mgpcg (default mic, or the scenario's).\n"
+	  "  --threads N       Number of solver threads (default one per core).\n"
+	  "  --integrator NAME Particle integrator: euler, rk2 or rk3\n"
+	  "                    (default rk2).\n"
+	  "  --stats FILE      Write per-frame timing statistics as CSV.\n"
+	  "  --output DIR      Write the simulation fields of each frame to DIR.\n"
+	  "  --every K         With --output, only write every K-th frame.\n"
+	  "  --output-queue N  With --output, let up to N frames wait to be\n"
+	  "                    written (default 4).\n"
+	  "  --output-policy NAME\n"
+	  "                    When the output queue is full: block, to slow the\n"
+	  "                    simulation down to the disk (the default), or drop,\n"
+	  "                    to skip frames instead.\n"
+	  "  --compress NAME   With --output, compress frames: lossless, or\n"
+	  "                    lossy to keep velocities within --tolerance.\n"
+	  "  --tolerance T     Largest velocity error in lossy frames, in cells\n"
+	  "                    per second (default 0.0001).\n"
+	  "  --trace FILE      Write a Chrome trace of every solver stage (needs\n"
+	  "                    a build configured with CONFIG+=profiling).\n"
+	  "  --checkpoint FILE Save the final frame to a checkpoint FILE.\n"
+	  "  --checkpoint-every K\n"
+	  "                    With --checkpoint, also save every K-th frame.\n"
+	  "  --restart FILE    Resume from a checkpoint, continuing after its\n"
+	  "                    frame up to --frames; --size is taken from it,\n"
+	  "                    and must match the --scenario if one is given.\n",
+	  program);
+}
+
+
+// Parses the command line into settings, returning false on error.
+static bool parseArguments(int argc, char *argv[], BatchSettings &settings)
+{
+  static const char *solverNames[FluidSolver::PRESSURE_SOLVER_COUNT] = {
+    "diagonal", "mic", "multigrid", "mgpcg"
+  };
+  static const char *integratorNames[ParticleSystem::INTEGRATOR_COUNT] = {
+    "euler", "rk2", "rk3"
+  };
+  static const char *policyNames[FrameExporter::OVERFLOW_POLICY_COUNT] = {
+    "block", "drop"
+  };
+  static const char *codecNames[FieldCodec::MODE_COUNT] = {
+    "lossless", "lossy"
+  };
+
+  for (int i = 1; i < argc; ++i) {
+    const string arg = argv[i];
+    const int remaining = argc - i - 1;
+    if (arg == "--frames" && remaining >= 1)
+      settings.frames = strtoul(argv[++i], NULL, 10);
+    else if (arg == "--scenario" && remaining >= 1)
+      settings.scenarioPath = argv[++i];
+    else if (arg == "--size" && remaining >= 2) {
+      settings.width  = atof(argv[++i]);
+      settings.height = atof(argv[++i]);
+    }
+    else if (arg == "--solver" && remaining >= 1) {
+      const string name = argv[++i];
+      unsigned type = 0;
+      while (type < FluidSolver::PRESSURE_SOLVER_COUNT &&
+	     name != solverNames[type])
+	++type;
+      if (type == FluidSolver::PRESSURE_SOLVER_COUNT) {
+	fprintf(stderr, "Unknown pressure solver: %s\n", name.c_str());
+	return false;
+      }
+      settings.pressureSolver = FluidSolver::PressureSolverType(type);
+    }
+    else if (arg == "--threads" && remaining >= 1)
+      settings.threads = strtoul(argv[++i], NULL, 10);
+    else if (arg == "--integrator" && remaining >= 1) {
+      const string name = argv[++i];
+      unsigned type = 0;
+      while (type < ParticleSystem::INTEGRATOR_COUNT &&
+	     name != integratorNames[type])
+	++type;
+      if (type == ParticleSystem::INTEGRATOR_COUNT) {
+	fprintf(stderr, "Unknown particle integrator: %s\n", name.c_str());
+	return false;
+      }
+      settings.integrator = ParticleSystem::Integrator(type);
+    }
+    else if (arg == "--stats" && remaining >= 1)
+      settings.statsPath = argv[++i];
+    else if (arg == "--output" && remaining >= 1)
+      settings.outputDirectory = argv[++i];
+    else if (arg == "--every" && remaining >= 1)
+      settings.outputInterval = strtoul(argv[++i], NULL, 10);
+    else if (arg == "--output-queue" && remaining >= 1)
+      settings.outputQueue = strtoul(argv[++i], NULL, 10);
+    else if (arg == "--output-policy" && remaining >= 1) {
+      const string name = argv[++i];
+      unsigned policy = 0;
+      while (policy < FrameExporter::OVERFLOW_POLICY_COUNT &&
+	     name != policyNames[policy])
+	++policy;
+      if (policy == FrameExporter::OVERFLOW_POLICY_COUNT) {
+	fprintf(stderr, "Unknown output policy: %s\n", name.c_str());
+	return false;
+      }
+      settings.outputPolicy = FrameExporter::OverflowPolicy(policy);
+    }
+    else if (arg == "--compress" && remaining >= 1) {
+      const string name = argv[++i];
+      unsigned mode = 0;
+      while (mode < FieldCodec::MODE_COUNT && name != codecNames[mode])
+	++mode;
+      if (mode == FieldCodec::MODE_COUNT) {
+	fprintf(stderr, "Unknown compression: %s\n", name.c_str());
+	return false;
+      }
+      settings.compressOutput = true;
+      settings.outputCodec = FieldCodec::Mode(mode);
+    }
+    else if (arg == "--tolerance" && remaining >= 1)
+      settings.velocityTolerance = atof(argv[++i]);
+    else if (arg == "--trace" && remaining >= 1)
+      settings.tracePath = argv[++i];
+    else if (arg == "--checkpoint" && remaining >= 1)
+      settings.checkpointPath = argv[++i];
+    else if (arg == "--checkpoint-every" && remaining >= 1)
+      settings.checkpointInterval = strtoul(argv[++i], NULL, 10);
+    else if (arg == "--restart" && remaining >= 1)
+      settings.restartPath = argv[++i];
+    else
+      return false;
+  }
+  return settings.frames > 0 && settings.width > 0.0f &&
+    settings.height > 0.0f && settings.outputInterval > 0 &&
+    settings.outputQueue > 0 && settings.velocityTolerance > 0.0f;
+}
+
+
+int main(int argc, char *argv[])
+{
+  BatchSettings settings;
+  settings.frames = 100;
+  settings.width = 64.0f;
+  settings.height = 64.0f;
+  settings.pressureSolver = FluidSolver::PRESSURE_SOLVER_COUNT;
+  settings.threads = 0;
+  settings.integrator = ParticleSystem::RK2;
+  settings.outputInterval = 1;
+  settings.outputQueue = 4;
+  settings.outputPolicy = FrameExporter::BLOCK_WHEN_FULL;
+  settings.compressOutput = false;
+  settings.outputCodec = FieldCodec::LOSSLESS;
+  settings.velocityTolerance = 1.0e-4f;
+  settings.checkpointInterval = 0;
+  if (!parseArguments(argc, argv, settings)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+#ifndef FLUID_PROFILING
+  if (!settings.tracePath.empty()) {
+    fprintf(stderr, "--trace requires a build with CONFIG+=profiling\n");
+    return 1;
+  }
+#endif
+
+  FILE *stats = NULL;
+  if (!settings.statsPath.empty()) {
+    stats = fopen(settings.statsPath.c_str(), "w");
+    if (!stats) {
+      fprintf(stderr, "Unable to open %s\n", settings.statsPath.c_str());
+      return 1;
+    }
+    fprintf(stats, "frame,milliseconds,substeps,pressure_iterations\n");
+  }
+
+  QElapsedTimer timer;
+  Scenario scenario;
+  if (!settings.scenarioPath.empty()) {
+    if (!scenario.load(settings.scenarioPath)) {
+      fprintf(stderr, "Unable to load %s: %s\n",
+	      settings.scenarioPath.c_str(), scenario.getError().c_str());
+      return 1;
+    }
+    settings.width = scenario.getWidth();
+    settings.height = scenario.getHeight();
+  }
+
+  // A restart takes the grid size from its checkpoint, and continues with
+  // the frame after the saved one.
+  Checkpoint checkpoint;
+  unsigned firstFrame = 0;
+  if (!settings.restartPath.empty()) {
+    timer.start();
+    const Checkpoint::Status status = checkpoint.open(settings.restartPath);
+    if (status != Checkpoint::OK) {
+      fprintf(stderr, "Unable to restart from %s: %s\n",
+	      settings.restartPath.c_str(),
+	      Checkpoint::getStatusMessage(status));
+      return 1;
+    }
+    if (!settings.scenarioPath.empty() &&
+	(checkpoint.getWidth() != scenario.getWidth() ||
+	 checkpoint.getHeight() != scenario.getHeight())) {
+      fprintf(stderr, "%s does not match the size of %s\n",
+	      settings.restartPath.c_str(), settings.scenarioPath.c_str());
+      return 1;
+    }
+    settings.width = checkpoint.getWidth();
+    settings.height = checkpoint.getHeight();
+    firstFrame = checkpoint.getFrame() + 1;
+    if (firstFrame >= settings.frames) {
+      fprintf(stderr, "%s already holds frame %u of %u\n",
+	      settings.restartPath.c_str(), firstFrame - 1, settings.frames);
+      return 1;
+    }
+  }
+
+  if (settings.scenarioPath.empty())
+    scenario = Scenario::makeDefault(settings.width, settings.height);
+  if (!checkpoint.isOpen())
+    timer.start();
+  FluidSolver solver(scenario);
+  if (settings.pressureSolver != FluidSolver::PRESSURE_SOLVER_COUNT)
+    solver.setPressureSolver(settings.pressureSolver);
+  solver.setThreadCount(settings.threads);
+  solver.setParticleIntegrator(settings.integrator);
+  if (checkpoint.isOpen()) {
+    solver.restore(checkpoint);
+    checkpoint.close();
+    printf("restarted at frame:  %u (%.3f s)\n", firstFrame,
+	   timer.nsecsElapsed() * 1.0e-9);
+  }
+  else
+    printf("scene set up in:     %.3f s\n", timer.nsecsElapsed() * 1.0e-9);
+
+  // Simulate each frame, timing only the simulation itself.  Exported frames
+  // and checkpoints are written in the background while the following frames
+  // run.
+  FrameSnapshotPool snapshots;
+  FrameExporter exporter(settings.outputDirectory, settings.outputQueue,
+			 settings.outputPolicy);
+  if (settings.compressOutput)
+    exporter.setCompression(settings.outputCodec, settings.velocityTolerance,
+			    settings.threads);
+  CheckpointWriter checkpoints;
+  const unsigned frameCount = settings.frames - firstFrame;
+  double totalMs = 0.0, minMs = 0.0, maxMs = 0.0;
+  unsigned long totalSubsteps = 0, totalIterations = 0;
+  for (unsigned frame = firstFrame; frame < settings.frames; ++frame) {
+    timer.start();
+    solver.advanceFrame();
+    const double ms = timer.nsecsElapsed() * 1.0e-6;
+
+    const vector<FluidSolver::PressureSolveStats> &solves =
+      solver.getFramePressureSolveStats();
+    unsigned iterations = 0;
+    for (unsigned i = 0; i < solves.size(); ++i)
+      iterations += solves[i].iterations;
+
+    totalMs += ms;
+    minMs = (frame == firstFrame || ms < minMs) ? ms : minMs;
+    maxMs = (frame == firstFrame || ms > maxMs) ? ms : maxMs;
+    totalSubsteps += solves.size();
+    totalIterations += iterations;
+    if (stats)
+      fprintf(stats, "%u,%.3f,%u,%u\n", frame, ms,
+	      unsigned(solves.size()), iterations);
+
+    if (!settings.outputDirectory.empty() &&
+	frame % settings.outputInterval == 0)
+      exporter.submit(snapshots.capture(solver.getGrid(),
+					solver.getParticles(), frame));
+
+    // Each checkpoint replaces the last, so the file always holds a
+    // complete frame to restart from.
+    const bool lastFrame = (frame + 1 == settings.frames);
+    if (!settings.checkpointPath.empty() &&
+	(lastFrame || (settings.checkpointInterval > 0 &&
+		       (frame + 1) % settings.checkpointInterval == 0)))
+      checkpoints.write(snapshots.capture(solver.getGrid(),
+					  solver.getParticles(), frame),
+			settings.checkpointPath);
+  }
+  if (stats)
+    fclose(stats);
+  if (!exporter.finish()) {
+    fprintf(stderr, "Unable to write %s (%lu frames failed)\n",
+	    exporter.getFirstFailedPath().c_str(), exporter.getFailedCount());
+    return 1;
+  }
+  const Checkpoint::Status checkpointStatus = checkpoints.finish();
+  if (checkpointStatus != Checkpoint::OK) {
+    fprintf(stderr, "Unable to write %s: %s\n",
+	    settings.checkpointPath.c_str(),
+	    Checkpoint::getStatusMessage(checkpointStatus));
+    return 1;
+  }
+
+  printf("frames:              %u\n", frameCount);
+  printf("size:                %g x %g\n", settings.width, settings.height);
+  printf("threads:             %u\n", solver.getThreadCount());
+  printf("total time:          %.3f s\n", totalMs * 1.0e-3);
+  printf("frame time (ms):     mean %.3f, min %.3f, max %.3f\n",
+	 totalMs / frameCount, minMs, maxMs);
+  printf("frames per second:   %.2f\n", frameCount / (totalMs * 1.0e-3));
+  printf("substeps:            %lu\n", totalSubsteps);
+  printf("pressure iterations: %lu\n", totalIterations);
+  if (!settings.outputDirectory.empty())
+    printf("frames exported:     %lu (%lu dropped, %.3f s blocked, "
+	   "%.1f MB)\n", exporter.getWrittenCount(), exporter.getDroppedCount(),
+	   exporter.getBlockedSec(), exporter.getWrittenBytes() * 1.0e-6);
+
+#ifdef FLUID_PROFILING
+  const Profiler &profiler = solver.getProfiler();
+  cout << "stages:\n";
+  profiler.dump(cout);
+  if (!settings.tracePath.empty()) {
+    ofstream trace(settings.tracePath.c_str());
+    profiler.writeChromeTrace(trace);
+    if (!trace) {
+      fprintf(stderr, "Unable to write %s\n", settings.tracePath.c_str());
+      return 1;
+    }
+    if (profiler.getDroppedEventCount() > 0)
+      fprintf(stderr, "Trace truncated: %lu events dropped\n",
+	      profiler.getDroppedEventCount());
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,9 @@
+include(../solver.pri)
+
+QT      -= gui opengl
+CONFIG  += console
+
+TEMPLATE = app
+TARGET   = 2D-Fluid-Solver-batch
+
+SOURCES += batch.cpp
@@ -0,0 +1,181 @@
+#ifndef __ADVECTION_BENCHMARK__
+#define __ADVECTION_BENCHMARK__
+
+#include <benchmark/benchmark.h>
+#include "FluidSolver.h"
+#include "Grid.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+#include "Vector2.h"
+
+// Grid sizes (cells per side) and thread counts used for the advection
+// scaling measurements.
+#define ADVECTION_BENCHMARK_MIN_SIZE 512
+#define ADVECTION_BENCHMARK_MAX_SIZE 2048
+#define ADVECTION_BENCHMARK_MAX_THREADS 64
+
+// Particle counts for the particle advection measurements, which run on a
+// grid of PARTICLE_BENCHMARK_GRID_SIZE cells per side.
+#define PARTICLE_BENCHMARK_MIN_COUNT (1 << 20)
+#define PARTICLE_BENCHMARK_MAX_COUNT (1 << 24)
+#define PARTICLE_BENCHMARK_GRID_SIZE 1024
+
+// Exposes FluidSolver's advection stage.
+class AdvectionBenchmarkSolver : public FluidSolver
+{
+public:
+  AdvectionBenchmarkSolver(float width, float height)
+    : FluidSolver(width, height)
+  {}
+
+  using FluidSolver::advectVelocity;
+  using FluidSolver::applyGlobalVelocity;
+  using FluidSolver::markCells;
+};
+
+// Semi-Lagrangian advection of every face with a given number of threads.
+// Wall time is reported, since CPU time only covers the calling thread.
+static void BM_AdvectVelocity(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  AdvectionBenchmarkSolver solver(size, size);
+  solver.setThreadCount(state.range(1));
+  solver.applyGlobalVelocity(Vector2(2.0f, -3.0f));
+
+  for (auto _ : state)
+    solver.advectVelocity(0.01f);
+  state.SetItemsProcessed(state.iterations() * 2 * size * (size + 1));
+}
+BENCHMARK(BM_AdvectVelocity)
+  ->RangeMultiplier(2)
+  ->Ranges({{ADVECTION_BENCHMARK_MIN_SIZE, ADVECTION_BENCHMARK_MAX_SIZE},
+	    {1, ADVECTION_BENCHMARK_MAX_THREADS}})
+  ->ArgNames({"size", "threads"})
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+// Fills a grid with a rotating velocity field and scatters particles over it
+// in no particular order.
+static void particleBenchmarkSetup(Grid &grid, ParticleSystem &particles,
+				   unsigned count)
+{
+  const unsigned size = PARTICLE_BENCHMARK_GRID_SIZE;
+  for (unsigned y = 0; y < size; ++y)
+    for (unsigned x = 0; x <= size; ++x)
+      grid.u(x, y) = 0.01f * (y - 0.5f * size);
+  for (unsigned y = 0; y <= size; ++y)
+    for (unsigned x = 0; x < size; ++x)
+      grid.v(x, y) = 0.01f * (0.5f * size - x);
+
+  // Positions from a linear congruential generator, so that consecutive
+  // particles land in unrelated cells.
+  particles.clear();
+  particles.reserve(count);
+  unsigned seed = 12345;
+  for (unsigned k = 0; k < count; ++k) {
+    seed = seed * 1664525u + 1013904223u;
+    const float x = (seed >> 8) * (size / 16777216.0f);
+    seed = seed * 1664525u + 1013904223u;
+    const float y = (seed >> 8) * (size / 16777216.0f);
+    particles.add(x, y);
+  }
+}
+
+// Advection of marker particles through a rotating velocity field, for a
+// given particle count, thread count and integrator.
+static void BM_AdvectParticles(benchmark::State &state)
+{
+  const unsigned count = state.range(0);
+  Grid grid(PARTICLE_BENCHMARK_GRID_SIZE, PARTICLE_BENCHMARK_GRID_SIZE);
+  ParticleSystem particles;
+  particleBenchmarkSetup(grid, particles, count);
+
+  ThreadPool pool(state.range(1));
+  const ParticleSystem::Integrator integrator =
+    static_cast<ParticleSystem::Integrator>(state.range(2));
+  for (auto _ : state)
+    particles.advect(grid, 0.01f, integrator, pool);
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_AdvectParticles)
+  ->RangeMultiplier(4)
+  ->Ranges({{PARTICLE_BENCHMARK_MIN_COUNT, PARTICLE_BENCHMARK_MAX_COUNT},
+	    {1, ADVECTION_BENCHMARK_MAX_THREADS},
+	    {ParticleSystem::FORWARD_EULER, ParticleSystem::RK3}})
+  ->ArgNames({"particles", "threads", "integrator"})
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+// Single-threaded RK2 advection of scattered particles, either in creation
+// order (-1) or after sorting them by cell in the given cell order.
+static void BM_AdvectSortedParticles(benchmark::State &state)
+{
+  const unsigned count = state.range(0);
+  Grid grid(PARTICLE_BENCHMARK_GRID_SIZE, PARTICLE_BENCHMARK_GRID_SIZE);
+  ParticleSystem particles;
+  particleBenchmarkSetup(grid, particles, count);
+  if (state.range(1) >= 0)
+    particles.sortByCell(PARTICLE_BENCHMARK_GRID_SIZE,
+			 PARTICLE_BENCHMARK_GRID_SIZE,
+			 static_cast<ParticleSystem::CellOrder>(state.range(1)));
+
+  ThreadPool pool(1);
+  for (auto _ : state)
+    particles.advect(grid, 0.01f, ParticleSystem::RK2, pool);
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_AdvectSortedParticles)
+  ->ArgsProduct({{PARTICLE_BENCHMARK_MIN_COUNT, PARTICLE_BENCHMARK_MAX_COUNT},
+		 {-1, ParticleSystem::ROW_MAJOR, ParticleSystem::MORTON}})
+  ->ArgNames({"particles", "order"})
+  ->Unit(benchmark::kMillisecond);
+
+// Re-sorting particles by cell after each advection step, as the solver
+// does.  Only the sort is timed.
+static void BM_SortParticles(benchmark::State &state)
+{
+  const unsigned count = state.range(0);
+  Grid grid(PARTICLE_BENCHMARK_GRID_SIZE, PARTICLE_BENCHMARK_GRID_SIZE);
+  ParticleSystem particles;
+  particleBenchmarkSetup(grid, particles, count);
+  const ParticleSystem::CellOrder order =
+    static_cast<ParticleSystem::CellOrder>(state.range(1));
+  particles.sortByCell(PARTICLE_BENCHMARK_GRID_SIZE,
+		       PARTICLE_BENCHMARK_GRID_SIZE, order);
+
+  ThreadPool pool;
+  for (auto _ : state) {
+    state.PauseTiming();
+    particles.advect(grid, 0.5f, ParticleSystem::RK2, pool);
+    state.ResumeTiming();
+    particles.sortByCell(PARTICLE_BENCHMARK_GRID_SIZE,
+			 PARTICLE_BENCHMARK_GRID_SIZE, order);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_SortParticles)
+  ->ArgsProduct({{PARTICLE_BENCHMARK_MIN_COUNT, PARTICLE_BENCHMARK_MAX_COUNT},
+		 {ParticleSystem::ROW_MAJOR, ParticleSystem::MORTON}})
+  ->ArgNames({"particles", "order"})
+  ->Unit(benchmark::kMillisecond);
+
+// FLUID/AIR classification from the initial particles (16 per cell over a
+// quarter of the grid), unsorted, with a given number of threads.
+static void BM_MarkCells(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  AdvectionBenchmarkSolver solver(size, size);
+  solver.setThreadCount(state.range(1));
+  for (auto _ : state)
+    solver.markCells();
+  state.SetItemsProcessed(state.iterations() * solver.getParticles().size());
+}
+BENCHMARK(BM_MarkCells)
+  ->RangeMultiplier(2)
+  ->Ranges({{ADVECTION_BENCHMARK_MIN_SIZE, ADVECTION_BENCHMARK_MAX_SIZE},
+	    {1, ADVECTION_BENCHMARK_MAX_THREADS}})
+  ->ArgNames({"size", "threads"})
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+#endif // __ADVECTION_BENCHMARK__
@@ -0,0 +1,46 @@
+#ifndef __CODEC_BENCHMARK__
+#define __CODEC_BENCHMARK__
+
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "FieldCodec.h"
+#include "FluidSolver.h"
+#include "FrameSnapshot.h"
+
+// Velocity tolerance used by the lossy codec benchmark.
+#define CODEC_BENCHMARK_TOLERANCE 1.0e-4f
+
+// Encodes a frame of a solver that has run for a few frames, so that the
+// fields have the structure of a real run.  The second argument is the
+// FieldCodec::Mode.  Alongside the encoding rate, "ratio" reports how many
+// times smaller the encoded frame is than the raw arrays.
+static void BM_EncodeFrame(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  const FieldCodec::Mode mode = FieldCodec::Mode(state.range(1));
+  FluidSolver solver(size, size);
+  for (unsigned frame = 0; frame < 3; ++frame)
+    solver.advanceFrame();
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame =
+    pool.capture(solver.getGrid(), solver.getParticles(), 3);
+  const double rawBytes =
+    ((size + 1.0) * size * 2 + size * size + 2.0 * frame->getParticleCount())
+    * sizeof(float) + size * size;
+
+  FieldCodec codec(mode, CODEC_BENCHMARK_TOLERANCE);
+  std::vector<unsigned char> bytes;
+  for (auto _ : state) {
+    codec.encode(*frame, bytes);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * rawBytes);
+  state.counters["ratio"] = rawBytes / bytes.size();
+}
+BENCHMARK(BM_EncodeFrame)
+->ArgsProduct({ { 256, 1024 },
+		{ FieldCodec::LOSSLESS, FieldCodec::LOSSY_VELOCITY } })
+->UseRealTime()
+->Unit(benchmark::kMillisecond);
+
+#endif // __CODEC_BENCHMARK__
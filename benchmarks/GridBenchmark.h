@@ -0,0 +1,307 @@
+#ifndef __GRID_BENCHMARK__
+#define __GRID_BENCHMARK__
+
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <vector>
+#include "Cell.h"
+#include "Grid.h"
+#include "Vector2.h"
+
+// Grid sizes (cells per side) used for the memory bandwidth comparisons.
+#define GRID_BENCHMARK_MIN_SIZE 1024
+#define GRID_BENCHMARK_MAX_SIZE 4096
+
+// The array-of-structures cell layout that the Grid used to store, kept here
+// as a baseline so that the structure-of-arrays Grid can be compared against
+// it.  Each cell is roughly 48 bytes on 64-bit platforms.
+struct LegacyCell {
+  enum Neighbor { POS_X = 0, POS_Y, POS_XY, NEIGHBOR_COUNT };
+  float pressure;
+  float vel[Cell::DIM_COUNT];
+  float stagedVel[Cell::DIM_COUNT];
+  Cell::Type cellType;
+  bool allNeighbors;
+  LegacyCell *neighbors[NEIGHBOR_COUNT];
+};
+
+// Links each legacy cell to its +X, +Y and +XY neighbors, as the Grid used
+// to do after every construction, copy and assignment.
+static void linkLegacyCells(std::vector<LegacyCell> &cells, unsigned size)
+{
+  const unsigned cols = size + 1;
+  for (unsigned y = 0; y < cols; ++y)
+    for (unsigned x = 0; x < cols; ++x) {
+      LegacyCell &cell = cells[y * cols + x];
+      cell.allNeighbors = (x < size && y < size);
+      cell.neighbors[LegacyCell::POS_X]  = x < size ? &cells[y * cols + x + 1] : NULL;
+      cell.neighbors[LegacyCell::POS_Y]  = y < size ? &cells[(y + 1) * cols + x] : NULL;
+      cell.neighbors[LegacyCell::POS_XY] = cell.allNeighbors
+	? &cells[(y + 1) * cols + x + 1] : NULL;
+    }
+}
+
+// Builds a square legacy cell array of the given size (plus the top/right
+// border) filled with fluid.
+static void makeLegacyCells(std::vector<LegacyCell> &cells, unsigned size)
+{
+  const unsigned cols = size + 1;
+  cells.assign(cols * cols, LegacyCell());
+  for (unsigned y = 0; y < cols; ++y)
+    for (unsigned x = 0; x < cols; ++x) {
+      LegacyCell &cell = cells[y * cols + x];
+      cell.vel[Cell::X] = static_cast<float>(x);
+      cell.vel[Cell::Y] = static_cast<float>(y);
+      cell.cellType = Cell::FLUID;
+    }
+  linkLegacyCells(cells, size);
+}
+
+// Builds a square Grid of the given size filled with fluid.
+static void makeGrid(Grid &grid)
+{
+  const unsigned width  = grid.getColCount() - 1;
+  const unsigned height = grid.getRowCount() - 1;
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x <= width; ++x)
+      grid.u(x, y) = static_cast<float>(x);
+  for (unsigned y = 0; y <= height; ++y)
+    for (unsigned x = 0; x < width; ++x)
+      grid.v(x, y) = static_cast<float>(y);
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x < width; ++x)
+      grid.cellType(x, y) = Cell::FLUID;
+}
+
+
+// Velocity divergence over every cell, using the legacy neighbor pointers.
+static void BM_LegacyCellDivergence(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  std::vector<LegacyCell> cells;
+  makeLegacyCells(cells, size);
+
+  for (auto _ : state) {
+    float total = 0.0f;
+    for (unsigned y = 0; y < size; ++y)
+      for (unsigned x = 0; x < size; ++x) {
+	const LegacyCell &cell = cells[y * (size + 1) + x];
+	total += cell.neighbors[LegacyCell::POS_X]->vel[Cell::X] - cell.vel[Cell::X];
+	total += cell.neighbors[LegacyCell::POS_Y]->vel[Cell::Y] - cell.vel[Cell::Y];
+      }
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+  state.counters["bytes_streamed_per_cell"] = sizeof(LegacyCell);
+}
+BENCHMARK(BM_LegacyCellDivergence)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Velocity divergence over every cell, using the structure-of-arrays Grid.
+static void BM_GridDivergence(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  makeGrid(grid);
+
+  for (auto _ : state) {
+    float total = 0.0f;
+    for (unsigned y = 0; y < size; ++y)
+      for (unsigned x = 0; x < size; ++x)
+	total += grid.getVelocityDivergence(x, y);
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+  state.counters["bytes_streamed_per_cell"] = 2 * sizeof(float);
+}
+BENCHMARK(BM_GridDivergence)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Adds a global velocity to every fluid cell, using the legacy layout.
+static void BM_LegacyCellGlobalVelocity(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  std::vector<LegacyCell> cells;
+  makeLegacyCells(cells, size);
+
+  for (auto _ : state) {
+    for (unsigned y = 0; y < size; ++y)
+      for (unsigned x = 0; x < size; ++x) {
+	LegacyCell &cell = cells[y * (size + 1) + x];
+	if (cell.cellType == Cell::FLUID) {
+	  cell.vel[Cell::X] += 0.001f;
+	  cell.vel[Cell::Y] -= 0.001f;
+	}
+      }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_LegacyCellGlobalVelocity)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Adds a global velocity to every fluid cell, using the structure-of-arrays
+// Grid.
+static void BM_GridGlobalVelocity(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  makeGrid(grid);
+
+  for (auto _ : state) {
+    for (unsigned y = 0; y < size; ++y)
+      for (unsigned x = 0; x < size; ++x)
+	if (grid.cellType(x, y) == Cell::FLUID) {
+	  grid.u(x, y) += 0.001f;
+	  grid.v(x, y) -= 0.001f;
+	}
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_GridGlobalVelocity)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Builds a scattered set of sample positions covering a square grid.
+static void makeSamplePositions(unsigned size, std::vector<float> &x,
+				std::vector<float> &y)
+{
+  const unsigned count = size * size;
+  x.resize(count);
+  y.resize(count);
+  for (unsigned k = 0; k < count; ++k) {
+    x[k] = (k % size) + 0.25f + 0.5f * ((k * 7) % 3) / 3.0f;
+    y[k] = (k / size) + 0.75f - 0.5f * ((k * 5) % 4) / 4.0f;
+  }
+}
+
+
+// Samples the velocity at one point per cell, one point at a time.
+static void BM_GridGetVelocity(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  makeGrid(grid);
+  std::vector<float> x, y;
+  makeSamplePositions(size, x, y);
+  std::vector<float> u(x.size()), v(x.size());
+
+  for (auto _ : state) {
+    for (unsigned k = 0; k < x.size(); ++k) {
+      const Vector2 velocity = grid.getVelocity(Vector2(x[k], y[k]));
+      u[k] = velocity.x;
+      v[k] = velocity.y;
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * x.size());
+}
+BENCHMARK(BM_GridGetVelocity)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Samples the velocity at one point per cell with the batch API.
+static void BM_GridGetVelocities(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  makeGrid(grid);
+  std::vector<float> x, y;
+  makeSamplePositions(size, x, y);
+  std::vector<float> u(x.size()), v(x.size());
+
+  for (auto _ : state) {
+    grid.getVelocities(&x[0], &y[0], &u[0], &v[0], x.size());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * x.size());
+  state.counters["vector_width"] = Grid::vectorWidth();
+}
+BENCHMARK(BM_GridGetVelocities)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Maximum velocity by sampling every cell center, as the CFL timestep used
+// to be chosen.
+static void BM_GridMaxVelocity(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  makeGrid(grid);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(grid.getMaxVelocity());
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_GridMaxVelocity)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Maximum face velocities in one streaming pass over the face arrays.
+static void BM_GridMaxFaceVelocity(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  makeGrid(grid);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(grid.getMaxFaceVelocity());
+  state.SetItemsProcessed(state.iterations() * size * size);
+  state.counters["bytes_streamed_per_cell"] = 2 * sizeof(float);
+}
+BENCHMARK(BM_GridMaxFaceVelocity)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Copies a legacy cell array and rebuilds its neighbor linkage.
+static void BM_LegacyCellCopy(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  std::vector<LegacyCell> cells;
+  std::vector<LegacyCell> copy;
+  makeLegacyCells(cells, size);
+  makeLegacyCells(copy, size);
+
+  for (auto _ : state) {
+    copy = cells;
+    linkLegacyCells(copy, size);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_LegacyCellCopy)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Assigns one Grid to another of the same size.
+static void BM_GridCopy(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  Grid copy(size, size);
+  makeGrid(grid);
+
+  for (auto _ : state) {
+    copy = grid;
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_GridCopy)
+  ->RangeMultiplier(2)->Range(GRID_BENCHMARK_MIN_SIZE, GRID_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+#endif // __GRID_BENCHMARK__
@@ -0,0 +1,209 @@
+#ifndef __KERNEL_BENCHMARK__
+#define __KERNEL_BENCHMARK__
+
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "FluidSolver.h"
+#include "Grid.h"
+#include "Vector2.h"
+
+// Grid sizes (cells per side) for the solver kernel suite: 64, 256, 1024
+// and 4096.  Every kernel runs over the same range on the same scene, the
+// solver's starting state, so that results can be tracked across releases.
+// Run a single size with e.g. --benchmark_filter=BM_Kernel.*/1024.
+#define KERNEL_BENCHMARK_MIN_SIZE 64
+#define KERNEL_BENCHMARK_MAX_SIZE 4096
+
+// The substep used by the time-dependent kernels.
+#define KERNEL_BENCHMARK_TIME_STEP 0.01f
+
+// Exposes FluidSolver's simulation stages.
+class KernelBenchmarkSolver : public FluidSolver
+{
+public:
+  KernelBenchmarkSolver(float width, float height)
+    : FluidSolver(width, height)
+  {}
+
+  using FluidSolver::advectVelocity;
+  using FluidSolver::applyGlobalVelocity;
+  using FluidSolver::markCells;
+  using FluidSolver::moveParticles;
+  using FluidSolver::pressureSolve;
+};
+
+// Starts a solver of the given size moving, so that every kernel has
+// non-trivial velocities to work on.  No pressure solve is done here: at
+// 4096x4096 a cold solve would cost more than the benchmarks themselves.
+static void kernelBenchmarkSetup(KernelBenchmarkSolver &solver)
+{
+  solver.applyGlobalVelocity(Vector2(2.0f, -3.0f));
+}
+
+// Registers a kernel benchmark over the suite's grid sizes.  Wall time is
+// reported, since the threaded kernels' CPU time only covers the calling
+// thread.
+#define KERNEL_BENCHMARK(function)					\
+  BENCHMARK(function)							\
+  ->RangeMultiplier(4)							\
+  ->Range(KERNEL_BENCHMARK_MIN_SIZE, KERNEL_BENCHMARK_MAX_SIZE)		\
+  ->UseRealTime()							\
+  ->Unit(benchmark::kMillisecond)
+
+
+// Grid::getVelocity() at every cell center, one point at a time.  Each
+// sample is two scalar bilerpVel() interpolations.
+static void BM_KernelGetVelocity(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  KernelBenchmarkSolver solver(size, size);
+  kernelBenchmarkSetup(solver);
+  const Grid &grid = solver.getGrid();
+
+  for (auto _ : state) {
+    Vector2 total(0.0f, 0.0f);
+    for (unsigned y = 0; y < size; ++y)
+      for (unsigned x = 0; x < size; ++x)
+	total += grid.getVelocity(Vector2(x + 0.5f, y + 0.5f));
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+KERNEL_BENCHMARK(BM_KernelGetVelocity);
+
+
+// Grid::getVelocities() at every cell center, a row at a time: the batched
+// bilerpVel() used by advection and particle movement.
+static void BM_KernelBilerpVelocities(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  KernelBenchmarkSolver solver(size, size);
+  kernelBenchmarkSetup(solver);
+  const Grid &grid = solver.getGrid();
+  std::vector<float> x(size), y(size), u(size), v(size);
+  for (unsigned i = 0; i < size; ++i)
+    x[i] = i + 0.5f;
+
+  for (auto _ : state) {
+    for (unsigned j = 0; j < size; ++j) {
+      for (unsigned i = 0; i < size; ++i)
+	y[i] = j + 0.5f;
+      grid.getVelocities(&x[0], &y[0], &u[0], &v[0], size);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+  state.counters["vector_width"] = Grid::vectorWidth();
+}
+KERNEL_BENCHMARK(BM_KernelBilerpVelocities);
+
+
+// Grid::getVelocityDivergence() of every cell.
+static void BM_KernelVelocityDivergence(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  KernelBenchmarkSolver solver(size, size);
+  kernelBenchmarkSetup(solver);
+  const Grid &grid = solver.getGrid();
+
+  for (auto _ : state) {
+    float total = 0.0f;
+    for (unsigned y = 0; y < size; ++y)
+      for (unsigned x = 0; x < size; ++x)
+	total += grid.getVelocityDivergence(x, y);
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+KERNEL_BENCHMARK(BM_KernelVelocityDivergence);
+
+
+// Grid::getMaxVelocity(), sampling every cell center.
+static void BM_KernelMaxVelocity(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  KernelBenchmarkSolver solver(size, size);
+  kernelBenchmarkSetup(solver);
+  const Grid &grid = solver.getGrid();
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(grid.getMaxVelocity());
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+KERNEL_BENCHMARK(BM_KernelMaxVelocity);
+
+
+// One substep of semi-Lagrangian velocity advection.
+static void BM_KernelAdvectVelocity(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  KernelBenchmarkSolver solver(size, size);
+  kernelBenchmarkSetup(solver);
+
+  for (auto _ : state)
+    solver.advectVelocity(KERNEL_BENCHMARK_TIME_STEP);
+  state.SetItemsProcessed(state.iterations() * 2 * size * (size + 1));
+  state.counters["threads"] = solver.getThreadCount();
+}
+KERNEL_BENCHMARK(BM_KernelAdvectVelocity);
+
+
+// One substep's pressure projection with the default solver.  Gravity is
+// applied, untimed, before each solve, so that every solve has divergence
+// to remove and starts from the previous substep's pressures, as it would
+// in a running simulation.
+static void BM_KernelPressureSolve(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  KernelBenchmarkSolver solver(size, size);
+  kernelBenchmarkSetup(solver);
+
+  unsigned long iterations = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    solver.applyGlobalVelocity(Vector2(0.0f,
+				       -9.8f * KERNEL_BENCHMARK_TIME_STEP));
+    state.ResumeTiming();
+    solver.pressureSolve(KERNEL_BENCHMARK_TIME_STEP);
+    iterations += solver.getLastPressureSolveStats().iterations;
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+  state.counters["threads"] = solver.getThreadCount();
+  state.counters["solver_iterations"] =
+    benchmark::Counter(iterations, benchmark::Counter::kAvgIterations);
+}
+KERNEL_BENCHMARK(BM_KernelPressureSolve);
+
+
+// One substep's movement of every marker particle.
+static void BM_KernelMoveParticles(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  KernelBenchmarkSolver solver(size, size);
+  kernelBenchmarkSetup(solver);
+
+  for (auto _ : state)
+    solver.moveParticles(KERNEL_BENCHMARK_TIME_STEP);
+  state.SetItemsProcessed(state.iterations() * solver.getParticles().size());
+  state.counters["particles"] = solver.getParticles().size();
+  state.counters["threads"] = solver.getThreadCount();
+}
+KERNEL_BENCHMARK(BM_KernelMoveParticles);
+
+
+// FLUID/AIR classification of every cell from the marker particles.
+static void BM_KernelMarkCells(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  KernelBenchmarkSolver solver(size, size);
+  kernelBenchmarkSetup(solver);
+
+  for (auto _ : state)
+    solver.markCells();
+  state.SetItemsProcessed(state.iterations() * solver.getParticles().size());
+  state.counters["particles"] = solver.getParticles().size();
+  state.counters["threads"] = solver.getThreadCount();
+}
+KERNEL_BENCHMARK(BM_KernelMarkCells);
+
+#endif // __KERNEL_BENCHMARK__
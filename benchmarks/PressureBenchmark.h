@@ -0,0 +1,128 @@
+#ifndef __PRESSURE_BENCHMARK__
+#define __PRESSURE_BENCHMARK__
+
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <eigen3/Eigen/Sparse>
+#include "Cell.h"
+#include "Grid.h"
+#include "PressureOperator.h"
+
+// Grid sizes (cells per side) used for the pressure operator comparisons.
+#define PRESSURE_BENCHMARK_MIN_SIZE 256
+#define PRESSURE_BENCHMARK_MAX_SIZE 2048
+
+typedef Eigen::SparseMatrix<double, Eigen::RowMajor> AssembledPressureMatrix;
+
+// Builds a square Grid of the given size with fluid in its lower 3/4 and AIR
+// above, similar to a settled tank.
+static void makePressureGrid(Grid &grid)
+{
+  const unsigned width  = grid.getColCount() - 1;
+  const unsigned height = grid.getRowCount() - 1;
+  for (unsigned y = 0; y < height * 3 / 4; ++y)
+    for (unsigned x = 0; x < width; ++x)
+      grid.cellType(x, y) = Cell::FLUID;
+}
+
+// Assembles the pressure matrix from triplets, as FluidSolver used to do on
+// every substep.
+static void assemblePressure(const Grid &grid, double scale,
+			     AssembledPressureMatrix &A)
+{
+  const unsigned width  = grid.getColCount() - 1;
+  const unsigned height = grid.getRowCount() - 1;
+  const unsigned char *types = grid.cellTypeData();
+  const int stride = grid.getStride();
+  const int offsets[4]   = { -1, 1, -stride, stride };
+  const int neighbors[4] = { -1, 1, -int(width), int(width) };
+  std::vector< Eigen::Triplet<double> > vals;
+  vals.reserve(5 * width * height);
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x < width; ++x) {
+      const unsigned c = grid.index(x, y);
+      const int i = y * width + x;
+      if (types[c] != Cell::FLUID) {
+	vals.push_back(Eigen::Triplet<double>(i, i, 1.0));
+	continue;
+      }
+      double diag = 0.0;
+      for (unsigned n = 0; n < 4; ++n) {
+	const unsigned char type = types[c + offsets[n]];
+	if (type == Cell::SOLID)
+	  continue;
+	diag += scale;
+	if (type == Cell::FLUID)
+	  vals.push_back(Eigen::Triplet<double>(i, i + neighbors[n], -scale));
+      }
+      vals.push_back(Eigen::Triplet<double>(i, i, diag));
+    }
+  A.resize(width * height, width * height);
+  A.setFromTriplets(vals.begin(), vals.end());
+}
+
+
+// Triplet assembly of the pressure matrix.
+static void BM_PressureAssembly(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  makePressureGrid(grid);
+  AssembledPressureMatrix A;
+
+  for (auto _ : state) {
+    assemblePressure(grid, 0.01, A);
+    benchmark::DoNotOptimize(A.valuePtr());
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_PressureAssembly)
+  ->RangeMultiplier(2)
+  ->Range(PRESSURE_BENCHMARK_MIN_SIZE, PRESSURE_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+// Sparse matrix-vector product with the assembled pressure matrix.
+static void BM_PressureAssembledProduct(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  makePressureGrid(grid);
+  AssembledPressureMatrix A;
+  assemblePressure(grid, 0.01, A);
+  Eigen::VectorXd x = Eigen::VectorXd::Ones(A.cols());
+  Eigen::VectorXd y(A.rows());
+
+  for (auto _ : state) {
+    y.noalias() = A * x;
+    benchmark::DoNotOptimize(y.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_PressureAssembledProduct)
+  ->RangeMultiplier(2)
+  ->Range(PRESSURE_BENCHMARK_MIN_SIZE, PRESSURE_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+// Matrix-free product with PressureOperator.  There is no assembly step.
+static void BM_PressureOperatorProduct(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  Grid grid(size, size);
+  makePressureGrid(grid);
+  PressureOperator A;
+  A.setup(grid, 0.01);
+  Eigen::VectorXd x = Eigen::VectorXd::Ones(A.cols());
+  Eigen::VectorXd y(A.rows());
+
+  for (auto _ : state) {
+    y.noalias() = A * x;
+    benchmark::DoNotOptimize(y.data());
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_PressureOperatorProduct)
+  ->RangeMultiplier(2)
+  ->Range(PRESSURE_BENCHMARK_MIN_SIZE, PRESSURE_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+#endif // __PRESSURE_BENCHMARK__
@@ -0,0 +1,111 @@
+#ifndef __RENDER_BENCHMARK__
+#define __RENDER_BENCHMARK__
+
+#include <benchmark/benchmark.h>
+#include "Cell.h"
+#include "FrameGeometry.h"
+#include "FrameSnapshot.h"
+#include "Grid.h"
+#include "ParticleSystem.h"
+
+// Grid sizes (cells per side) for the rendering benchmarks.
+#define RENDER_BENCHMARK_MIN_SIZE 64
+#define RENDER_BENCHMARK_MAX_SIZE 1024
+
+// Captures a square frame with a solid border, fluid in the bottom half,
+// air above it, a swirling velocity field and four particles per fluid cell.
+static FrameSnapshotPtr makeRenderFrame(FrameSnapshotPool &pool,
+					unsigned size)
+{
+  Grid grid(size, size);
+  ParticleSystem particles;
+  for (unsigned y = 0; y < size; ++y) {
+    for (unsigned x = 0; x < size; ++x) {
+      const bool border = x == 0 || y == 0 || x == size - 1 || y == size - 1;
+      const bool fluid = y < size / 2;
+      grid.cellType(x, y) = border ? Cell::SOLID
+	: fluid ? Cell::FLUID : Cell::AIR;
+      grid.u(x, y) = 0.01f * (float(y) - 0.5f * size);
+      grid.v(x, y) = 0.01f * (0.5f * size - float(x));
+      if (fluid && !border)
+	for (unsigned k = 0; k < 4; ++k)
+	  particles.add(x + 0.25f + 0.5f * (k % 2), y + 0.25f + 0.5f * (k / 2));
+    }
+  }
+  return pool.capture(grid, particles, 0);
+}
+
+// Returns the number of glBegin()/glEnd() pairs the CompatibilityRenderer
+// issues for a frame: one for the grid lines, one per tinted cell, one per
+// face and cell center velocity, and one for the particles.
+static unsigned countImmediateModeCalls(const FrameSnapshot &frame)
+{
+  const unsigned width  = frame.getWidth();
+  const unsigned height = frame.getHeight();
+  unsigned calls = 2;
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x < width; ++x)
+      calls += frame.cellType(x, y) != Cell::SOLID;
+  calls += (width + 1) * height + width * (height + 1) + width * height;
+  return calls;
+}
+
+
+// Packs a frame into vertex arrays, as the VertexBufferRenderer does before
+// every upload.  This is the renderer's per-frame CPU cost; it then draws
+// the frame with draw_calls calls, where the CompatibilityRenderer makes
+// immediate_mode_calls glBegin()/glEnd() pairs and a call per vertex.
+static void BM_BuildFrameGeometry(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeRenderFrame(pool, size);
+  FrameGeometry geometry;
+  geometry.build(*frame);
+
+  for (auto _ : state) {
+    geometry.build(*frame);
+    benchmark::DoNotOptimize(geometry.frameData());
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+  state.counters["draw_calls"] = FrameGeometry::BATCH_COUNT;
+  state.counters["immediate_mode_calls"] = countImmediateModeCalls(*frame);
+  state.counters["vertices"] = geometry.getGridLineVertexCount() +
+    geometry.getFrameVertexCount();
+  state.counters["upload_bytes"] =
+    geometry.getFrameVertexCount() * sizeof(FrameGeometry::Vertex);
+}
+BENCHMARK(BM_BuildFrameGeometry)
+  ->RangeMultiplier(4)->Range(RENDER_BENCHMARK_MIN_SIZE,
+			      RENDER_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+
+// Captures a frame snapshot from a grid and particles, the other half of the
+// per-frame cost of handing a frame to a renderer.
+static void BM_CaptureFrameSnapshot(benchmark::State &state)
+{
+  const unsigned size = state.range(0);
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeRenderFrame(pool, size);
+  Grid grid(size, size);
+  ParticleSystem particles;
+  particles.reserve(frame->getParticleCount());
+  for (unsigned k = 0; k < frame->getParticleCount(); ++k)
+    particles.add(frame->particleXData()[k], frame->particleYData()[k]);
+
+  FrameSnapshotPtr snapshot;
+  for (auto _ : state) {
+    snapshot.reset();
+    snapshot = pool.capture(grid, particles, 0);
+    benchmark::DoNotOptimize(snapshot->uData());
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+  state.counters["snapshots"] = pool.getSnapshotCount();
+}
+BENCHMARK(BM_CaptureFrameSnapshot)
+  ->RangeMultiplier(4)->Range(RENDER_BENCHMARK_MIN_SIZE,
+			      RENDER_BENCHMARK_MAX_SIZE)
+  ->Unit(benchmark::kMillisecond);
+
+#endif // __RENDER_BENCHMARK__
@@ -0,0 +1,37 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+#include "Grid.h"
+#include "FluidSolver.h"
+
+// Include benchmark headers here:
+#include "AdvectionBenchmark.h"
+#include "CodecBenchmark.h"
+#include "GridBenchmark.h"
+#include "KernelBenchmark.h"
+#include "PressureBenchmark.h"
+#include "RenderBenchmark.h"
+#include "ScenarioBenchmark.h"
+
+int main(int argc, char *argv[])
+{
+  // Initialize Google Benchmark library.
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+
+  // Record how the solver was built alongside the results, so that JSON
+  // results from different builds are not compared by mistake.
+  benchmark::AddCustomContext("vector_width",
+			      std::to_string(Grid::vectorWidth()));
+#ifdef FLUID_PROFILING
+  benchmark::AddCustomContext("profiling", "on");
+#else
+  benchmark::AddCustomContext("profiling", "off");
+#endif
+
+  // Run all benchmarks!
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,24 @@
+include(../solver.pri)
+
+QT      -= gui opengl
+
+TEMPLATE = app
+TARGET   = solver-benchmarks
+
+# Frame geometry packing is benchmarked without an OpenGL context.
+INCLUDEPATH += $$BaseDirectory/renderers
+
+HEADERS += AdvectionBenchmark.h \
+           CodecBenchmark.h \
+           GridBenchmark.h \
+           KernelBenchmark.h \
+           PressureBenchmark.h \
+           RenderBenchmark.h \
+           ScenarioBenchmark.h \
+           $$BaseDirectory/renderers/FrameGeometry.h
+
+SOURCES += benchmarks.cpp \
+           $$BaseDirectory/renderers/FrameGeometry.cpp
+
+QMAKE_CXXFLAGS += -std=c++11
+LIBS    += -lbenchmark -lpthread
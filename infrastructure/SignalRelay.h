@@ -29,6 +29,9 @@ class SignalRelay : public QObject
     // Extend this with additional signals here!
     void resetSimulation();
 
+    // Emitted when the simulation has published a new frame to draw.
+    void frameAvailable();
+
   private:
     SignalRelay() {}
     static SignalRelay *_instance;
@@ -1,34 +1,43 @@
 #include <QtGui/QApplication>
-#include <QTimer>
+#include <cstdio>
 #include <vector>
 #include <algorithm>
 #include "MainWindow.h"
-#include "FluidSolver.h"
+#include "QFluidSolver.h"
+#include "Scenario.h"
 
 using namespace std;
 
 
 // TODO - YUCK - This global variable is a temporary hack!!!
-FluidSolver *solver = NULL;
+QFluidSolver *solver = NULL;
 
 int main(int argc, char *argv[])
 {
   // Create the Qt application.
   QApplication app(argc, argv);
 
-  // Instantiate the Fluid Solver using the initial velocity field.
-  solver = new FluidSolver(8.0f, 8.0f);
+  // Set up the scenario file given on the command line, or the default
+  // scene without one.
+  Scenario scenario = Scenario::makeDefault(8, 8);
+  if (argc > 1 && !scenario.load(argv[1])) {
+    fprintf(stderr, "Unable to load %s: %s\n", argv[1],
+	    scenario.getError().c_str());
+    return 1;
+  }
+
+  // Instantiate the Fluid Solver from the scenario.  It starts simulating on
+  // its own thread right away.
+  solver = new QFluidSolver(scenario);
   
   // Create and realize UI widgets.
   MainWindow window;
   window.resize(window.sizeHint());
   window.show();
 
-  // Kick off a timer to calculate new frames.
-  QTimer *timer = new QTimer(solver);
-  QObject::connect(timer, SIGNAL(timeout()), solver, SLOT(advanceFrame()));
-  timer->start();
-
   // Begin the Qt event loop.
-  return app.exec();
+  const int result = app.exec();
+  delete solver;
+  solver = NULL;
+  return result;
 }
@@ -2,9 +2,8 @@
 #include <cstdio>
 
 // TODO - YUCK - This global variable is a temporary hack!!!
-#include "FluidSolver.h"
-extern FluidSolver *solver;
-using std::vector;
+#include "QFluidSolver.h"
+extern QFluidSolver *solver;
 
 QGLFormat CompatibilityRenderer::getFormat()
 {
@@ -81,12 +80,11 @@ void CompatibilityRenderer::resize(int pixWidth, int pixHeight)
 }
 
 
-void CompatibilityRenderer::drawGrid(const Grid &grid, 
-                                     const vector<Vector2> &particles)
+void CompatibilityRenderer::drawGrid(const FrameSnapshot &frame)
 {
-  // Get grid dimensions.
-  float height = grid.getRowCount();
-  float width  = grid.getColCount();
+  // Get grid dimensions, counted in grid lines.
+  float height = frame.getHeight() + 1;
+  float width  = frame.getWidth() + 1;
 
   // Clear the existing framebuffer contents.
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -114,13 +112,13 @@ void CompatibilityRenderer::drawGrid(const Grid &grid,
   // Color the cells gray if they currently contain liquid.
   glPushAttrib(GL_DEPTH_BUFFER_BIT);
   glDepthMask(GL_FALSE);
-  for (unsigned y = 0; y < height; ++y) {
-    for (unsigned x = 0; x < width; ++x) {
-      if (grid(x, y).cellType == Cell::SOLID)
+  for (unsigned y = 0; y < height - 1; ++y) {
+    for (unsigned x = 0; x < width - 1; ++x) {
+      if (frame.cellType(x, y) == Cell::SOLID)
 	continue;
-      if (grid(x, y).cellType == Cell::FLUID)
+      if (frame.cellType(x, y) == Cell::FLUID)
 	glColor4f(0.65f, 0.65f, 1.0f, 0.1f);
-      if (grid(x, y).cellType == Cell::AIR)
+      if (frame.cellType(x, y) == Cell::AIR)
 	glColor4f(1.0f, 1.0f, 1.0f, 0.1f);
       glBegin(GL_TRIANGLES);
       glVertex2f(x, y);
@@ -136,15 +134,18 @@ void CompatibilityRenderer::drawGrid(const Grid &grid,
 
   // Draw the MAC velocity vectors.
   glColor4f(0.5f, 0.0f, 0.0f, 1.0f);
-  for (unsigned y = 0; y < height; ++y) {
+  for (unsigned y = 0; y < height - 1; ++y) {
     for (unsigned x = 0; x < width; ++x) {
-      float xV = grid(x, y).vel[Cell::X] * 0.5f;
+      float xV = frame.u(x, y) * 0.5f;
       glBegin(GL_LINES);
       glVertex2f(x, y + 0.5f);
       glVertex2f(x + xV, y + 0.5f);
       glEnd();
-
-      float yV = grid(x, y).vel[Cell::Y] * 0.5f;
+    }
+  }
+  for (unsigned y = 0; y < height; ++y) {
+    for (unsigned x = 0; x < width - 1; ++x) {
+      float yV = frame.v(x, y) * 0.5f;
       glBegin(GL_LINES);
       glVertex2f(x + 0.5f, y);
       glVertex2f(x + 0.5f, y + yV);
@@ -154,22 +155,23 @@ void CompatibilityRenderer::drawGrid(const Grid &grid,
 
   // Draw the velocity vector at the center of each cell.
   glColor4f(1.0f, 1.0f, 0.0f, 1.0f);
-  for (float y = 0.5f; y < grid.getHeight(); y += 1.0f) {
-    for (float x = 0.5f; x < grid.getWidth(); x += 1.0f) {
-      Vector2 vec = grid.getVelocity(Vector2(x, y)) * 0.5;
+  for (unsigned j = 0; j < frame.getHeight(); ++j) {
+    for (unsigned i = 0; i < frame.getWidth(); ++i) {
+      const Vector2 velocity = frame.getCellVelocity(i, j);
       glBegin(GL_LINES);
-      glVertex2f(x, y);
-      glVertex2f(x + vec.x, y + vec.y);
+      glVertex2f(i + 0.5f, j + 0.5f);
+      glVertex2f(i + 0.5f + velocity.x * 0.5f, j + 0.5f + velocity.y * 0.5f);
       glEnd();
     }
   }
 
   glColor4f(0.0f, 0.6f, 0.8f, 1.0f);
   glBegin(GL_POINTS);
-  vector<Vector2>::const_iterator itr = particles.begin();
-  for(; itr != particles.end(); ++itr)
+  const float *px = frame.particleXData();
+  const float *py = frame.particleYData();
+  for (unsigned k = 0; k < frame.getParticleCount(); ++k)
   {
-    glVertex2f(itr->x, itr->y);
+    glVertex2f(px[k], py[k]);
   }
   glEnd();
        
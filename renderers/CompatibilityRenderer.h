@@ -4,7 +4,7 @@
 #include <QGLWidget>
 #include <vector>
 #include "IFluidRenderer.h"
-#include "Grid.h"
+#include "FrameSnapshot.h"
 
 
 class CompatibilityRenderer : public IFluidRenderer
@@ -59,13 +59,11 @@ public:
   // Should typically be called from the FluidSolver class.
   //
   // Arguments:
-  //   Grid &grid - The grid object containing all simulation cell data.
-  //   vector<Vector2> &particles- The particles visually representing the fluid.
+  //   FrameSnapshot &frame - The grid and particles at the end of a frame.
   //
   // Returns:
   //   None
-  virtual void drawGrid(const Grid &grid, 
-                        const std::vector<Vector2> &particles);
+  virtual void drawGrid(const FrameSnapshot &frame);
 };
 
 #endif // __COMPATIBILITY_RENDERER_H__
@@ -0,0 +1,346 @@
+#include "CoreProfileRenderer.h"
+#include <QCoreApplication>
+#include <cstdio>
+#include <vector>
+#include "glsw.h"
+
+// Texture formats from OpenGL 3.0, which older headers may not define.
+#ifndef GL_R8
+#define GL_R8 0x8229
+#endif
+#ifndef GL_R32F
+#define GL_R32F 0x822E
+#endif
+
+namespace
+{
+  // Pressure at which fluid cells are colored halfway between the fluid's
+  // tint and the colormap's extremes.
+  const float PRESSURE_SCALE = 100.0f;
+
+  // The particle coordinates' vertex attributes.
+  enum { X_ATTRIBUTE = 0, Y_ATTRIBUTE };
+}
+
+
+CoreProfileRenderer::CoreProfileRenderer()
+  : _gl(),
+    _genVertexArrays(NULL),
+    _bindVertexArray(NULL),
+    _deleteVertexArrays(NULL),
+    _ready(false),
+    _particleBuffer(0),
+    _pixWidth(1),
+    _pixHeight(1),
+    _width(0),
+    _height(0)
+{
+  for (unsigned i = 0; i < PROGRAM_COUNT; ++i)
+    _programs[i] = 0;
+  for (unsigned i = 0; i < TEXTURE_COUNT; ++i)
+    _textures[i] = 0;
+  for (unsigned i = 0; i < VERTEX_ARRAY_COUNT; ++i)
+    _vertexArrays[i] = 0;
+}
+
+
+CoreProfileRenderer::~CoreProfileRenderer()
+{
+  // Nothing was created if initialize() was never called.
+  if (!_deleteVertexArrays)
+    return;
+  for (unsigned i = 0; i < PROGRAM_COUNT; ++i)
+    if (_programs[i])
+      _gl.glDeleteProgram(_programs[i]);
+  glDeleteTextures(TEXTURE_COUNT, _textures);
+  _deleteVertexArrays(VERTEX_ARRAY_COUNT, _vertexArrays);
+  _gl.glDeleteBuffers(1, &_particleBuffer);
+}
+
+
+QGLFormat CoreProfileRenderer::getFormat()
+{
+  // Specify the necessary OpenGL context attributes for this renderer.
+  QGLFormat glFormat;
+  glFormat.setVersion(3, 2);
+  glFormat.setProfile(QGLFormat::CoreProfile);
+  glFormat.setSwapInterval(1);
+  return glFormat;
+}
+
+
+void CoreProfileRenderer::initialize()
+{
+  _gl.initializeGLFunctions();
+  const QGLContext *context = QGLContext::currentContext();
+  _genVertexArrays = reinterpret_cast<GenVertexArrays>
+    (context->getProcAddress("glGenVertexArrays"));
+  _bindVertexArray = reinterpret_cast<BindVertexArray>
+    (context->getProcAddress("glBindVertexArray"));
+  _deleteVertexArrays = reinterpret_cast<DeleteVertexArrays>
+    (context->getProcAddress("glDeleteVertexArrays"));
+
+  // Load the shaders from the source tree, next to the build directories.
+  const QByteArray shaderPath = QString(QCoreApplication::applicationDirPath()
+					+ "/../renderers/shaders/").toLocal8Bit();
+  glswInit();
+  glswSetPath(shaderPath.constData(), ".glsl");
+  glswAddDirectiveToken("", "#version 150");
+  _programs[CELL_PROGRAM] = loadProgram("Fluid.Cells.Vertex",
+					"Fluid.Cells.Fragment");
+  _programs[GLYPH_PROGRAM] = loadProgram("Fluid.Glyphs.Vertex",
+					 "Fluid.Color.Fragment");
+  _programs[PARTICLE_PROGRAM] = loadProgram("Fluid.Particles.Vertex",
+					    "Fluid.Color.Fragment");
+  glswShutdown();
+  _ready = _programs[CELL_PROGRAM] && _programs[GLYPH_PROGRAM] &&
+    _programs[PARTICLE_PROGRAM];
+
+  // Bind each field texture to its own unit for good, and point the
+  // samplers at them.
+  glGenTextures(TEXTURE_COUNT, _textures);
+  for (unsigned i = 0; i < TEXTURE_COUNT; ++i) {
+    _gl.glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, _textures[i]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  if (_ready) {
+    const GLuint cells = _programs[CELL_PROGRAM];
+    _gl.glUseProgram(cells);
+    _gl.glUniform1i(_gl.glGetUniformLocation(cells, "pressures"),
+		    PRESSURE_TEXTURE);
+    _gl.glUniform1i(_gl.glGetUniformLocation(cells, "cellTypes"),
+		    CELL_TYPE_TEXTURE);
+    _gl.glUniform1f(_gl.glGetUniformLocation(cells, "pressureScale"),
+		    PRESSURE_SCALE);
+    const GLuint glyphs = _programs[GLYPH_PROGRAM];
+    _gl.glUseProgram(glyphs);
+    _gl.glUniform1i(_gl.glGetUniformLocation(glyphs, "uVelocities"),
+		    U_TEXTURE);
+    _gl.glUniform1i(_gl.glGetUniformLocation(glyphs, "vVelocities"),
+		    V_TEXTURE);
+    _gl.glUseProgram(0);
+  }
+
+  // The particle vertex array reads X and Y from separate halves of the
+  // particle buffer; the attribute pointers are set once the size is known.
+  _genVertexArrays(VERTEX_ARRAY_COUNT, _vertexArrays);
+  _gl.glGenBuffers(1, &_particleBuffer);
+  _bindVertexArray(_vertexArrays[PARTICLE_VERTEX_ARRAY]);
+  _gl.glEnableVertexAttribArray(X_ATTRIBUTE);
+  _gl.glEnableVertexAttribArray(Y_ATTRIBUTE);
+  _bindVertexArray(0);
+
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glDisable(GL_DEPTH_TEST);
+  glPointSize(2.0f);
+}
+
+
+void CoreProfileRenderer::resize(int pixWidth, int pixHeight)
+{
+  glViewport(0, 0, pixWidth, pixHeight);
+  _pixWidth = pixWidth > 0 ? pixWidth : 1;
+  _pixHeight = pixHeight > 0 ? pixHeight : 1;
+}
+
+
+void CoreProfileRenderer::drawGrid(const FrameSnapshot &frame)
+{
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (!_ready)
+    return;
+
+  // Upload the fields, one row after another, as each texture is laid out
+  // exactly like the snapshot's arrays.
+  const unsigned width  = frame.getWidth();
+  const unsigned height = frame.getHeight();
+  if (width != _width || height != _height)
+    allocateTextures(width, height);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  _gl.glActiveTexture(GL_TEXTURE0 + U_TEXTURE);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width + 1, height, GL_RED,
+		  GL_FLOAT, frame.uData());
+  _gl.glActiveTexture(GL_TEXTURE0 + V_TEXTURE);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height + 1, GL_RED,
+		  GL_FLOAT, frame.vData());
+  _gl.glActiveTexture(GL_TEXTURE0 + PRESSURE_TEXTURE);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED,
+		  GL_FLOAT, frame.pressureData());
+  _gl.glActiveTexture(GL_TEXTURE0 + CELL_TYPE_TEXTURE);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED,
+		  GL_UNSIGNED_BYTE, frame.cellTypeData());
+
+  // Upload the particles, orphaning the buffer's previous storage so the
+  // upload never waits for the last frame's draw.
+  const unsigned particles = frame.getParticleCount();
+  const unsigned coordinateBytes = particles * sizeof(float);
+  _gl.glBindBuffer(GL_ARRAY_BUFFER, _particleBuffer);
+  _gl.glBufferData(GL_ARRAY_BUFFER, 2 * coordinateBytes, NULL,
+		   GL_STREAM_DRAW);
+  if (particles > 0) {
+    _gl.glBufferSubData(GL_ARRAY_BUFFER, 0, coordinateBytes,
+			frame.particleXData());
+    _gl.glBufferSubData(GL_ARRAY_BUFFER, coordinateBytes, coordinateBytes,
+			frame.particleYData());
+  }
+
+  updateProjection();
+
+  // Fill the cells and draw the grid lines with a single quad.
+  _bindVertexArray(_vertexArrays[EMPTY_VERTEX_ARRAY]);
+  _gl.glUseProgram(_programs[CELL_PROGRAM]);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+  // Draw a velocity glyph, two vertices, per cell.
+  _gl.glUseProgram(_programs[GLYPH_PROGRAM]);
+  glDrawArrays(GL_LINES, 0, 2 * width * height);
+
+  // Draw the particles.  With a buffer bound, the attribute "pointers" are
+  // offsets into it.
+  const GLvoid *yOffset =
+    reinterpret_cast<const GLvoid *>(size_t(coordinateBytes));
+  _bindVertexArray(_vertexArrays[PARTICLE_VERTEX_ARRAY]);
+  _gl.glVertexAttribPointer(X_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, 0, NULL);
+  _gl.glVertexAttribPointer(Y_ATTRIBUTE, 1, GL_FLOAT, GL_FALSE, 0, yOffset);
+  _gl.glUseProgram(_programs[PARTICLE_PROGRAM]);
+  glDrawArrays(GL_POINTS, 0, particles);
+
+  _gl.glUseProgram(0);
+  _bindVertexArray(0);
+  _gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+GLuint CoreProfileRenderer::loadProgram(const char *vertexKey,
+					const char *fragmentKey)
+{
+  const GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexKey);
+  const GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentKey);
+  if (!vertexShader || !fragmentShader) {
+    _gl.glDeleteShader(vertexShader);
+    _gl.glDeleteShader(fragmentShader);
+    return 0;
+  }
+
+  GLuint program = _gl.glCreateProgram();
+  _gl.glAttachShader(program, vertexShader);
+  _gl.glAttachShader(program, fragmentShader);
+  _gl.glBindAttribLocation(program, X_ATTRIBUTE, "x");
+  _gl.glBindAttribLocation(program, Y_ATTRIBUTE, "y");
+  _gl.glLinkProgram(program);
+
+  // The shaders are freed along with the program.
+  _gl.glDeleteShader(vertexShader);
+  _gl.glDeleteShader(fragmentShader);
+
+  GLint linked = GL_FALSE;
+  _gl.glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    GLint length = 0;
+    _gl.glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(length + 1, '\0');
+    _gl.glGetProgramInfoLog(program, length, NULL, &log[0]);
+    fprintf(stderr, "Unable to link %s and %s:\n%s\n", vertexKey,
+	    fragmentKey, &log[0]);
+    _gl.glDeleteProgram(program);
+    program = 0;
+  }
+  return program;
+}
+
+
+GLuint CoreProfileRenderer::compileShader(GLenum type, const char *key)
+{
+  const char *source = glswGetShader(key);
+  if (!source) {
+    fprintf(stderr, "Unable to load shader %s: %s\n", key, glswGetError());
+    return 0;
+  }
+
+  GLuint shader = _gl.glCreateShader(type);
+  _gl.glShaderSource(shader, 1, &source, NULL);
+  _gl.glCompileShader(shader);
+
+  GLint compiled = GL_FALSE;
+  _gl.glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (!compiled) {
+    GLint length = 0;
+    _gl.glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(length + 1, '\0');
+    _gl.glGetShaderInfoLog(shader, length, NULL, &log[0]);
+    fprintf(stderr, "Unable to compile shader %s:\n%s\n", key, &log[0]);
+    _gl.glDeleteShader(shader);
+    shader = 0;
+  }
+  return shader;
+}
+
+
+void CoreProfileRenderer::allocateTextures(unsigned width, unsigned height)
+{
+  // Velocities and pressures are kept as 32-bit floats, and cell types as
+  // normalized bytes, read back in the shaders as Cell::Type / 255.
+  _gl.glActiveTexture(GL_TEXTURE0 + U_TEXTURE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width + 1, height, 0, GL_RED,
+	       GL_FLOAT, NULL);
+  _gl.glActiveTexture(GL_TEXTURE0 + V_TEXTURE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height + 1, 0, GL_RED,
+	       GL_FLOAT, NULL);
+  _gl.glActiveTexture(GL_TEXTURE0 + PRESSURE_TEXTURE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED,
+	       GL_FLOAT, NULL);
+  _gl.glActiveTexture(GL_TEXTURE0 + CELL_TYPE_TEXTURE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED,
+	       GL_UNSIGNED_BYTE, NULL);
+
+  _width = width;
+  _height = height;
+}
+
+
+void CoreProfileRenderer::updateProjection()
+{
+  // Fit the grid plus a one cell margin, then widen whichever axis has room
+  // to spare so that cells stay square.
+  const float paddedWidth  = _width + 2.0f;
+  const float paddedHeight = _height + 2.0f;
+  float xMin = -1.0f, xMax = _width + 1.0f;
+  float yMin = -1.0f, yMax = _height + 1.0f;
+  if (paddedWidth * _pixHeight > paddedHeight * _pixWidth) {
+    const float span = paddedWidth * _pixHeight / _pixWidth;
+    yMin = 0.5f * (_height - span);
+    yMax = yMin + span;
+  }
+  else {
+    const float span = paddedHeight * _pixWidth / _pixHeight;
+    xMin = 0.5f * (_width - span);
+    xMax = xMin + span;
+  }
+
+  // A column-major orthographic projection.
+  GLfloat projection[16] = { 0.0f };
+  projection[0]  = 2.0f / (xMax - xMin);
+  projection[5]  = 2.0f / (yMax - yMin);
+  projection[10] = -1.0f;
+  projection[12] = -(xMax + xMin) / (xMax - xMin);
+  projection[13] = -(yMax + yMin) / (yMax - yMin);
+  projection[15] = 1.0f;
+
+  const GLfloat gridSize[2] = { GLfloat(_width), GLfloat(_height) };
+  for (unsigned i = 0; i < PROGRAM_COUNT; ++i) {
+    const GLuint program = _programs[i];
+    _gl.glUseProgram(program);
+    _gl.glUniformMatrix4fv(_gl.glGetUniformLocation(program, "projection"),
+			   1, GL_FALSE, projection);
+    if (i == CELL_PROGRAM)
+      _gl.glUniform2fv(_gl.glGetUniformLocation(program, "gridSize"), 1,
+		       gridSize);
+    if (i == GLYPH_PROGRAM)
+      _gl.glUniform1i(_gl.glGetUniformLocation(program, "gridWidth"),
+		      _width);
+  }
+}
@@ -0,0 +1,122 @@
+#ifndef __CORE_PROFILE_RENDERER_H__
+#define __CORE_PROFILE_RENDERER_H__
+
+#include <QGLFunctions>
+#include <QGLWidget>
+#include "IFluidRenderer.h"
+#include "FrameSnapshot.h"
+
+
+// Renders the simulation with an OpenGL 3.2 Core profile context, doing all
+// of the drawing work in shaders.  Each frame the velocity, pressure and cell
+// type fields are uploaded as textures, one texel per face or cell, and the
+// particle coordinates as a vertex buffer.  Shaders then color every cell by
+// its type and pressure, draw the grid lines, and generate a velocity glyph
+// per cell; nothing else is computed on the CPU.
+//
+// The shaders live in renderers/shaders/Fluid.glsl and are loaded through
+// glsw when the renderer is initialized.
+class CoreProfileRenderer : public IFluidRenderer
+{
+public:
+  // Constructor
+  //
+  // Arguments:
+  //   None
+  CoreProfileRenderer();
+
+  // Destructor.  Frees all OpenGL objects, so the renderer's context must be
+  // current.
+  //
+  // Arguments:
+  //   None
+  virtual ~CoreProfileRenderer();
+
+  // Provides the required OpenGL context arguments for this renderer.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   QGLFormat - A 3.2 Core profile format.
+  virtual QGLFormat getFormat();
+
+  // Loads and compiles the shaders, and creates the textures and buffers.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  virtual void initialize();
+
+  // Redefines the viewport.  The projection is fitted to each frame's grid
+  // when it is drawn.
+  //
+  // Arguments:
+  //   int pixWidth - The new width of the widget, in pixels.
+  //   int pixHeight - The new height of the widget, in pixels.
+  //
+  // Returns:
+  //   None
+  virtual void resize(int pixWidth, int pixHeight);
+
+  // Uploads a frame's fields and particles, and renders them.
+  //
+  // Arguments:
+  //   FrameSnapshot &frame - The grid and particles at the end of a frame.
+  //
+  // Returns:
+  //   None
+  virtual void drawGrid(const FrameSnapshot &frame);
+
+private:
+  // The shader programs.
+  enum Program { CELL_PROGRAM = 0, GLYPH_PROGRAM, PARTICLE_PROGRAM,
+		 PROGRAM_COUNT };
+
+  // The field textures, in the order of the texture units they are bound to.
+  enum Texture { U_TEXTURE = 0, V_TEXTURE, PRESSURE_TEXTURE,
+		 CELL_TYPE_TEXTURE, TEXTURE_COUNT };
+
+  // The vertex arrays: one with no attributes, for geometry generated in
+  // shaders, and one for the particles.
+  enum VertexArray { EMPTY_VERTEX_ARRAY = 0, PARTICLE_VERTEX_ARRAY,
+		     VERTEX_ARRAY_COUNT };
+
+  // Vertex array object entry points, which QGLFunctions lacks.
+  typedef void (APIENTRY *GenVertexArrays)(GLsizei n, GLuint *arrays);
+  typedef void (APIENTRY *BindVertexArray)(GLuint array);
+  typedef void (APIENTRY *DeleteVertexArrays)(GLsizei n,
+					       const GLuint *arrays);
+
+  // Compiles a program from two glsw shader keys.  Prints a message and
+  // returns 0 on failure.
+  GLuint loadProgram(const char *vertexKey, const char *fragmentKey);
+
+  // Compiles one shader.  Prints a message and returns 0 on failure.
+  GLuint compileShader(GLenum type, const char *key);
+
+  // Reallocates the textures for a new grid size.
+  void allocateTextures(unsigned width, unsigned height);
+
+  // Sets every program's projection to fit the grid in the viewport, with a
+  // margin of one cell, without stretching it.
+  void updateProjection();
+
+  QGLFunctions _gl;                   // Shader and buffer entry points.
+  GenVertexArrays _genVertexArrays;
+  BindVertexArray _bindVertexArray;
+  DeleteVertexArrays _deleteVertexArrays;
+  bool _ready;                        // True if every program linked.
+  GLuint _programs[PROGRAM_COUNT];    // Shader programs; 0 if unlinked.
+  GLuint _textures[TEXTURE_COUNT];    // Field textures.
+  GLuint _vertexArrays[VERTEX_ARRAY_COUNT]; // Vertex array objects.
+  GLuint _particleBuffer;             // Particle X then Y coordinates.
+  int _pixWidth;                      // Viewport size, in pixels.
+  int _pixHeight;
+  unsigned _width;                    // Grid size of the textures, in
+  unsigned _height;                   // cells.
+};
+
+#endif // __CORE_PROFILE_RENDERER_H__
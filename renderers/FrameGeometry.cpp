@@ -0,0 +1,143 @@
+#include "FrameGeometry.h"
+#include "Cell.h"
+
+namespace
+{
+  // Vertex colors, matching those of the CompatibilityRenderer.
+  const unsigned char GRID_LINE_COLOR[4]     = {  51,  51,  51, 255 };
+  const unsigned char FLUID_CELL_COLOR[4]    = { 166, 166, 255,  26 };
+  const unsigned char AIR_CELL_COLOR[4]      = { 255, 255, 255,  26 };
+  const unsigned char FACE_VELOCITY_COLOR[4] = { 128,   0,   0, 255 };
+  const unsigned char CELL_VELOCITY_COLOR[4] = { 255, 255,   0, 255 };
+  const unsigned char PARTICLE_COLOR[4]      = {   0, 153, 204, 255 };
+
+  // Writes a vertex and returns a pointer to the next one.
+  inline FrameGeometry::Vertex * putVertex(FrameGeometry::Vertex *vertex,
+					 float x, float y,
+					 const unsigned char color[4])
+  {
+    vertex->x = x;
+    vertex->y = y;
+    vertex->color[0] = color[0];
+    vertex->color[1] = color[1];
+    vertex->color[2] = color[2];
+    vertex->color[3] = color[3];
+    return vertex + 1;
+  }
+}
+
+
+FrameGeometry::FrameGeometry()
+  : _gridLines(),
+    _frame(),
+    _width(0),
+    _height(0)
+{
+  for (unsigned i = 0; i < BATCH_COUNT; ++i)
+    _first[i] = _count[i] = 0;
+}
+
+
+bool FrameGeometry::build(const FrameSnapshot &frame)
+{
+  const unsigned width  = frame.getWidth();
+  const unsigned height = frame.getHeight();
+  const bool resized = _gridLines.empty() || width != _width ||
+    height != _height;
+  if (resized)
+    buildGridLines(width, height);
+
+  // Size the array for the most vertices the frame could need: a quad for
+  // every cell, a line for every face and cell center, and every particle.
+  // Solid cells are skipped, so fewer may be used.  The array only grows:
+  // a frame needing no more than an earlier one reuses its vertices as they
+  // are, and only the counts below say how many are in use.
+  const unsigned cells = width * height;
+  const unsigned faces = (width + 1) * height + width * (height + 1);
+  const unsigned particles = frame.getParticleCount();
+  const unsigned maxFills = 6 * cells;
+  const unsigned maxLines = 2 * (faces + cells);
+  if (_frame.size() < maxFills + maxLines + particles)
+    _frame.resize(maxFills + maxLines + particles);
+
+  // Tint every non-solid cell with two triangles.
+  Vertex *first = &_frame[0];
+  Vertex *next = first;
+  for (unsigned y = 0; y < height; ++y) {
+    for (unsigned x = 0; x < width; ++x) {
+      const unsigned char type = frame.cellType(x, y);
+      if (type == Cell::SOLID)
+	continue;
+      const unsigned char *color =
+	type == Cell::FLUID ? FLUID_CELL_COLOR : AIR_CELL_COLOR;
+      next = putVertex(next, x, y, color);
+      next = putVertex(next, x + 1, y, color);
+      next = putVertex(next, x + 1, y + 1, color);
+      next = putVertex(next, x + 1, y + 1, color);
+      next = putVertex(next, x, y + 1, color);
+      next = putVertex(next, x, y, color);
+    }
+  }
+  _first[CELL_FILLS] = 0;
+  _count[CELL_FILLS] = next - first;
+
+  // Draw each face velocity from the center of its face, then the velocity
+  // at each cell center, all at half length.
+  _first[VELOCITY_LINES] = next - first;
+  for (unsigned y = 0; y < height; ++y) {
+    for (unsigned x = 0; x <= width; ++x) {
+      next = putVertex(next, x, y + 0.5f, FACE_VELOCITY_COLOR);
+      next = putVertex(next, x + frame.u(x, y) * 0.5f, y + 0.5f,
+		       FACE_VELOCITY_COLOR);
+    }
+  }
+  for (unsigned y = 0; y <= height; ++y) {
+    for (unsigned x = 0; x < width; ++x) {
+      next = putVertex(next, x + 0.5f, y, FACE_VELOCITY_COLOR);
+      next = putVertex(next, x + 0.5f, y + frame.v(x, y) * 0.5f,
+		       FACE_VELOCITY_COLOR);
+    }
+  }
+  for (unsigned y = 0; y < height; ++y) {
+    for (unsigned x = 0; x < width; ++x) {
+      const Vector2 velocity = frame.getCellVelocity(x, y);
+      next = putVertex(next, x + 0.5f, y + 0.5f, CELL_VELOCITY_COLOR);
+      next = putVertex(next, x + 0.5f + velocity.x * 0.5f,
+		       y + 0.5f + velocity.y * 0.5f, CELL_VELOCITY_COLOR);
+    }
+  }
+  _count[VELOCITY_LINES] = (next - first) - _first[VELOCITY_LINES];
+
+  _first[PARTICLES] = next - first;
+  const float *px = frame.particleXData();
+  const float *py = frame.particleYData();
+  for (unsigned k = 0; k < particles; ++k)
+    next = putVertex(next, px[k], py[k], PARTICLE_COLOR);
+  _count[PARTICLES] = particles;
+
+  return resized;
+}
+
+
+void FrameGeometry::buildGridLines(unsigned width, unsigned height)
+{
+  // Like the CompatibilityRenderer, draw one more line along each axis than
+  // the grid has cells, framing the ghost cells along the top and right.
+  const unsigned cols = width + 1;
+  const unsigned rows = height + 1;
+  _gridLines.resize(2 * (cols + 1) + 2 * (rows + 1));
+  Vertex *next = &_gridLines[0];
+  for (unsigned i = 0; i <= cols; ++i) {
+    next = putVertex(next, i, 0, GRID_LINE_COLOR);
+    next = putVertex(next, i, rows, GRID_LINE_COLOR);
+  }
+  for (unsigned i = 0; i <= rows; ++i) {
+    next = putVertex(next, 0, i, GRID_LINE_COLOR);
+    next = putVertex(next, cols, i, GRID_LINE_COLOR);
+  }
+
+  _width = width;
+  _height = height;
+  _first[GRID_LINES] = 0;
+  _count[GRID_LINES] = _gridLines.size();
+}
@@ -0,0 +1,125 @@
+#ifndef __FRAME_GEOMETRY_H__
+#define __FRAME_GEOMETRY_H__
+
+#include <vector>
+#include "FrameSnapshot.h"
+
+// Packs everything a renderer draws for one frame into flat vertex arrays,
+// so that a whole frame can be drawn with one call per primitive type rather
+// than one per cell, face or particle.  Geometry is split into batches:
+//
+//   GRID_LINES     - Grid lines (GL_LINES); only rebuilt when the size changes.
+//   CELL_FILLS     - Tinted fluid and air cells (GL_TRIANGLES).
+//   VELOCITY_LINES - Face velocities and cell center velocities (GL_LINES).
+//   PARTICLES      - Marker particles (GL_POINTS).
+//
+// Grid lines live in an array of their own; the other batches are stored one
+// after another in a single array that is rebuilt every frame.  Both arrays
+// keep their storage between frames.  This class makes no OpenGL calls, so
+// the packing cost can be measured without a context.
+class FrameGeometry
+{
+public:
+  // An interleaved vertex: a world position and an RGBA color.
+  struct Vertex {
+    float x, y;
+    unsigned char color[4];
+  };
+
+  // The batches geometry is drawn in, in drawing order.
+  enum Batch {
+    GRID_LINES = 0,
+    CELL_FILLS,
+    VELOCITY_LINES,
+    PARTICLES,
+    BATCH_COUNT
+  };
+
+  // Constructs empty geometry.
+  //
+  // Arguments:
+  //   None
+  FrameGeometry();
+
+  // Rebuilds the geometry from a frame.
+  //
+  // Arguments:
+  //   FrameSnapshot &frame - The frame to draw.
+  //
+  // Returns:
+  //   bool - True if the grid lines changed, and must be uploaded again.
+  bool build(const FrameSnapshot &frame);
+
+  // Returns the grid line vertices, or the vertices rebuilt every frame.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   Vertex * - The first vertex, or NULL if there are none.
+  //   unsigned - The number of vertices.
+  inline const Vertex * gridLineData() const;
+  inline unsigned getGridLineVertexCount() const;
+  inline const Vertex * frameData() const;
+  inline unsigned getFrameVertexCount() const;
+
+  // Returns where a batch lies within its array.  GRID_LINES always starts
+  // at 0 in the grid line array; the others are in the frame array.
+  //
+  // Arguments:
+  //   Batch batch - The batch.
+  //
+  // Returns:
+  //   unsigned - The index of the batch's first vertex, or its vertex count.
+  inline unsigned getFirstVertex(Batch batch) const;
+  inline unsigned getVertexCount(Batch batch) const;
+
+private:
+  // Rebuilds the grid lines for a new grid size.
+  void buildGridLines(unsigned width, unsigned height);
+
+  std::vector<Vertex> _gridLines;   // Grid line vertices.
+  std::vector<Vertex> _frame;       // Vertices of the other batches.
+  unsigned _width;                  // Grid size the lines were built for.
+  unsigned _height;
+  unsigned _first[BATCH_COUNT];     // First vertex of each batch.
+  unsigned _count[BATCH_COUNT];     // Vertex count of each batch.
+};
+
+
+const FrameGeometry::Vertex * FrameGeometry::gridLineData() const
+{
+  return _gridLines.empty() ? NULL : &_gridLines[0];
+}
+
+
+unsigned FrameGeometry::getGridLineVertexCount() const
+{
+  return _count[GRID_LINES];
+}
+
+
+const FrameGeometry::Vertex * FrameGeometry::frameData() const
+{
+  return _frame.empty() ? NULL : &_frame[0];
+}
+
+
+unsigned FrameGeometry::getFrameVertexCount() const
+{
+  return _count[CELL_FILLS] + _count[VELOCITY_LINES] + _count[PARTICLES];
+}
+
+
+unsigned FrameGeometry::getFirstVertex(Batch batch) const
+{
+  return _first[batch];
+}
+
+
+unsigned FrameGeometry::getVertexCount(Batch batch) const
+{
+  return _count[batch];
+}
+
+#endif // __FRAME_GEOMETRY_H__
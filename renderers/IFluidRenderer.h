@@ -3,7 +3,7 @@
 
 #include <QGLWidget>
 #include <vector>
-#include "Grid.h"
+#include "FrameSnapshot.h"
 
 class IFluidRenderer
 {
@@ -46,16 +46,14 @@ public:
   //   None
   virtual void resize(int pixWidth, int pixHeight) = 0;
 
-  // Renders the fluid simulation grid.
+  // Renders a frame of the fluid simulation.
   //
   // Arguments:
-  //   Grid &grid - The grid object containing all simulation cell data.
-  //   vector<Vector2> &particles - The particles visually representing fluid.
+  //   FrameSnapshot &frame - The grid and particles at the end of a frame.
   //
   // Returns:
   //   None
-  virtual void drawGrid(const Grid &grid, 
-                        const std::vector<Vector2> &particles) = 0;
+  virtual void drawGrid(const FrameSnapshot &frame) = 0;
 };
 
 #endif // __FLUID_RENDERER_H__
@@ -0,0 +1,94 @@
+#include "VertexBufferRenderer.h"
+#include <cstddef>
+
+
+VertexBufferRenderer::VertexBufferRenderer()
+  : CompatibilityRenderer(),
+    _gl(),
+    _geometry()
+{
+  for (unsigned i = 0; i < BUFFER_COUNT; ++i)
+    _buffers[i] = 0;
+}
+
+
+VertexBufferRenderer::~VertexBufferRenderer()
+{
+  if (_buffers[0])
+    _gl.glDeleteBuffers(BUFFER_COUNT, _buffers);
+}
+
+
+void VertexBufferRenderer::initialize()
+{
+  CompatibilityRenderer::initialize();
+  _gl.initializeGLFunctions();
+  _gl.glGenBuffers(BUFFER_COUNT, _buffers);
+}
+
+
+void VertexBufferRenderer::drawGrid(const FrameSnapshot &frame)
+{
+  typedef FrameGeometry::Vertex Vertex;
+
+  // Upload the grid lines only when they change, and the rest every frame.
+  // Passing NULL to glBufferData() orphans the buffer's old storage, which
+  // may still be in use by the previous frame's draw calls.
+  if (_geometry.build(frame)) {
+    _gl.glBindBuffer(GL_ARRAY_BUFFER, _buffers[GRID_LINE_BUFFER]);
+    _gl.glBufferData(GL_ARRAY_BUFFER,
+		     _geometry.getGridLineVertexCount() * sizeof(Vertex),
+		     _geometry.gridLineData(), GL_STATIC_DRAW);
+  }
+  const unsigned frameBytes = _geometry.getFrameVertexCount() * sizeof(Vertex);
+  _gl.glBindBuffer(GL_ARRAY_BUFFER, _buffers[FRAME_BUFFER]);
+  _gl.glBufferData(GL_ARRAY_BUFFER, frameBytes, NULL, GL_STREAM_DRAW);
+  _gl.glBufferSubData(GL_ARRAY_BUFFER, 0, frameBytes, _geometry.frameData());
+
+  // Clear the existing framebuffer contents.
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // Push the current modelview matrix onto the stack, and store previous
+  // OpenGL state.
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glPushAttrib(GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT);
+  glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+
+  bindVertices(GRID_LINE_BUFFER);
+  glDrawArrays(GL_LINES, 0, _geometry.getGridLineVertexCount());
+
+  // Cell tints are translucent, so they must not hide what is drawn later.
+  bindVertices(FRAME_BUFFER);
+  glDepthMask(GL_FALSE);
+  glDrawArrays(GL_TRIANGLES,
+	       _geometry.getFirstVertex(FrameGeometry::CELL_FILLS),
+	       _geometry.getVertexCount(FrameGeometry::CELL_FILLS));
+  glDepthMask(GL_TRUE);
+  glDrawArrays(GL_LINES,
+	       _geometry.getFirstVertex(FrameGeometry::VELOCITY_LINES),
+	       _geometry.getVertexCount(FrameGeometry::VELOCITY_LINES));
+  glDrawArrays(GL_POINTS,
+	       _geometry.getFirstVertex(FrameGeometry::PARTICLES),
+	       _geometry.getVertexCount(FrameGeometry::PARTICLES));
+
+  // Restore previous OpenGL state and the previous modelview matrix.
+  _gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glPopClientAttrib();
+  glPopAttrib();
+  glPopMatrix();
+}
+
+
+void VertexBufferRenderer::bindVertices(Buffer buffer)
+{
+  // With a buffer bound, the array "pointers" are offsets into it.
+  typedef FrameGeometry::Vertex Vertex;
+  _gl.glBindBuffer(GL_ARRAY_BUFFER, _buffers[buffer]);
+  glVertexPointer(2, GL_FLOAT, sizeof(Vertex),
+		  reinterpret_cast<const GLvoid *>(offsetof(Vertex, x)));
+  glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex),
+		 reinterpret_cast<const GLvoid *>(offsetof(Vertex, color)));
+}
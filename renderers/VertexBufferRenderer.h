@@ -0,0 +1,70 @@
+#ifndef __VERTEX_BUFFER_RENDERER_H__
+#define __VERTEX_BUFFER_RENDERER_H__
+
+#include <QGLFunctions>
+#include "CompatibilityRenderer.h"
+#include "FrameGeometry.h"
+#include "FrameSnapshot.h"
+
+
+// Draws the same picture as the CompatibilityRenderer, but from vertex
+// buffer objects instead of immediate mode.  Each frame is packed by a
+// FrameGeometry and uploaded in one go, then drawn with one call per batch:
+// four draw calls per frame, however large the grid.
+//
+// Grid lines sit in a static buffer that is only refilled when the grid
+// size changes.  Everything else goes in a stream buffer that is orphaned
+// before each upload, so the driver can hand out fresh storage rather than
+// stall until the GPU has finished drawing the previous frame.
+class VertexBufferRenderer : public CompatibilityRenderer
+{
+public:
+  // Constructor
+  //
+  // Arguments:
+  //   None
+  VertexBufferRenderer();
+
+  // Destructor.  Frees the buffers, so the renderer's OpenGL context must be
+  // current.
+  //
+  // Arguments:
+  //   None
+  virtual ~VertexBufferRenderer();
+
+  // Performs all initial OpenGL commands, and creates the vertex buffers.
+  //
+  // Inherited from CompatibilityRenderer.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  virtual void initialize();
+
+  // Renders the fluid simulation grid, the contents of each cell, velocity
+  // vectors and particles, exactly as the CompatibilityRenderer does.
+  //
+  // Inherited from CompatibilityRenderer.
+  //
+  // Arguments:
+  //   FrameSnapshot &frame - The grid and particles at the end of a frame.
+  //
+  // Returns:
+  //   None
+  virtual void drawGrid(const FrameSnapshot &frame);
+
+private:
+  // The vertex buffers.
+  enum Buffer { GRID_LINE_BUFFER = 0, FRAME_BUFFER, BUFFER_COUNT };
+
+  // Points the vertex and color arrays at the start of a vertex buffer.
+  void bindVertices(Buffer buffer);
+
+  QGLFunctions _gl;                // Buffer object entry points.
+  GLuint _buffers[BUFFER_COUNT];   // Buffer object names; 0 until created.
+  FrameGeometry _geometry;         // The packed geometry of the last frame.
+};
+
+#endif // __VERTEX_BUFFER_RENDERER_H__
@@ -0,0 +1,118 @@
+// Shaders for the CoreProfileRenderer, loaded through glsw.  Each section
+// below is fetched with a key of the form "Fluid.<section>", and has a
+// "#version" directive prepended by the renderer.
+//
+// The fields are sampled from textures with one texel per cell or face:
+//   uVelocities - X face velocities, (width+1) x height
+//   vVelocities - Y face velocities, width x (height+1)
+//   pressures   - Cell pressures, width x height
+//   cellTypes   - Cell::Type / 255, width x height
+// World coordinates are measured in cells, with the origin at the grid's
+// bottom left corner.
+
+
+-- Cells.Vertex
+// Covers the grid with a triangle strip, generated without vertex data.
+uniform mat4 projection;
+uniform vec2 gridSize;
+out vec2 gridPosition;
+
+void main()
+{
+  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+  gridPosition = corner * gridSize;
+  gl_Position = projection * vec4(gridPosition, 0.0, 1.0);
+}
+
+
+-- Cells.Fragment
+// Colors fluid cells by pressure, air and solid cells flat, and draws the
+// grid lines one pixel wide at any zoom.
+uniform sampler2D cellTypes;
+uniform sampler2D pressures;
+uniform float pressureScale;
+in vec2 gridPosition;
+out vec4 fragColor;
+
+const float AIR   = 0.0;
+const float FLUID = 1.0;
+
+// Maps [-1, 1] from blue, through the fluid's tint, to red.
+vec3 colormap(float t)
+{
+  const vec3 low  = vec3(0.1, 0.3, 1.0);
+  const vec3 mid  = vec3(0.3, 0.3, 0.5);
+  const vec3 high = vec3(1.0, 0.3, 0.1);
+  return t < 0.0 ? mix(mid, low, -t) : mix(mid, high, t);
+}
+
+void main()
+{
+  ivec2 cell = ivec2(floor(gridPosition));
+  float type = floor(texelFetch(cellTypes, cell, 0).r * 255.0 + 0.5);
+  vec3 color;
+  if (type == FLUID) {
+    float pressure = texelFetch(pressures, cell, 0).r;
+    color = colormap(pressure / (abs(pressure) + pressureScale));
+  }
+  else if (type == AIR) {
+    color = vec3(0.05);
+  }
+  else {
+    color = vec3(0.25);
+  }
+
+  vec2 distance = abs(fract(gridPosition - 0.5) - 0.5) / fwidth(gridPosition);
+  float line = 1.0 - clamp(min(distance.x, distance.y), 0.0, 1.0);
+  fragColor = vec4(mix(color, vec3(0.2), line), 1.0);
+}
+
+
+-- Glyphs.Vertex
+// Draws the velocity at each cell center as a line of half its length.
+// Vertices 2k and 2k+1 are the ends of cell k's line.
+uniform mat4 projection;
+uniform sampler2D uVelocities;
+uniform sampler2D vVelocities;
+uniform int gridWidth;
+out vec4 color;
+
+void main()
+{
+  int index = gl_VertexID >> 1;
+  ivec2 cell = ivec2(index % gridWidth, index / gridWidth);
+  vec2 velocity =
+    0.5 * vec2(texelFetch(uVelocities, cell, 0).r +
+               texelFetch(uVelocities, cell + ivec2(1, 0), 0).r,
+               texelFetch(vVelocities, cell, 0).r +
+               texelFetch(vVelocities, cell + ivec2(0, 1), 0).r);
+  float tip = float(gl_VertexID & 1);
+  vec2 position = vec2(cell) + 0.5 + tip * 0.5 * velocity;
+  gl_Position = projection * vec4(position, 0.0, 1.0);
+  color = vec4(1.0, 1.0, 0.0, 1.0);
+}
+
+
+-- Particles.Vertex
+// Draws each marker particle as a point.
+uniform mat4 projection;
+in float x;
+in float y;
+out vec4 color;
+
+void main()
+{
+  gl_Position = projection * vec4(x, y, 0.0, 1.0);
+  color = vec4(0.0, 0.6, 0.8, 1.0);
+}
+
+
+-- Color.Fragment
+// Passes on the color computed per vertex.
+in vec4 color;
+out vec4 fragColor;
+
+void main()
+{
+  fragColor = color;
+}
@@ -0,0 +1,75 @@
+include(../config.pri)
+
+BaseDirectory = ..
+
+Release:DESTDIR     = $$BaseDirectory/release
+Release:OBJECTS_DIR = $$BaseDirectory/release/.obj
+Release:MOC_DIR     = $$BaseDirectory/release/.moc
+Release:RCC_DIR     = $$BaseDirectory/release/.rcc
+Release:UI_DIR      = $$BaseDirectory/release/.ui
+
+Debug:DESTDIR     = $$BaseDirectory/debug
+Debug:OBJECTS_DIR = $$BaseDirectory/debug/.obj
+Debug:MOC_DIR     = $$BaseDirectory/debug/.moc
+Debug:RCC_DIR     = $$BaseDirectory/debug/.rcc
+Debug:UI_DIR      = $$BaseDirectory/debug/.ui
+
+DEFINES += EIGEN_YES_I_KNOW_SPARSE_MODULE_IS_NOT_STABLE_YET
+
+# The simulation core.  It depends on neither QtGui nor OpenGL, so headless
+# targets include only this file.
+INCLUDEPATH += $$BaseDirectory/solver
+
+# Build with "qmake CONFIG+=profiling" to time every stage of the simulation
+# (see solver/Profiler.h).  Without it the instrumentation compiles out.
+profiling {
+    DEFINES += FLUID_PROFILING
+}
+
+# Build with "qmake CONFIG+=avx2" or "qmake CONFIG+=avx512" to interpolate
+# batches of velocity samples with SIMD gathers (see Grid::getVelocities()).
+# Eigen requires FMA alongside AVX-512.
+avx2 {
+    QMAKE_CXXFLAGS += -mavx2
+}
+avx512 {
+    QMAKE_CXXFLAGS += -mavx2 -mavx512f -mfma
+}
+
+SOURCES += $$BaseDirectory/solver/Vector2.cpp \
+           $$BaseDirectory/solver/CellBitmap.cpp \
+           $$BaseDirectory/solver/Checkpoint.cpp \
+           $$BaseDirectory/solver/FieldCodec.cpp \
+           $$BaseDirectory/solver/FluidSolver.cpp \
+           $$BaseDirectory/solver/FrameExporter.cpp \
+           $$BaseDirectory/solver/FrameLayout.cpp \
+           $$BaseDirectory/solver/FrameSnapshot.cpp \
+           $$BaseDirectory/solver/Grid.cpp \
+           $$BaseDirectory/solver/Cell.cpp \
+           $$BaseDirectory/solver/MultigridSolver.cpp \
+           $$BaseDirectory/solver/ParticleSystem.cpp \
+           $$BaseDirectory/solver/PressureOperator.cpp \
+           $$BaseDirectory/solver/Profiler.cpp \
+           $$BaseDirectory/solver/Scenario.cpp \
+           $$BaseDirectory/solver/SolverDiagnostics.cpp \
+           $$BaseDirectory/solver/ThreadPool.cpp
+
+HEADERS += $$BaseDirectory/solver/Vector2.h \
+           $$BaseDirectory/solver/Cell.h \
+           $$BaseDirectory/solver/CellBitmap.h \
+           $$BaseDirectory/solver/Checkpoint.h \
+           $$BaseDirectory/solver/FieldCodec.h \
+           $$BaseDirectory/solver/FluidSolver.h \
+           $$BaseDirectory/solver/FrameExporter.h \
+           $$BaseDirectory/solver/FrameLayout.h \
+           $$BaseDirectory/solver/FrameSnapshot.h \
+           $$BaseDirectory/solver/Grid.h \
+           $$BaseDirectory/solver/MICPreconditioner.h \
+           $$BaseDirectory/solver/MultigridSolver.h \
+           $$BaseDirectory/solver/ParticleSystem.h \
+           $$BaseDirectory/solver/PressureOperator.h \
+           $$BaseDirectory/solver/Profiler.h \
+           $$BaseDirectory/solver/Scenario.h \
+           $$BaseDirectory/solver/SolverDiagnostics.h \
+           $$BaseDirectory/solver/ThreadPool.h \
+           $$BaseDirectory/solver/TripleBuffer.h
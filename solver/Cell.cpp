@@ -2,17 +2,13 @@
 
 Cell::Cell()
   : pressure(0.0f),
-    cellType(AIR),
-    allNeighbors(false)
+    cellType(AIR)
 {
   // Initialize arrays.
   for (unsigned i = 0; i < DIM_COUNT; ++i) {
     vel[i] = 0.0f;
     stagedVel[i] = 0.0f;
   }
-  for (unsigned i = 0; i < NEIGHBOR_COUNT; ++i) {
-    neighbors[i] = NULL;
-  }
 }
 
 
@@ -15,13 +15,6 @@ struct Cell {
     SOLID,
     TYPE_COUNT
   };
-  // Enumerated type used in the Cell struct to enumerate Neighbors.
-  enum Neighbor {   
-    POS_X = 0,
-    POS_Y,
-    POS_XY,
-    NEIGHBOR_COUNT
-  };
   // Enumerated type to define the dimensionality of the Cell.
   enum Dimension {
     X = 0,
@@ -35,8 +28,6 @@ struct Cell {
   float vel[DIM_COUNT];       // Velocity component, as sampled at the faces.
   float stagedVel[DIM_COUNT]; // Temp vel. component, as sampled at faces.
   Type  cellType;             // Contents type of this cell.
-  bool  allNeighbors;         // Flag, true if all four neighbors are in grid.
-  Cell *neighbors[NEIGHBOR_COUNT]; // Pointers to neighbor cells.
 
 
   // Default Constuctor, simply initializes data members to sensible values.
@@ -0,0 +1,57 @@
+#include "CellBitmap.h"
+#include <algorithm>
+
+
+CellBitmap::CellBitmap()
+  : _width(0),
+    _height(0),
+    _rowWords(0),
+    _words()
+{}
+
+
+CellBitmap::CellBitmap(unsigned width, unsigned height)
+  : _width(0),
+    _height(0),
+    _rowWords(0),
+    _words()
+{
+  resize(width, height);
+}
+
+
+void CellBitmap::resize(unsigned width, unsigned height)
+{
+  _width = width;
+  _height = height;
+  _rowWords = (width + WORD_BITS - 1) / WORD_BITS;
+  _words.assign(_rowWords * height, 0);
+}
+
+
+void CellBitmap::clear()
+{
+  std::fill(_words.begin(), _words.end(), Word(0));
+}
+
+
+unsigned CellBitmap::count() const
+{
+  // Parallel bit count of each word.
+  unsigned total = 0;
+  for (unsigned w = 0; w < _words.size(); ++w) {
+    Word bits = _words[w];
+    bits = bits - ((bits >> 1) & 0x5555555555555555ULL);
+    bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+    bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    total += (bits * 0x0101010101010101ULL) >> 56;
+  }
+  return total;
+}
+
+
+bool CellBitmap::operator==(const CellBitmap &bitmap) const
+{
+  return _width == bitmap._width && _height == bitmap._height &&
+    _words == bitmap._words;
+}
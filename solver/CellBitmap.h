@@ -0,0 +1,168 @@
+#ifndef __CELL_BITMAP_H__
+#define __CELL_BITMAP_H__
+
+#include <stdint.h>
+#include <vector>
+
+
+// One bit per cell of a width x height grid, stored row by row in 64-bit
+// words.  Each row starts on a new word, so rows can be written by different
+// threads without sharing a word, and whole rows of bitmaps can be combined
+// a word at a time.  FluidSolver keeps the set of FLUID cells in a
+// CellBitmap; at one bit per cell it is an eighth the size of the cell type
+// array and is cheap to scan, clear and merge.
+class CellBitmap
+{
+public:
+  typedef uint64_t Word;
+  static const unsigned WORD_BITS = 64;
+
+  // Constructs an empty bitmap of size 0 x 0.
+  //
+  // Arguments:
+  //   None
+  CellBitmap();
+
+  // Constructs a bitmap with every bit cleared.
+  //
+  // Arguments:
+  //   unsigned width - The number of cells along X.
+  //   unsigned height - The number of cells along Y.
+  CellBitmap(unsigned width, unsigned height);
+
+  // Changes the size of the bitmap and clears every bit.
+  //
+  // Arguments:
+  //   unsigned width - The number of cells along X.
+  //   unsigned height - The number of cells along Y.
+  //
+  // Returns:
+  //   None
+  void resize(unsigned width, unsigned height);
+
+  // Clears every bit.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void clear();
+
+  // Returns the number of set bits.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of cells whose bit is set.
+  unsigned count() const;
+
+  // Returns true if both bitmaps have the same size and bits.
+  //
+  // Arguments:
+  //   CellBitmap &bitmap - The bitmap to compare against.
+  //
+  // Returns:
+  //   bool - True if the bitmaps are equal.
+  bool operator==(const CellBitmap &bitmap) const;
+
+  // Returns the size of the bitmap.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of cells along X or Y.
+  inline unsigned getWidth() const;
+  inline unsigned getHeight() const;
+
+  // Returns the number of words per row.  Bits beyond the width are 0.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of words in each row.
+  inline unsigned getRowWords() const;
+
+  // Sets the bit of a cell.
+  //
+  // Arguments:
+  //   unsigned x - The cell's column.
+  //   unsigned y - The cell's row.
+  //
+  // Returns:
+  //   None
+  inline void set(unsigned x, unsigned y);
+
+  // Returns the bit of a cell.
+  //
+  // Arguments:
+  //   unsigned x - The cell's column.
+  //   unsigned y - The cell's row.
+  //
+  // Returns:
+  //   bool - True if the cell's bit is set.
+  inline bool test(unsigned x, unsigned y) const;
+
+  // Returns the words of a row; bit x % 64 of word x / 64 is cell x.
+  //
+  // Arguments:
+  //   unsigned y - The row.
+  //
+  // Returns:
+  //   Word * - The row's getRowWords() words.
+  inline Word * rowData(unsigned y);
+  inline const Word * rowData(unsigned y) const;
+
+private:
+  unsigned _width;          // Number of cells along X.
+  unsigned _height;         // Number of cells along Y.
+  unsigned _rowWords;       // Words per row.
+  std::vector<Word> _words; // The bits, row by row.
+};
+
+
+unsigned CellBitmap::getWidth() const
+{
+  return _width;
+}
+
+
+unsigned CellBitmap::getHeight() const
+{
+  return _height;
+}
+
+
+unsigned CellBitmap::getRowWords() const
+{
+  return _rowWords;
+}
+
+
+void CellBitmap::set(unsigned x, unsigned y)
+{
+  _words[y * _rowWords + x / WORD_BITS] |= Word(1) << (x % WORD_BITS);
+}
+
+
+bool CellBitmap::test(unsigned x, unsigned y) const
+{
+  return (_words[y * _rowWords + x / WORD_BITS] >> (x % WORD_BITS)) & 1;
+}
+
+
+CellBitmap::Word * CellBitmap::rowData(unsigned y)
+{
+  return &_words[y * _rowWords];
+}
+
+
+const CellBitmap::Word * CellBitmap::rowData(unsigned y) const
+{
+  return &_words[y * _rowWords];
+}
+
+#endif // __CELL_BITMAP_H__
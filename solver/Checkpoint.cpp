@@ -0,0 +1,405 @@
+#include "Checkpoint.h"
+#include "FrameLayout.h"
+#include <QMutexLocker>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+
+// Every array starts on a boundary of this many bytes, so that the mapped
+// arrays are page aligned.
+static const uint64_t SECTION_ALIGNMENT = 4096;
+
+// Identifies checkpoint files, and the byte order they were written in.
+static const char MAGIC[8] = { 'F', 'L', 'U', 'I', 'D', 'C', 'K', 'P' };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+
+// Lookup tables for CRC-32 (the polynomial used by zlib and PNG), processing
+// eight bytes per step.  The tables are built before main() runs.
+class Crc32Tables
+{
+public:
+  Crc32Tables()
+  {
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t crc = n;
+      for (unsigned k = 0; k < 8; ++k)
+	crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+      table[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; ++n)
+      for (unsigned t = 1; t < 8; ++t)
+	table[t][n] = (table[t - 1][n] >> 8) ^ table[0][table[t - 1][n] & 0xFF];
+  }
+
+  uint32_t table[8][256];
+};
+static const Crc32Tables crc32Tables;
+
+
+// Continues a CRC-32 over more bytes.  Pass 0 to start a new checksum.
+static uint32_t crc32(uint32_t crc, const unsigned char *data, uint64_t bytes)
+{
+  const uint32_t (*t)[256] = crc32Tables.table;
+  crc = ~crc;
+  for (; bytes >= 8; bytes -= 8, data += 8) {
+    crc ^= data[0] | (data[1] << 8) | (data[2] << 16) |
+      (uint32_t(data[3]) << 24);
+    crc = t[7][crc & 0xFF] ^ t[6][(crc >> 8) & 0xFF] ^
+      t[5][(crc >> 16) & 0xFF] ^ t[4][crc >> 24] ^
+      t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+  }
+  for (; bytes > 0; --bytes, ++data)
+    crc = t[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+
+Checkpoint::Checkpoint()
+  : _file(),
+    _data(NULL)
+{
+  memset(&_header, 0, sizeof(_header));
+}
+
+
+Checkpoint::~Checkpoint()
+{
+  close();
+}
+
+
+void Checkpoint::layout(uint64_t width, uint64_t height, uint64_t frame,
+			uint64_t particles, Header &header)
+{
+  // The header's size is part of the format.
+  typedef char HeaderSizeCheck[sizeof(Header) == 256 ? 1 : -1];
+  (void)sizeof(HeaderSizeCheck);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byteOrder = BYTE_ORDER_MARK;
+  header.width = width;
+  header.height = height;
+  header.frame = frame;
+  header.particleCount = particles;
+  header.sectionCount = SECTION_COUNT;
+  header.alignment = SECTION_ALIGNMENT;
+
+  header.sections[U_SECTION].bytes = (width + 1) * height * sizeof(float);
+  header.sections[V_SECTION].bytes = width * (height + 1) * sizeof(float);
+  header.sections[PRESSURE_SECTION].bytes = width * height * sizeof(float);
+  header.sections[CELL_TYPE_SECTION].bytes = width * height;
+  header.sections[PARTICLE_X_SECTION].bytes = particles * sizeof(float);
+  header.sections[PARTICLE_Y_SECTION].bytes = particles * sizeof(float);
+
+  uint64_t offset = sizeof(Header);
+  for (unsigned s = 0; s < SECTION_COUNT; ++s) {
+    offset = (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT *
+      SECTION_ALIGNMENT;
+    header.sections[s].offset = offset;
+    offset += header.sections[s].bytes;
+  }
+}
+
+
+Checkpoint::Status Checkpoint::write(const FrameSnapshot &frame,
+				     const std::string &path)
+{
+  Header header;
+  layout(frame.getWidth(), frame.getHeight(), frame.getFrame(),
+	 frame.getParticleCount(), header);
+  const unsigned char *data[SECTION_COUNT] = {
+    reinterpret_cast<const unsigned char *>(frame.uData()),
+    reinterpret_cast<const unsigned char *>(frame.vData()),
+    reinterpret_cast<const unsigned char *>(frame.pressureData()),
+    frame.cellTypeData(),
+    reinterpret_cast<const unsigned char *>(frame.particleXData()),
+    reinterpret_cast<const unsigned char *>(frame.particleYData())
+  };
+  for (unsigned s = 0; s < SECTION_COUNT; ++s)
+    header.sections[s].checksum = crc32(0, data[s], header.sections[s].bytes);
+  header.checksum = crc32(0, reinterpret_cast<const unsigned char *>(&header),
+			  offsetof(Header, checksum));
+
+  const std::string temporaryPath = path + ".tmp";
+  FILE *file = fopen(temporaryPath.c_str(), "wb");
+  if (!file)
+    return OPEN_FAILED;
+
+  // Each array is preceded by the zero padding up to its offset.
+  static const char zeros[SECTION_ALIGNMENT] = { 0 };
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  uint64_t offset = sizeof(header);
+  for (unsigned s = 0; ok && s < SECTION_COUNT; ++s) {
+    const SectionEntry &section = header.sections[s];
+    ok = fwrite(zeros, 1, section.offset - offset, file) ==
+      section.offset - offset;
+    if (ok && section.bytes > 0)
+      ok = fwrite(data[s], 1, section.bytes, file) == section.bytes;
+    offset = section.offset + section.bytes;
+  }
+  ok = (fclose(file) == 0) && ok;
+
+  if (!ok || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+    remove(temporaryPath.c_str());
+    return WRITE_FAILED;
+  }
+  return OK;
+}
+
+
+Checkpoint::Status Checkpoint::open(const std::string &path, bool verify)
+{
+  close();
+  _file.setFileName(QString::fromLocal8Bit(path.c_str()));
+  if (!_file.open(QIODevice::ReadOnly))
+    return OPEN_FAILED;
+
+  const uint64_t size = _file.size();
+  if (size < sizeof(Header)) {
+    close();
+    return TRUNCATED;
+  }
+  const unsigned char *data = _file.map(0, size);
+  if (!data) {
+    close();
+    return OPEN_FAILED;
+  }
+  _data = data;
+
+  // Check that the header is intact before trusting any of its fields.
+  Header header;
+  memcpy(&header, data, sizeof(header));
+  Status status = OK;
+  if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    status = BAD_MAGIC;
+  else if (header.version != VERSION)
+    status = BAD_VERSION;
+  else if (header.byteOrder != BYTE_ORDER_MARK)
+    status = BAD_BYTE_ORDER;
+  else if (header.checksum !=
+	   crc32(0, data, offsetof(Header, checksum)))
+    status = BAD_HEADER;
+
+  // The arrays must be exactly where this version of the format puts them
+  // for the recorded grid size and particle count.
+  if (status == OK) {
+    const uint64_t cells = uint64_t(header.width) * header.height;
+    if (header.width == 0 || header.height == 0 ||
+	cells > FrameLayout::MAX_CELLS ||
+	header.particleCount > FrameLayout::MAX_PARTICLES)
+      status = BAD_HEADER;
+  }
+  if (status == OK) {
+    Header expected;
+    layout(header.width, header.height, header.frame, header.particleCount,
+	   expected);
+    if (header.sectionCount != expected.sectionCount ||
+	header.alignment != expected.alignment)
+      status = BAD_HEADER;
+    for (unsigned s = 0; status == OK && s < SECTION_COUNT; ++s) {
+      const SectionEntry &section = header.sections[s];
+      if (section.offset != expected.sections[s].offset ||
+	  section.bytes != expected.sections[s].bytes)
+	status = BAD_HEADER;
+      else if (section.offset + section.bytes > size)
+	status = TRUNCATED;
+    }
+  }
+
+  // Checksumming the arrays is the only pass over the data.
+  for (unsigned s = 0; verify && status == OK && s < SECTION_COUNT; ++s) {
+    const SectionEntry &section = header.sections[s];
+    if (crc32(0, data + section.offset, section.bytes) != section.checksum)
+      status = BAD_CHECKSUM;
+  }
+
+  if (status != OK) {
+    close();
+    return status;
+  }
+  _header = header;
+  return OK;
+}
+
+
+void Checkpoint::close()
+{
+  if (_data)
+    _file.unmap(const_cast<unsigned char *>(_data));
+  _data = NULL;
+  _file.close();
+  memset(&_header, 0, sizeof(_header));
+}
+
+
+bool Checkpoint::isOpen() const
+{
+  return _data != NULL;
+}
+
+
+const char *Checkpoint::getStatusMessage(Status status)
+{
+  static const char *messages[STATUS_COUNT] = {
+    "OK",
+    "unable to open file",
+    "unable to write file",
+    "file is truncated",
+    "not a checkpoint file",
+    "unsupported checkpoint version",
+    "checkpoint written with a different byte order",
+    "corrupt checkpoint header",
+    "checkpoint data does not match its checksum"
+  };
+  return status < STATUS_COUNT ? messages[status] : "unknown error";
+}
+
+
+unsigned Checkpoint::getWidth() const
+{
+  return _header.width;
+}
+
+
+unsigned Checkpoint::getHeight() const
+{
+  return _header.height;
+}
+
+
+unsigned long Checkpoint::getFrame() const
+{
+  return _header.frame;
+}
+
+
+const float * Checkpoint::uData() const
+{
+  return reinterpret_cast<const float *>(sectionData(U_SECTION));
+}
+
+
+const float * Checkpoint::vData() const
+{
+  return reinterpret_cast<const float *>(sectionData(V_SECTION));
+}
+
+
+const float * Checkpoint::pressureData() const
+{
+  return reinterpret_cast<const float *>(sectionData(PRESSURE_SECTION));
+}
+
+
+const unsigned char * Checkpoint::cellTypeData() const
+{
+  return sectionData(CELL_TYPE_SECTION);
+}
+
+
+unsigned Checkpoint::getParticleCount() const
+{
+  return _header.particleCount;
+}
+
+
+const float * Checkpoint::particleXData() const
+{
+  return _header.particleCount > 0 ?
+    reinterpret_cast<const float *>(sectionData(PARTICLE_X_SECTION)) : NULL;
+}
+
+
+const float * Checkpoint::particleYData() const
+{
+  return _header.particleCount > 0 ?
+    reinterpret_cast<const float *>(sectionData(PARTICLE_Y_SECTION)) : NULL;
+}
+
+
+const unsigned char *Checkpoint::sectionData(Section section) const
+{
+  return _data ? _data + _header.sections[section].offset : NULL;
+}
+
+
+CheckpointWriter::CheckpointWriter()
+  : QThread(),
+    _mutex(),
+    _changed(),
+    _pending(),
+    _pendingPath(),
+    _writing(false),
+    _stopping(false),
+    _status(Checkpoint::OK)
+{
+  start();
+}
+
+
+CheckpointWriter::~CheckpointWriter()
+{
+  {
+    QMutexLocker lock(&_mutex);
+    _stopping = true;
+    _changed.wakeAll();
+  }
+  QThread::wait();
+}
+
+
+void CheckpointWriter::write(const FrameSnapshotPtr &frame,
+			     const std::string &path)
+{
+  QMutexLocker lock(&_mutex);
+  while (!_pending.isNull())
+    _changed.wait(&_mutex);
+  _pending = frame;
+  _pendingPath = path;
+  _changed.wakeAll();
+}
+
+
+Checkpoint::Status CheckpointWriter::finish()
+{
+  QMutexLocker lock(&_mutex);
+  while (!_pending.isNull() || _writing)
+    _changed.wait(&_mutex);
+  const Checkpoint::Status status = _status;
+  _status = Checkpoint::OK;
+  return status;
+}
+
+
+void CheckpointWriter::run()
+{
+  QMutexLocker lock(&_mutex);
+  for (;;) {
+    while (_pending.isNull() && !_stopping)
+      _changed.wait(&_mutex);
+    if (_pending.isNull())
+      return;
+
+    // Take the frame off the queue, making room for the next one, and write
+    // it without holding the lock.
+    FrameSnapshotPtr frame = _pending;
+    const std::string path = _pendingPath;
+    _pending.reset();
+    _writing = true;
+    _changed.wakeAll();
+    lock.unlock();
+
+    const Checkpoint::Status status = Checkpoint::write(*frame, path);
+    frame.reset();
+
+    lock.relock();
+    if (_status == Checkpoint::OK)
+      _status = status;
+    _writing = false;
+    _changed.wakeAll();
+  }
+}
@@ -0,0 +1,270 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <stdint.h>
+#include <string>
+#include "FrameSnapshot.h"
+
+
+// A simulation checkpoint: the complete state of a frame, written to disk so
+// that a run can be resumed later (see FluidSolver::restore()).
+//
+// The file is a fixed 256 byte header followed by six arrays, each starting
+// on a 4096 byte boundary:
+//
+//   u          - X face velocities: (width+1) x height floats
+//   v          - Y face velocities: width x (height+1) floats
+//   pressure   - Cell pressures:    width x height floats
+//   cellType   - Cell::Type bytes:  width x height
+//   particleX  - Particle X coordinates: particleCount floats
+//   particleY  - Particle Y coordinates: particleCount floats
+//
+// laid out exactly as in a FrameSnapshot.  The header records the format
+// version, the grid size, the frame number and the offset, length and CRC-32
+// of every array, and ends with a CRC-32 of the header itself.  Data is
+// stored in the writer's byte order, which is recorded in the header; files
+// are only read back on hosts with the same byte order.
+//
+// Reading a checkpoint maps the file into memory and validates the header;
+// nothing is parsed or copied, and the arrays are read in place.  Verifying
+// the array checksums is the only pass over the data before it is used.
+class Checkpoint
+{
+public:
+  // Outcome of reading or writing a checkpoint.
+  enum Status {
+    OK = 0,            // Success.
+    OPEN_FAILED,       // The file could not be opened or mapped.
+    WRITE_FAILED,      // The file could not be written in full.
+    TRUNCATED,         // The file is shorter than its header says.
+    BAD_MAGIC,         // The file is not a checkpoint.
+    BAD_VERSION,       // The file is from an unsupported format version.
+    BAD_BYTE_ORDER,    // The file was written with another byte order.
+    BAD_HEADER,        // The header is corrupt or inconsistent.
+    BAD_CHECKSUM,      // An array does not match its checksum.
+    STATUS_COUNT
+  };
+
+  // The current format version, stored in every header.
+  static const uint32_t VERSION = 1;
+
+  // Constructs a checkpoint with no file open.
+  //
+  // Arguments:
+  //   None
+  Checkpoint();
+
+  // Destructor.  Unmaps the file, if open.
+  //
+  // Arguments:
+  //   None
+  ~Checkpoint();
+
+  // Writes a frame to a checkpoint file.  The data is written to a temporary
+  // file alongside path, which then replaces path, so an interrupted write
+  // never leaves a partial checkpoint behind.
+  //
+  // Arguments:
+  //   FrameSnapshot &frame - The frame to save.
+  //   std::string &path - The file to write.
+  //
+  // Returns:
+  //   Status - OK, OPEN_FAILED or WRITE_FAILED.
+  static Status write(const FrameSnapshot &frame, const std::string &path);
+
+  // Maps a checkpoint file and validates its header.  Any previously open
+  // file is closed first.
+  //
+  // Arguments:
+  //   std::string &path - The file to read.
+  //   bool verify - True to also check every array against its checksum.
+  //
+  // Returns:
+  //   Status - OK, or the reason the file cannot be used.
+  Status open(const std::string &path, bool verify = true);
+
+  // Unmaps the file.  Pointers returned by the accessors become invalid.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void close();
+
+  // Returns true if a checkpoint has been opened successfully.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   bool - True if the accessors below may be used.
+  bool isOpen() const;
+
+  // Returns a short description of a status, for error messages.
+  //
+  // Arguments:
+  //   Status status - The status to describe.
+  //
+  // Returns:
+  //   char * - A static string.
+  static const char *getStatusMessage(Status status);
+
+  // Returns the size of the saved grid, in cells.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of cells along X or Y.
+  unsigned getWidth() const;
+  unsigned getHeight() const;
+
+  // Returns the number of the saved frame.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned long - The frame number of the snapshot that was written.
+  unsigned long getFrame() const;
+
+  // Returns the saved arrays, laid out as described above.  They point into
+  // the mapped file.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float * or unsigned char * - The first entry of the array.
+  const float * uData() const;
+  const float * vData() const;
+  const float * pressureData() const;
+  const unsigned char * cellTypeData() const;
+
+  // Returns the number of saved particles.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of particles.
+  unsigned getParticleCount() const;
+
+  // Returns the particles' X or Y coordinates.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float * - getParticleCount() coordinates.
+  const float * particleXData() const;
+  const float * particleYData() const;
+
+private:
+  // The arrays of a checkpoint, in file order.
+  enum Section { U_SECTION = 0, V_SECTION, PRESSURE_SECTION,
+		 CELL_TYPE_SECTION, PARTICLE_X_SECTION, PARTICLE_Y_SECTION,
+		 SECTION_COUNT };
+
+  // The location and checksum of an array within the file.
+  struct SectionEntry {
+    uint64_t offset;   // Byte offset from the start of the file.
+    uint64_t bytes;    // Length in bytes.
+    uint32_t checksum; // CRC-32 of the bytes.
+    uint32_t reserved; // Zero.
+  };
+
+  // The on-disk header.  Every field has a fixed size and offset.
+  struct Header {
+    char magic[8];          // "FLUIDCKP".
+    uint32_t version;       // VERSION.
+    uint32_t byteOrder;     // 0x01020304, in the writer's byte order.
+    uint32_t width;         // Grid size, in cells.
+    uint32_t height;
+    uint64_t frame;         // Frame number.
+    uint64_t particleCount; // Number of particles.
+    uint32_t sectionCount;  // SECTION_COUNT.
+    uint32_t alignment;     // Alignment of every array, in bytes.
+    SectionEntry sections[SECTION_COUNT];
+    unsigned char reserved[60]; // Zero.
+    uint32_t checksum;      // CRC-32 of everything above.
+  };
+
+  // Not copyable.
+  Checkpoint(const Checkpoint &);
+  Checkpoint &operator=(const Checkpoint &);
+
+  // Fills in a header for a frame of the given size, without checksums.
+  static void layout(uint64_t width, uint64_t height, uint64_t frame,
+		     uint64_t particles, Header &header);
+
+  // Returns a pointer to an array within the mapped file.
+  const unsigned char *sectionData(Section section) const;
+
+  QFile _file;                // The open file.
+  const unsigned char *_data; // The mapped file, or NULL.
+  Header _header;             // Copy of the file's header.
+};
+
+
+// Writes checkpoints on a background thread, so that the simulation can move
+// on while a frame is saved.  The writer holds a reference to the snapshot
+// until it has been written; snapshots are immutable, so no copy is made.
+//
+// At most one checkpoint is queued while another is being written.  Queuing
+// a third blocks until the first completes, bounding the memory held by the
+// writer however slow the disk is.
+class CheckpointWriter : private QThread
+{
+public:
+  // Constructs a writer and starts its thread.
+  //
+  // Arguments:
+  //   None
+  CheckpointWriter();
+
+  // Destructor.  Finishes every queued checkpoint, then stops the thread.
+  //
+  // Arguments:
+  //   None
+  virtual ~CheckpointWriter();
+
+  // Queues a frame to be written to a file, returning once it is queued.
+  //
+  // Arguments:
+  //   FrameSnapshotPtr &frame - The frame to save.
+  //   std::string &path - The file to write.
+  //
+  // Returns:
+  //   None
+  void write(const FrameSnapshotPtr &frame, const std::string &path);
+
+  // Blocks until every queued checkpoint has been written.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   Checkpoint::Status - OK if every checkpoint since the last call was
+  //                        written, otherwise the first failure.
+  Checkpoint::Status finish();
+
+private:
+  // Inherited from QThread.
+  virtual void run();
+
+  mutable QMutex _mutex;        // Guards the members below.
+  QWaitCondition _changed;      // Signalled when the queue changes.
+  FrameSnapshotPtr _pending;    // The queued frame, or null.
+  std::string _pendingPath;     // Where to write it.
+  bool _writing;                // True while a frame is being written.
+  bool _stopping;               // True once the destructor has run.
+  Checkpoint::Status _status;   // First failure since the last finish().
+};
+
+#endif // __CHECKPOINT_H__
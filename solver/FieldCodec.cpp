@@ -0,0 +1,540 @@
+#include "FieldCodec.h"
+#include "FrameLayout.h"
+#include <QByteArray>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdint.h>
+
+
+namespace {
+  // How a chunk's values are encoded.
+  enum ChunkMethod {
+    FLOAT_DELTA = 1, // Ordered float bits, differenced, folded and shuffled.
+    FLOAT_QUANTIZED, // Multiples of a step, differenced, folded and shuffled.
+    RAW_BYTES        // Bytes as they are.
+  };
+
+  // Length of the header in front of every chunk's payload.
+  const unsigned CHUNK_HEADER_BYTES = 16;
+
+  // zlib level used for payloads.  Higher levels barely shrink shuffled
+  // fields, and cost several times as long.
+  const int COMPRESSION_LEVEL = 1;
+
+  // Longest header decode() looks through for its end.
+  const size_t MAX_HEADER_BYTES = 4096;
+
+  // Largest quantized value, kept well clear of overflowing the differences.
+  const double MAX_QUANTIZED = 1073741824.0;
+
+  // Stores a 4 byte value little-endian.
+  void putUint32(unsigned char *bytes, uint32_t value)
+  {
+    bytes[0] = value & 0xff;
+    bytes[1] = (value >> 8) & 0xff;
+    bytes[2] = (value >> 16) & 0xff;
+    bytes[3] = (value >> 24) & 0xff;
+  }
+
+  // Loads a 4 byte little-endian value.
+  uint32_t getUint32(const unsigned char *bytes)
+  {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+      (uint32_t(bytes[3]) << 24);
+  }
+
+  uint32_t floatBits(float value)
+  {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  float bitsFloat(uint32_t bits)
+  {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  // Maps float bits to integers that sort in the same order as the floats,
+  // so that nearby values have nearby codes on both sides of zero.
+  uint32_t orderBits(uint32_t bits)
+  {
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+  }
+
+  uint32_t unorderBits(uint32_t ordered)
+  {
+    return (ordered & 0x80000000u) ? (ordered & 0x7fffffffu) : ~ordered;
+  }
+
+  // Folds a two's complement difference so that small magnitudes of either
+  // sign become small unsigned numbers.
+  uint32_t fold(uint32_t difference)
+  {
+    return (difference << 1) ^ (0u - (difference >> 31));
+  }
+
+  uint32_t unfold(uint32_t folded)
+  {
+    return (folded >> 1) ^ (0u - (folded & 1));
+  }
+
+  // Writes byte b of every value to the b-th quarter of the output.
+  void shuffle(const uint32_t *values, unsigned count, unsigned char *bytes)
+  {
+    for (unsigned k = 0; k < count; ++k) {
+      const uint32_t value = values[k];
+      bytes[k] = value & 0xff;
+      bytes[count + k] = (value >> 8) & 0xff;
+      bytes[2 * count + k] = (value >> 16) & 0xff;
+      bytes[3 * count + k] = value >> 24;
+    }
+  }
+
+  void unshuffle(const unsigned char *bytes, unsigned count, uint32_t *values)
+  {
+    for (unsigned k = 0; k < count; ++k)
+      values[k] = bytes[k] | (bytes[count + k] << 8) |
+	(bytes[2 * count + k] << 16) | (uint32_t(bytes[3 * count + k]) << 24);
+  }
+
+  // Reconstructs a quantized value.  The encoder checks its tolerance
+  // against exactly this expression.
+  float dequantize(int32_t quantized, float step)
+  {
+    return float(double(quantized) * double(step));
+  }
+
+  // Quantizes a chunk's values to multiples of a step, and returns the
+  // folded differences between them.
+  //
+  // Returns false if any value would be reconstructed further than the
+  // tolerance from the original.
+  bool quantize(const float *values, unsigned count, float step,
+		float tolerance, uint32_t *folded)
+  {
+    const double limit = double(step) * MAX_QUANTIZED;
+    int32_t previous = 0;
+    for (unsigned k = 0; k < count; ++k) {
+      const double value = values[k];
+      // Written to reject NaN as well.
+      if (!(std::fabs(value) < limit))
+	return false;
+      const int32_t quantized = int32_t(std::floor(value / step + 0.5));
+      if (!(std::fabs(dequantize(quantized, step) - value) <= tolerance))
+	return false;
+      folded[k] = fold(uint32_t(quantized) - uint32_t(previous));
+      previous = quantized;
+    }
+    return true;
+  }
+
+  // Returns the ordered float bits of a chunk's values, differenced and
+  // folded.
+  void deltaEncode(const float *values, unsigned count, uint32_t *folded)
+  {
+    uint32_t previous = orderBits(0);
+    for (unsigned k = 0; k < count; ++k) {
+      const uint32_t ordered = orderBits(floatBits(values[k]));
+      folded[k] = fold(ordered - previous);
+      previous = ordered;
+    }
+  }
+
+  // A chunk of an array, with its encoding once it has been encoded.
+  struct Chunk
+  {
+    Chunk()
+      : array(0), input(NULL), count(0), step(0.0f), tolerance(0.0f),
+	encoded(NULL), output(NULL), payload(), method(FLOAT_DELTA), ok(false)
+    {}
+
+    unsigned array;               // Index of the array the chunk is from.
+    const unsigned char *input;   // The chunk's first value.
+    unsigned count;               // Number of values.
+    float step;                   // Quantization step, or 0 for lossless.
+    float tolerance;              // Largest error allowed when quantized.
+    const unsigned char *encoded; // Decoding: the chunk's header.
+    unsigned char *output;        // Decoding: where its values go.
+    QByteArray payload;           // Encoding: the compressed values.
+    ChunkMethod method;           // Encoding: how the values were encoded.
+    bool ok;                      // Decoding: true if the chunk decoded.
+  };
+
+  // Encodes one chunk, choosing its method.
+  void encodeChunk(Chunk &chunk)
+  {
+    const unsigned count = chunk.count;
+    if (chunk.array == FrameLayout::CELL_TYPE_ARRAY) {
+      chunk.method = RAW_BYTES;
+      chunk.payload = qCompress(chunk.input, count, COMPRESSION_LEVEL);
+      return;
+    }
+
+    const float *values = reinterpret_cast<const float *>(chunk.input);
+    std::vector<uint32_t> folded(count);
+    chunk.method = FLOAT_QUANTIZED;
+    if (chunk.step == 0.0f ||
+	!quantize(values, count, chunk.step, chunk.tolerance, &folded[0])) {
+      chunk.method = FLOAT_DELTA;
+      chunk.step = 0.0f;
+      deltaEncode(values, count, &folded[0]);
+    }
+    std::vector<unsigned char> shuffled(count * sizeof(uint32_t));
+    shuffle(&folded[0], count, &shuffled[0]);
+    chunk.payload = qCompress(&shuffled[0], shuffled.size(),
+			      COMPRESSION_LEVEL);
+  }
+
+  // Decodes one chunk whose header has been validated.
+  bool decodeChunk(const Chunk &chunk)
+  {
+    const unsigned char *header = chunk.encoded;
+    const ChunkMethod method = ChunkMethod(getUint32(header));
+    const unsigned count = getUint32(header + 4);
+    const unsigned payloadBytes = getUint32(header + 8);
+
+    // qUncompress allocates the size its payload starts with, a 4 byte
+    // big-endian value, so it must be what the chunk decodes to.
+    const unsigned char *payload = header + CHUNK_HEADER_BYTES;
+    const unsigned long expectedBytes =
+      (method == RAW_BYTES) ? count : count * sizeof(uint32_t);
+    if (payloadBytes < 4 ||
+	((unsigned long)(payload[0]) << 24 | payload[1] << 16 |
+	 payload[2] << 8 | payload[3]) != expectedBytes)
+      return false;
+    const QByteArray bytes = qUncompress(payload, payloadBytes);
+    const unsigned char *data =
+      reinterpret_cast<const unsigned char *>(bytes.constData());
+
+    if (method == RAW_BYTES) {
+      if (chunk.array != FrameLayout::CELL_TYPE_ARRAY ||
+	  unsigned(bytes.size()) != count)
+	return false;
+      memcpy(chunk.output, data, count);
+      return true;
+    }
+    if (chunk.array == FrameLayout::CELL_TYPE_ARRAY ||
+	unsigned(bytes.size()) != count * sizeof(uint32_t))
+      return false;
+
+    std::vector<uint32_t> folded(count);
+    unshuffle(data, count, &folded[0]);
+    float *values = reinterpret_cast<float *>(chunk.output);
+    if (method == FLOAT_DELTA) {
+      uint32_t ordered = orderBits(0);
+      for (unsigned k = 0; k < count; ++k) {
+	ordered += unfold(folded[k]);
+	values[k] = bitsFloat(unorderBits(ordered));
+      }
+      return true;
+    }
+    if (method == FLOAT_QUANTIZED) {
+      const float step = bitsFloat(getUint32(header + 12));
+      uint32_t quantized = 0;
+      for (unsigned k = 0; k < count; ++k) {
+	quantized += unfold(folded[k]);
+	values[k] = dequantize(int32_t(quantized), step);
+      }
+      return true;
+    }
+    return false;
+  }
+}
+
+
+// Encodes a block of chunks.
+class FieldCodec::EncodeTask : public ThreadPool::Task
+{
+public:
+  EncodeTask(std::vector<Chunk> &chunks) : _chunks(chunks) {}
+
+  void run(unsigned begin, unsigned end) const
+  {
+    for (unsigned c = begin; c < end; ++c)
+      encodeChunk(_chunks[c]);
+  }
+
+private:
+  std::vector<Chunk> &_chunks;
+};
+
+
+// Decodes a block of chunks.
+class FieldCodec::DecodeTask : public ThreadPool::Task
+{
+public:
+  DecodeTask(std::vector<Chunk> &chunks) : _chunks(chunks) {}
+
+  void run(unsigned begin, unsigned end) const
+  {
+    for (unsigned c = begin; c < end; ++c)
+      _chunks[c].ok = decodeChunk(_chunks[c]);
+  }
+
+private:
+  std::vector<Chunk> &_chunks;
+};
+
+
+FieldCodec::FieldCodec(Mode mode, float velocityTolerance,
+		       unsigned threadCount)
+  : _mode(mode),
+    _velocityTolerance(velocityTolerance),
+    _threadPool(threadCount),
+    _fileBytes()
+{
+}
+
+
+FieldCodec::Mode FieldCodec::getMode() const
+{
+  return _mode;
+}
+
+
+float FieldCodec::getVelocityTolerance() const
+{
+  return _velocityTolerance;
+}
+
+
+void FieldCodec::encode(const FrameSnapshot &frame,
+			std::vector<unsigned char> &bytes)
+{
+  const unsigned long particles = frame.getParticleCount();
+  FrameLayout::Shape shapes[FrameLayout::ARRAY_COUNT];
+  FrameLayout::getShapes(frame.getWidth(), frame.getHeight(), particles,
+			 shapes);
+  const void *data[FrameLayout::ARRAY_COUNT] = {
+    frame.uData(), frame.vData(), frame.pressureData(), frame.cellTypeData(),
+    frame.particleXData(), frame.particleYData()
+  };
+
+  // Round to a step just under twice the tolerance, so that values halfway
+  // between two steps, and the rounding of the reconstruction, rarely push
+  // the error past it.
+  const bool lossy = _mode == LOSSY_VELOCITY && _velocityTolerance > 0.0f;
+  const float step = lossy ? float(2.0 * _velocityTolerance * 0.999) : 0.0f;
+
+  std::vector<Chunk> chunks;
+  for (unsigned a = 0; a < FrameLayout::ARRAY_COUNT; ++a) {
+    for (unsigned long first = 0; first < shapes[a].count;
+	 first += CHUNK_VALUES) {
+      Chunk chunk;
+      chunk.array = a;
+      chunk.input = static_cast<const unsigned char *>(data[a]) +
+	first * shapes[a].elementSize;
+      chunk.count = std::min<unsigned long>(CHUNK_VALUES,
+					    shapes[a].count - first);
+      chunk.step = a < 2 ? step : 0.0f;
+      chunk.tolerance = _velocityTolerance;
+      chunks.push_back(chunk);
+    }
+  }
+  _threadPool.parallelFor(0, chunks.size(), EncodeTask(chunks));
+
+  unsigned long arrayBytes[FrameLayout::ARRAY_COUNT] = { 0 };
+  for (size_t c = 0; c < chunks.size(); ++c)
+    arrayBytes[chunks[c].array] +=
+      CHUNK_HEADER_BYTES + chunks[c].payload.size();
+
+  char properties[256];
+  int length = snprintf(properties, sizeof(properties), "FLUIDFRAMEZ 1\n"
+			"frame %lu\nwidth %u\nheight %u\nparticles %lu\n",
+			frame.getFrame(), frame.getWidth(), frame.getHeight(),
+			particles);
+  if (lossy)
+    snprintf(properties + length, sizeof(properties) - length,
+	     "velocity_tolerance %g\n", _velocityTolerance);
+  unsigned long offsets[FrameLayout::ARRAY_COUNT];
+  const std::string header =
+    FrameLayout::layOutHeader(properties, shapes, arrayBytes, 1, true,
+			      offsets);
+
+  const unsigned last = FrameLayout::ARRAY_COUNT - 1;
+  bytes.assign(offsets[last] + arrayBytes[last], 0);
+  memcpy(&bytes[0], header.data(), header.size());
+  unsigned long position = offsets[0];
+  for (size_t c = 0; c < chunks.size(); ++c) {
+    const Chunk &chunk = chunks[c];
+    unsigned char *out = &bytes[position];
+    putUint32(out, chunk.method);
+    putUint32(out + 4, chunk.count);
+    putUint32(out + 8, chunk.payload.size());
+    putUint32(out + 12, floatBits(chunk.step));
+    memcpy(out + CHUNK_HEADER_BYTES, chunk.payload.constData(),
+	   chunk.payload.size());
+    position += CHUNK_HEADER_BYTES + chunk.payload.size();
+  }
+}
+
+
+bool FieldCodec::decode(const unsigned char *bytes, size_t size,
+			Frame &frame)
+{
+  // Find the end of the header before parsing it.
+  const char *text = reinterpret_cast<const char *>(bytes);
+  const std::string terminator = "\nend\n";
+  const std::string start(text, std::min(size, MAX_HEADER_BYTES));
+  const size_t end = start.find(terminator);
+  if (end == std::string::npos)
+    return false;
+  const size_t headerSize = end + terminator.size();
+
+  std::istringstream header(start.substr(0, headerSize));
+  std::string line;
+  if (!std::getline(header, line) || line != "FLUIDFRAMEZ 1")
+    return false;
+  unsigned long width = 0, height = 0, particles = 0, frameNumber = 0;
+  unsigned long offsets[FrameLayout::ARRAY_COUNT];
+  unsigned long arrayBytes[FrameLayout::ARRAY_COUNT];
+  bool found[FrameLayout::ARRAY_COUNT] = { false };
+  std::vector<unsigned long> arrayLines[FrameLayout::ARRAY_COUNT];
+  while (std::getline(header, line) && line != "end") {
+    std::istringstream fields(line);
+    std::string key;
+    fields >> key;
+    if (key == "frame")
+      fields >> frameNumber;
+    else if (key == "width")
+      fields >> width;
+    else if (key == "height")
+      fields >> height;
+    else if (key == "particles")
+      fields >> particles;
+    else if (key == "array") {
+      std::string name, type;
+      fields >> name >> type;
+      unsigned a = 0;
+      while (a < FrameLayout::ARRAY_COUNT &&
+	     name != FrameLayout::getArrayName(a))
+	++a;
+      if (a == FrameLayout::ARRAY_COUNT)
+	return false;
+      unsigned long value;
+      while (fields >> value)
+	arrayLines[a].push_back(value);
+      found[a] = true;
+    }
+    if (fields.fail() && !fields.eof())
+      return false;
+  }
+
+  if (!FrameLayout::isWithinLimits(width, height, particles))
+    return false;
+
+  // Every array must be present, with the shape the properties imply, and
+  // lie within the file, with room for the headers of all its chunks.
+  FrameLayout::Shape shapes[FrameLayout::ARRAY_COUNT];
+  FrameLayout::getShapes(width, height, particles, shapes);
+  for (unsigned a = 0; a < FrameLayout::ARRAY_COUNT; ++a) {
+    const std::vector<unsigned long> &values = arrayLines[a];
+    const unsigned dimensionCount = shapes[a].dimensionCount;
+    if (!found[a] || values.size() != dimensionCount + 2)
+      return false;
+    for (unsigned d = 0; d < dimensionCount; ++d)
+      if (values[d] != shapes[a].dimensions[d])
+	return false;
+    offsets[a] = values[dimensionCount];
+    arrayBytes[a] = values[dimensionCount + 1];
+    if (offsets[a] < headerSize || offsets[a] > size ||
+	arrayBytes[a] > size - offsets[a])
+      return false;
+    const unsigned long chunkCount =
+      (shapes[a].count + CHUNK_VALUES - 1) / CHUNK_VALUES;
+    if (chunkCount > arrayBytes[a] / CHUNK_HEADER_BYTES)
+      return false;
+  }
+
+  frame.frame = frameNumber;
+  frame.width = width;
+  frame.height = height;
+  frame.u.resize(shapes[0].count);
+  frame.v.resize(shapes[1].count);
+  frame.pressure.resize(shapes[2].count);
+  frame.cellTypes.resize(shapes[3].count);
+  frame.particleX.resize(shapes[4].count);
+  frame.particleY.resize(shapes[5].count);
+  unsigned char *outputs[FrameLayout::ARRAY_COUNT] = {
+    reinterpret_cast<unsigned char *>(frame.u.empty() ? NULL : &frame.u[0]),
+    reinterpret_cast<unsigned char *>(frame.v.empty() ? NULL : &frame.v[0]),
+    reinterpret_cast<unsigned char *>(frame.pressure.empty() ?
+				      NULL : &frame.pressure[0]),
+    frame.cellTypes.empty() ? NULL : &frame.cellTypes[0],
+    reinterpret_cast<unsigned char *>(frame.particleX.empty() ?
+				      NULL : &frame.particleX[0]),
+    reinterpret_cast<unsigned char *>(frame.particleY.empty() ?
+				      NULL : &frame.particleY[0])
+  };
+
+  // Walk each array's chunk headers, checking that they tile it exactly,
+  // then decode the chunks concurrently.
+  std::vector<Chunk> chunks;
+  for (unsigned a = 0; a < FrameLayout::ARRAY_COUNT; ++a) {
+    unsigned long position = offsets[a];
+    const unsigned long arrayEnd = offsets[a] + arrayBytes[a];
+    for (unsigned long first = 0; first < shapes[a].count;
+	 first += CHUNK_VALUES) {
+      if (arrayEnd - position < CHUNK_HEADER_BYTES)
+	return false;
+      Chunk chunk;
+      chunk.array = a;
+      chunk.encoded = bytes + position;
+      chunk.count = std::min<unsigned long>(CHUNK_VALUES,
+					    shapes[a].count - first);
+      chunk.output = outputs[a] + first * shapes[a].elementSize;
+      const unsigned long payloadBytes = getUint32(chunk.encoded + 8);
+      if (getUint32(chunk.encoded + 4) != chunk.count ||
+	  payloadBytes > arrayEnd - position - CHUNK_HEADER_BYTES)
+	return false;
+      position += CHUNK_HEADER_BYTES + payloadBytes;
+      chunks.push_back(chunk);
+    }
+    if (position != arrayEnd)
+      return false;
+  }
+  _threadPool.parallelFor(0, chunks.size(), DecodeTask(chunks));
+
+  for (size_t c = 0; c < chunks.size(); ++c)
+    if (!chunks[c].ok)
+      return false;
+  return true;
+}
+
+
+size_t FieldCodec::writeFrame(const FrameSnapshot &frame,
+			      const std::string &path)
+{
+  encode(frame, _fileBytes);
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+    return 0;
+  bool ok = fwrite(&_fileBytes[0], 1, _fileBytes.size(), file) ==
+    _fileBytes.size();
+  ok = (fclose(file) == 0) && ok;
+  return ok ? _fileBytes.size() : 0;
+}
+
+
+bool FieldCodec::readFrame(const std::string &path, Frame &frame)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  bool ok = fseek(file, 0, SEEK_END) == 0;
+  const long size = ok ? ftell(file) : -1;
+  ok = ok && size > 0 && fseek(file, 0, SEEK_SET) == 0;
+  if (ok) {
+    _fileBytes.resize(size);
+    ok = fread(&_fileBytes[0], 1, size, file) == size_t(size);
+  }
+  fclose(file);
+  return ok && decode(&_fileBytes[0], _fileBytes.size(), frame);
+}
@@ -0,0 +1,170 @@
+#ifndef __FIELD_CODEC_H__
+#define __FIELD_CODEC_H__
+
+#include <string>
+#include <vector>
+#include "FrameSnapshot.h"
+#include "ThreadPool.h"
+
+
+// Compresses frames for long runs, where raw output (see FrameExporter)
+// would fill the disk.  Every array is cut into chunks of CHUNK_VALUES
+// values, and the chunks are encoded concurrently, each independently of
+// the others:
+//
+//  - Floats are mapped to integers that sort like the floats do, and each is
+//    replaced by its difference from the one before, folded so that small
+//    negative differences become small positive numbers.  The chunk's bytes
+//    are then shuffled so that the first byte of every value comes first,
+//    then every second byte, and so on, which puts the mostly zero high
+//    bytes of smooth fields next to each other.  Decoding restores every
+//    bit, including NaNs and the sign of zero.
+//
+//  - In LOSSY_VELOCITY mode, u and v are instead rounded to multiples of a
+//    step just under twice the tolerance, and the multiples are
+//    differenced, folded and shuffled the same way.  Every value is checked
+//    against the tolerance as it is encoded, and a chunk with any value
+//    that would miss it (because it is not finite, too large, or too
+//    precise for the tolerance to help) is stored losslessly instead, so
+//    the bound always holds.  Pressure, cell types and particles are always
+//    lossless.
+//
+//  - Cell types are stored as they are.
+//
+// The result is then deflated with zlib, through qCompress().
+//
+// Encoded frames are written to frame_NNNNN.fldz files holding a text header
+// like FrameExporter's:
+//
+//   FLUIDFRAMEZ 1
+//   frame 42
+//   width 64
+//   height 48
+//   particles 12288
+//   velocity_tolerance 0.001
+//   array u float32 65 48 311 1595
+//   array v float32 64 49 1906 1644
+//   array pressure float32 64 48 3550 3110
+//   array cell_type uint8 64 48 6660 148
+//   array particle_x float32 12288 6808 29643
+//   array particle_y float32 12288 36451 30319
+//   end
+//
+// Every array line gives the array's name, element type, dimensions, and
+// the byte offset and length of its encoded chunks.  The velocity_tolerance
+// line is only present for lossy frames.  Each chunk starts with a 16 byte
+// little-endian header of its method, value count, payload length and
+// quantization step, followed by its qCompress() payload.
+class FieldCodec
+{
+public:
+  // How velocities are encoded.
+  enum Mode {
+    LOSSLESS = 0,   // Every field is reproduced bit for bit.
+    LOSSY_VELOCITY, // u and v are reproduced to within a tolerance.
+    MODE_COUNT
+  };
+
+  // Values per independently encoded chunk.
+  static const unsigned CHUNK_VALUES = 65536;
+
+  // A decoded frame.  The arrays are laid out as in FrameSnapshot.
+  struct Frame
+  {
+    unsigned long frame;
+    unsigned width;
+    unsigned height;
+    std::vector<float> u;
+    std::vector<float> v;
+    std::vector<float> pressure;
+    std::vector<unsigned char> cellTypes;
+    std::vector<float> particleX;
+    std::vector<float> particleY;
+  };
+
+  // Constructs a codec.
+  //
+  // Arguments:
+  //   Mode mode - How velocities are encoded.
+  //   float velocityTolerance - The largest absolute error allowed in u and
+  //                             v, in LOSSY_VELOCITY mode.
+  //   unsigned threadCount - The number of threads encoding chunks, or 0 to
+  //                          use one per processor core.
+  FieldCodec(Mode mode = LOSSLESS, float velocityTolerance = 0.0f,
+	     unsigned threadCount = 0);
+
+  // Returns the mode the codec was constructed with.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   Mode - How velocities are encoded.
+  Mode getMode() const;
+
+  // Returns the velocity tolerance the codec was constructed with.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float - The largest absolute error allowed in u and v.
+  float getVelocityTolerance() const;
+
+  // Encodes a frame in the format described above.  Not reentrant; use one
+  // codec per thread.
+  //
+  // Arguments:
+  //   FrameSnapshot &frame - The frame to encode.
+  //   std::vector<unsigned char> &bytes - Replaced with the encoded file.
+  //
+  // Returns:
+  //   None
+  void encode(const FrameSnapshot &frame, std::vector<unsigned char> &bytes);
+
+  // Decodes a frame.  Not reentrant; use one codec per thread.
+  //
+  // Arguments:
+  //   unsigned char *bytes - The encoded file.
+  //   size_t size - The length of the file, in bytes.
+  //   Frame &frame - Replaced with the decoded frame.
+  //
+  // Returns:
+  //   bool - True on success; false if the file is damaged or not a frame.
+  bool decode(const unsigned char *bytes, size_t size, Frame &frame);
+
+  // Encodes a frame and writes it to a file.
+  //
+  // Arguments:
+  //   FrameSnapshot &frame - The frame to write.
+  //   std::string &path - The file to write.
+  //
+  // Returns:
+  //   size_t - The number of bytes written, or 0 on failure.
+  size_t writeFrame(const FrameSnapshot &frame, const std::string &path);
+
+  // Reads a file and decodes it.
+  //
+  // Arguments:
+  //   std::string &path - The file to read.
+  //   Frame &frame - Replaced with the decoded frame.
+  //
+  // Returns:
+  //   bool - True on success.
+  bool readFrame(const std::string &path, Frame &frame);
+
+private:
+  class EncodeTask;
+  class DecodeTask;
+
+  // Not copyable.
+  FieldCodec(const FieldCodec &);
+  FieldCodec &operator=(const FieldCodec &);
+
+  const Mode _mode;                 // How velocities are encoded.
+  const float _velocityTolerance;   // Largest error allowed in u and v.
+  ThreadPool _threadPool;           // Encodes and decodes chunks.
+  std::vector<unsigned char> _fileBytes; // Reused by writeFrame/readFrame.
+};
+
+#endif // __FIELD_CODEC_H__
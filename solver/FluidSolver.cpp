@@ -1,96 +1,352 @@
-// DEBUG
-#include <iostream>
+#include <algorithm>
 #include <vector>
+#include <cmath>
+#include <cstring>
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/Sparse>
 #include <eigen3/Eigen/IterativeLinearSolvers>
+#include "Checkpoint.h"
 #include "FluidSolver.h"
-#include "IFluidRenderer.h"
 #include "Grid.h"
 #include "Cell.h"
 #include "Vector2.h"
-#include "SignalRelay.h"
+#include "MICPreconditioner.h"
+#include "PressureOperator.h"
 
 
 using std::vector;
 using Eigen::VectorXd;
 using Eigen::VectorXi;
-using Eigen::SparseMatrix;
-using Eigen::Triplet;
-using Eigen::RowMajor;
-using Eigen::ConjugateGradient;
 using Eigen::Success;
-typedef Triplet<double> Tripletd;
+
+// The maximum number of V-cycles performed by the multigrid pressure solver.
+static const unsigned MAX_MULTIGRID_CYCLES = 100;
+
+
+// Solves Ap = b with the provided iterative solver, recording its
+// convergence information in stats.  p holds the initial guess on entry.
+// The solver's preconditioner is only recomputed when setup is true.
+template <typename Solver>
+static void solvePressure(Solver &solver, const PressureOperator &A,
+			  bool setup, const VectorXd &b, VectorXd &p,
+			  double tolerance,
+			  FluidSolver::PressureSolveStats &stats)
+{
+  solver.setTolerance(tolerance);
+  if (setup)
+    solver.compute(A);
+  p = solver.solveWithGuess(b, p);
+  stats.iterations = solver.iterations();
+  stats.error      = solver.error();
+  stats.converged  = (solver.info() == Success);
+}
+
 
 FluidSolver::FluidSolver(float width, float height)
   : _width(width),
     _height(height),
+    _scenario(Scenario::makeDefault(width, height)),
     _grid(_width, _height),
-    _frameReady(false),
-    _particles()
+    _frameTimeSec(1.0f / _scenario.getFrameRate()),
+    _cflNumber(_scenario.getCFLNumber()),
+    _gravity(_scenario.getGravity()),
+    _maxVelocity(),
+    _maxVelocityCurrent(false),
+    _particles(),
+    _particleIntegrator(ParticleSystem::RK2),
+    _particleSortInterval(8),
+    _particleCellOrder(ParticleSystem::ROW_MAJOR),
+    _pressureSolver(PressureSolverType(_scenario.getPressureSolver())),
+    _pressureTolerance(1.0e-6),
+    _warmStartPressure(true),
+    _setupSolver(PRESSURE_SOLVER_COUNT),
+    _diagnostics(),
+    _stepCount(0),
+    _threadPool(),
+    _fluidCells(),
+    _chunkFluidCells(),
+    _solidUFaces(),
+    _solidVFaces()
 {
-  // Provide default values to the grid.
-  reset();
+  _lastPressureSolve.iterations = 0;
+  _lastPressureSolve.error = 0.0;
+  _lastPressureSolve.initialError = 0.0;
+  _lastPressureSolve.converged = true;
+  _lastPressureSolve.warmStarted = false;
+  _lastPressureSolve.reusedSetup = false;
 
-  // Connect ourselves to the 'resetSimulation' signal.
-  QObject::connect(SignalRelay::getInstance(), SIGNAL(resetSimulation()),
-		   this, SLOT(reset()));
+  setUpScene();
 }
 
 
-FluidSolver::~FluidSolver()
+FluidSolver::FluidSolver(const Scenario &scenario)
+  : _width(scenario.getWidth()),
+    _height(scenario.getHeight()),
+    _scenario(scenario),
+    _grid(_width, _height),
+    _frameTimeSec(1.0f / _scenario.getFrameRate()),
+    _cflNumber(_scenario.getCFLNumber()),
+    _gravity(_scenario.getGravity()),
+    _maxVelocity(),
+    _maxVelocityCurrent(false),
+    _particles(),
+    _particleIntegrator(ParticleSystem::RK2),
+    _particleSortInterval(8),
+    _particleCellOrder(ParticleSystem::ROW_MAJOR),
+    _pressureSolver(PressureSolverType(_scenario.getPressureSolver())),
+    _pressureTolerance(1.0e-6),
+    _warmStartPressure(true),
+    _setupSolver(PRESSURE_SOLVER_COUNT),
+    _diagnostics(),
+    _stepCount(0),
+    _threadPool(),
+    _fluidCells(),
+    _chunkFluidCells(),
+    _solidUFaces(),
+    _solidVFaces()
 {
-  // Disconnect from receiving any signals.
-  SignalRelay::getInstance()->disconnect(this);
+  _lastPressureSolve.iterations = 0;
+  _lastPressureSolve.error = 0.0;
+  _lastPressureSolve.initialError = 0.0;
+  _lastPressureSolve.converged = true;
+  _lastPressureSolve.warmStarted = false;
+  _lastPressureSolve.reusedSetup = false;
+
+  setUpScene();
 }
 
 
+FluidSolver::~FluidSolver()
+{}
+
+
 void FluidSolver::reset()
 {
-  // Note: This is super ghetto currently, and simply initializes the solver
-  // with a large default grid, all filled with fluid and arbitrary velocities.
-  // Change this as needed during devlopment to quickly test stuff out, and
-  // remove before final release!
+  setUpScene();
+}
+
+
+bool FluidSolver::reset(const Scenario &scenario)
+{
+  if (scenario.getWidth() != _grid.getColCount() - 1 ||
+      scenario.getHeight() != _grid.getRowCount() - 1)
+    return false;
+
+  _scenario = scenario;
+  _frameTimeSec = 1.0f / scenario.getFrameRate();
+  _cflNumber = scenario.getCFLNumber();
+  _gravity = scenario.getGravity();
+  _pressureSolver = PressureSolverType(scenario.getPressureSolver());
+  setUpScene();
+  return true;
+}
 
-  // Delete existing particles
-  _particles.clear();
-  
-  // Initialize a velocity field for testing.
-  // Note: values in this velocity field are arbitrarily chosen and may be
-  //  divergent within a cell.
-  // Note: sin() is used to clamp output values to [-1, 1].
-  Grid grid(_width, _height);
-  for (unsigned y = _height / 2; y < _height; ++y) 
-    for (unsigned x = _width / 2; x < _width; ++x) {
-      grid(x,y).cellType = Cell::FLUID;
-      grid(x,y).pressure = 0.0f;
 
-      // Initialize marker particle positions.
-      for (unsigned i = 0; i < 4; i++)
-        for(unsigned j = 0; j < 4; j++) 
-	  _particles.push_back(Vector2(x + 0.20f * (i + 1), y + 0.20f * (j + 1)));
+// Sets up rows [begin, end) of the scenario's scene: each row starts out as
+// AIR, every region's span of the row is filled in order, and the row's
+// FLUID cells are marked in the bitmap and counted.
+class FluidSolver::SceneRowsTask : public ThreadPool::Task
+{
+public:
+  SceneRowsTask(FluidSolver &solver, unsigned *rowFluidCounts)
+    : _solver(solver), _rowFluidCounts(rowFluidCounts)
+  {}
+
+  void run(unsigned begin, unsigned end) const
+  {
+    Grid &grid = _solver._grid;
+    const Scenario &scenario = _solver._scenario;
+    const vector<Scenario::Region> &regions = scenario.getRegions();
+    CellBitmap &fluid = _solver._fluidCells;
+    const unsigned width = fluid.getWidth();
+
+    for (unsigned y = begin; y < end; ++y) {
+      unsigned char *types = grid.cellTypeData() + grid.index(0, y);
+      memset(types, Cell::AIR, width);
+      for (unsigned r = 0; r < regions.size(); ++r) {
+	unsigned first, last;
+	scenario.getRegionSpan(regions[r], y, first, last);
+	memset(types + first, regions[r].type, last - first);
+      }
+
+      memset(fluid.rowData(y), 0,
+	     fluid.getRowWords() * sizeof(CellBitmap::Word));
+      unsigned count = 0;
+      for (unsigned x = 0; x < width; ++x) {
+	if (types[x] == Cell::FLUID) {
+	  fluid.set(x, y);
+	  ++count;
+	}
+      }
+      _rowFluidCounts[y] = count;
+    }
+  }
+
+private:
+  FluidSolver &_solver;      // The solver whose scene is set up.
+  unsigned *_rowFluidCounts; // Receives the FLUID cells of each row.
+};
+
+
+// Seeds the particles of rows [begin, end) on a square lattice in each FLUID
+// cell.  Each row's particles start at its offset in the array, so rows are
+// laid out in the same order as if seeded one by one.
+class FluidSolver::SeedParticlesTask : public ThreadPool::Task
+{
+public:
+  SeedParticlesTask(FluidSolver &solver, const unsigned *rowFirstCells,
+		    float *x, float *y)
+    : _solver(solver), _rowFirstCells(rowFirstCells), _x(x), _y(y)
+  {}
+
+  void run(unsigned begin, unsigned end) const
+  {
+    const Grid &grid = _solver._grid;
+    const unsigned width = grid.getColCount() - 1;
+    const unsigned side = _solver._scenario.getParticlesPerSide();
+    const float spacing = 1.0f / (side + 1);
+
+    for (unsigned y = begin; y < end; ++y) {
+      const unsigned char *types = grid.cellTypeData() + grid.index(0, y);
+      const unsigned first = _rowFirstCells[y] * side * side;
+      float *px = _x + first;
+      float *py = _y + first;
+      for (unsigned x = 0; x < width; ++x) {
+	if (types[x] != Cell::FLUID)
+	  continue;
+	for (unsigned i = 0; i < side; ++i)
+	  for (unsigned j = 0; j < side; ++j) {
+	    *px++ = x + spacing * (i + 1);
+	    *py++ = y + spacing * (j + 1);
+	  }
+      }
+    }
   }
 
-  // Set values accordingly.
-  _grid = grid;
-  _frameReady = false;
+private:
+  FluidSolver &_solver;           // The solver whose particles are seeded.
+  const unsigned *_rowFirstCells; // FLUID cells before each row.
+  float *_x;                      // The particles' X coordinates.
+  float *_y;                      // The particles' Y coordinates.
+};
+
+
+void FluidSolver::setUpScene()
+{
+  const unsigned width  = _grid.getColCount() - 1;
+  const unsigned height = _grid.getRowCount() - 1;
+  if (_fluidCells.getWidth() != width || _fluidCells.getHeight() != height)
+    _fluidCells.resize(width, height);
+
+  // Start from still fluid at zero pressure.  Ghost cells stay SOLID.
+  const unsigned padded = _grid.getPaddedCount();
+  std::fill(_grid.uData(), _grid.uData() + padded, 0.0f);
+  std::fill(_grid.vData(), _grid.vData() + padded, 0.0f);
+  std::fill(_grid.stagedUData(), _grid.stagedUData() + padded, 0.0f);
+  std::fill(_grid.stagedVData(), _grid.stagedVData() + padded, 0.0f);
+  std::fill(_grid.pressureData(), _grid.pressureData() + padded, 0.0f);
+
+  // Lay out the cells and count each row's FLUID cells, then seed every
+  // row's particles at once into an array sized from the counts.  The
+  // FLUID cells are exactly the ones that receive particles, so the cells
+  // are already marked as markCells() would mark them.
+  vector<unsigned> rowFirstCells(height + 1, 0);
+  _threadPool.parallelFor(0, height, SceneRowsTask(*this, &rowFirstCells[1]),
+			  16);
+  for (unsigned y = 0; y < height; ++y)
+    rowFirstCells[y + 1] += rowFirstCells[y];
+  const unsigned side = _scenario.getParticlesPerSide();
+  _particles.resize(rowFirstCells[height] * side * side);
+
+  // Fetching the coordinate arrays marks the particles' cell ranges stale,
+  // so it is done once here rather than by every thread.
+  float *x = _particles.xData();
+  float *y = _particles.yData();
+  _threadPool.parallelFor(0, height,
+			  SeedParticlesTask(*this, &rowFirstCells[0], x, y),
+			  16);
+
+  _maxVelocityCurrent = false;
+  findSolidFaces();
+}
+
+
+void FluidSolver::findSolidFaces()
+{
+  const unsigned width  = _grid.getColCount() - 1;
+  const unsigned height = _grid.getRowCount() - 1;
+  _solidUFaces.clear();
+  _solidVFaces.clear();
+  for (unsigned y = 0; y < height; ++y) {
+    const unsigned row = _grid.index(0, y);
+    const unsigned char *types = _grid.cellTypeData() + row;
+    for (unsigned x = 0; x < width; ++x) {
+      if (types[x] == Cell::SOLID) {
+	_solidUFaces.push_back(row + x);
+	_solidUFaces.push_back(row + x + 1);
+	_solidVFaces.push_back(row + x);
+	_solidVFaces.push_back(_grid.index(x, y + 1));
+      }
+    }
+  }
+}
+
+
+bool FluidSolver::restore(const Checkpoint &checkpoint)
+{
+  const unsigned width  = _grid.getColCount() - 1;
+  const unsigned height = _grid.getRowCount() - 1;
+  if (checkpoint.getWidth() != width || checkpoint.getHeight() != height)
+    return false;
+
+  // Copy each row into the grid's padded arrays; the ghost layer is left
+  // as it is.
+  const float *u = checkpoint.uData();
+  const float *v = checkpoint.vData();
+  const float *pressure = checkpoint.pressureData();
+  const unsigned char *cellTypes = checkpoint.cellTypeData();
+  for (unsigned y = 0; y < height; ++y) {
+    const unsigned row = _grid.index(0, y);
+    memcpy(_grid.uData() + row, u + y * (width + 1),
+	   (width + 1) * sizeof(float));
+    memcpy(_grid.pressureData() + row, pressure + y * width,
+	   width * sizeof(float));
+    memcpy(_grid.cellTypeData() + row, cellTypes + y * width, width);
+  }
+  for (unsigned y = 0; y <= height; ++y)
+    memcpy(_grid.vData() + _grid.index(0, y), v + y * width,
+	   width * sizeof(float));
+
+  _particles.assign(checkpoint.particleXData(), checkpoint.particleYData(),
+		    checkpoint.getParticleCount());
+  findSolidFaces();
+
+  // The largest face velocities must be found again for the next timestep.
+  _maxVelocityCurrent = false;
+  markCells();
+  return true;
 }
 
 void FluidSolver::advanceFrame()
 {
-  float frameTimeSec = 1.0f/30.0f; // TODO Target 30 Hz framerate for now.
-  float CFLCoefficient = 2.0f;     // TODO CFL coefficient set to 2 for now.
+  float frameTimeSec = _frameTimeSec;
 
-  while (!_frameReady) {
-    // If enough simulation time has elapsed to draw the next frame, break.
-    if (frameTimeSec <= 0.0f) {
-      _frameReady = true;
-      break;
-    }
+  PROFILE_FRAME(_profiler);
+
+  // Only collect the pressure solve statistics of this frame's substeps.
+  _framePressureSolves.clear();
 
+  // Advance until enough simulation time has elapsed to draw the next frame.
+  while (frameTimeSec > 0.0f) {
     // Calculate an appropriate timestep based on the estimated max velocity
-    // and the CFL coefficient.
-    float simTimeStepSec = CFLCoefficient / _grid.getMaxVelocity().magnitude();
+    // and the CFL number.  Each substep's projection leaves the largest
+    // face velocities behind, so only the first substep after a reset has
+    // to sweep the grid for them.
+    if (!_maxVelocityCurrent) {
+      _maxVelocity = _grid.getMaxFaceVelocity();
+      _maxVelocityCurrent = true;
+    }
+    float simTimeStepSec = _cflNumber / _maxVelocity.magnitude();
     
     // If the remaining time to simulate in this frame is less than the
     // CFL-calculated time, just advance the sim for the remaining frame time.
@@ -108,44 +364,158 @@ void FluidSolver::advanceFrame()
 
 void FluidSolver::advanceTimeStep(float timeStepSec)
 {
-  Vector2 gravity(0.0f, -9.8f);  // Gravity: -0.098 cells/sec^2
+  ++_stepCount;
 
-  advectVelocity(timeStepSec);
-  applyGlobalVelocity(gravity * timeStepSec);
-  boundaryCollide();
-  pressureSolve(timeStepSec);
-  boundaryCollide();
-  moveParticles(timeStepSec);
-  markCells();
+  // Each stage runs in its own scope so that profiling builds can time it.
+  {
+    PROFILE_STAGE(stage, _profiler, Profiler::STAGE_ADVECT);
+    advectVelocity(timeStepSec);
+  }
+  {
+    PROFILE_STAGE(stage, _profiler, Profiler::STAGE_GRAVITY);
+    applyGlobalVelocity(_gravity * timeStepSec);
+  }
+  {
+    PROFILE_STAGE(stage, _profiler, Profiler::STAGE_COLLIDE);
+    boundaryCollide();
+  }
+  {
+    PROFILE_STAGE(stage, _profiler, Profiler::STAGE_PRESSURE);
+    pressureSolve(timeStepSec);
+    PROFILE_ITERATIONS(stage, _lastPressureSolve.iterations);
+  }
+  {
+    PROFILE_STAGE(stage, _profiler, Profiler::STAGE_COLLIDE);
+    boundaryCollide();
+  }
+
+  // Record the outcome of this substep.  Divergence is measured after the
+  // walls have been enforced again, since the projection also writes to
+  // wall faces.
+  if (_diagnostics.isEnabled()) {
+    SolverDiagnostics::StepRecord record;
+    record.step = _stepCount;
+    record.timeStepSec = timeStepSec;
+    record.pressureIterations = _lastPressureSolve.iterations;
+    record.pressureError = _lastPressureSolve.error;
+    record.pressureInitialError = _lastPressureSolve.initialError;
+    record.pressureConverged = _lastPressureSolve.converged;
+    record.pressureWarmStarted = _lastPressureSolve.warmStarted;
+    record.pressureReusedSetup = _lastPressureSolve.reusedSetup;
+    record.maxDivergence = -1.0f;
+
+    // Measuring the remaining divergence takes another pass over the grid.
+    if (_diagnostics.isEnabled(SolverDiagnostics::DIAGNOSTICS_DETAILED)) {
+      const unsigned width  = _grid.getColCount() - 1;
+      const unsigned height = _grid.getRowCount() - 1;
+      record.maxDivergence = 0.0f;
+      for (unsigned y = 0; y < height; ++y)
+	for (unsigned x = 0; x < width; ++x)
+	  if (_grid.cellType(x, y) == Cell::FLUID) {
+	    const float divergence = fabs(_grid.getVelocityDivergence(x, y));
+	    if (divergence > record.maxDivergence)
+	      record.maxDivergence = divergence;
+	  }
+    }
+    _diagnostics.record(record);
+  }
+
+  {
+    PROFILE_STAGE(stage, _profiler, Profiler::STAGE_MOVE_PARTICLES);
+    PROFILE_PARTICLES(stage, _particles.size());
+    moveParticles(timeStepSec);
+  }
+  if (_particleSortInterval > 0 && _stepCount % _particleSortInterval == 0) {
+    PROFILE_STAGE(stage, _profiler, Profiler::STAGE_SORT_PARTICLES);
+    PROFILE_PARTICLES(stage, _particles.size());
+    sortParticles();
+  }
+  {
+    PROFILE_STAGE(stage, _profiler, Profiler::STAGE_MARK_CELLS);
+    PROFILE_PARTICLES(stage, _particles.size());
+    markCells();
+  }
 }
 
 
-void FluidSolver::advectVelocity(float timeStepSec)
+// Traces the u and v faces of rows [begin, end) back through the velocity
+// field.  Each face only reads the current velocities and writes its own
+// staged velocity, so blocks of rows can run concurrently.
+class FluidSolver::AdvectionTask : public ThreadPool::Task
 {
-  for(float x = 0; x < _grid.getWidth(); x += 1.0f)
-    for( float y = 0.5; y < _grid.getHeight(); y += 1.0f) {
-      Cell &cell = _grid(floor(x), floor(y));
-      Vector2 position(x, y); 
-      position = particleTrace(position, timeStepSec);
-      cell.stagedVel[Cell::X] = _grid.getVelocity(position).x;
+public:
+  AdvectionTask(FluidSolver &solver, float timeStepSec)
+    : _solver(solver), _timeStepSec(timeStepSec)
+  {}
+
+  void run(unsigned begin, unsigned end) const
+  {
+    Grid &grid = _solver._grid;
+    const unsigned width  = grid.getColCount() - 1;
+    const unsigned height = grid.getRowCount() - 1;
+
+    // Each row of faces is traced as a batch: sample the velocity at every
+    // face, trace back from it, then sample the velocity component at the
+    // traced positions straight into the staged row.
+    std::vector<float> x(width + 1), y(width + 1), u(width + 1), v(width + 1);
+    for (unsigned j = begin; j < end; ++j) {
+      // Trace back from each vertical face to find its new X velocity.
+      // There is one more row of horizontal faces than of vertical ones.
+      if (j < height) {
+	for (unsigned i = 0; i <= width; ++i) {
+	  x[i] = i;
+	  y[i] = j + 0.5f;
+	}
+	trace(grid, &x[0], &y[0], &u[0], &v[0], width + 1);
+	grid.sampleU(&x[0], &y[0], &grid.stagedUData()[grid.index(0, j)],
+		     width + 1);
+      }
+
+      // Trace back from each horizontal face to find its new Y velocity.
+      for (unsigned i = 0; i < width; ++i) {
+	x[i] = i + 0.5f;
+	y[i] = j;
+      }
+      trace(grid, &x[0], &y[0], &u[0], &v[0], width);
+      grid.sampleV(&x[0], &y[0], &grid.stagedVData()[grid.index(0, j)],
+		   width);
     }
-  for(float y = 0; y < _grid.getHeight(); y += 1.0f)
-    for(float x = 0.5; x < _grid.getWidth(); x+= 1.0f) {
-      Cell &cell = _grid(floor(x), floor(y));
-      Vector2 position(x, y);
-      position = particleTrace(position, timeStepSec);
-      cell.stagedVel[Cell::Y] = _grid.getVelocity(position).y;
+  }
+
+private:
+  // Traces a batch of positions back in place, using u and v as scratch.
+  void trace(const Grid &grid, float *x, float *y, float *u, float *v,
+	     unsigned count) const
+  {
+    grid.getVelocities(x, y, u, v, count);
+    for (unsigned k = 0; k < count; ++k) {
+      const Vector2 position = _solver.particleTrace(
+	Vector2(x[k], y[k]), Vector2(u[k], v[k]), _timeStepSec);
+      x[k] = position.x;
+      y[k] = position.y;
     }
-  for(unsigned i = 0; i < _grid.getRowCount() * _grid.getColCount(); i++) {
-    _grid[i].commitStagedVel();
   }
+
+  FluidSolver &_solver; // The solver whose grid is advected.
+  float _timeStepSec;   // The amount of time to advect over.
+};
+
+
+void FluidSolver::advectVelocity(float timeStepSec)
+{
+  // Small grids are not worth splitting into blocks of fewer than 16 rows.
+  const unsigned height = _grid.getRowCount() - 1;
+  _threadPool.parallelFor(0, height + 1, AdvectionTask(*this, timeStepSec),
+			  16);
+  _grid.commitStagedVel();
 }
 
 // This function only enforces boundary condtitions at the grid borders,
 // not on the free surface
-Vector2 FluidSolver::particleTrace(Vector2 position, float timeStepSec)
+Vector2 FluidSolver::particleTrace(Vector2 position, Vector2 velocity,
+				   float timeStepSec) const
 {
-  Vector2 velocity = _grid.getVelocity(position) * -timeStepSec;
+  velocity *= -timeStepSec;
   Vector2 toPosition = position + velocity;
   Vector2 tempPos;
   float width = _grid.getWidth();
@@ -179,26 +549,96 @@ void FluidSolver::applyGlobalVelocity(Vector2 velocity)
   // Apply the provided velocity to all cells in the simulation.
   for (unsigned y = 0; y < _grid.getHeight(); ++y) 
     for (unsigned x = 0; x < _grid.getWidth(); ++x) {
-      Cell &cell = _grid(x,y);
-      if (cell.cellType == Cell::FLUID) {
-	cell.vel[Cell::X] += velocity.x;
-	cell.vel[Cell::Y] += velocity.y;
+      if (_grid.cellType(x,y) == Cell::FLUID) {
+	_grid.u(x,y) += velocity.x;
+	_grid.v(x,y) += velocity.y;
       }
     }
 }
 
 
+// Stores the pressures of rows [begin, end) and subtracts the pressure
+// gradient from the faces of those rows.  Each face is updated exactly as if
+// every FLUID cell, in row-major order, subtracted its pressure from its
+// left and bottom faces and added it to its right and top faces.  Pressures
+// are read from the solution vector, so rows never depend on each other.
+//
+// The largest velocities of each row are recorded while the row is still in
+// cache.  Faces on the walls are left out, since boundaryCollide() zeroes
+// them before the velocities are used again.
+class FluidSolver::ProjectionTask : public ThreadPool::Task
+{
+public:
+  ProjectionTask(FluidSolver &solver, const double *p, float timeStepSec,
+		 float *rowMaxU, float *rowMaxV)
+    : _solver(solver), _p(p), _timeStepSec(timeStepSec),
+      _rowMaxU(rowMaxU), _rowMaxV(rowMaxV)
+  {}
+
+  void run(unsigned begin, unsigned end) const
+  {
+    Grid &grid = _solver._grid;
+    const unsigned width  = grid.getColCount() - 1;
+    const unsigned height = grid.getRowCount() - 1;
+    const int stride = grid.getStride();
+
+    for (unsigned j = begin; j < end; ++j) {
+      const unsigned row = grid.index(0, j);
+      const unsigned char *types = grid.cellTypeData() + row;
+      const double *p = _p + j * width;
+
+      // The vertical faces and pressures only exist below the top row.
+      if (j < height) {
+	float *u = grid.uData() + row;
+	float *pressure = grid.pressureData() + row;
+	for (unsigned i = 0; i < width; ++i)
+	  pressure[i] = p[i];
+	for (unsigned i = 0; i <= width; ++i) {
+	  if (i > 0 && types[i - 1] == Cell::FLUID)
+	    u[i] += _timeStepSec * pressure[i - 1];
+	  if (i < width && types[i] == Cell::FLUID)
+	    u[i] -= _timeStepSec * pressure[i];
+	}
+	_rowMaxU[j] = (width > 1) ? Grid::maxAbs(u + 1, width - 1) : 0.0f;
+      }
+
+      // Horizontal faces lie between this row of cells and the one below.
+      float *v = grid.vData() + row;
+      const unsigned char *typesBelow = types - stride;
+      const double *pBelow = p - width;
+      for (unsigned i = 0; i < width; ++i) {
+	if (typesBelow[i] == Cell::FLUID)
+	  v[i] += _timeStepSec * float(pBelow[i]);
+	if (types[i] == Cell::FLUID)
+	  v[i] -= _timeStepSec * float(p[i]);
+      }
+      _rowMaxV[j] = (j > 0 && j < height) ? Grid::maxAbs(v, width) : 0.0f;
+    }
+  }
+
+private:
+  FluidSolver &_solver; // The solver whose grid is projected.
+  const double *_p;     // The solved pressures, one per cell.
+  float _timeStepSec;   // The timestep the pressures were solved for.
+  float *_rowMaxU;      // Receives the largest |u| of each row.
+  float *_rowMaxV;      // Receives the largest |v| of each row.
+};
+
+
 void FluidSolver::pressureSolve(float timeStepSec)
 {
-  // NOTE: assumptions are made here that the only "SOLID" cells in the sim
-  // are the walls of the simulation, and are therefore not handled in this
-  // method.  Instead, they are handled in the boundaryCollide method where
-  // velocities entering or exiting a boundary are simply set to 0.0f.
+  // SOLID cells, both the walls of the simulation and obstacles inside it,
+  // are still.  boundaryCollide() zeroes every face they share with other
+  // cells before this method runs, so the divergence below already sees a
+  // velocity of 0 at every solid face.  The pressure operator then treats
+  // SOLID neighbors as Neumann boundaries, contributing nothing, and the
+  // projection's writes to solid faces are undone by the boundaryCollide()
+  // that follows.
 
   // The pressureSolve routine does the following:
   // * Calculate the negative divergence b with moditications at solid walls.
-  // * Set the entries of A (stored in Adiag, etc.)
-  // * Solve the Ap = b using the conjugate gradient algorithm.
+  // * Solve the Ap = b using the selected solver.  A is never assembled;
+  //   its stencil is applied directly from the grid's cell types.
   // * Compute the new velocities according to the updated pressure.
 
   // Calculate the dimensionality of our vectors/matrix.
@@ -214,31 +654,32 @@ void FluidSolver::pressureSolve(float timeStepSec)
       b(index) = -_grid.getVelocityDivergence(x, y);
     }
 
-  // Update the negative divergence to account for solid boundaries.
-  // TODO assumes that the only solids are at the boundaries, which have 0 vel.
+  // Update the negative divergence to account for the walls' velocities,
+  // which boundaryCollide() has set to 0.  Obstacles need no update, as
+  // their faces were zeroed along with the walls'.
   // Bottom row.
   for (unsigned x = 0; x < width; ++x) {
     unsigned y = 0;
     unsigned index = y * width + x;
-    b(index) -= _grid(x,y).vel[Cell::Y];
+    b(index) -= _grid.v(x,y);
   }
   // Top row.
   for (unsigned x = 0; x < width; ++x) {
     unsigned y = height - 1;
     unsigned index = y * width + x;
-    b(index) += _grid(x,y+1).vel[Cell::Y];
+    b(index) += _grid.v(x,y+1);
   }
   // Left column.
   for (unsigned y = 0; y < height; ++y) {
     unsigned x = 0;
     unsigned index = y * width + x;
-    b(index) -= _grid(x,y).vel[Cell::X];
+    b(index) -= _grid.u(x,y);
   }
   // Right column.
   for (unsigned y = 0; y < height; ++y) {
     unsigned x = width - 1;
     unsigned index = y * width + x;
-    b(index) += _grid(x+1,y).vel[Cell::X];
+    b(index) += _grid.u(x+1,y);
   }
 
   // Enforce the compatibility condition.
@@ -263,106 +704,98 @@ void FluidSolver::pressureSolve(float timeStepSec)
   //  std::cout << "Post-compat Divergence: " << std::endl << b << std::endl;
   */
 
-  // Set the entries of A. 
-  std::vector< Tripletd > vals;
-  SparseMatrix<double,RowMajor> A(dim, dim);
+  // Only FLUID cells are unknowns; the rows of all other cells are identity
+  // rows with a zero right-hand side.
   for (unsigned y = 0; y < height; ++y)
-    for (unsigned x = 0; x < width; ++x) {
-      Cell &cell = _grid(x,y);
-      unsigned i = y * width + x;  // this cell's col/row in A.
-      unsigned j;                  // neighbor cell's col/row in A
-
-      switch (cell.cellType) {
-      case (Cell::SOLID):
-	// If this cell is a SOLID, leave the entire row as 0's.
-	break;
-
-      case (Cell::AIR):
-	// If this cell is AIR, increment neighboring fluid diagonals' coeff.
-	if (cell.neighbors[Cell::POS_X]->cellType == Cell::FLUID) {
-	  j = y * width + x + 1;                        // rt neighbor's idx
-	  vals.push_back( Tripletd(j,j,timeStepSec) );  // rt neighbor's diag
-	}
-	if (cell.neighbors[Cell::POS_Y]->cellType == Cell::FLUID) {
-	  j = (y + 1) * width + x;                      // up neighbor's idx
-	  vals.push_back( Tripletd(j,j,timeStepSec) );  // up neighbor's diag
-	}
-	break;
-
-      case (Cell::FLUID):
-	// Cell is fluid. Determine coefficients of self and neighbors.
-	if (cell.neighbors[Cell::POS_X]->cellType == Cell::FLUID) {
-	  j = y * width + x + 1;                        // rt neighbor's idx
-	  vals.push_back( Tripletd(i,i,timeStepSec) );  // my diagonal coeff
-	  vals.push_back( Tripletd(i,j,-timeStepSec) ); // rt neighbor's coeff
-	  vals.push_back( Tripletd(j,j,timeStepSec) );  // rt neighbor's diag
-	}
-	else if (cell.neighbors[Cell::POS_X]->cellType == Cell::AIR) {
-	  vals.push_back( Tripletd(i,i,timeStepSec) );
-	}
-	if (cell.neighbors[Cell::POS_Y]->cellType == Cell::FLUID) {
-	  j = (y + 1) * width + x;                      // up neighbor's idx
-	  vals.push_back( Tripletd(i,i,timeStepSec) );  // my diagonal coeff
-	  vals.push_back( Tripletd(i,j,-timeStepSec) ); // up neighbor's coeff
-	  vals.push_back( Tripletd(j,j,timeStepSec) );  // up neighbor's diag
-	}
-	else if (cell.neighbors[Cell::POS_Y]->cellType == Cell::AIR) {
-	  vals.push_back( Tripletd(i,i,timeStepSec) );
-	}
-	break;
-	
-      default:
-	break;
-      }
-    }
-  A.setFromTriplets(vals.begin(), vals.end());
+    for (unsigned x = 0; x < width; ++x)
+      if (!_fluidCells.test(x, y))
+	b(y * width + x) = 0.0;
 
-  // Solve for the new pressure values, p.
+  // The pressure matrix only differs from the previous substep's by its
+  // timestep scaling unless the FLUID/AIR classification has changed.  When
+  // it has not changed, the previous preconditioner (or multigrid hierarchy)
+  // is reused: a preconditioner for A is exactly a scalar multiple of one for
+  // sA, and scaling a preconditioner by a constant leaves the CG iterates
+  // unchanged.
+  const unsigned char *types = _grid.cellTypeData();
+  const unsigned typeCount = _grid.getPaddedCount();
+  const bool setup = (_setupSolver != _pressureSolver ||
+		      _setupCellTypes.size() != typeCount ||
+		      memcmp(&_setupCellTypes[0], types, typeCount) != 0);
+  if (setup) {
+    _setupCellTypes.assign(types, types + typeCount);
+    _setupSolver = _pressureSolver;
+  }
+  _lastPressureSolve.reusedSetup = !setup;
+
+  // Seed the solve with the previous substep's pressure, if enabled.  Cells
+  // that are no longer FLUID must start (and stay) at 0.
   VectorXd p(dim);
-  ConjugateGradient< SparseMatrix<double,RowMajor> > cg;
-  cg.compute(A);
-  p = cg.solve(b);
-  if (cg.info() == Success)
-    std::cout << "SUCCESS: Convergence!" << std::endl;
-  else 
-    std::cout << "FAILED: No Convergence..." << std::endl;
-  //  std::cout << "#iterations:     " << cg.iterations() << std::endl;
-  //  std::cout << "estimated error: " << cg.error()      << std::endl;  
-  //  std::cout << "A: " << std::endl << A << std::endl;
-  //  std::cout << "Pressure: " << std::endl << p << std::endl;
-  //  std::cout << "Divergence: " << std::endl << b << std::endl;
-  //  std::cout << "Ap: " << std::endl << A*p << std::endl;
-
-  // Set new pressure values.
-  for (unsigned y = 0; y < height; ++y)
-    for (unsigned x = 0; x < width; ++x) {
-      unsigned index = y * width + x;
-      _grid(x, y).pressure = p(index);
-    }
+  _pressureOperator.setup(_grid, timeStepSec);
+  const bool warmStart = _warmStartPressure;
+  if (warmStart) {
+    for (unsigned y = 0; y < height; ++y)
+      for (unsigned x = 0; x < width; ++x)
+	p(y * width + x) = _fluidCells.test(x, y) ? _grid.pressure(x, y) : 0.0;
+  }
+  else
+    p.setZero();
+  _lastPressureSolve.warmStarted = warmStart;
+  // The previous pressure is scaled to best fit the new right-hand side, so
+  // that the guess is never worse than starting from zero, even when the
+  // fluid's shape has changed sharply since the last substep.
+  const double bNorm = b.norm();
+  if (warmStart && bNorm > 0.0) {
+    const VectorXd Ap = _pressureOperator * p;
+    const double ApNorm2 = Ap.squaredNorm();
+    const double scale = (ApNorm2 > 0.0) ? b.dot(Ap) / ApNorm2 : 0.0;
+    p *= scale;
+    _lastPressureSolve.initialError = (b - scale * Ap).norm() / bNorm;
+  }
+  else
+    _lastPressureSolve.initialError = (bNorm > 0.0) ? 1.0 : 0.0;
 
-  // Modify velocity field based on updated pressure scalar field.
-  for (unsigned y = 0; y < height; ++y)
-    for (unsigned x = 0; x < width; ++x) {
-      Cell &cell = _grid(x,y);
-      float pressureVel = timeStepSec * cell.pressure;
-      if (cell.cellType == Cell::FLUID) {
-	// Update all neighboring velocities touched by this pressure.
-	cell.vel[Cell::X] -= pressureVel;
-	cell.vel[Cell::Y] -= pressureVel;
-	if (cell.neighbors[Cell::POS_X])
-	  cell.neighbors[Cell::POS_X]->vel[Cell::X] += pressureVel;
-	if (cell.neighbors[Cell::POS_Y])
-	  cell.neighbors[Cell::POS_Y]->vel[Cell::Y] += pressureVel;
-      }
-    }
+  // Solve for the new pressure values, p.
+  switch (_pressureSolver) {
+  case MULTIGRID_SOLVER:
+    if (setup)
+      _multigrid.setup(_grid, timeStepSec);
+    else
+      _multigrid.setScale(timeStepSec);
+    _lastPressureSolve.converged = _multigrid.solve(b.data(), p.data(),
+      _pressureTolerance, MAX_MULTIGRID_CYCLES);
+    _lastPressureSolve.iterations = _multigrid.iterations();
+    _lastPressureSolve.error = _multigrid.error();
+    break;
+  case MIC_PCG_SOLVER:
+    _micPCG.preconditioner().setGridWidth(width);
+    solvePressure(_micPCG, _pressureOperator, setup, b, p,
+		  _pressureTolerance, _lastPressureSolve);
+    break;
+  case MGPCG_SOLVER:
+    if (setup)
+      _multigrid.setup(_grid, timeStepSec);
+    _mgPCG.preconditioner().setMultigrid(&_multigrid);
+    solvePressure(_mgPCG, _pressureOperator, setup, b, p,
+		  _pressureTolerance, _lastPressureSolve);
+    break;
+  case DIAGONAL_PCG_SOLVER:
+  default:
+    solvePressure(_diagonalPCG, _pressureOperator, setup, b, p,
+		  _pressureTolerance, _lastPressureSolve);
+    break;
+  }
+  _framePressureSolves.push_back(_lastPressureSolve);
 
-  // Calculate the negative divergence throughout the simulation.
-  for (unsigned y = 0; y < height; ++y)
-    for (unsigned x = 0; x < width; ++x) {
-      unsigned index = y * width + x;
-      b(index) = -_grid.getVelocityDivergence(x, y);
-    }
-  std::cout << "New Divergence: " << std::endl << b << std::endl;
+  // Store the new pressures and update the velocity field in one parallel
+  // sweep over the rows, which also finds the largest resulting velocities.
+  std::vector<float> rowMaxU(height + 1, 0.0f), rowMaxV(height + 1, 0.0f);
+  _threadPool.parallelFor(0, height + 1,
+    ProjectionTask(*this, p.data(), timeStepSec, &rowMaxU[0], &rowMaxV[0]),
+    16);
+  _maxVelocity = Vector2(*std::max_element(rowMaxU.begin(), rowMaxU.end()),
+			 *std::max_element(rowMaxV.begin(), rowMaxV.end()));
+  _maxVelocityCurrent = true;
 }
 
 
@@ -371,67 +804,219 @@ void FluidSolver::boundaryCollide()
   // Set all boundary velocities to zero in the MAC grid.
   // This prevents fluid from entering or exiting through the walls of the
   // simulation.
-  const unsigned rows = _grid.getRowCount();
-  const unsigned cols = _grid.getColCount();
+  const unsigned width  = _grid.getColCount() - 1;
+  const unsigned height = _grid.getRowCount() - 1;
 
-  // Bottom row. Set velocity Y component to 0.
-  // Top row. Set velocity X and Y components to 0. Set to SOLID.
-  for (unsigned col = 0; col < cols; ++col) {
-    _grid(col, 0).vel[Cell::Y] = 0.0f;
-    _grid(col, rows-1).vel[Cell::X] = 0.0f;
-    _grid(col, rows-1).vel[Cell::Y] = 0.0f;
-    _grid(col, rows-1).cellType = Cell::SOLID;
+  // Bottom and top walls. Set velocity Y component to 0.
+  for (unsigned x = 0; x < width; ++x) {
+    _grid.v(x, 0) = 0.0f;
+    _grid.v(x, height) = 0.0f;
   }
 
-  // Left column. Set velocity X component to 0.
-  // Right column. Set velocity X and Y components to 0. Set to SOLID.
-  for (unsigned row = 0; row < rows; ++row) {
-    _grid(0, row).vel[Cell::X] = 0.0f;
-    _grid(cols-1, row).vel[Cell::X] = 0.0f;
-    _grid(cols-1, row).vel[Cell::Y] = 0.0f;
-    _grid(cols-1, row).cellType = Cell::SOLID;
+  // Left and right walls. Set velocity X component to 0.
+  for (unsigned y = 0; y < height; ++y) {
+    _grid.u(0, y) = 0.0f;
+    _grid.u(width, y) = 0.0f;
   }
+
+  // Obstacles inside the domain.
+  float *u = _grid.uData();
+  for (unsigned k = 0; k < _solidUFaces.size(); ++k)
+    u[_solidUFaces[k]] = 0.0f;
+  float *v = _grid.vData();
+  for (unsigned k = 0; k < _solidVFaces.size(); ++k)
+    v[_solidVFaces[k]] = 0.0f;
 }
 
 
 void FluidSolver::moveParticles(float timeStepSec)
 {
-  // Advect velocity using simple forward Euler.
-  vector<Vector2>::iterator itr = _particles.begin();
-  for (; itr != _particles.end(); ++itr) {
-    *itr += _grid.getVelocity(*itr) * timeStepSec;
-  }
+  _particles.advect(_grid, timeStepSec, _particleIntegrator, _threadPool);
 }
 
 
-void FluidSolver::markCells()
+void FluidSolver::sortParticles()
 {
-  // Sweep over all FLUID cells, resetting them to AIR.
-  unsigned cellCount = _grid.getRowCount() * _grid.getColCount();
-  for (unsigned i = 0; i < cellCount; ++i)
-    if (_grid[i].cellType == Cell::FLUID)
-      _grid[i].cellType = Cell::AIR;
-  
-  // Iterate over all marker particles, setting their resident cells to FLUID.
-  vector<Vector2>::iterator itr = _particles.begin();
-  for (; itr != _particles.end(); ++itr) {
-    if (itr->x >= 0.0f && itr->x < _width &&
-	itr->y >= 0.0f && itr->y < _height)
-      _grid(itr->x, itr->y).cellType = Cell::FLUID;
-  }
+  _particles.sortByCell(_grid.getColCount() - 1, _grid.getRowCount() - 1,
+			_particleCellOrder);
 }
 
 
-void FluidSolver::draw(IFluidRenderer *renderer)
+// Marks the cell of every particle in chunks [begin, end) of the particles,
+// each chunk in its own bitmap.  Particles are split into equal contiguous
+// chunks, so no two threads ever write to the same bitmap.
+class FluidSolver::MarkParticlesTask : public ThreadPool::Task
 {
-  // If a new frame is ready for rendering, draw it.
-  if (_frameReady) {
-    renderer->drawGrid(_grid, _particles);
-    _frameReady = false;
+public:
+  MarkParticlesTask(FluidSolver &solver, CellBitmap *chunkCells,
+		    unsigned chunkCount)
+    : _solver(solver), _chunkCells(chunkCells), _chunkCount(chunkCount)
+  {}
+
+  void run(unsigned begin, unsigned end) const
+  {
+    const ParticleSystem &particles = _solver._particles;
+    const float *px = particles.xData();
+    const float *py = particles.yData();
+    const float width  = _solver._width;
+    const float height = _solver._height;
+    const unsigned size  = particles.size() / _chunkCount;
+    const unsigned extra = particles.size() % _chunkCount;
+
+    for (unsigned c = begin; c < end; ++c) {
+      CellBitmap &cells = _chunkCells[c];
+      cells.clear();
+      if (cells.getHeight() == 0)
+	continue;
+
+      // Consecutive particles usually fall in the same word, so bits are
+      // gathered in a register and only written out when the word changes.
+      CellBitmap::Word *words = cells.rowData(0);
+      const unsigned rowWords = cells.getRowWords();
+      unsigned word = 0;
+      CellBitmap::Word bits = 0;
+      const unsigned first = c * size + std::min(c, extra);
+      const unsigned last  = first + size + (c < extra);
+      for (unsigned k = first; k < last; ++k) {
+	if (px[k] >= 0.0f && px[k] < width && py[k] >= 0.0f && py[k] < height) {
+	  const unsigned x = px[k];
+	  const unsigned y = py[k];
+	  const unsigned w = y * rowWords + x / CellBitmap::WORD_BITS;
+	  if (w != word) {
+	    words[word] |= bits;
+	    word = w;
+	    bits = 0;
+	  }
+	  bits |= CellBitmap::Word(1) << (x % CellBitmap::WORD_BITS);
+	}
+      }
+      words[word] |= bits;
+    }
   }
-  else {
-    // TODO, redraw previous frame.
+
+private:
+  FluidSolver &_solver;    // The solver whose particles are marked.
+  CellBitmap *_chunkCells; // One bitmap per chunk.
+  unsigned _chunkCount;    // Number of chunks.
+};
+
+
+// Builds rows [begin, end) of the FLUID cell bitmap, either by ORing the
+// chunk bitmaps together or, without chunks, from the sorted particles' cell
+// ranges.  The cell types of each row are then updated from its bits: FLUID
+// where set, and former FLUID cells become AIR.
+class FluidSolver::MarkRowsTask : public ThreadPool::Task
+{
+public:
+  MarkRowsTask(FluidSolver &solver, const CellBitmap *chunkCells,
+	       unsigned chunkCount)
+    : _solver(solver), _chunkCells(chunkCells), _chunkCount(chunkCount)
+  {}
+
+  void run(unsigned begin, unsigned end) const
+  {
+    Grid &grid = _solver._grid;
+    CellBitmap &fluid = _solver._fluidCells;
+    const unsigned width = fluid.getWidth();
+    const unsigned words = fluid.getRowWords();
+
+    for (unsigned y = begin; y < end; ++y) {
+      CellBitmap::Word *row = fluid.rowData(y);
+      if (_chunkCount > 0) {
+	for (unsigned w = 0; w < words; ++w) {
+	  CellBitmap::Word bits = 0;
+	  for (unsigned c = 0; c < _chunkCount; ++c)
+	    bits |= _chunkCells[c].rowData(y)[w];
+	  row[w] = bits;
+	}
+      }
+      else {
+	for (unsigned w = 0; w < words; ++w)
+	  row[w] = 0;
+	for (unsigned x = 0; x < width; ++x) {
+	  unsigned first, last;
+	  _solver._particles.getCellRange(x, y, first, last);
+	  if (first != last)
+	    fluid.set(x, y);
+	}
+      }
+
+      // Particles that have strayed into an obstacle leave it SOLID.
+      unsigned char *types = grid.cellTypeData() + grid.index(0, y);
+      for (unsigned x = 0; x < width; ++x) {
+	const CellBitmap::Word bit =
+	  CellBitmap::Word(1) << (x % CellBitmap::WORD_BITS);
+	if (types[x] == Cell::SOLID)
+	  row[x / CellBitmap::WORD_BITS] &= ~bit;
+	else if (row[x / CellBitmap::WORD_BITS] & bit)
+	  types[x] = Cell::FLUID;
+	else if (types[x] == Cell::FLUID)
+	  types[x] = Cell::AIR;
+      }
+    }
   }
+
+private:
+  FluidSolver &_solver;          // The solver whose cells are marked.
+  const CellBitmap *_chunkCells; // Bitmap of each particle chunk.
+  unsigned _chunkCount;          // Number of chunks, or 0 to use ranges.
+};
+
+
+void FluidSolver::markCells()
+{
+  const unsigned width  = _grid.getColCount() - 1;
+  const unsigned height = _grid.getRowCount() - 1;
+  if (_fluidCells.getWidth() != width || _fluidCells.getHeight() != height)
+    _fluidCells.resize(width, height);
+
+  // Freshly sorted particles list the particles of each cell directly, so
+  // the rows can be marked straight from the range table.
+  if (_particles.hasCellRanges()) {
+    _threadPool.parallelFor(0, height, MarkRowsTask(*this, NULL, 0), 16);
+    return;
+  }
+
+  // Otherwise each thread marks a chunk of the particles in a bitmap of its
+  // own, and those are merged row by row.  Setting a bit is a single OR, so
+  // the many particles sharing a cell cost no more than a cached write each.
+  // Chunks are kept large enough that clearing and merging their bitmaps
+  // stays cheap next to marking their particles.
+  const unsigned minChunkSize = 16384;
+  const unsigned chunkCount = std::max(1u, std::min(
+    _threadPool.getThreadCount(), _particles.size() / minChunkSize));
+  CellBitmap *chunkCells = &_fluidCells;
+  if (chunkCount > 1) {
+    _chunkFluidCells.resize(chunkCount);
+    for (unsigned c = 0; c < chunkCount; ++c)
+      if (_chunkFluidCells[c].getWidth() != width ||
+	  _chunkFluidCells[c].getHeight() != height)
+	_chunkFluidCells[c].resize(width, height);
+    chunkCells = &_chunkFluidCells[0];
+  }
+
+  _threadPool.parallelFor(0, chunkCount,
+			  MarkParticlesTask(*this, chunkCells, chunkCount));
+  _threadPool.parallelFor(0, height,
+			  MarkRowsTask(*this, chunkCells, chunkCount), 16);
+}
+
+
+const Grid &FluidSolver::getGrid() const
+{
+  return _grid;
+}
+
+
+const ParticleSystem &FluidSolver::getParticles() const
+{
+  return _particles;
+}
+
+
+const CellBitmap &FluidSolver::getFluidCells() const
+{
+  return _fluidCells;
 }
 
 
@@ -445,3 +1030,147 @@ float FluidSolver::getSimulationHeight() const
 {
   return _height;
 }
+
+
+float FluidSolver::getFrameTimeSec() const
+{
+  return _frameTimeSec;
+}
+
+
+void FluidSolver::setFrameTimeSec(float frameTimeSec)
+{
+  _frameTimeSec = frameTimeSec;
+}
+
+
+void FluidSolver::setCFLNumber(float cflNumber)
+{
+  _cflNumber = cflNumber;
+}
+
+
+float FluidSolver::getCFLNumber() const
+{
+  return _cflNumber;
+}
+
+
+void FluidSolver::setGravity(const Vector2 &gravity)
+{
+  _gravity = gravity;
+}
+
+
+Vector2 FluidSolver::getGravity() const
+{
+  return _gravity;
+}
+
+
+void FluidSolver::setPressureSolver(PressureSolverType type)
+{
+  _pressureSolver = type;
+  _setupSolver = PRESSURE_SOLVER_COUNT;
+}
+
+
+FluidSolver::PressureSolverType FluidSolver::getPressureSolver() const
+{
+  return _pressureSolver;
+}
+
+
+FluidSolver::PressureSolveStats FluidSolver::getLastPressureSolveStats() const
+{
+  return _lastPressureSolve;
+}
+
+
+const std::vector<FluidSolver::PressureSolveStats> &
+FluidSolver::getFramePressureSolveStats() const
+{
+  return _framePressureSolves;
+}
+
+
+void FluidSolver::setWarmStartPressure(bool enabled)
+{
+  _warmStartPressure = enabled;
+}
+
+
+bool FluidSolver::getWarmStartPressure() const
+{
+  return _warmStartPressure;
+}
+
+
+SolverDiagnostics &FluidSolver::getDiagnostics()
+{
+  return _diagnostics;
+}
+
+
+const SolverDiagnostics &FluidSolver::getDiagnostics() const
+{
+  return _diagnostics;
+}
+
+
+Vector2 FluidSolver::getMaxFaceVelocity() const
+{
+  return _maxVelocityCurrent ? _maxVelocity : _grid.getMaxFaceVelocity();
+}
+
+
+void FluidSolver::setThreadCount(unsigned threadCount)
+{
+  _threadPool.setThreadCount(threadCount);
+}
+
+
+unsigned FluidSolver::getThreadCount() const
+{
+  return _threadPool.getThreadCount();
+}
+
+
+void FluidSolver::setParticleIntegrator(ParticleSystem::Integrator integrator)
+{
+  _particleIntegrator = integrator;
+}
+
+
+ParticleSystem::Integrator FluidSolver::getParticleIntegrator() const
+{
+  return _particleIntegrator;
+}
+
+
+void FluidSolver::setParticleSorting(unsigned substeps,
+				     ParticleSystem::CellOrder order)
+{
+  _particleSortInterval = substeps;
+  _particleCellOrder = order;
+}
+
+
+unsigned FluidSolver::getParticleSortInterval() const
+{
+  return _particleSortInterval;
+}
+
+
+#ifdef FLUID_PROFILING
+Profiler &FluidSolver::getProfiler()
+{
+  return _profiler;
+}
+
+
+const Profiler &FluidSolver::getProfiler() const
+{
+  return _profiler;
+}
+#endif
@@ -1,23 +1,114 @@
 #ifndef __FLUID_SOLVER_H__
 #define __FLUID_SOLVER_H__
 
+#include "CellBitmap.h"
 #include "Grid.h"
 #include "Vector2.h"
-#include "IFluidRenderer.h"
+#include "MICPreconditioner.h"
+#include "MultigridSolver.h"
+#include "ParticleSystem.h"
+#include "PressureOperator.h"
+#include "Profiler.h"
+#include "Scenario.h"
+#include "SolverDiagnostics.h"
+#include "ThreadPool.h"
 #include <vector>
+#include <eigen3/Eigen/IterativeLinearSolvers>
 
+class Checkpoint;
 
-class FluidSolver : public QObject
+
+// The fluid simulation itself.  This class has no dependency on Qt's GUI or
+// OpenGL modules; front ends (see QFluidSolver) and headless tools drive it
+// by calling advanceFrame() and read the results via getGrid() and
+// getParticles().
+class FluidSolver
 {
-  Q_OBJECT
+public:
+  // Enumerated type listing all implemented pressure solvers to choose from.
+  enum PressureSolverType {
+    DIAGONAL_PCG_SOLVER = 0, // Conjugate gradient, diagonal preconditioner.
+    MIC_PCG_SOLVER,          // Conjugate gradient, MIC(0) preconditioner.
+    MULTIGRID_SOLVER,        // Geometric multigrid V-cycles.
+    MGPCG_SOLVER,            // Conjugate gradient, multigrid preconditioner.
+    PRESSURE_SOLVER_COUNT
+  };
+
+  // Convergence information reported by a single pressure solve.
+  struct PressureSolveStats {
+    unsigned iterations;   // Number of iterations performed.
+    double   error;        // Relative residual |Ap - b| / |b| at termination.
+    double   initialError; // Relative residual of the initial guess.
+    bool     converged;    // True if the solver reached the tolerance.
+    bool     warmStarted;  // True if seeded with the previous pressure.
+    bool     reusedSetup;  // True if the preconditioner/hierarchy was reused.
+  };
 
 private:
   const float     _width;       // The width of the simulation.
   const float     _height;      // The height of the simulation.
+  Scenario        _scenario;    // The scene reset() sets up.
   Grid            _grid;        // The 2D MAC Grid.
-  Vector2 _maxVelocity; // The maximum velocity seen last timestep.
-  bool            _frameReady;  // True if frame's calculations are complete.
-  std::vector<Vector2> _particles;
+  float           _frameTimeSec; // Simulated time per frame.
+  float           _cflNumber;   // Cells the fastest fluid moves per substep.
+  Vector2         _gravity;     // Acceleration of all fluid.
+  Vector2 _maxVelocity;     // Largest face velocities, for the CFL timestep.
+  bool _maxVelocityCurrent; // True if _maxVelocity matches the grid.
+  ParticleSystem  _particles;   // Marker particles, stored as x/y arrays.
+  ParticleSystem::Integrator _particleIntegrator; // Particle time stepping.
+  unsigned _particleSortInterval;            // Substeps between sorts.
+  ParticleSystem::CellOrder _particleCellOrder; // Cell order of the sort.
+  PressureSolverType _pressureSolver;    // Selected pressure solver.
+  double _pressureTolerance;             // Relative residual tolerance.
+  PressureSolveStats _lastPressureSolve; // Stats from the latest solve.
+  std::vector<PressureSolveStats> _framePressureSolves; // This frame's solves.
+  bool _warmStartPressure;               // Seed solves with last pressure.
+  MultigridSolver _multigrid;            // Multigrid hierarchy, reused.
+
+  // Pressure solvers are kept between substeps, so that their preconditioners
+  // can be reused while the FLUID/AIR classification remains unchanged.
+  typedef Eigen::ConjugateGradient< PressureOperator, Eigen::Lower|Eigen::Upper,
+    Eigen::DiagonalPreconditioner<double> > DiagonalPCG;
+  typedef Eigen::ConjugateGradient< PressureOperator, Eigen::Lower|Eigen::Upper,
+    MICPreconditioner<double> > MICPCG;
+  typedef Eigen::ConjugateGradient< PressureOperator, Eigen::Lower|Eigen::Upper,
+    MultigridPreconditioner > MGPCG;
+  PressureOperator _pressureOperator; // The pressure matrix, matrix-free.
+  DiagonalPCG _diagonalPCG;           // Diagonal-preconditioned CG.
+  MICPCG _micPCG;                     // MIC(0)-preconditioned CG.
+  MGPCG _mgPCG;                       // Multigrid-preconditioned CG.
+  PressureSolverType _setupSolver;    // Solver whose setup is current.
+  std::vector<unsigned char> _setupCellTypes; // Cell types at that setup.
+
+  SolverDiagnostics _diagnostics; // Per-substep diagnostics records.
+  unsigned long _stepCount;       // Substeps simulated since construction.
+#ifdef FLUID_PROFILING
+  Profiler _profiler;             // Per-stage timings.
+#endif
+  ThreadPool _threadPool;         // Runs the data-parallel stages.
+
+  CellBitmap _fluidCells;         // Cells containing a marker particle.
+  std::vector<CellBitmap> _chunkFluidCells; // Per-chunk scratch for markCells.
+  std::vector<unsigned> _solidUFaces; // u faces of SOLID cells in the domain.
+  std::vector<unsigned> _solidVFaces; // v faces of SOLID cells in the domain.
+
+  // Advects the velocities of a block of grid rows; see advectVelocity().
+  class AdvectionTask;
+
+  // Projects the velocities of a block of grid rows; see pressureSolve().
+  class ProjectionTask;
+
+  // Marks the cells of chunks of particles; see markCells().
+  class MarkParticlesTask;
+
+  // Merges the marked cells of a block of rows; see markCells().
+  class MarkRowsTask;
+
+  // Sets up the cells of a block of rows; see setUpScene().
+  class SceneRowsTask;
+
+  // Seeds the particles of a block of rows; see setUpScene().
+  class SeedParticlesTask;
 
 public:
   // Constructs a 2D fluid simulation of the specified size.
@@ -28,18 +119,43 @@ public:
   //   float height - The height of the simulation, in world coordinates.
   FluidSolver(float width, float height);
 
+  // Constructs a 2D fluid simulation set up as a scenario describes.
+  //
+  // Arguments:
+  //   Scenario &scenario - The simulation's size, settings and scene.
+  explicit FluidSolver(const Scenario &scenario);
+
   // Destructs the solver.
   virtual ~FluidSolver();
 
-  // Draws the current state of the simulation using the provided FluidRenderer.
-  // 
+  // Returns the simulation's MAC grid.
+  //
   // Arguments:
-  //   IFluidRenderer *renderer - The FluidRenderer that will draw all sim data.
+  //   None
   //
   // Returns:
+  //   Grid & - The grid holding all simulation cell data.
+  const Grid &getGrid() const;
+
+  // Returns the marker particles visually representing the fluid.
+  //
+  // Arguments:
   //   None
-  void draw(IFluidRenderer *renderer);
-  
+  //
+  // Returns:
+  //   ParticleSystem & - The marker particle positions.
+  const ParticleSystem &getParticles() const;
+
+  // Returns the cells that currently hold fluid, one bit per cell.  A bit is
+  // set exactly when the cell is marked FLUID, as of the last markCells().
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   CellBitmap & - The FLUID cells.
+  const CellBitmap &getFluidCells() const;
+
   // Returns the simulation width.
   //
   // Arguments:
@@ -58,10 +174,225 @@ public:
   //   float - The height of the simulation.
   float getSimulationHeight() const;
 
-public slots:
-  // Advances the simulation by a single frame if necessary.  If a frame has
-  // already been calculated but not yet drawn (by calling the draw() method
-  // of this class), this method immediately returns.
+  // Returns the amount of simulated time advanced by each advanceFrame().
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float - The frame duration, in seconds.
+  float getFrameTimeSec() const;
+
+  // Sets the amount of simulated time advanced by each advanceFrame().
+  //
+  // Arguments:
+  //   float frameTimeSec - The frame duration, in seconds (default 1/30).
+  //
+  // Returns:
+  //   None
+  void setFrameTimeSec(float frameTimeSec);
+
+  // Sets the CFL number, the largest distance in cells that the fastest
+  // fluid may travel in one substep.  Larger numbers take fewer, longer
+  // substeps per frame.
+  //
+  // Arguments:
+  //   float cflNumber - The CFL number (default 2).
+  //
+  // Returns:
+  //   None
+  void setCFLNumber(float cflNumber);
+
+  // Returns the CFL number.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float - The CFL number.
+  float getCFLNumber() const;
+
+  // Sets the acceleration applied to all fluid every substep.
+  //
+  // Arguments:
+  //   Vector2 gravity - The acceleration, in cells per second squared
+  //                     (default 0, -9.8).
+  //
+  // Returns:
+  //   None
+  void setGravity(const Vector2 &gravity);
+
+  // Returns the acceleration applied to all fluid.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   Vector2 - The acceleration, in cells per second squared.
+  Vector2 getGravity() const;
+
+  // Returns the largest X and Y face velocities currently in the grid, the
+  // bound used to choose the next CFL timestep.  After each substep this is
+  // the value found during the pressure projection.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   Vector2 - (max |u|, max |v|) over all faces.
+  Vector2 getMaxFaceVelocity() const;
+
+  // Selects the solver used for the pressure projection.  The next solve
+  // sets its preconditioner (or multigrid hierarchy) up afresh, even if the
+  // solver is unchanged.
+  //
+  // Arguments:
+  //   PressureSolverType type - The pressure solver to use from now on.
+  //
+  // Returns:
+  //   None
+  void setPressureSolver(PressureSolverType type);
+
+  // Returns the solver used for the pressure projection.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   PressureSolverType - The currently selected pressure solver.
+  PressureSolverType getPressureSolver() const;
+
+  // Returns the iteration count and residual of the most recent pressure
+  // solve.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   PressureSolveStats - Convergence information for the latest solve.
+  PressureSolveStats getLastPressureSolveStats() const;
+
+  // Returns the statistics of every pressure solve performed while
+  // calculating the most recent frame, one entry per substep, in order.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   std::vector<PressureSolveStats> & - The latest frame's solve stats.
+  const std::vector<PressureSolveStats> &getFramePressureSolveStats() const;
+
+  // Enables or disables seeding each pressure solve with the pressure from
+  // the previous substep, scaled to best fit the new divergence.  Enabled by
+  // default.
+  //
+  // Arguments:
+  //   bool enabled - True to warm start pressure solves.
+  //
+  // Returns:
+  //   None
+  void setWarmStartPressure(bool enabled);
+
+  // Returns whether pressure solves are seeded with the previous pressure.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   bool - True if pressure solves are warm started.
+  bool getWarmStartPressure() const;
+
+  // Returns the solver's diagnostics channel, which collects one record per
+  // substep according to its verbosity (off by default).
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   SolverDiagnostics & - The diagnostics channel.
+  SolverDiagnostics &getDiagnostics();
+  const SolverDiagnostics &getDiagnostics() const;
+
+  // Sets the number of threads used by the data-parallel stages of the
+  // simulation.  Results are identical for any thread count.
+  //
+  // Arguments:
+  //   unsigned threadCount - The number of threads, or 0 to use one per
+  //                          processor core (the default).
+  //
+  // Returns:
+  //   None
+  void setThreadCount(unsigned threadCount);
+
+  // Returns the number of threads used by the data-parallel stages.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of threads.
+  unsigned getThreadCount() const;
+
+  // Selects the integrator used to move marker particles.  Higher order
+  // integrators follow curved streamlines more closely at large CFL numbers,
+  // at the cost of extra velocity samples per particle.
+  //
+  // Arguments:
+  //   ParticleSystem::Integrator integrator - The integrator (default RK2).
+  //
+  // Returns:
+  //   None
+  void setParticleIntegrator(ParticleSystem::Integrator integrator);
+
+  // Returns the integrator used to move marker particles.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   ParticleSystem::Integrator - The selected integrator.
+  ParticleSystem::Integrator getParticleIntegrator() const;
+
+  // Sets how often marker particles are reordered by cell.  Sorting keeps
+  // the grid lookups of consecutive particles close together in memory,
+  // and lets markCells() work from the sorted cell ranges on the substeps
+  // where it runs.  Particles drift slowly, so sorting every substep rarely
+  // pays for itself.
+  //
+  // Arguments:
+  //   unsigned substeps - Sort every this many substeps (default 8), or 0
+  //                       to never sort.
+  //   ParticleSystem::CellOrder order - The order cells are laid out in.
+  //
+  // Returns:
+  //   None
+  void setParticleSorting(unsigned substeps,
+			  ParticleSystem::CellOrder order =
+			  ParticleSystem::ROW_MAJOR);
+
+  // Returns how often marker particles are reordered by cell.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of substeps between sorts, or 0 if disabled.
+  unsigned getParticleSortInterval() const;
+
+#ifdef FLUID_PROFILING
+  // Returns the solver's profiler, which times every stage of each substep.
+  // Only available in builds with FLUID_PROFILING defined.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   Profiler & - The profiler.
+  Profiler &getProfiler();
+  const Profiler &getProfiler() const;
+#endif
+
+  // Advances the simulation by a single frame.
   // Calculating a single frame involves determining an appropriate timestep
   // based on the CFL condition, and potentially advancing the simulation
   // multiple times based on that timestep until the simulation over the
@@ -74,9 +405,10 @@ public slots:
   //   None
   void advanceFrame();
 
-  // Resets the simulation to a default starting grid.
-  // This is primarily to be used for debugging during development, and is
-  // expected to change regularly as more capabilities are added.
+  // Resets the simulation to the starting scene of its scenario: the one
+  // it was constructed with or last reset to, or by default the upper right
+  // quadrant full of still fluid (see Scenario::makeDefault()).  Settings
+  // such as the pressure solver are kept.
   //
   // Arguments:
   //   None
@@ -85,6 +417,32 @@ public slots:
   //   None
   void reset();
 
+  // Resets the simulation to a scenario's starting scene, and takes on its
+  // frame rate, CFL number, gravity and pressure solver.
+  //
+  // Arguments:
+  //   Scenario &scenario - A scenario of the same size as the simulation.
+  //
+  // Returns:
+  //   bool - True if reset; false if the scenario's size differs, in which
+  //          case the simulation is unchanged.
+  bool reset(const Scenario &scenario);
+
+  // Restores the simulation to a saved frame.  The grid's velocities,
+  // pressures and SOLID cells, and the marker particles, are copied from the
+  // checkpoint; FLUID and AIR cells are then marked from the particles as
+  // after any other frame.  Settings such as the pressure solver are kept.
+  // Continuing from a restored frame reproduces the fields of the original
+  // run exactly, though particles may be reordered at different substeps.
+  //
+  // Arguments:
+  //   Checkpoint &checkpoint - An open checkpoint of the same grid size.
+  //
+  // Returns:
+  //   bool - True if restored; false if the checkpoint's grid size differs,
+  //          in which case the simulation is unchanged.
+  bool restore(const Checkpoint &checkpoint);
+
 protected:
   // Advances the simulation by a specific amount of time.
   //
@@ -96,7 +454,8 @@ protected:
   void advanceTimeStep(float timeStepSec);
 
   // Advects the fluid's velocity field via a backward particle trace,
-  // over the specified amount of time
+  // over the specified amount of time.  Rows of faces are traced in
+  // parallel.
   //
   // Arguments:
   //   float timeStepSec - The amount of time to advect over.
@@ -109,11 +468,13 @@ protected:
   //
   // Arguments:
   //   Vector2 position - The starting position of an imaginary particle.
+  //   Vector2 velocity - The fluid velocity sampled at that position.
   //   float timeStepSec - The amount of time to trace backwards.
   //
   // Returns:
   //   Vector2 - The new position of the imaginary particle.
-  Vector2 particleTrace(Vector2 position, float timeStepSec);
+  Vector2 particleTrace(Vector2 position, Vector2 velocity,
+			float timeStepSec) const;
 
   // Applies a global velocity to all cells containing fluid. This is helpful
   // for simulating gravity.
@@ -127,7 +488,8 @@ protected:
   
   // Adjusts velocity field based on the pressure scalar field to enforce 
   // incompressibility (non-divergence) of the fluid, and redistributes
-  // pressure values appropriately.
+  // pressure values appropriately.  The pass that updates the velocities
+  // also records the largest face velocities for the next CFL timestep.
   //
   // Arguments:
   //   float timeStepSec - The amount of time to simulate.
@@ -137,7 +499,7 @@ protected:
   void pressureSolve(float timeStepSec);
   
   // Modifies velocity values to prevent the fluid from flowing out of the
-  // simulation boundaries.
+  // simulation boundaries, or into SOLID cells inside it.
   //
   // TODO:
   //   Does this cover the case where fluid cells travel into air?
@@ -158,7 +520,17 @@ protected:
   //   None
   void moveParticles(float timeStepSec);
 
-  // Updates all FLUID and AIR cells to reflect positions of marker particles.
+  // Reorders the marker particles by the cell they occupy.
+  //
+  // Arguments:
+  //   None
+  // 
+  // Returns:
+  //   None
+  void sortParticles();
+
+  // Updates all FLUID and AIR cells, and the FLUID cell bitmap, to reflect
+  // positions of marker particles.  SOLID cells are never changed.
   //
   // Arguments:
   //   None
@@ -170,6 +542,27 @@ protected:
 private:
   // Hidden default constructor.
   FluidSolver();
+
+  // Sets up the scenario's starting scene: clears the velocities and
+  // pressures, applies its regions to the cells and seeds particles in
+  // every FLUID cell.  Rows are set up in parallel.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void setUpScene();
+
+  // Lists the faces of the SOLID cells inside the domain, which
+  // boundaryCollide() holds at zero velocity.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void findSolidFaces();
 };
 
 #endif //__FLUID_SOLVER_H__
@@ -0,0 +1,255 @@
+#include "FrameExporter.h"
+#include "FrameLayout.h"
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+
+// Arrays start on multiples of this many bytes.
+static const unsigned long ARRAY_ALIGNMENT = 64;
+
+
+// Returns true if the host stores numbers little-endian.
+static bool isLittleEndianHost()
+{
+  const uint32_t one = 1;
+  return *reinterpret_cast<const unsigned char *>(&one) == 1;
+}
+
+
+// Writes an array of 4 byte values little-endian, swapping bytes through a
+// small buffer on big-endian hosts.
+static bool writeLittleEndian(FILE *file, const float *values,
+			      unsigned long count)
+{
+  if (count == 0)
+    return true;
+  if (isLittleEndianHost())
+    return fwrite(values, sizeof(float), count, file) == count;
+
+  const unsigned long blockSize = 4096;
+  unsigned char block[blockSize * sizeof(float)];
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(values);
+  for (unsigned long first = 0; first < count; first += blockSize) {
+    const unsigned long n = std::min(blockSize, count - first);
+    for (unsigned long k = 0; k < n; ++k)
+      for (unsigned b = 0; b < sizeof(float); ++b)
+	block[k * sizeof(float) + b] =
+	  bytes[(first + k) * sizeof(float) + sizeof(float) - 1 - b];
+    if (fwrite(block, sizeof(float), n, file) != n)
+      return false;
+  }
+  return true;
+}
+
+
+FrameExporter::FrameExporter(const std::string &directory, unsigned capacity,
+			     OverflowPolicy policy)
+  : QThread(),
+    _directory(directory),
+    _policy(policy),
+    _codec(NULL),
+    _mutex(),
+    _changed(),
+    _queue(std::max(capacity, 1u)),
+    _head(0),
+    _count(0),
+    _writing(false),
+    _stopping(false),
+    _written(0),
+    _dropped(0),
+    _failed(0),
+    _writtenBytes(0),
+    _blockedNsec(0),
+    _firstFailedPath()
+{
+  start();
+}
+
+
+FrameExporter::~FrameExporter()
+{
+  {
+    QMutexLocker lock(&_mutex);
+    _stopping = true;
+    _changed.wakeAll();
+  }
+  QThread::wait();
+  delete _codec;
+}
+
+
+void FrameExporter::setCompression(FieldCodec::Mode mode,
+				   float velocityTolerance,
+				   unsigned threadCount)
+{
+  QMutexLocker lock(&_mutex);
+  delete _codec;
+  _codec = new FieldCodec(mode, velocityTolerance, threadCount);
+}
+
+
+bool FrameExporter::submit(const FrameSnapshotPtr &frame)
+{
+  QMutexLocker lock(&_mutex);
+  if (_count == _queue.size()) {
+    if (_policy == DROP_WHEN_FULL) {
+      ++_dropped;
+      return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    while (_count == _queue.size())
+      _changed.wait(&_mutex);
+    _blockedNsec += timer.nsecsElapsed();
+  }
+
+  _queue[(_head + _count) % _queue.size()] = frame;
+  ++_count;
+  _changed.wakeAll();
+  return true;
+}
+
+
+bool FrameExporter::finish()
+{
+  QMutexLocker lock(&_mutex);
+  while (_count > 0 || _writing)
+    _changed.wait(&_mutex);
+  return _failed == 0;
+}
+
+
+unsigned long FrameExporter::getWrittenCount() const
+{
+  QMutexLocker lock(&_mutex);
+  return _written;
+}
+
+
+unsigned long FrameExporter::getDroppedCount() const
+{
+  QMutexLocker lock(&_mutex);
+  return _dropped;
+}
+
+
+unsigned long FrameExporter::getFailedCount() const
+{
+  QMutexLocker lock(&_mutex);
+  return _failed;
+}
+
+
+unsigned long long FrameExporter::getWrittenBytes() const
+{
+  QMutexLocker lock(&_mutex);
+  return _writtenBytes;
+}
+
+
+double FrameExporter::getBlockedSec() const
+{
+  QMutexLocker lock(&_mutex);
+  return _blockedNsec * 1.0e-9;
+}
+
+
+std::string FrameExporter::getFirstFailedPath() const
+{
+  QMutexLocker lock(&_mutex);
+  return _firstFailedPath;
+}
+
+
+void FrameExporter::run()
+{
+  QMutexLocker lock(&_mutex);
+  for (;;) {
+    while (_count == 0 && !_stopping)
+      _changed.wait(&_mutex);
+    if (_count == 0)
+      return;
+
+    // Take the oldest frame off the queue, making room for the next one,
+    // and write it without holding the lock.
+    FrameSnapshotPtr frame = _queue[_head];
+    _queue[_head].reset();
+    _head = (_head + 1) % _queue.size();
+    --_count;
+    _writing = true;
+    _changed.wakeAll();
+    lock.unlock();
+
+    // The codec is only replaced before frames are submitted, so it is
+    // safe to use unlocked.
+    char name[32];
+    snprintf(name, sizeof(name), "/frame_%05lu.%s", frame->getFrame(),
+	     _codec ? "fldz" : "fld");
+    const std::string path = _directory + name;
+    const size_t bytes = _codec ? _codec->writeFrame(*frame, path) :
+      writeFrame(*frame, path);
+    frame.reset();
+
+    lock.relock();
+    if (bytes > 0) {
+      ++_written;
+      _writtenBytes += bytes;
+    }
+    else if (_failed++ == 0)
+      _firstFailedPath = path;
+    _writing = false;
+    _changed.wakeAll();
+  }
+}
+
+
+size_t FrameExporter::writeFrame(const FrameSnapshot &frame,
+				 const std::string &path)
+{
+  const unsigned long width  = frame.getWidth();
+  const unsigned long height = frame.getHeight();
+  const unsigned long particles = frame.getParticleCount();
+
+  FrameLayout::Shape shapes[FrameLayout::ARRAY_COUNT];
+  FrameLayout::getShapes(width, height, particles, shapes);
+  const float *data[FrameLayout::ARRAY_COUNT] = {
+    frame.uData(), frame.vData(), frame.pressureData(), NULL,
+    frame.particleXData(), frame.particleYData()
+  };
+  unsigned long arrayBytes[FrameLayout::ARRAY_COUNT];
+  for (unsigned a = 0; a < FrameLayout::ARRAY_COUNT; ++a)
+    arrayBytes[a] = shapes[a].count * shapes[a].elementSize;
+
+  char properties[128];
+  snprintf(properties, sizeof(properties), "FLUIDFRAME 1\nframe %lu\n"
+	   "width %lu\nheight %lu\nparticles %lu\n", frame.getFrame(), width,
+	   height, particles);
+  unsigned long offsets[FrameLayout::ARRAY_COUNT];
+  const std::string header =
+    FrameLayout::layOutHeader(properties, shapes, arrayBytes, ARRAY_ALIGNMENT,
+			      false, offsets);
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+    return 0;
+
+  static const char zeros[ARRAY_ALIGNMENT] = { 0 };
+  bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+  unsigned long position = header.size();
+  for (unsigned a = 0; ok && a < FrameLayout::ARRAY_COUNT; ++a) {
+    ok = fwrite(zeros, 1, offsets[a] - position, file) ==
+      offsets[a] - position;
+    const unsigned long count = shapes[a].count;
+    if (ok && a == FrameLayout::CELL_TYPE_ARRAY)
+      ok = fwrite(frame.cellTypeData(), 1, count, file) == count;
+    else if (ok)
+      ok = writeLittleEndian(file, data[a], count);
+    position = offsets[a] + arrayBytes[a];
+  }
+  ok = (fclose(file) == 0) && ok;
+  return ok ? position : 0;
+}
@@ -0,0 +1,176 @@
+#ifndef __FRAME_EXPORTER_H__
+#define __FRAME_EXPORTER_H__
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <string>
+#include <vector>
+#include "FieldCodec.h"
+#include "FrameSnapshot.h"
+
+
+// Writes frames to disk on a dedicated I/O thread, for offline rendering and
+// analysis.  Frames are handed over as snapshots on a bounded queue, so the
+// simulation only pays for capturing them; when the disk cannot keep up, the
+// overflow policy decides whether the simulation waits or frames are
+// skipped.
+//
+// Each frame goes to its own file, frame_NNNNN.fld in the output directory,
+// holding a text header followed by raw little-endian arrays:
+//
+//   FLUIDFRAME 1
+//   frame 42
+//   width 64
+//   height 48
+//   particles 12288
+//   array u float32 65 48 320
+//   array v float32 64 49 12800
+//   array pressure float32 64 48 25344
+//   array cell_type uint8 64 48 37632
+//   array particle_x float32 12288 40704
+//   array particle_y float32 12288 89856
+//   end
+//
+// Every array line gives the array's name, element type, dimensions (X
+// first, for the grid fields) and byte offset from the start of the file.
+// The arrays are stored row-major from the bottom-left, as in FrameSnapshot,
+// each starting on a 64 byte boundary with zero padding in between.
+//
+// With compression enabled, frames are encoded by a FieldCodec and written to
+// frame_NNNNN.fldz files instead.
+//
+// The pool the snapshots come from must outlive the exporter.
+class FrameExporter : private QThread
+{
+public:
+  // What submit() does when the queue is full.
+  enum OverflowPolicy {
+    BLOCK_WHEN_FULL = 0, // Wait for room, throttling the simulation.
+    DROP_WHEN_FULL,      // Skip the frame, keeping the simulation running.
+    OVERFLOW_POLICY_COUNT
+  };
+
+  // Constructs an exporter and starts its thread.
+  //
+  // Arguments:
+  //   std::string &directory - The existing directory to write frames to.
+  //   unsigned capacity - The most frames that may wait to be written.
+  //   OverflowPolicy policy - What to do with frames beyond the capacity.
+  FrameExporter(const std::string &directory, unsigned capacity = 4,
+		OverflowPolicy policy = BLOCK_WHEN_FULL);
+
+  // Destructor.  Writes every queued frame, then stops the thread.
+  //
+  // Arguments:
+  //   None
+  virtual ~FrameExporter();
+
+  // Compresses every frame from now on.  Call before the first submit().
+  //
+  // Arguments:
+  //   FieldCodec::Mode mode - How velocities are encoded.
+  //   float velocityTolerance - The largest absolute error allowed in u and
+  //                             v, in FieldCodec::LOSSY_VELOCITY mode.
+  //   unsigned threadCount - The number of threads encoding each frame, or
+  //                          0 to use one per processor core.
+  //
+  // Returns:
+  //   None
+  void setCompression(FieldCodec::Mode mode, float velocityTolerance = 0.0f,
+		      unsigned threadCount = 0);
+
+  // Queues a frame to be written.  The exporter keeps a reference to the
+  // snapshot until the frame has been written.
+  //
+  // Arguments:
+  //   FrameSnapshotPtr &frame - The frame to export.
+  //
+  // Returns:
+  //   bool - True if queued; false if the queue was full and the frame was
+  //          dropped.
+  bool submit(const FrameSnapshotPtr &frame);
+
+  // Blocks until every queued frame has been written.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   bool - True if every frame so far was written successfully.
+  bool finish();
+
+  // Returns the number of frames written, dropped, or that failed to be
+  // written.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned long - The number of frames.
+  unsigned long getWrittenCount() const;
+  unsigned long getDroppedCount() const;
+  unsigned long getFailedCount() const;
+
+  // Returns the total size of the files written.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned long long - The number of bytes.
+  unsigned long long getWrittenBytes() const;
+
+  // Returns the total time submit() has spent waiting for room in the
+  // queue, which is how long the simulation was held back by the disk.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   double - The waiting time, in seconds.
+  double getBlockedSec() const;
+
+  // Returns the first file that could not be written.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   std::string - The path, or an empty string if there were no failures.
+  std::string getFirstFailedPath() const;
+
+  // Writes a frame to a file in the format described above.
+  //
+  // Arguments:
+  //   FrameSnapshot &frame - The frame to write.
+  //   std::string &path - The file to write.
+  //
+  // Returns:
+  //   size_t - The number of bytes written, or 0 on failure.
+  static size_t writeFrame(const FrameSnapshot &frame,
+			   const std::string &path);
+
+private:
+  // Inherited from QThread.
+  virtual void run();
+
+  const std::string _directory;        // Where frames are written.
+  const OverflowPolicy _policy;        // What to do when the queue is full.
+  FieldCodec *_codec;                  // Compresses frames, or NULL.
+  mutable QMutex _mutex;               // Guards the members below.
+  QWaitCondition _changed;             // Signalled when the queue changes.
+  std::vector<FrameSnapshotPtr> _queue; // Ring buffer of queued frames.
+  unsigned _head;                      // Index of the oldest queued frame.
+  unsigned _count;                     // Number of queued frames.
+  bool _writing;                       // True while a frame is being written.
+  bool _stopping;                      // True once the destructor has run.
+  unsigned long _written;              // Frames written.
+  unsigned long _dropped;              // Frames dropped.
+  unsigned long _failed;               // Frames that could not be written.
+  unsigned long long _writtenBytes;    // Size of the files written.
+  long long _blockedNsec;              // Time submit() spent waiting.
+  std::string _firstFailedPath;        // First file that failed.
+};
+
+#endif // __FRAME_EXPORTER_H__
@@ -0,0 +1,85 @@
+#include "FrameLayout.h"
+#include <cstdio>
+
+
+const unsigned long FrameLayout::MAX_CELLS;
+const unsigned long FrameLayout::MAX_PARTICLES;
+
+
+const char *FrameLayout::getArrayName(unsigned array)
+{
+  static const char *const names[ARRAY_COUNT] = {
+    "u", "v", "pressure", "cell_type", "particle_x", "particle_y"
+  };
+  return names[array];
+}
+
+
+bool FrameLayout::isWithinLimits(unsigned long width, unsigned long height,
+				 unsigned long particles)
+{
+  return width <= MAX_CELLS && height <= MAX_CELLS &&
+    (height == 0 || width <= MAX_CELLS / height) &&
+    particles <= MAX_PARTICLES;
+}
+
+
+void FrameLayout::getShapes(unsigned long width, unsigned long height,
+			    unsigned long particles,
+			    Shape shapes[ARRAY_COUNT])
+{
+  const unsigned long columns[ARRAY_COUNT] = {
+    width + 1, width, width, width, particles, particles
+  };
+  const unsigned long rows[ARRAY_COUNT] = {
+    height, height + 1, height, height, 1, 1
+  };
+  for (unsigned a = 0; a < ARRAY_COUNT; ++a) {
+    const bool cellTypes = (a == CELL_TYPE_ARRAY);
+    shapes[a].name = getArrayName(a);
+    shapes[a].type = cellTypes ? "uint8" : "float32";
+    shapes[a].elementSize = cellTypes ? 1 : 4;
+    shapes[a].dimensionCount = a < PARTICLE_X_ARRAY ? 2 : 1;
+    shapes[a].dimensions[0] = columns[a];
+    shapes[a].dimensions[1] = rows[a];
+    shapes[a].count = columns[a] * rows[a];
+  }
+}
+
+
+std::string FrameLayout::layOutHeader(const std::string &leadingLines,
+				      const Shape shapes[ARRAY_COUNT],
+				      const unsigned long arrayBytes[ARRAY_COUNT],
+				      unsigned long alignment, bool listBytes,
+				      unsigned long offsets[ARRAY_COUNT])
+{
+  std::string header;
+  unsigned long dataStart = 0;
+  for (;;) {
+    header = leadingLines;
+    unsigned long offset = dataStart;
+    for (unsigned a = 0; a < ARRAY_COUNT; ++a) {
+      offset = (offset + alignment - 1) / alignment * alignment;
+      offsets[a] = offset;
+
+      char line[160];
+      int length = snprintf(line, sizeof(line), "array %s %s %lu",
+			    shapes[a].name, shapes[a].type,
+			    shapes[a].dimensions[0]);
+      if (shapes[a].dimensionCount == 2)
+	length += snprintf(line + length, sizeof(line) - length, " %lu",
+			   shapes[a].dimensions[1]);
+      length += snprintf(line + length, sizeof(line) - length, " %lu",
+			 offset);
+      if (listBytes)
+	snprintf(line + length, sizeof(line) - length, " %lu", arrayBytes[a]);
+      header += line;
+      header += '\n';
+      offset += arrayBytes[a];
+    }
+    header += "end\n";
+    if (header.size() <= dataStart)
+      return header;
+    dataStart = header.size();
+  }
+}
@@ -0,0 +1,106 @@
+#ifndef __FRAME_LAYOUT_H__
+#define __FRAME_LAYOUT_H__
+
+#include <string>
+
+
+// The arrays every saved frame holds, and the text header that the files of
+// FrameExporter and FieldCodec start with.  Those formats and Checkpoint
+// share the limits below, so that a frame one of them can save, the others
+// can too.
+//
+// A header is the format's own leading lines (its magic line and
+// properties), then one line per array, in file order:
+//
+//   array NAME TYPE DIMENSIONS... OFFSET [BYTES]
+//
+// and finally an "end" line.  OFFSET is where the array starts in the file,
+// and BYTES, listed only by formats whose arrays are encoded, its length.
+class FrameLayout
+{
+public:
+  // The arrays, in file order.
+  enum Array {
+    U_ARRAY = 0,      // X face velocities: (width+1) x height floats.
+    V_ARRAY,          // Y face velocities: width x (height+1) floats.
+    PRESSURE_ARRAY,   // Cell pressures: width x height floats.
+    CELL_TYPE_ARRAY,  // Cell::Type bytes: width x height.
+    PARTICLE_X_ARRAY, // Particle X coordinates: one float per particle.
+    PARTICLE_Y_ARRAY, // Particle Y coordinates: one float per particle.
+    ARRAY_COUNT
+  };
+
+  // Largest number of cells and particles a saved frame may hold, keeping
+  // every size in range of the unsigned indices used by the solver.
+  static const unsigned long MAX_CELLS = 0x3FFFFFFF;
+  static const unsigned long MAX_PARTICLES = 0x3FFFFFFF;
+
+  // The shape of one of a frame's arrays.
+  struct Shape
+  {
+    const char *name;             // Name in the header.
+    const char *type;             // Element type: "float32" or "uint8".
+    unsigned elementSize;         // Bytes per element.
+    unsigned dimensionCount;      // 2 for grid fields, 1 for particles.
+    unsigned long dimensions[2];  // Columns, then rows (1 for particles).
+    unsigned long count;          // Number of elements.
+  };
+
+  // Returns the name an array is listed under in headers.
+  //
+  // Arguments:
+  //   unsigned array - The Array.
+  //
+  // Returns:
+  //   const char * - The name.
+  static const char *getArrayName(unsigned array);
+
+  // Returns whether a frame is within MAX_CELLS and MAX_PARTICLES.
+  //
+  // Arguments:
+  //   unsigned long width - The frame's width, in cells.
+  //   unsigned long height - The frame's height, in cells.
+  //   unsigned long particles - The frame's number of particles.
+  //
+  // Returns:
+  //   bool - True if the frame may be saved.
+  static bool isWithinLimits(unsigned long width, unsigned long height,
+			     unsigned long particles);
+
+  // Finds the shapes of a frame's arrays.  The frame must be within the
+  // limits.
+  //
+  // Arguments:
+  //   unsigned long width - The frame's width, in cells.
+  //   unsigned long height - The frame's height, in cells.
+  //   unsigned long particles - The frame's number of particles.
+  //   Shape shapes[] - Receives the shape of each array.
+  //
+  // Returns:
+  //   None
+  static void getShapes(unsigned long width, unsigned long height,
+			unsigned long particles, Shape shapes[ARRAY_COUNT]);
+
+  // Lays out a header and the arrays following it.  The header's length
+  // depends on the offsets it lists, and they on its length, so it is laid
+  // out again until the two agree; this settles within a couple of passes.
+  //
+  // Arguments:
+  //   std::string &leadingLines - The format's lines before the arrays,
+  //                               each ending in a newline.
+  //   Shape shapes[] - The arrays' shapes.
+  //   unsigned long arrayBytes[] - The length of each array in the file.
+  //   unsigned long alignment - Every array starts at a multiple of this.
+  //   bool listBytes - True to list each array's length in its line.
+  //   unsigned long offsets[] - Receives where each array starts.
+  //
+  // Returns:
+  //   std::string - The header, ending with its "end" line.
+  static std::string layOutHeader(const std::string &leadingLines,
+				  const Shape shapes[ARRAY_COUNT],
+				  const unsigned long arrayBytes[ARRAY_COUNT],
+				  unsigned long alignment, bool listBytes,
+				  unsigned long offsets[ARRAY_COUNT]);
+};
+
+#endif // __FRAME_LAYOUT_H__
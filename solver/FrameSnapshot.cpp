@@ -0,0 +1,163 @@
+#include "FrameSnapshot.h"
+#include <QMutexLocker>
+#include <cstring>
+
+
+FrameSnapshot::FrameSnapshot(FrameSnapshotPool *pool)
+  : _pool(pool),
+    _refCount(0),
+    _width(0),
+    _height(0),
+    _frame(0),
+    _fields(),
+    _cellTypes(),
+    _vOffset(0),
+    _pressureOffset(0),
+    _particleOffset(0),
+    _particleCount(0)
+{}
+
+
+FrameSnapshot::~FrameSnapshot()
+{}
+
+
+void FrameSnapshot::capture(const Grid &grid, const ParticleSystem &particles,
+			    unsigned long frame)
+{
+  const unsigned width  = grid.getColCount() - 1;
+  const unsigned height = grid.getRowCount() - 1;
+  _width = width;
+  _height = height;
+  _frame = frame;
+  _particleCount = particles.size();
+  _vOffset = (width + 1) * height;
+  _pressureOffset = _vOffset + width * (height + 1);
+  _particleOffset = _pressureOffset + width * height;
+
+  // resize() keeps the existing capacity, so frames of a steady size reuse
+  // the same storage.
+  _fields.resize(_particleOffset + 2 * _particleCount);
+  _cellTypes.resize(width * height);
+
+  // Copy each row out of the grid's padded arrays.
+  float *u = &_fields[0];
+  float *v = &_fields[_vOffset];
+  float *pressure = &_fields[_pressureOffset];
+  for (unsigned y = 0; y < height; ++y) {
+    const unsigned row = grid.index(0, y);
+    memcpy(u + y * (width + 1), grid.uData() + row,
+	   (width + 1) * sizeof(float));
+    memcpy(pressure + y * width, grid.pressureData() + row,
+	   width * sizeof(float));
+    memcpy(&_cellTypes[y * width], grid.cellTypeData() + row, width);
+  }
+  for (unsigned y = 0; y <= height; ++y)
+    memcpy(v + y * width, grid.vData() + grid.index(0, y),
+	   width * sizeof(float));
+
+  if (_particleCount > 0) {
+    memcpy(&_fields[_particleOffset], particles.xData(),
+	   _particleCount * sizeof(float));
+    memcpy(&_fields[_particleOffset + _particleCount], particles.yData(),
+	   _particleCount * sizeof(float));
+  }
+}
+
+
+FrameSnapshotPtr::FrameSnapshotPtr()
+  : _snapshot(NULL)
+{}
+
+
+FrameSnapshotPtr::FrameSnapshotPtr(FrameSnapshot *snapshot)
+  : _snapshot(snapshot)
+{}
+
+
+FrameSnapshotPtr::FrameSnapshotPtr(const FrameSnapshotPtr &ptr)
+  : _snapshot(ptr._snapshot)
+{
+  if (_snapshot)
+    _snapshot->_refCount.ref();
+}
+
+
+FrameSnapshotPtr::~FrameSnapshotPtr()
+{
+  reset();
+}
+
+
+FrameSnapshotPtr & FrameSnapshotPtr::operator=(const FrameSnapshotPtr &ptr)
+{
+  // Take the new reference first, in case both refer to the same snapshot.
+  if (ptr._snapshot)
+    ptr._snapshot->_refCount.ref();
+  reset();
+  _snapshot = ptr._snapshot;
+  return *this;
+}
+
+
+void FrameSnapshotPtr::reset()
+{
+  if (_snapshot && !_snapshot->_refCount.deref())
+    _snapshot->_pool->release(_snapshot);
+  _snapshot = NULL;
+}
+
+
+FrameSnapshotPool::FrameSnapshotPool()
+  : _mutex(),
+    _free(),
+    _snapshotCount(0)
+{}
+
+
+FrameSnapshotPool::~FrameSnapshotPool()
+{
+  for (unsigned i = 0; i < _free.size(); ++i)
+    delete _free[i];
+}
+
+
+FrameSnapshotPtr FrameSnapshotPool::capture(const Grid &grid,
+					    const ParticleSystem &particles,
+					    unsigned long frame)
+{
+  FrameSnapshot *snapshot = NULL;
+  {
+    QMutexLocker lock(&_mutex);
+    if (!_free.empty()) {
+      snapshot = _free.back();
+      _free.pop_back();
+    }
+    else {
+      ++_snapshotCount;
+      _free.reserve(_snapshotCount);
+    }
+  }
+  if (!snapshot)
+    snapshot = new FrameSnapshot(this);
+
+  // The snapshot is not shared yet, so it can be filled in without locking.
+  snapshot->capture(grid, particles, frame);
+  snapshot->_refCount.ref();
+  return FrameSnapshotPtr(snapshot);
+}
+
+
+unsigned FrameSnapshotPool::getSnapshotCount() const
+{
+  QMutexLocker lock(&_mutex);
+  return _snapshotCount;
+}
+
+
+void FrameSnapshotPool::release(FrameSnapshot *snapshot)
+{
+  // _free has room for every snapshot, so this never allocates.
+  QMutexLocker lock(&_mutex);
+  _free.push_back(snapshot);
+}
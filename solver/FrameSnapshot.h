@@ -0,0 +1,369 @@
+#ifndef __FRAME_SNAPSHOT_H__
+#define __FRAME_SNAPSHOT_H__
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <vector>
+#include "Grid.h"
+#include "ParticleSystem.h"
+#include "Vector2.h"
+
+class FrameSnapshotPool;
+
+
+// An immutable copy of the simulation's state at the end of a frame, for
+// renderers and exporters to read while the solver moves on to the next one.
+// Fields are stored unpadded, row-major from the bottom-left, in flat arrays:
+//
+//   u        - X face velocities: (width+1) x height
+//   v        - Y face velocities: width x (height+1)
+//   pressure - Cell pressures:    width x height
+//   cellType - Cell::Type bytes:  width x height
+//
+// followed by the X and then the Y coordinate of every marker particle.
+//
+// Snapshots are created by a FrameSnapshotPool and handed out through
+// reference-counted FrameSnapshotPtr handles, which only give const access.
+// When the last handle goes away the snapshot returns to its pool, keeping
+// its storage for the next frame.
+class FrameSnapshot
+{
+public:
+  // Returns the size of the captured grid, in cells.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of cells along X or Y.
+  inline unsigned getWidth() const;
+  inline unsigned getHeight() const;
+
+  // Returns the number of the captured frame.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned long - The frame number given to capture().
+  inline unsigned long getFrame() const;
+
+  // Returns a captured X face velocity, located at world position
+  // (i, j+0.5).
+  //
+  // Arguments:
+  //   unsigned i - The face's column, at most getWidth().
+  //   unsigned j - The face's row, less than getHeight().
+  //
+  // Returns:
+  //   float - The X velocity.
+  inline float u(unsigned i, unsigned j) const;
+
+  // Returns a captured Y face velocity, located at world position
+  // (i+0.5, j).
+  //
+  // Arguments:
+  //   unsigned i - The face's column, less than getWidth().
+  //   unsigned j - The face's row, at most getHeight().
+  //
+  // Returns:
+  //   float - The Y velocity.
+  inline float v(unsigned i, unsigned j) const;
+
+  // Returns a captured cell pressure or cell type.
+  //
+  // Arguments:
+  //   unsigned i - The cell's column.
+  //   unsigned j - The cell's row.
+  //
+  // Returns:
+  //   float - The pressure, or unsigned char - The Cell::Type.
+  inline float pressure(unsigned i, unsigned j) const;
+  inline unsigned char cellType(unsigned i, unsigned j) const;
+
+  // Returns the velocity at the center of a cell, the average of its faces.
+  //
+  // Arguments:
+  //   unsigned i - The cell's column.
+  //   unsigned j - The cell's row.
+  //
+  // Returns:
+  //   Vector2 - The velocity at world position (i+0.5, j+0.5).
+  inline Vector2 getCellVelocity(unsigned i, unsigned j) const;
+
+  // Returns the raw field arrays, laid out as described above.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float * or unsigned char * - The first entry of the array.
+  inline const float * uData() const;
+  inline const float * vData() const;
+  inline const float * pressureData() const;
+  inline const unsigned char * cellTypeData() const;
+
+  // Returns the number of captured particles.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of particles.
+  inline unsigned getParticleCount() const;
+
+  // Returns the particles' X or Y coordinates.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float * - getParticleCount() coordinates, or NULL if there are none.
+  inline const float * particleXData() const;
+  inline const float * particleYData() const;
+
+private:
+  friend class FrameSnapshotPool;
+  friend class FrameSnapshotPtr;
+
+  // Snapshots are only created and destroyed by their pool.
+  FrameSnapshot(FrameSnapshotPool *pool);
+  ~FrameSnapshot();
+
+  // Not copyable.
+  FrameSnapshot(const FrameSnapshot &);
+  FrameSnapshot &operator=(const FrameSnapshot &);
+
+  // Copies the state of a grid and particles.  Storage is only reallocated
+  // if it is too small.
+  void capture(const Grid &grid, const ParticleSystem &particles,
+	       unsigned long frame);
+
+  FrameSnapshotPool *_pool;  // The pool the snapshot returns to.
+  QAtomicInt _refCount;      // Number of FrameSnapshotPtrs held.
+  unsigned _width;           // Number of cells along X.
+  unsigned _height;          // Number of cells along Y.
+  unsigned long _frame;      // The captured frame's number.
+  std::vector<float> _fields; // u, v, pressure, particle X and Y.
+  std::vector<unsigned char> _cellTypes; // Cell::Type per cell.
+  unsigned _vOffset;         // Offset of the Y velocities within _fields.
+  unsigned _pressureOffset;  // Offset of the pressures.
+  unsigned _particleOffset;  // Offset of the particle X coordinates.
+  unsigned _particleCount;   // Number of particles.
+};
+
+
+// A shared, read-only reference to a FrameSnapshot.  Copies share the same
+// snapshot; the snapshot goes back to its pool once no copies remain.
+// Handles may be copied and released on any thread.
+class FrameSnapshotPtr
+{
+public:
+  // Constructs a null handle.
+  //
+  // Arguments:
+  //   None
+  FrameSnapshotPtr();
+
+  // Copy constructs a handle to the same snapshot.
+  //
+  // Arguments:
+  //   FrameSnapshotPtr &ptr - The handle to duplicate.
+  FrameSnapshotPtr(const FrameSnapshotPtr &ptr);
+
+  // Destructor.  Releases the snapshot.
+  //
+  // Arguments:
+  //   None
+  ~FrameSnapshotPtr();
+
+  // Assignment operator, releasing the previous snapshot.
+  //
+  // Arguments:
+  //   FrameSnapshotPtr &ptr - The handle to assign.
+  // Returns:
+  //   FrameSnapshotPtr & - A reference to this handle.
+  FrameSnapshotPtr & operator=(const FrameSnapshotPtr &ptr);
+
+  // Returns the snapshot.  The handle must not be null.
+  const FrameSnapshot & operator*() const { return *_snapshot; }
+  const FrameSnapshot * operator->() const { return _snapshot; }
+
+  // Returns true if the handle refers to no snapshot.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   bool - True if null.
+  bool isNull() const { return _snapshot == NULL; }
+
+  // Releases the snapshot, leaving the handle null.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void reset();
+
+private:
+  friend class FrameSnapshotPool;
+
+  // Takes over a reference already counted on the snapshot.
+  explicit FrameSnapshotPtr(FrameSnapshot *snapshot);
+
+  FrameSnapshot *_snapshot; // The referenced snapshot, or NULL.
+};
+
+
+// Recycles FrameSnapshots, so that capturing frames at a steady size never
+// allocates memory: a released snapshot keeps its arrays, and the next
+// capture reuses them.  The pool only grows while more snapshots are held
+// at once than ever before.
+//
+// The pool must outlive every handle to its snapshots.
+class FrameSnapshotPool
+{
+public:
+  // Constructs an empty pool.
+  //
+  // Arguments:
+  //   None
+  FrameSnapshotPool();
+
+  // Destructor.  Frees every snapshot, all of which must have been released.
+  //
+  // Arguments:
+  //   None
+  ~FrameSnapshotPool();
+
+  // Captures the state of a grid and its particles in a snapshot.
+  //
+  // Arguments:
+  //   Grid &grid - The grid to copy.
+  //   ParticleSystem &particles - The particles to copy.
+  //   unsigned long frame - The frame number to record.
+  //
+  // Returns:
+  //   FrameSnapshotPtr - A handle to the new snapshot.
+  FrameSnapshotPtr capture(const Grid &grid, const ParticleSystem &particles,
+			   unsigned long frame);
+
+  // Returns the number of snapshots the pool has created.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of snapshots, free or in use.
+  unsigned getSnapshotCount() const;
+
+private:
+  friend class FrameSnapshotPtr;
+
+  // Not copyable.
+  FrameSnapshotPool(const FrameSnapshotPool &);
+  FrameSnapshotPool &operator=(const FrameSnapshotPool &);
+
+  // Returns a snapshot whose last handle was released.
+  void release(FrameSnapshot *snapshot);
+
+  mutable QMutex _mutex;              // Guards the members below.
+  std::vector<FrameSnapshot *> _free; // Snapshots ready for reuse.
+  unsigned _snapshotCount;            // Snapshots created.
+};
+
+
+unsigned FrameSnapshot::getWidth() const
+{
+  return _width;
+}
+
+
+unsigned FrameSnapshot::getHeight() const
+{
+  return _height;
+}
+
+
+unsigned long FrameSnapshot::getFrame() const
+{
+  return _frame;
+}
+
+
+float FrameSnapshot::u(unsigned i, unsigned j) const
+{
+  return _fields[j * (_width + 1) + i];
+}
+
+
+float FrameSnapshot::v(unsigned i, unsigned j) const
+{
+  return _fields[_vOffset + j * _width + i];
+}
+
+
+float FrameSnapshot::pressure(unsigned i, unsigned j) const
+{
+  return _fields[_pressureOffset + j * _width + i];
+}
+
+
+unsigned char FrameSnapshot::cellType(unsigned i, unsigned j) const
+{
+  return _cellTypes[j * _width + i];
+}
+
+
+Vector2 FrameSnapshot::getCellVelocity(unsigned i, unsigned j) const
+{
+  return Vector2(0.5f * (u(i, j) + u(i + 1, j)),
+		 0.5f * (v(i, j) + v(i, j + 1)));
+}
+
+
+const float * FrameSnapshot::uData() const
+{
+  return &_fields[0];
+}
+
+
+const float * FrameSnapshot::vData() const
+{
+  return &_fields[_vOffset];
+}
+
+
+const float * FrameSnapshot::pressureData() const
+{
+  return &_fields[_pressureOffset];
+}
+
+
+const unsigned char * FrameSnapshot::cellTypeData() const
+{
+  return &_cellTypes[0];
+}
+
+
+unsigned FrameSnapshot::getParticleCount() const
+{
+  return _particleCount;
+}
+
+
+const float * FrameSnapshot::particleXData() const
+{
+  return _particleCount > 0 ? &_fields[_particleOffset] : NULL;
+}
+
+
+const float * FrameSnapshot::particleYData() const
+{
+  return _particleCount > 0 ? &_fields[_particleOffset + _particleCount]
+    : NULL;
+}
+
+#endif // __FRAME_SNAPSHOT_H__
@@ -2,26 +2,64 @@
 #include "Cell.h"
 #include "Vector2.h"
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <cstring>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
+// Number of positions interpolated at once by the batch sampling methods.
+#if defined(__AVX512F__)
+#define GRID_VECTOR_WIDTH 16
+#elif defined(__AVX2__)
+#define GRID_VECTOR_WIDTH 8
+#else
+#define GRID_VECTOR_WIDTH 1
+#endif
+
 Grid::Grid(float width, float height)
 {
-  // Note the extra top/right border cell to track velocity at edges of sim.
+  // Note the extra top/right border to track velocity at edges of sim.
   _colCount = width  < _minSize ? _minSize : ceil(width)  + 1;
   _rowCount = height < _minSize ? _minSize : ceil(height) + 1;
-  _cells.resize(_rowCount * _colCount);
-  setCellLinkage();
+
+  // Every array shares one padded layout: the largest staggered array is
+  // (nx+1) x (ny+1), surrounded on each side by the ghost layer.
+  _stride = _colCount + 2 * _ghostSize;
+  _paddedCount = _stride * (_rowCount + 2 * _ghostSize);
+  _uOffset        = 0;
+  _vOffset        = 1 * _paddedCount;
+  _stagedUOffset  = 2 * _paddedCount;
+  _stagedVOffset  = 3 * _paddedCount;
+  _pressureOffset = 4 * _paddedCount;
+  _fields.resize(5 * _paddedCount, 0.0f);
+
+  // Ghost cells are SOLID; cells inside the simulation start as AIR.
+  _cellTypes.resize(_paddedCount, Cell::SOLID);
+  for (unsigned y = 0; y < _rowCount - 1; ++y)
+    memset(&_cellTypes[index(0, y)], Cell::AIR, _colCount - 1);
 }
 
 
 Grid::Grid(const Grid &grid)
   : _rowCount(grid._rowCount),
-    _colCount(grid._colCount)
+    _colCount(grid._colCount),
+    _stride(grid._stride),
+    _paddedCount(grid._paddedCount),
+    _fields(grid._fields.size()),
+    _cellTypes(grid._cellTypes.size()),
+    _uOffset(grid._uOffset),
+    _vOffset(grid._vOffset),
+    _stagedUOffset(grid._stagedUOffset),
+    _stagedVOffset(grid._stagedVOffset),
+    _pressureOffset(grid._pressureOffset)
 {
-  _cells = grid._cells;
-  setCellLinkage();
+  memcpy(&_fields[0], &grid._fields[0], _fields.size() * sizeof(float));
+  memcpy(&_cellTypes[0], &grid._cellTypes[0], _cellTypes.size());
 }
 
 
@@ -30,22 +68,60 @@ Grid & Grid::operator=(const Grid &grid)
   if (this != &grid) {
     _rowCount = grid._rowCount;
     _colCount = grid._colCount;
-    _cells = grid._cells;
-    setCellLinkage();
+    _stride = grid._stride;
+    _paddedCount = grid._paddedCount;
+    _uOffset = grid._uOffset;
+    _vOffset = grid._vOffset;
+    _stagedUOffset = grid._stagedUOffset;
+    _stagedVOffset = grid._stagedVOffset;
+    _pressureOffset = grid._pressureOffset;
+
+    // Only reallocate if the grid dimensions have changed.
+    _fields.resize(grid._fields.size());
+    _cellTypes.resize(grid._cellTypes.size());
+    memcpy(&_fields[0], &grid._fields[0], _fields.size() * sizeof(float));
+    memcpy(&_cellTypes[0], &grid._cellTypes[0], _cellTypes.size());
   }
   return *this;
 }
 
 
 Grid::~Grid()
+{}
+
+
+void Grid::commitStagedVel()
 {
-  // Tear down linkage between cells.
-  vector<Cell>::iterator itr = _cells.begin();
-  for( ; itr != _cells.end(); ++itr) {
-    for (unsigned i = 0; i < Cell::NEIGHBOR_COUNT; ++i) {
-      itr->neighbors[i] = NULL;
-    }
-  }
+  std::swap(_uOffset, _stagedUOffset);
+  std::swap(_vOffset, _stagedVOffset);
+}
+
+
+void Grid::getVelocities(const float *x, const float *y,
+			 float *u, float *v, unsigned count) const
+{
+  bilerpVel(x, y, u, count, Cell::X);
+  bilerpVel(x, y, v, count, Cell::Y);
+}
+
+
+void Grid::sampleU(const float *x, const float *y, float *u,
+		   unsigned count) const
+{
+  bilerpVel(x, y, u, count, Cell::X);
+}
+
+
+void Grid::sampleV(const float *x, const float *y, float *v,
+		   unsigned count) const
+{
+  bilerpVel(x, y, v, count, Cell::Y);
+}
+
+
+unsigned Grid::vectorWidth()
+{
+  return GRID_VECTOR_WIDTH;
 }
 
 
@@ -63,29 +139,13 @@ Vector2 Grid::getVelocity(Vector2 position) const
 
 float Grid::getVelocityDivergence(unsigned x, unsigned y) const
 {
-  // Get reference to the cell. Note that x and y are assumted to be valid.
-  Cell cell = (*this)(x,y);
-
-  // If all neighbors are present, get the velocity value from each.
-  float xDivergence;
-  float yDivergence;
-  if (cell.allNeighbors) {
-    xDivergence = cell.neighbors[Cell::POS_X]->vel[Cell::X] - cell.vel[Cell::X];
-    yDivergence = cell.neighbors[Cell::POS_Y]->vel[Cell::Y] - cell.vel[Cell::Y];
-  }
-  // Else, set missing neighbors to 0 velocity.
-  else {
-    // Get right/top neighbor's velocity, or set to 0.
-    float rightXVel = cell.neighbors[Cell::POS_X]
-      ? cell.neighbors[Cell::POS_X]->vel[Cell::X] : 0.0f;
-    float topYVel = cell.neighbors[Cell::POS_Y]
-      ? cell.neighbors[Cell::POS_Y]->vel[Cell::Y] : 0.0f;
-
-    // Calculate x and y divergence.
-    xDivergence = rightXVel - cell.vel[Cell::X];
-    yDivergence = topYVel - cell.vel[Cell::Y];
-  }
-  
+  // Note that x and y are assumed to be valid cell indices, so each of the
+  // four faces surrounding the cell is guaranteed to exist.
+  const float *u = uData();
+  const float *v = vData();
+  const unsigned i = index(x, y);
+  float xDivergence = u[i + 1] - u[i];
+  float yDivergence = v[i + _stride] - v[i];
   return xDivergence + yDivergence;
 }
 
@@ -93,50 +153,40 @@ float Grid::getVelocityDivergence(unsigned x, unsigned y) const
 Vector2 Grid::getMaxVelocity() const
 {
   // Iterate through all MAC cell centers, finding the maximum velocity.
-  // Note that this is an incredibly naive and expensive approach to 
+  // Note that this is an incredibly naive and expensive approach to
   // estimating the maximum velocity in the grid.  Consider revising
-  // this in the future.
+  // this in the future.  Each row of centers is sampled as one batch.
+  const unsigned width  = _colCount - 1;
+  const unsigned height = _rowCount - 1;
+  vector<float> x(width), y(width), u(width), v(width);
+  for (unsigned i = 0; i < width; ++i)
+    x[i] = i + 0.5f;
+
   Vector2 maxVel;
-  for (float y = 0.5f; y < getHeight(); ++y)
-    for (float x = 0.5f; x < getWidth(); ++x) {
-      Vector2 vel = getVelocity(Vector2(x, y));
+  for (unsigned j = 0; j < height; ++j) {
+    fill(y.begin(), y.end(), j + 0.5f);
+    getVelocities(&x[0], &y[0], &u[0], &v[0], width);
+    for (unsigned i = 0; i < width; ++i) {
+      Vector2 vel(u[i], v[i]);
       if (vel.magnitude() > maxVel.magnitude())
 	maxVel = vel;
     }
-  
+  }
+
   return maxVel;
 }
 
 
-void Grid::setCellLinkage() 
+Vector2 Grid::getMaxFaceVelocity() const
 {
-  unsigned x, y;
-
-  // Create linkage from each cell to its +X, +Y, and +XY neighbors.
-  // Keep in mind that the Cell struct's default constructor initializes
-  // NULL for all neighbor pointers, so we only need to touch the values
-  // that must be changed.
-  // First, set linkage for the cells that have all neighbors.
-  for (y = 0; y < _rowCount - 1; ++y) {
-    for (x = 0; x < _colCount - 1; ++x) {
-      Cell &cell = (*this)(x,y);
-      cell.neighbors[Cell::POS_X]  = &(*this)(x+1, y);
-      cell.neighbors[Cell::POS_Y]  = &(*this)(x,   y+1);
-      cell.neighbors[Cell::POS_XY] = &(*this)(x+1, y+1);
-      cell.allNeighbors = true;
-    }
-  }
-  // Set linkage for the cells in the far right column, but not the corner.
-  x = _colCount - 1;
-  for (y = 0; y < _rowCount - 1; ++y) {
-    (*this)(x,y).neighbors[Cell::POS_Y] = &(*this)(x, y+1);
-  }
-
-  // Set linkage for the cells in the top row, but not the corner.
-  y = _rowCount - 1;
-  for (x = 0; x < _colCount - 1; ++x) {
-    (*this)(x,y).neighbors[Cell::POS_X] = &(*this)(x+1, y);
-  }
+  const unsigned width  = _colCount - 1;
+  const unsigned height = _rowCount - 1;
+  Vector2 maxVel;
+  for (unsigned j = 0; j < height; ++j)
+    maxVel.x = max(maxVel.x, maxAbs(&uData()[index(0, j)], width + 1));
+  for (unsigned j = 0; j <= height; ++j)
+    maxVel.y = max(maxVel.y, maxAbs(&vData()[index(0, j)], width));
+  return maxVel;
 }
 
 
@@ -160,14 +210,17 @@ float Grid::bilerpVel(Vector2 position, Cell::Dimension dim) const
   // Here, an offset is applied to the provided X or Y coordinate to
   // adjust for this velocity component offset in bilinear interpolation.
   // See documentation on the MAC grid for a deeper explanation.
+  // The face array being sampled is selected as well.
+  const float *faces;
   switch(dim) {
     case Cell::X:
       position.y -= 0.5;
+      faces = uData();
       break;
     case Cell::Y:
-      position.x -= 0.5;
-      break;
     default:
+      position.x -= 0.5;
+      faces = vData();
       break;
   }
 
@@ -186,28 +239,196 @@ float Grid::bilerpVel(Vector2 position, Cell::Dimension dim) const
   j = floor(position.y);
   position -= Vector2(i,j);
 
-  // Get the base cell.
-  Cell cell = (*this)(i,j);
+  // Fetch the four surrounding face velocities.  The clamping above
+  // guarantees the base face exists; faces beyond the far edges of the
+  // simulation fall in the ghost layer, which holds 0 velocity.
+  const unsigned base = index(i, j);
+  float thisVel     = faces[base];
+  float rightVel    = faces[base + 1];
+  float topVel      = faces[base + _stride];
+  float topRightVel = faces[base + _stride + 1];
 
-  float thisVel, rightVel, topVel, topRightVel;
-  // If all neighbors are present, get the velocity value from each.
-  if (cell.allNeighbors) {
-    thisVel  = cell.vel[dim];
-    rightVel = cell.neighbors[Cell::POS_X]->vel[dim];
-    topVel   = cell.neighbors[Cell::POS_Y]->vel[dim];
-    topRightVel = cell.neighbors[Cell::POS_XY]->vel[dim];
+  // Perform the bilinear interpolation.
+  return bilerp(position, thisVel, rightVel, topVel, topRightVel);
+}
+
+
+// The vectorized sampling kernels below follow bilerpVel() step by step:
+// clamp to the far edges, shift to the face array's origin, clamp to 0,
+// split into base index and fraction, fetch the four surrounding faces with
+// gathers and interpolate, evaluating the same expression in the same order.
+#if defined(__AVX512F__)
+
+void Grid::bilerpVel(const float *x, const float *y, float *out,
+		     unsigned count, Cell::Dimension dim) const
+{
+  const float *faces = (dim == Cell::X) ? uData() : vData();
+  const __m512 maxX  = _mm512_set1_ps(getWidth());
+  const __m512 maxY  = _mm512_set1_ps(getHeight());
+  const __m512 shiftX = _mm512_set1_ps(dim == Cell::X ? 0.0f : 0.5f);
+  const __m512 shiftY = _mm512_set1_ps(dim == Cell::X ? 0.5f : 0.0f);
+  const __m512 zero  = _mm512_setzero_ps();
+  const __m512 one   = _mm512_set1_ps(1.0f);
+  const __m512i stride = _mm512_set1_epi32(_stride);
+  const __m512i origin = _mm512_set1_epi32(index(0, 0));
+
+  for (unsigned k = 0; k < count; k += GRID_VECTOR_WIDTH) {
+    // A partial final batch is masked, so every position goes through the
+    // same arithmetic however the caller splits its batches.
+    const unsigned lanes = count - k < GRID_VECTOR_WIDTH
+      ? count - k : GRID_VECTOR_WIDTH;
+    const __mmask16 mask = (__mmask16)((1u << lanes) - 1);
+
+    __m512 px = _mm512_maskz_loadu_ps(mask, x + k);
+    __m512 py = _mm512_maskz_loadu_ps(mask, y + k);
+    px = _mm512_max_ps(_mm512_sub_ps(_mm512_min_ps(px, maxX), shiftX), zero);
+    py = _mm512_max_ps(_mm512_sub_ps(_mm512_min_ps(py, maxY), shiftY), zero);
+
+    const __m512i i = _mm512_cvttps_epi32(px);
+    const __m512i j = _mm512_cvttps_epi32(py);
+    const __m512 fx = _mm512_sub_ps(px, _mm512_cvtepi32_ps(i));
+    const __m512 fy = _mm512_sub_ps(py, _mm512_cvtepi32_ps(j));
+    const __m512i base = _mm512_add_epi32(_mm512_add_epi32(
+      _mm512_mullo_epi32(j, stride), i), origin);
+
+    const __m512 thisVel     = _mm512_i32gather_ps(base, faces, 4);
+    const __m512 rightVel    = _mm512_i32gather_ps(base, faces + 1, 4);
+    const __m512 topVel      = _mm512_i32gather_ps(base, faces + _stride, 4);
+    const __m512 topRightVel = _mm512_i32gather_ps(base, faces + _stride + 1, 4);
+
+    const __m512 gx = _mm512_sub_ps(one, fx);
+    const __m512 gy = _mm512_sub_ps(one, fy);
+    __m512 result = _mm512_mul_ps(_mm512_mul_ps(gx, gy), thisVel);
+    result = _mm512_add_ps(result,
+      _mm512_mul_ps(_mm512_mul_ps(fx, gy), rightVel));
+    result = _mm512_add_ps(result,
+      _mm512_mul_ps(_mm512_mul_ps(gx, fy), topVel));
+    result = _mm512_add_ps(result,
+      _mm512_mul_ps(_mm512_mul_ps(fx, fy), topRightVel));
+    _mm512_mask_storeu_ps(out + k, mask, result);
   }
-  // Else, set missing neighbors to 0 velocity.
-  else {
-    thisVel  = cell.vel[dim];
-    rightVel = cell.neighbors[Cell::POS_X]
-      ? cell.neighbors[Cell::POS_X]->vel[dim] : 0;
-    topVel   = cell.neighbors[Cell::POS_Y]
-      ? cell.neighbors[Cell::POS_Y]->vel[dim] : 0;
-    topRightVel = cell.neighbors[Cell::POS_XY]
-      ? cell.neighbors[Cell::POS_XY]->vel[dim] : 0;
+}
+
+float Grid::maxAbs(const float *values, unsigned count)
+{
+  const __m512i absMask = _mm512_set1_epi32(0x7fffffff);
+  __m512 result = _mm512_setzero_ps();
+  for (unsigned k = 0; k < count; k += GRID_VECTOR_WIDTH) {
+    const unsigned lanes = count - k < GRID_VECTOR_WIDTH
+      ? count - k : GRID_VECTOR_WIDTH;
+    const __mmask16 mask = (__mmask16)((1u << lanes) - 1);
+    const __m512i bits = _mm512_and_si512(
+      _mm512_castps_si512(_mm512_maskz_loadu_ps(mask, values + k)), absMask);
+    result = _mm512_max_ps(result, _mm512_castsi512_ps(bits));
   }
+  return _mm512_reduce_max_ps(result);
+}
 
-  // Perform the bilinear interpolation.
-  return bilerp(position, thisVel, rightVel, topVel, topRightVel);
+#elif defined(__AVX2__)
+
+void Grid::bilerpVel(const float *x, const float *y, float *out,
+		     unsigned count, Cell::Dimension dim) const
+{
+  const float *faces = (dim == Cell::X) ? uData() : vData();
+  const __m256 maxX  = _mm256_set1_ps(getWidth());
+  const __m256 maxY  = _mm256_set1_ps(getHeight());
+  const __m256 shiftX = _mm256_set1_ps(dim == Cell::X ? 0.0f : 0.5f);
+  const __m256 shiftY = _mm256_set1_ps(dim == Cell::X ? 0.5f : 0.0f);
+  const __m256 zero  = _mm256_setzero_ps();
+  const __m256 one   = _mm256_set1_ps(1.0f);
+  const __m256i stride = _mm256_set1_epi32(_stride);
+  const __m256i origin = _mm256_set1_epi32(index(0, 0));
+
+  for (unsigned k = 0; k < count; k += GRID_VECTOR_WIDTH) {
+    // A partial final batch is padded with positions at the origin, so
+    // every position goes through the same arithmetic however the caller
+    // splits its batches.
+    const unsigned lanes = count - k < GRID_VECTOR_WIDTH
+      ? count - k : GRID_VECTOR_WIDTH;
+    __m256 px, py;
+    if (lanes == GRID_VECTOR_WIDTH) {
+      px = _mm256_loadu_ps(x + k);
+      py = _mm256_loadu_ps(y + k);
+    }
+    else {
+      float tailX[GRID_VECTOR_WIDTH] = { 0.0f };
+      float tailY[GRID_VECTOR_WIDTH] = { 0.0f };
+      memcpy(tailX, x + k, lanes * sizeof(float));
+      memcpy(tailY, y + k, lanes * sizeof(float));
+      px = _mm256_loadu_ps(tailX);
+      py = _mm256_loadu_ps(tailY);
+    }
+    px = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(px, maxX), shiftX), zero);
+    py = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(py, maxY), shiftY), zero);
+
+    const __m256i i = _mm256_cvttps_epi32(px);
+    const __m256i j = _mm256_cvttps_epi32(py);
+    const __m256 fx = _mm256_sub_ps(px, _mm256_cvtepi32_ps(i));
+    const __m256 fy = _mm256_sub_ps(py, _mm256_cvtepi32_ps(j));
+    const __m256i base = _mm256_add_epi32(_mm256_add_epi32(
+      _mm256_mullo_epi32(j, stride), i), origin);
+
+    const __m256 thisVel     = _mm256_i32gather_ps(faces, base, 4);
+    const __m256 rightVel    = _mm256_i32gather_ps(faces + 1, base, 4);
+    const __m256 topVel      = _mm256_i32gather_ps(faces + _stride, base, 4);
+    const __m256 topRightVel = _mm256_i32gather_ps(faces + _stride + 1, base, 4);
+
+    const __m256 gx = _mm256_sub_ps(one, fx);
+    const __m256 gy = _mm256_sub_ps(one, fy);
+    __m256 result = _mm256_mul_ps(_mm256_mul_ps(gx, gy), thisVel);
+    result = _mm256_add_ps(result,
+      _mm256_mul_ps(_mm256_mul_ps(fx, gy), rightVel));
+    result = _mm256_add_ps(result,
+      _mm256_mul_ps(_mm256_mul_ps(gx, fy), topVel));
+    result = _mm256_add_ps(result,
+      _mm256_mul_ps(_mm256_mul_ps(fx, fy), topRightVel));
+
+    if (lanes == GRID_VECTOR_WIDTH)
+      _mm256_storeu_ps(out + k, result);
+    else {
+      float tail[GRID_VECTOR_WIDTH];
+      _mm256_storeu_ps(tail, result);
+      memcpy(out + k, tail, lanes * sizeof(float));
+    }
+  }
+}
+
+float Grid::maxAbs(const float *values, unsigned count)
+{
+  const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 result = _mm256_setzero_ps();
+  unsigned k = 0;
+  for (; k + GRID_VECTOR_WIDTH <= count; k += GRID_VECTOR_WIDTH)
+    result = _mm256_max_ps(result,
+      _mm256_and_ps(_mm256_loadu_ps(values + k), absMask));
+
+  // Reduce the lanes, then finish any partial batch.
+  float lanes[GRID_VECTOR_WIDTH];
+  _mm256_storeu_ps(lanes, result);
+  float maxValue = 0.0f;
+  for (unsigned i = 0; i < GRID_VECTOR_WIDTH; ++i)
+    maxValue = max(maxValue, lanes[i]);
+  for (; k < count; ++k)
+    maxValue = max(maxValue, fabsf(values[k]));
+  return maxValue;
+}
+
+#else
+
+void Grid::bilerpVel(const float *x, const float *y, float *out,
+		     unsigned count, Cell::Dimension dim) const
+{
+  for (unsigned k = 0; k < count; ++k)
+    out[k] = bilerpVel(Vector2(x[k], y[k]), dim);
 }
+
+
+float Grid::maxAbs(const float *values, unsigned count)
+{
+  float maxValue = 0.0f;
+  for (unsigned k = 0; k < count; ++k)
+    maxValue = max(maxValue, fabsf(values[k]));
+  return maxValue;
+}
+
+#endif
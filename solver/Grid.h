@@ -6,11 +6,42 @@
 #include "Vector2.h"
 
 
+// The Grid stores the MAC grid as a structure of arrays.  Rather than keeping
+// a Cell struct per grid location, each simulated quantity lives in its own
+// contiguous, row-major array sized to the MAC staggering:
+//
+//   u        - X velocities, sampled at the vertical faces:   (nx+1) x ny
+//   v        - Y velocities, sampled at the horizontal faces: nx x (ny+1)
+//   pressure - Pressure, sampled at the cell centers:         nx x ny
+//   cellType - Contents of each cell (see Cell::Type):        nx x ny
+//
+// where nx and ny are the number of cells along each axis.  The X velocity
+// u(i,j) is located at world position (i, j+0.5), and the Y velocity v(i,j)
+// is located at world position (i+0.5, j).  Solver sweeps typically touch
+// only one or two of these arrays at a time, so keeping them separate means
+// every byte pulled into cache is a byte that gets used.
+//
+// Every array is surrounded by a ghost layer and shares one padded layout of
+// (nx+3) x (ny+3) entries, so the same flat index (see index()) addresses
+// cell (i,j), its left face u(i,j) and its bottom face v(i,j) in each array.
+// Neighbors are reached with plain index arithmetic: +1 / -1 along X, and
+// +getStride() / -getStride() along Y.  Ghost faces always hold 0 velocity
+// and ghost cells are always SOLID, so stencils that reach one cell or face
+// beyond the simulation never need to check for a missing neighbor.
 class Grid {
   unsigned _rowCount;  // The number of rows in the sim.
   unsigned _colCount;  // The number of columns in the sim.
-  std::vector<Cell> _cells;  // STL Vector of all managed cells.
+  unsigned _stride;       // Distance between rows in every padded array.
+  unsigned _paddedCount;  // Number of entries in each padded array.
+  std::vector<float> _fields; // u, v, staged u/v, and pressure, back to back.
+  std::vector<unsigned char> _cellTypes; // Cell::Type per padded cell.
+  unsigned _uOffset;        // Offset of the X velocities within _fields.
+  unsigned _vOffset;        // Offset of the Y velocities within _fields.
+  unsigned _stagedUOffset;  // Offset of the staged X velocities.
+  unsigned _stagedVOffset;  // Offset of the staged Y velocities.
+  unsigned _pressureOffset; // Offset of the pressures within _fields.
   const static unsigned _minSize = 2; // Minimum size of grid in any dim.
+  const static unsigned _ghostSize = 1; // Ghost layer width on each side.
 
 public:
   // Constructs an instance of Grid of size width by height. Width and height
@@ -42,59 +73,170 @@ public:
   //   None
   ~Grid();
 
-  // Returns a reference to the specified cell, as specified by x and y coord.
-  // 
+  // Returns the flat index of cell (i, j) in the padded arrays. The same
+  // index addresses the cell's left X velocity face and bottom Y velocity
+  // face.  Use with the raw array accessors below.
+  //
   // Arguments:
-  //   unsigned x - The integer x coordinate of this cell within the grid.
-  //   unsigned y - The integer y coordinate of this cell within the grid.
+  //   unsigned i - The column of the cell or face.
+  //   unsigned j - The row of the cell or face.
   //
   // Returns:
-  //   Cell& - A reference to the specified cell.
-  inline Cell& operator()(unsigned x, unsigned y);
-  
-  // Returns a copy of the specified cell, as specified by x and y coord.
-  // 
+  //   unsigned - The index of (i, j) within every padded array.
+  inline unsigned index(unsigned i, unsigned j) const;
+
+  // Returns the distance between vertically adjacent entries in every padded
+  // array, i.e. index(i, j+1) - index(i, j).
+  //
   // Arguments:
-  //   unsigned x - The integer x coordinate of this cell within the grid.
-  //   unsigned y - The integer y coordinate of this cell within the grid.
+  //   None
   //
   // Returns:
-  //   Cell - A copy of the specified cell.
-  inline Cell operator()(unsigned x, unsigned y) const;
+  //   unsigned - The row stride of the padded arrays.
+  inline unsigned getStride() const;
 
-  // Returns a reference to the specified cell, as specified by an index
-  // into a contiguous array of Cell objects in row-major order.
-  // 
+  // Returns the number of entries in each padded array, ghost layer included.
+  //
   // Arguments:
-  //   unsigned index - The index into the row-major
+  //   None
   //
   // Returns:
-  //   Cell& - A reference to the specified cell.
-  inline Cell& operator[](unsigned index);
+  //   unsigned - The number of entries in each padded array.
+  inline unsigned getPaddedCount() const;
 
-  // Returns a copy of the specified cell, as specified by an index
-  // into a contiguous array of Cell objects in row-major order.
-  // 
+  // Returns a pointer to the first entry of a padded array. Entries are to
+  // be addressed with index(); the ghost layer must not be written to.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float * / unsigned char * - The padded array.
+  inline float * uData();
+  inline const float * uData() const;
+  inline float * vData();
+  inline const float * vData() const;
+  inline float * stagedUData();
+  inline float * stagedVData();
+  inline float * pressureData();
+  inline const float * pressureData() const;
+  inline unsigned char * cellTypeData();
+  inline const unsigned char * cellTypeData() const;
+
+  // Returns a reference to the X velocity stored at vertical face (i, j),
+  // located at world position (i, j+0.5).
+  //
   // Arguments:
-  //   unsigned index - The index into the row-major
+  //   unsigned i - The face's column, in [0, getColCount()).
+  //   unsigned j - The face's row, in [0, getRowCount() - 1).
   //
   // Returns:
-  //   Cell - A copy of the specified cell.
-  inline Cell operator[](unsigned index) const;
+  //   float& - A reference to the X velocity at this face.
+  inline float& u(unsigned i, unsigned j);
+  inline float  u(unsigned i, unsigned j) const;
+
+  // Returns a reference to the Y velocity stored at horizontal face (i, j),
+  // located at world position (i+0.5, j).
+  //
+  // Arguments:
+  //   unsigned i - The face's column, in [0, getColCount() - 1).
+  //   unsigned j - The face's row, in [0, getRowCount()).
+  //
+  // Returns:
+  //   float& - A reference to the Y velocity at this face.
+  inline float& v(unsigned i, unsigned j);
+  inline float  v(unsigned i, unsigned j) const;
+
+  // Returns a reference to the staged (temporary) X or Y velocity at a face.
+  // Indexing matches u() and v() respectively.  Staged velocities become
+  // the current velocities on the next call to commitStagedVel().
+  //
+  // Arguments:
+  //   unsigned i - The face's column.
+  //   unsigned j - The face's row.
+  //
+  // Returns:
+  //   float& - A reference to the staged velocity at this face.
+  inline float& stagedU(unsigned i, unsigned j);
+  inline float& stagedV(unsigned i, unsigned j);
+
+  // Returns a reference to the pressure at the center of cell (i, j).
+  //
+  // Arguments:
+  //   unsigned i - The cell's column, in [0, getColCount() - 1).
+  //   unsigned j - The cell's row, in [0, getRowCount() - 1).
+  //
+  // Returns:
+  //   float& - A reference to the pressure in this cell.
+  inline float& pressure(unsigned i, unsigned j);
+  inline float  pressure(unsigned i, unsigned j) const;
+
+  // Returns a reference to the contents type (a Cell::Type) of cell (i, j).
+  //
+  // Arguments:
+  //   unsigned i - The cell's column, in [0, getColCount() - 1).
+  //   unsigned j - The cell's row, in [0, getRowCount() - 1).
+  //
+  // Returns:
+  //   unsigned char& - A reference to the Cell::Type of this cell.
+  inline unsigned char& cellType(unsigned i, unsigned j);
+  inline unsigned char  cellType(unsigned i, unsigned j) const;
+
+  // Realizes all staged velocities (previously set via stagedU and stagedV)
+  // as the grid's current velocities.  This is an O(1) buffer swap; the
+  // contents of the staged velocities are unspecified afterwards.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void commitStagedVel();
 
   // Get the velocity at a location within the grid. This performs a bilinear
   // interpolation between values in neighboring cells per component.
   // NOTE: x and y are expected to be range supplied at construction time
   // of this Grid class, where x = [0.0f, width), y = [0.0f, height)
-  // 
+  //
   // Arguments:
   //   Vector2 position - The position to sample velocity at
   // Returns:
   //   Vector2 - The interpolated velocity at this point.
   Vector2 getVelocity(Vector2 position) const;
 
-  // Calculates the pressure gradient across this cell. 
-  // 
+  // Samples velocities at a batch of locations, as getVelocity() does for a
+  // single one.  Positions and results are passed as separate X and Y
+  // arrays, which lets the interpolation run several lanes at a time when
+  // the build targets AVX2 or AVX-512 (see vectorWidth()).  sampleU() and
+  // sampleV() compute only the X or Y component.  Output arrays must not
+  // overlap the input arrays.
+  //
+  // Arguments:
+  //   float *x - The X coordinates of the locations.
+  //   float *y - The Y coordinates of the locations.
+  //   float *u - Receives the X velocity at each location.
+  //   float *v - Receives the Y velocity at each location.
+  //   unsigned count - The number of locations.
+  //
+  // Returns:
+  //   None
+  void getVelocities(const float *x, const float *y,
+		     float *u, float *v, unsigned count) const;
+  void sampleU(const float *x, const float *y, float *u, unsigned count) const;
+  void sampleV(const float *x, const float *y, float *v, unsigned count) const;
+
+  // Returns the number of locations the batch sampling methods interpolate
+  // at once: 16 for AVX-512 builds, 8 for AVX2 builds and 1 otherwise.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of SIMD lanes used for batch sampling.
+  static unsigned vectorWidth();
+
+  // Calculates the pressure gradient across this cell.
+  //
   // Arguments:
   //   unsigned x - The integer x coordinate of this cell within the grid.
   //   unsigned y - The integer y coordinate of this cell within the grid.
@@ -104,9 +246,9 @@ public:
   Vector2 getPressureGradient(unsigned x, unsigned y) const;
 
   // Calculates the divergence of the velocity field within this cell.
-  // NOTE: x and y are expected to be range supplied at construction time
-  // of this Grid class, where x = [0.0f, width), y = [0.0f, height)
-  // 
+  // NOTE: x and y are expected to be cell indices, where
+  // x = [0, getColCount() - 1), y = [0, getRowCount() - 1)
+  //
   // Arguments:
   //   unsigned x - The integer x coordinate of this cell within the grid.
   //   unsigned y - The integer y coordinate of this cell within the grid.
@@ -117,7 +259,7 @@ public:
 
   // Calculates the maximum velocity in the grid by sampling the center
   // of each MAC cell.  This is currently an expensive operation due to
-  // naive implementation.
+  // naive implementation; getMaxFaceVelocity() gives a cheaper bound.
   //
   // Arguments:
   //   None
@@ -126,6 +268,29 @@ public:
   //   Vector2 - The maximum velocity since resetMaxVelocity().
   Vector2 getMaxVelocity() const;
 
+  // Calculates the largest X and Y velocity magnitudes stored on any face,
+  // in a single streaming pass over the face arrays.  Since interpolated
+  // velocities never exceed their faces, the magnitude of the result bounds
+  // the fluid's speed anywhere in the grid, e.g. for CFL timestep selection.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   Vector2 - (max |u|, max |v|) over all faces.
+  Vector2 getMaxFaceVelocity() const;
+
+  // Returns the largest absolute value in an array, using SIMD when the
+  // build targets AVX2 or AVX-512.
+  //
+  // Arguments:
+  //   float *values - The values.
+  //   unsigned count - The number of values.
+  //
+  // Returns:
+  //   float - The largest absolute value, or 0 if count is 0.
+  static float maxAbs(const float *values, unsigned count);
+
   // Gets the simulation height supported by this grid, in world coordinates.
   //
   // Arguments:
@@ -146,7 +311,7 @@ public:
 
   // Gets the number of rows in the MAC grid.
   // NOTE: The top row of the grid exceeds the bounds of the simulation.
-  // This row is used to store the y-velocities at the top of the sim.
+  // This row only holds the y-velocities at the top of the sim.
   // To determine the height of the simulation that is represented by this
   // grid, use getHeight() instead.
   //
@@ -159,9 +324,9 @@ public:
 
   // Gets the number of columns in the MAC grid.
   // NOTE: The far right of the grid exceeds the bounds of the simulation.
-  // This column is used to store the y-velocities at the top of the sim.
-  // To determine the height of the simulation that is represented by this
-  // grid, use getHeight() instead.
+  // This column only holds the x-velocities at the right of the sim.
+  // To determine the width of the simulation that is represented by this
+  // grid, use getWidth() instead.
   //
   // Arguments:
   //   None
@@ -171,14 +336,15 @@ public:
   inline unsigned getColCount() const;
 
 private:
-  // Creates linkage between neighboring cells.
-  void setCellLinkage();
-
   // Calculates a velocity component at the given world location in the MAC grid.
   float bilerpVel(Vector2 position, Cell::Dimension dim) const;
 
+  // Calculates a velocity component at a batch of world locations.
+  void bilerpVel(const float *x, const float *y, float *out, unsigned count,
+		 Cell::Dimension dim) const;
+
   // Utility function to perform bilinear interpolation between four values.
-  // 
+  //
   // Arguments:
   //   Vector2 position - Position to perform bilinear interpolation at
   //   float originVal - Value at (0, 0)
@@ -193,29 +359,141 @@ private:
 };
 
 
-Cell& Grid::operator()(unsigned x, unsigned y)
+unsigned Grid::index(unsigned i, unsigned j) const
+{
+  return (j + _ghostSize) * _stride + (i + _ghostSize);
+}
+
+
+unsigned Grid::getStride() const
+{
+  return _stride;
+}
+
+
+unsigned Grid::getPaddedCount() const
+{
+  return _paddedCount;
+}
+
+
+float * Grid::uData()
+{
+  return &_fields[_uOffset];
+}
+
+
+const float * Grid::uData() const
+{
+  return &_fields[_uOffset];
+}
+
+
+float * Grid::vData()
+{
+  return &_fields[_vOffset];
+}
+
+
+const float * Grid::vData() const
+{
+  return &_fields[_vOffset];
+}
+
+
+float * Grid::stagedUData()
+{
+  return &_fields[_stagedUOffset];
+}
+
+
+float * Grid::stagedVData()
+{
+  return &_fields[_stagedVOffset];
+}
+
+
+float * Grid::pressureData()
+{
+  return &_fields[_pressureOffset];
+}
+
+
+const float * Grid::pressureData() const
 {
-  unsigned index = y * _colCount + x;
-  return _cells[index];
+  return &_fields[_pressureOffset];
 }
- 
- 
-Cell Grid::operator()(unsigned x, unsigned y) const
+
+
+unsigned char * Grid::cellTypeData()
+{
+  return &_cellTypes[0];
+}
+
+
+const unsigned char * Grid::cellTypeData() const
+{
+  return &_cellTypes[0];
+}
+
+
+float& Grid::u(unsigned i, unsigned j)
+{
+  return _fields[_uOffset + index(i, j)];
+}
+
+
+float Grid::u(unsigned i, unsigned j) const
+{
+  return _fields[_uOffset + index(i, j)];
+}
+
+
+float& Grid::v(unsigned i, unsigned j)
+{
+  return _fields[_vOffset + index(i, j)];
+}
+
+
+float Grid::v(unsigned i, unsigned j) const
+{
+  return _fields[_vOffset + index(i, j)];
+}
+
+
+float& Grid::stagedU(unsigned i, unsigned j)
+{
+  return _fields[_stagedUOffset + index(i, j)];
+}
+
+
+float& Grid::stagedV(unsigned i, unsigned j)
+{
+  return _fields[_stagedVOffset + index(i, j)];
+}
+
+
+float& Grid::pressure(unsigned i, unsigned j)
+{
+  return _fields[_pressureOffset + index(i, j)];
+}
+
+
+float Grid::pressure(unsigned i, unsigned j) const
 {
-  unsigned index = y * _colCount + x;
-  return _cells[index];
+  return _fields[_pressureOffset + index(i, j)];
 }
 
 
-Cell& Grid::operator[](unsigned index)
+unsigned char& Grid::cellType(unsigned i, unsigned j)
 {
-  return _cells[index];
+  return _cellTypes[index(i, j)];
 }
 
 
-Cell Grid::operator[](unsigned index) const
+unsigned char Grid::cellType(unsigned i, unsigned j) const
 {
-  return _cells[index];
+  return _cellTypes[index(i, j)];
 }
 
 
@@ -245,7 +523,7 @@ unsigned Grid::getColCount() const
 
 float Grid::bilerp(Vector2 pos,
 		   float originVal, float posXVal,
-		   float posYVal, float posXYVal) const 
+		   float posYVal, float posXYVal) const
 {
   return (1-pos.x) * (1-pos.y) * originVal +
          pos.x     * (1-pos.y) * posXVal +
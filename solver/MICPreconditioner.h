@@ -0,0 +1,198 @@
+#ifndef __MIC_PRECONDITIONER_H__
+#define __MIC_PRECONDITIONER_H__
+
+#include <cmath>
+#include <vector>
+#include <eigen3/Eigen/Core>
+
+
+// A Modified Incomplete Cholesky, level zero (MIC(0)), preconditioner for
+// the 5-point pressure Laplacian of a MAC grid, as described in chapter 4 of
+// Bridson's "Fluid Simulation for Computer Graphics".
+//
+// The preconditioner assumes that unknowns are ordered row-major over a grid
+// of a known width (see setGridWidth()), so that each row of the matrix only
+// couples to the unknowns at +/-1 (X neighbors) and +/-width (Y neighbors).
+// Only the diagonal and the +X / +Y coefficients of each row are retained,
+// which is all the incomplete factorization needs.
+//
+// This class implements Eigen's preconditioner interface, so it can be used
+// directly as the preconditioner of Eigen::ConjugateGradient:
+//
+//   ConjugateGradient<Matrix, Lower|Upper, MICPreconditioner<double> > cg;
+//   cg.preconditioner().setGridWidth(width);
+//   cg.compute(A);
+template <typename _Scalar>
+class MICPreconditioner
+{
+  typedef _Scalar Scalar;
+  typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> Vector;
+
+public:
+  typedef typename Vector::StorageIndex StorageIndex;
+  enum {
+    ColsAtCompileTime = Eigen::Dynamic,
+    MaxColsAtCompileTime = Eigen::Dynamic
+  };
+
+  // Default constructor.  setGridWidth() must be called before compute().
+  //
+  // Arguments:
+  //   None
+  MICPreconditioner()
+    : _gridWidth(0),
+      _tuning(0.97),
+      _safety(0.25),
+      _isInitialized(false)
+  {}
+
+  // Sets the number of unknowns in each row of the grid.
+  //
+  // Arguments:
+  //   unsigned width - The number of cells in each row of the grid.
+  //
+  // Returns:
+  //   None
+  void setGridWidth(unsigned width) { _gridWidth = width; }
+
+  // Sets the MIC tuning constant (tau) blending between incomplete Cholesky
+  // (0.0) and fully modified incomplete Cholesky (1.0).
+  //
+  // Arguments:
+  //   Scalar tuning - The tuning constant, typically 0.97.
+  //
+  // Returns:
+  //   None
+  void setTuning(Scalar tuning) { _tuning = tuning; }
+
+  Eigen::Index rows() const { return _precon.size(); }
+  Eigen::Index cols() const { return _precon.size(); }
+
+  // The MIC(0) factorization has no symbolic phase; the sparsity pattern is
+  // implied by the grid width.
+  template <typename MatType>
+  MICPreconditioner& analyzePattern(const MatType &)
+  {
+    return *this;
+  }
+
+  // Extracts the 5-point coefficients of the matrix and computes the
+  // incomplete factorization.
+  //
+  // Arguments:
+  //   MatType &mat - A symmetric 5-point matrix, row-major over the grid.
+  //
+  // Returns:
+  //   MICPreconditioner & - A reference to this preconditioner.
+  template <typename MatType>
+  MICPreconditioner& factorize(const MatType &mat)
+  {
+    const Eigen::Index n = mat.cols();
+    _diag.assign(n, Scalar(0));
+    _plusX.assign(n, Scalar(0));
+    _plusY.assign(n, Scalar(0));
+    for (Eigen::Index k = 0; k < mat.outerSize(); ++k)
+      for (typename MatType::InnerIterator it(mat, k); it; ++it) {
+	const Eigen::Index row = it.row();
+	const Eigen::Index col = it.col();
+	if (col == row)
+	  _diag[row] += it.value();
+	else if (col == row + 1)
+	  _plusX[row] += it.value();
+	else if (col == row + Eigen::Index(_gridWidth))
+	  _plusY[row] += it.value();
+      }
+
+    computePrecon();
+    return *this;
+  }
+
+  template <typename MatType>
+  MICPreconditioner& compute(const MatType &mat)
+  {
+    return factorize(mat);
+  }
+
+  // Applies the preconditioner, solving L L^T z = r by forward and backward
+  // substitution.
+  //
+  // Arguments:
+  //   MatrixBase<Rhs> &r - The residual to precondition.
+  //
+  // Returns:
+  //   Vector - The preconditioned residual, z.
+  template <typename Rhs>
+  Vector solve(const Eigen::MatrixBase<Rhs> &r) const
+  {
+    const Eigen::Index n = _precon.size();
+    const Eigen::Index w = _gridWidth;
+    Vector q(n);
+
+    // Solve L q = r.
+    for (Eigen::Index i = 0; i < n; ++i) {
+      Scalar t = r(i);
+      if (i >= 1)
+	t -= _plusX[i-1] * _precon[i-1] * q(i-1);
+      if (i >= w)
+	t -= _plusY[i-w] * _precon[i-w] * q(i-w);
+      q(i) = t * _precon[i];
+    }
+
+    // Solve L^T z = q, in place.
+    for (Eigen::Index i = n - 1; i >= 0; --i) {
+      Scalar t = q(i);
+      if (i + 1 < n)
+	t -= _plusX[i] * _precon[i] * q(i+1);
+      if (i + w < n)
+	t -= _plusY[i] * _precon[i] * q(i+w);
+      q(i) = t * _precon[i];
+    }
+    return q;
+  }
+
+  Eigen::ComputationInfo info()
+  {
+    return _isInitialized ? Eigen::Success : Eigen::InvalidInput;
+  }
+
+private:
+  // Computes the inverse square root of the factor's diagonal, falling back
+  // to the plain diagonal wherever the modified estimate becomes too small.
+  void computePrecon()
+  {
+    const std::size_t n = _diag.size();
+    const std::size_t w = _gridWidth;
+    _precon.assign(n, Scalar(0));
+    for (std::size_t i = 0; i < n; ++i) {
+      if (_diag[i] == Scalar(0))
+	continue;
+
+      Scalar e = _diag[i];
+      if (i >= 1) {
+	const Scalar px = _plusX[i-1] * _precon[i-1];
+	e -= px * px +
+	  _tuning * _plusX[i-1] * _plusY[i-1] * _precon[i-1] * _precon[i-1];
+      }
+      if (i >= w) {
+	const Scalar py = _plusY[i-w] * _precon[i-w];
+	e -= py * py +
+	  _tuning * _plusY[i-w] * _plusX[i-w] * _precon[i-w] * _precon[i-w];
+      }
+      if (e < _safety * _diag[i])
+	e = _diag[i];
+      _precon[i] = Scalar(1) / std::sqrt(e);
+    }
+    _isInitialized = (_gridWidth > 0);
+  }
+
+  unsigned _gridWidth;          // Number of unknowns per grid row.
+  Scalar _tuning;               // MIC tuning constant, tau.
+  Scalar _safety;               // Safety constant, sigma.
+  bool _isInitialized;          // True once factorize() has been called.
+  std::vector<Scalar> _diag;    // Diagonal coefficient of each row.
+  std::vector<Scalar> _plusX;   // Coefficient coupling each row to +X.
+  std::vector<Scalar> _plusY;   // Coefficient coupling each row to +Y.
+  std::vector<Scalar> _precon;  // Inverse square root of factor diagonal.
+};
+
+#endif // __MIC_PRECONDITIONER_H__
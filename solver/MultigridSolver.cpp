@@ -0,0 +1,347 @@
+#include "MultigridSolver.h"
+#include "Cell.h"
+#include <cmath>
+#include <algorithm>
+
+using std::vector;
+
+// Bilinear weights between cell centers of adjacent levels.  A fine cell lies
+// 1/4 of a coarse cell from its parent's center and 3/4 of a coarse cell from
+// the next closest coarse centers, giving weights of 3/4 and 1/4 per axis for
+// the parent, X neighbor, Y neighbor and diagonal neighbor, in that order.
+static const double STENCIL_WEIGHTS[4] = {
+  0.75 * 0.75, 0.75 * 0.25, 0.25 * 0.75, 0.25 * 0.25
+};
+
+// On the finest level p = 0 is imposed at AIR cell centers.  A coarse cell
+// whose children border AIR lies 3/4 of its width from that location rather
+// than a full cell width, so AIR neighbors are weighted by 1 / (3/4) on
+// every coarse level to keep the free surface from drifting outwards.
+static const double COARSE_AIR_WEIGHT = 4.0 / 3.0;
+
+// Returns the diagonal coefficient of the (unscaled) stencil at padded index
+// c: FLUID neighbors contribute 1, AIR neighbors airWeight and SOLID
+// neighbors nothing.
+static inline double diagonal(const unsigned char *types, unsigned c,
+			      int stride, double airWeight)
+{
+  const unsigned char neighbors[4] = {
+    types[c - 1], types[c + 1], types[c - stride], types[c + stride]
+  };
+  double diag = 0.0;
+  for (unsigned n = 0; n < 4; ++n) {
+    if (neighbors[n] == Cell::FLUID)
+      diag += 1.0;
+    else if (neighbors[n] == Cell::AIR)
+      diag += airWeight;
+  }
+  return diag;
+}
+
+
+MultigridSolver::MultigridSolver()
+  : _levels(),
+    _preSweeps(2),
+    _postSweeps(2),
+    _coarseSweeps(32),
+    _iterations(0),
+    _error(0.0)
+{}
+
+
+void MultigridSolver::setup(const Grid &grid, double scale)
+{
+  // Determine the number of levels required to reach the coarsest size.
+  unsigned width  = grid.getColCount() - 1;
+  unsigned height = grid.getRowCount() - 1;
+  unsigned levelCount = 1;
+  for (unsigned w = width, h = height;
+       w > _coarsestSize || h > _coarsestSize; ++levelCount) {
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+  }
+  _levels.resize(levelCount);
+
+  // Copy the finest level's cell types directly from the grid.
+  Level &finest = _levels[0];
+  resizeLevel(finest, width, height);
+  finest.scale = scale;
+  finest.airWeight = 1.0;
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x < width; ++x)
+      finest.types[finest.index(x, y)] = grid.cellType(x, y);
+
+  // Derive each coarser level's cell types from its 2x2 children.
+  for (unsigned l = 1; l < levelCount; ++l) {
+    const Level &fine = _levels[l-1];
+    Level &coarse = _levels[l];
+    resizeLevel(coarse, (fine.width + 1) / 2, (fine.height + 1) / 2);
+    coarse.scale = fine.scale * 0.25;
+    coarse.airWeight = COARSE_AIR_WEIGHT;
+    for (unsigned y = 0; y < coarse.height; ++y)
+      for (unsigned x = 0; x < coarse.width; ++x) {
+	const unsigned f = fine.index(2*x, 2*y);
+	const unsigned char children[4] = {
+	  fine.types[f], fine.types[f + 1],
+	  fine.types[f + fine.stride], fine.types[f + fine.stride + 1]
+	};
+	unsigned char type = Cell::SOLID;
+	for (unsigned c = 0; c < 4; ++c) {
+	  if (children[c] == Cell::AIR)
+	    type = Cell::AIR;
+	  else if (children[c] == Cell::FLUID && type == Cell::SOLID)
+	    type = Cell::FLUID;
+	}
+	coarse.types[coarse.index(x, y)] = type;
+      }
+  }
+}
+
+
+void MultigridSolver::setScale(double scale)
+{
+  for (unsigned l = 0; l < _levels.size(); ++l, scale *= 0.25)
+    _levels[l].scale = scale;
+}
+
+
+bool MultigridSolver::solve(const double *b, double *p,
+			    double tolerance, unsigned maxCycles)
+{
+  // Load the right-hand side and initial guess into the finest level.
+  Level &finest = _levels[0];
+  double bNorm2 = 0.0;
+  for (unsigned y = 0; y < finest.height; ++y)
+    for (unsigned x = 0; x < finest.width; ++x) {
+      const unsigned i = finest.index(x, y);
+      const unsigned k = y * finest.width + x;
+      const bool fluid = (finest.types[i] == Cell::FLUID);
+      finest.b[i] = fluid ? b[k] : 0.0;
+      finest.x[i] = fluid ? p[k] : 0.0;
+      bNorm2 += finest.b[i] * finest.b[i];
+    }
+
+  // Perform V-cycles until the residual is sufficiently reduced.
+  const double threshold2 = tolerance * tolerance * bNorm2;
+  double rNorm2 = computeResidual(finest);
+  _iterations = 0;
+  while (rNorm2 > threshold2 && _iterations < maxCycles) {
+    vCycle(0);
+    rNorm2 = computeResidual(finest);
+    ++_iterations;
+  }
+  _error = bNorm2 > 0.0 ? std::sqrt(rNorm2 / bNorm2) : 0.0;
+
+  // Store the solution; non-FLUID cells hold 0 pressure.
+  for (unsigned y = 0; y < finest.height; ++y)
+    for (unsigned x = 0; x < finest.width; ++x)
+      p[y * finest.width + x] = finest.x[finest.index(x, y)];
+
+  return rNorm2 <= threshold2;
+}
+
+
+void MultigridSolver::precondition(const double *r, double *z)
+{
+  Level &finest = _levels[0];
+  for (unsigned y = 0; y < finest.height; ++y)
+    for (unsigned x = 0; x < finest.width; ++x) {
+      const unsigned i = finest.index(x, y);
+      finest.b[i] = (finest.types[i] == Cell::FLUID) ? r[y * finest.width + x]
+						      : 0.0;
+    }
+  std::fill(finest.x.begin(), finest.x.end(), 0.0);
+
+  vCycle(0);
+
+  // Non-FLUID entries pass straight through, keeping M^-1 nonsingular on
+  // the identity rows of the assembled matrix.
+  for (unsigned y = 0; y < finest.height; ++y)
+    for (unsigned x = 0; x < finest.width; ++x) {
+      const unsigned i = finest.index(x, y);
+      const unsigned k = y * finest.width + x;
+      z[k] = (finest.types[i] == Cell::FLUID) ? finest.x[i] : r[k];
+    }
+}
+
+
+unsigned MultigridSolver::iterations() const
+{
+  return _iterations;
+}
+
+
+double MultigridSolver::error() const
+{
+  return _error;
+}
+
+
+unsigned MultigridSolver::getLevelCount() const
+{
+  return _levels.size();
+}
+
+
+void MultigridSolver::resizeLevel(Level &level, unsigned width, unsigned height)
+{
+  level.width  = width;
+  level.height = height;
+  level.stride = width + 2 * _ghostSize;
+  const unsigned padded = level.stride * (height + 2 * _ghostSize);
+  level.types.assign(padded, Cell::SOLID);
+  level.x.assign(padded, 0.0);
+  level.b.assign(padded, 0.0);
+  level.r.assign(padded, 0.0);
+}
+
+
+void MultigridSolver::vCycle(unsigned l)
+{
+  Level &level = _levels[l];
+
+  // On the coarsest level, simply smooth until (nearly) solved.  Sweeping
+  // red-black and then black-red keeps the cycle symmetric.
+  if (l + 1 == _levels.size()) {
+    smooth(level, _coarseSweeps, true);
+    smooth(level, _coarseSweeps, false);
+    return;
+  }
+
+  // Pre-smooth, then solve for the error on the next coarser level.
+  Level &coarse = _levels[l+1];
+  smooth(level, _preSweeps, true);
+  computeResidual(level);
+  restrictResidual(level, coarse);
+  std::fill(coarse.x.begin(), coarse.x.end(), 0.0);
+  vCycle(l + 1);
+
+  // Apply the coarse correction and post-smooth.
+  prolongate(coarse, level);
+  smooth(level, _postSweeps, false);
+}
+
+
+void MultigridSolver::smooth(Level &level, unsigned sweeps, bool redFirst)
+{
+  const unsigned char *types = &level.types[0];
+  const double *b = &level.b[0];
+  double *x = &level.x[0];
+  const int stride = level.stride;
+  const double invScale = 1.0 / level.scale;
+
+  for (unsigned sweep = 0; sweep < sweeps; ++sweep)
+    for (unsigned color = 0; color < 2; ++color) {
+      // Red cells have an even (x + y), black cells an odd (x + y).
+      const unsigned parity = redFirst ? color : 1 - color;
+      for (unsigned j = 0; j < level.height; ++j)
+	for (unsigned i = (j + parity) & 1; i < level.width; i += 2) {
+	  const unsigned c = level.index(i, j);
+	  if (types[c] != Cell::FLUID)
+	    continue;
+
+	  // Non-FLUID neighbors hold x = 0, so only the diagonal needs to
+	  // distinguish AIR from SOLID.
+	  const double diag = diagonal(types, c, stride, level.airWeight);
+	  if (diag == 0.0)
+	    continue;
+	  const double sum = x[c - 1] + x[c + 1] + x[c - stride] + x[c + stride];
+	  x[c] = (b[c] * invScale + sum) / diag;
+	}
+    }
+}
+
+
+double MultigridSolver::computeResidual(Level &level)
+{
+  const unsigned char *types = &level.types[0];
+  const double *b = &level.b[0];
+  const double *x = &level.x[0];
+  double *r = &level.r[0];
+  const int stride = level.stride;
+  double norm2 = 0.0;
+
+  for (unsigned j = 0; j < level.height; ++j)
+    for (unsigned i = 0; i < level.width; ++i) {
+      const unsigned c = level.index(i, j);
+      if (types[c] != Cell::FLUID) {
+	r[c] = 0.0;
+	continue;
+      }
+      const double diag = diagonal(types, c, stride, level.airWeight);
+      const double sum = x[c - 1] + x[c + 1] + x[c - stride] + x[c + stride];
+      r[c] = b[c] - level.scale * (diag * x[c] - sum);
+      norm2 += r[c] * r[c];
+    }
+  return norm2;
+}
+
+
+void MultigridSolver::interpolationStencil(const Level &coarse,
+					   unsigned i, unsigned j,
+					   unsigned stencil[4]) const
+{
+  // Even fine cells lean towards the coarse cell below/left of their parent,
+  // odd cells towards the one above/right.
+  const unsigned c = coarse.index(i / 2, j / 2);
+  const unsigned char *types = &coarse.types[0];
+  int dx = (i & 1) ? 1 : -1;
+  int dy = (j & 1) ? int(coarse.stride) : -int(coarse.stride);
+
+  // SOLID neighbors are Neumann boundaries, so the parent's value is
+  // mirrored across them rather than interpolating towards 0.
+  if (types[c + dx] == Cell::SOLID)
+    dx = 0;
+  if (types[c + dy] == Cell::SOLID)
+    dy = 0;
+  stencil[0] = c;
+  stencil[1] = c + dx;
+  stencil[2] = c + dy;
+  stencil[3] = (types[c + dy + dx] == Cell::SOLID) ? c : c + dy + dx;
+}
+
+
+void MultigridSolver::restrictResidual(const Level &fine, Level &coarse)
+{
+  // Scatter each fine residual to the coarse cells it is interpolated from,
+  // making restriction exactly the transpose of prolongation, scaled by 1/4.
+  const double *r = &fine.r[0];
+  double *b = &coarse.b[0];
+  std::fill(coarse.b.begin(), coarse.b.end(), 0.0);
+
+  for (unsigned j = 0; j < fine.height; ++j)
+    for (unsigned i = 0; i < fine.width; ++i) {
+      const unsigned f = fine.index(i, j);
+      if (fine.types[f] != Cell::FLUID)
+	continue;
+      unsigned stencil[4];
+      interpolationStencil(coarse, i, j, stencil);
+      const double rf = 0.25 * r[f];
+      for (unsigned k = 0; k < 4; ++k)
+	b[stencil[k]] += STENCIL_WEIGHTS[k] * rf;
+    }
+
+  // Only FLUID cells are unknowns on the coarse level.
+  for (unsigned c = 0; c < coarse.b.size(); ++c)
+    if (coarse.types[c] != Cell::FLUID)
+      b[c] = 0.0;
+}
+
+
+void MultigridSolver::prolongate(const Level &coarse, Level &fine)
+{
+  const double *xc = &coarse.x[0];
+
+  for (unsigned j = 0; j < fine.height; ++j)
+    for (unsigned i = 0; i < fine.width; ++i) {
+      const unsigned f = fine.index(i, j);
+      if (fine.types[f] != Cell::FLUID)
+	continue;
+      unsigned stencil[4];
+      interpolationStencil(coarse, i, j, stencil);
+      fine.x[f] += STENCIL_WEIGHTS[0] * xc[stencil[0]] +
+		   STENCIL_WEIGHTS[1] * xc[stencil[1]] +
+		   STENCIL_WEIGHTS[2] * xc[stencil[2]] +
+		   STENCIL_WEIGHTS[3] * xc[stencil[3]];
+    }
+}
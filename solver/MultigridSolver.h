@@ -0,0 +1,239 @@
+#ifndef __MULTIGRID_SOLVER_H__
+#define __MULTIGRID_SOLVER_H__
+
+#include <vector>
+#include <eigen3/Eigen/Core>
+#include "Grid.h"
+
+
+// A geometric multigrid solver for the pressure Poisson equation on a MAC
+// grid.  The hierarchy is built directly from the Grid's cell types: each
+// coarse cell covers 2x2 fine cells and is AIR if any child is AIR (Dirichlet
+// conditions dominate), FLUID if any remaining child is FLUID, and SOLID
+// otherwise.  On every level the operator is the 5-point stencil over FLUID
+// cells, where AIR neighbors hold p = 0 and SOLID neighbors contribute
+// nothing (Neumann), scaled by 1/4 per level to account for the doubled
+// cell size.  On coarse levels AIR neighbors are weighted by 4/3, which keeps
+// the coarse free surface at the same location as the finest one.
+//
+// Smoothing uses red-black Gauss-Seidel, prolongation is bilinear between
+// cell centers (mirroring values across SOLID cells), and restriction is the
+// transpose of prolongation scaled by 1/4.  Pre-smoothing visits red cells
+// first and post-smoothing visits black cells first, making a V-cycle a
+// symmetric operator that can also serve as a preconditioner for conjugate
+// gradient (see MultigridPreconditioner).
+//
+// Vectors passed to and from the solver are compact and row-major over the
+// simulation's cells, exactly like the vectors of the assembled pressure
+// matrix: entry y * width + x holds cell (x, y).
+class MultigridSolver
+{
+public:
+  // Constructs an empty solver.  setup() must be called before solving.
+  //
+  // Arguments:
+  //   None
+  MultigridSolver();
+
+  // Builds the level hierarchy from the cell types of a grid.  Buffers are
+  // reused between calls when the grid dimensions do not change.
+  //
+  // Arguments:
+  //   Grid &grid - The grid whose cell types define the Poisson problem.
+  //   double scale - The coefficient of the finest level's stencil.
+  //
+  // Returns:
+  //   None
+  void setup(const Grid &grid, double scale);
+
+  // Changes the coefficient of the finest level's stencil without rebuilding
+  // the hierarchy, for when only the timestep has changed since setup().
+  //
+  // Arguments:
+  //   double scale - The coefficient of the finest level's stencil.
+  //
+  // Returns:
+  //   None
+  void setScale(double scale);
+
+  // Solves Ap = b by repeated V-cycles, starting from the provided p, until
+  // the relative residual falls below the tolerance.
+  //
+  // Arguments:
+  //   double *b - The right-hand side, one entry per cell.
+  //   double *p - In: the initial guess. Out: the solution.
+  //   double tolerance - The relative residual |b - Ap| / |b| to reach.
+  //   unsigned maxCycles - The maximum number of V-cycles to perform.
+  //
+  // Returns:
+  //   bool - True if the tolerance was reached.
+  bool solve(const double *b, double *p, double tolerance, unsigned maxCycles);
+
+  // Applies a single V-cycle to r, starting from a zero initial guess.
+  // This is the preconditioning operation z = M^-1 r.
+  //
+  // Arguments:
+  //   double *r - The residual to precondition, one entry per cell.
+  //   double *z - The preconditioned residual, one entry per cell.
+  //
+  // Returns:
+  //   None
+  void precondition(const double *r, double *z);
+
+  // Returns the number of V-cycles performed by the latest solve().
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of V-cycles performed.
+  unsigned iterations() const;
+
+  // Returns the relative residual reached by the latest solve().
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   double - The relative residual |b - Ap| / |b|.
+  double error() const;
+
+  // Returns the number of levels in the hierarchy.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of levels, including the finest.
+  unsigned getLevelCount() const;
+
+private:
+  // A single level of the hierarchy.  Every array is padded with a ghost
+  // layer (SOLID cells, zero values) so that stencils never branch.
+  struct Level {
+    unsigned width;   // Number of cells along X.
+    unsigned height;  // Number of cells along Y.
+    unsigned stride;  // Distance between rows in the padded arrays.
+    double   scale;   // Stencil coefficient on this level.
+    double   airWeight; // Diagonal contribution of each AIR neighbor.
+    std::vector<unsigned char> types; // Cell::Type per padded cell.
+    std::vector<double> x;  // Solution (or correction).
+    std::vector<double> b;  // Right-hand side.
+    std::vector<double> r;  // Residual.
+
+    // Returns the padded index of cell (i, j).
+    inline unsigned index(unsigned i, unsigned j) const
+    {
+      return (j + _ghostSize) * stride + (i + _ghostSize);
+    }
+  };
+
+  // Resizes a level to hold a width x height grid of cells.
+  void resizeLevel(Level &level, unsigned width, unsigned height);
+
+  // Performs a V-cycle on the given level and all coarser levels.
+  void vCycle(unsigned level);
+
+  // Performs red-black Gauss-Seidel sweeps on a level.
+  void smooth(Level &level, unsigned sweeps, bool redFirst);
+
+  // Computes r = b - Ax on a level, returning the squared norm of r.
+  double computeResidual(Level &level);
+
+  // Finds the four coarse cells that fine cell (i, j) is interpolated from,
+  // ordered to match the bilinear weights.
+  void interpolationStencil(const Level &coarse, unsigned i, unsigned j,
+			    unsigned stencil[4]) const;
+
+  // Restricts the fine level's residual into the coarse level's rhs.
+  void restrictResidual(const Level &fine, Level &coarse);
+
+  // Adds the bilinearly interpolated coarse correction to the fine level.
+  void prolongate(const Level &coarse, Level &fine);
+
+  std::vector<Level> _levels; // The hierarchy, finest level first.
+  unsigned _preSweeps;        // Smoothing sweeps before coarse correction.
+  unsigned _postSweeps;       // Smoothing sweeps after coarse correction.
+  unsigned _coarseSweeps;     // Smoothing sweeps on the coarsest level.
+  unsigned _iterations;       // V-cycles performed by the latest solve.
+  double   _error;            // Relative residual of the latest solve.
+
+  const static unsigned _ghostSize = 2;   // Ghost layer width on each side.
+  const static unsigned _coarsestSize = 4; // Max cells per side, coarsest.
+};
+
+
+// Adapts a MultigridSolver to Eigen's preconditioner interface, so that a
+// single V-cycle can precondition Eigen::ConjugateGradient:
+//
+//   ConjugateGradient<Matrix, Lower|Upper, MultigridPreconditioner> cg;
+//   multigrid.setup(grid, scale);
+//   cg.preconditioner().setMultigrid(&multigrid);
+//   cg.compute(A);
+//
+// The hierarchy comes from the grid given to MultigridSolver::setup(); the
+// matrix given to compute() is ignored.
+class MultigridPreconditioner
+{
+  typedef Eigen::VectorXd Vector;
+
+public:
+  typedef Vector::StorageIndex StorageIndex;
+  enum {
+    ColsAtCompileTime = Eigen::Dynamic,
+    MaxColsAtCompileTime = Eigen::Dynamic
+  };
+
+  MultigridPreconditioner() : _multigrid(NULL), _size(0) {}
+
+  // Sets the (already set up) multigrid solver used to precondition.
+  //
+  // Arguments:
+  //   MultigridSolver *multigrid - The solver; not owned by this object.
+  //
+  // Returns:
+  //   None
+  void setMultigrid(MultigridSolver *multigrid) { _multigrid = multigrid; }
+
+  Eigen::Index rows() const { return _size; }
+  Eigen::Index cols() const { return _size; }
+
+  template <typename MatType>
+  MultigridPreconditioner& analyzePattern(const MatType &)
+  {
+    return *this;
+  }
+
+  template <typename MatType>
+  MultigridPreconditioner& factorize(const MatType &mat)
+  {
+    _size = mat.cols();
+    return *this;
+  }
+
+  template <typename MatType>
+  MultigridPreconditioner& compute(const MatType &mat)
+  {
+    return factorize(mat);
+  }
+
+  template <typename Rhs>
+  Vector solve(const Eigen::MatrixBase<Rhs> &r) const
+  {
+    const Vector residual = r;
+    Vector z(residual.size());
+    _multigrid->precondition(residual.data(), z.data());
+    return z;
+  }
+
+  Eigen::ComputationInfo info()
+  {
+    return _multigrid ? Eigen::Success : Eigen::InvalidInput;
+  }
+
+private:
+  MultigridSolver *_multigrid; // The solver applying each V-cycle.
+  Eigen::Index _size;          // Number of unknowns.
+};
+
+#endif // __MULTIGRID_SOLVER_H__
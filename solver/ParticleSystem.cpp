@@ -0,0 +1,316 @@
+#include "ParticleSystem.h"
+#include <algorithm>
+#include <utility>
+
+
+namespace {
+  // Number of particles integrated together.  Intermediate positions and
+  // velocities for a batch stay on the stack, in cache.
+  const unsigned BATCH_SIZE = 256;
+
+  // Smallest block of particles worth handing to another thread.
+  const unsigned MIN_BLOCK_SIZE = 4096;
+
+  // Spreads the low 16 bits of a value out to the even bits.
+  unsigned spreadBits(unsigned value)
+  {
+    value &= 0x0000ffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+  }
+
+  // Returns the position of a cell along the Z-order curve.
+  unsigned mortonCode(unsigned x, unsigned y)
+  {
+    return spreadBits(x) | (spreadBits(y) << 1);
+  }
+
+  // Advects a block of particles; see ParticleSystem::advect().
+  class AdvectionTask : public ThreadPool::Task
+  {
+  public:
+    AdvectionTask(const Grid &grid, float *x, float *y, float timeStepSec,
+		  ParticleSystem::Integrator integrator)
+      : _grid(grid), _x(x), _y(y), _timeStepSec(timeStepSec),
+	_integrator(integrator)
+    {}
+
+    void run(unsigned begin, unsigned end) const
+    {
+      for (unsigned first = begin; first < end; first += BATCH_SIZE) {
+	const unsigned count = std::min(BATCH_SIZE, end - first);
+	switch (_integrator) {
+	case ParticleSystem::RK3:
+	  rk3(_x + first, _y + first, count);
+	  break;
+	case ParticleSystem::RK2:
+	  rk2(_x + first, _y + first, count);
+	  break;
+	case ParticleSystem::FORWARD_EULER:
+	default:
+	  forwardEuler(_x + first, _y + first, count);
+	  break;
+	}
+      }
+    }
+
+  private:
+    // x += dt v(x)
+    void forwardEuler(float *x, float *y, unsigned count) const
+    {
+      const float dt = _timeStepSec;
+      float u[BATCH_SIZE], v[BATCH_SIZE];
+      _grid.getVelocities(x, y, u, v, count);
+      for (unsigned k = 0; k < count; ++k) {
+	x[k] += u[k] * dt;
+	y[k] += v[k] * dt;
+      }
+    }
+
+    // x += dt v(x + dt/2 v(x))
+    void rk2(float *x, float *y, unsigned count) const
+    {
+      const float dt = _timeStepSec;
+      float u[BATCH_SIZE], v[BATCH_SIZE];
+      float midX[BATCH_SIZE], midY[BATCH_SIZE];
+      _grid.getVelocities(x, y, u, v, count);
+      for (unsigned k = 0; k < count; ++k) {
+	midX[k] = x[k] + 0.5f * dt * u[k];
+	midY[k] = y[k] + 0.5f * dt * v[k];
+      }
+      _grid.getVelocities(midX, midY, u, v, count);
+      for (unsigned k = 0; k < count; ++k) {
+	x[k] += dt * u[k];
+	y[k] += dt * v[k];
+      }
+    }
+
+    // k1 = v(x), k2 = v(x + dt/2 k1), k3 = v(x + 3dt/4 k2),
+    // x += dt (2/9 k1 + 3/9 k2 + 4/9 k3)
+    void rk3(float *x, float *y, unsigned count) const
+    {
+      const float dt = _timeStepSec;
+      float u[BATCH_SIZE], v[BATCH_SIZE];
+      float stageX[BATCH_SIZE], stageY[BATCH_SIZE];
+      float sumU[BATCH_SIZE], sumV[BATCH_SIZE];
+
+      _grid.getVelocities(x, y, u, v, count);
+      for (unsigned k = 0; k < count; ++k) {
+	sumU[k] = (2.0f / 9.0f) * u[k];
+	sumV[k] = (2.0f / 9.0f) * v[k];
+	stageX[k] = x[k] + 0.5f * dt * u[k];
+	stageY[k] = y[k] + 0.5f * dt * v[k];
+      }
+
+      _grid.getVelocities(stageX, stageY, u, v, count);
+      for (unsigned k = 0; k < count; ++k) {
+	sumU[k] += (3.0f / 9.0f) * u[k];
+	sumV[k] += (3.0f / 9.0f) * v[k];
+	stageX[k] = x[k] + 0.75f * dt * u[k];
+	stageY[k] = y[k] + 0.75f * dt * v[k];
+      }
+
+      _grid.getVelocities(stageX, stageY, u, v, count);
+      for (unsigned k = 0; k < count; ++k) {
+	x[k] += dt * (sumU[k] + (4.0f / 9.0f) * u[k]);
+	y[k] += dt * (sumV[k] + (4.0f / 9.0f) * v[k]);
+      }
+    }
+
+    const Grid &_grid;                      // The velocity field.
+    float *_x;                              // All particles' X coordinates.
+    float *_y;                              // All particles' Y coordinates.
+    float _timeStepSec;                     // The time to advect over.
+    ParticleSystem::Integrator _integrator; // The integration scheme.
+  };
+}
+
+
+ParticleSystem::ParticleSystem()
+  : _x(),
+    _y(),
+    _rangesCurrent(false),
+    _cellWidth(0),
+    _cellHeight(0),
+    _cellOrder(ROW_MAJOR),
+    _cellSlot(),
+    _slotStart(),
+    _sortKeys(),
+    _sortedX(),
+    _sortedY()
+{}
+
+
+ParticleSystem::ParticleSystem(const ParticleSystem &particles)
+  : _x(particles._x),
+    _y(particles._y),
+    _rangesCurrent(particles._rangesCurrent),
+    _cellWidth(particles._cellWidth),
+    _cellHeight(particles._cellHeight),
+    _cellOrder(particles._cellOrder),
+    _cellSlot(particles._cellSlot),
+    _slotStart(particles._slotStart),
+    _sortKeys(),
+    _sortedX(),
+    _sortedY()
+{}
+
+
+ParticleSystem & ParticleSystem::operator=(const ParticleSystem &particles)
+{
+  if (this != &particles) {
+    _x = particles._x;
+    _y = particles._y;
+    _rangesCurrent = particles._rangesCurrent;
+    _cellWidth = particles._cellWidth;
+    _cellHeight = particles._cellHeight;
+    _cellOrder = particles._cellOrder;
+    _cellSlot = particles._cellSlot;
+    _slotStart = particles._slotStart;
+  }
+  return *this;
+}
+
+
+unsigned ParticleSystem::size() const
+{
+  return _x.size();
+}
+
+
+void ParticleSystem::clear()
+{
+  _x.clear();
+  _y.clear();
+  _rangesCurrent = false;
+}
+
+
+void ParticleSystem::reserve(unsigned count)
+{
+  _x.reserve(count);
+  _y.reserve(count);
+}
+
+
+void ParticleSystem::resize(unsigned count)
+{
+  _x.resize(count);
+  _y.resize(count);
+  _rangesCurrent = false;
+}
+
+
+void ParticleSystem::add(float x, float y)
+{
+  _x.push_back(x);
+  _y.push_back(y);
+  _rangesCurrent = false;
+}
+
+
+void ParticleSystem::assign(const float *x, const float *y, unsigned count)
+{
+  _x.assign(x, x + count);
+  _y.assign(y, y + count);
+  _rangesCurrent = false;
+}
+
+
+Vector2 ParticleSystem::getPosition(unsigned i) const
+{
+  return Vector2(_x[i], _y[i]);
+}
+
+
+void ParticleSystem::advect(const Grid &grid, float timeStepSec,
+			    Integrator integrator, ThreadPool &threadPool)
+{
+  _rangesCurrent = false;
+  if (_x.empty())
+    return;
+  threadPool.parallelFor(0, size(), AdvectionTask(grid, &_x[0], &_y[0],
+						  timeStepSec, integrator),
+			 MIN_BLOCK_SIZE);
+}
+
+
+void ParticleSystem::sortByCell(unsigned width, unsigned height,
+				CellOrder order)
+{
+  if (width != _cellWidth || height != _cellHeight || order != _cellOrder ||
+      _cellSlot.empty())
+    buildCellSlots(width, height, order);
+
+  // Count the particles per slot.  Counts are stored one slot ahead, so that
+  // the prefix sum below leaves the first particle of each slot in place.
+  const unsigned count = size();
+  const unsigned outside = width * height;
+  const float maxX = width;
+  const float maxY = height;
+  _sortKeys.resize(count);
+  _slotStart.assign(outside + 2, 0);
+  for (unsigned k = 0; k < count; ++k) {
+    const float x = _x[k];
+    const float y = _y[k];
+    unsigned slot = outside;
+    if (x >= 0.0f && x < maxX && y >= 0.0f && y < maxY)
+      slot = _cellSlot[unsigned(y) * width + unsigned(x)];
+    _sortKeys[k] = slot;
+    ++_slotStart[slot + 1];
+  }
+  for (unsigned s = 1; s < _slotStart.size(); ++s)
+    _slotStart[s] += _slotStart[s - 1];
+
+  // Scatter each particle to the next free place in its slot.  This advances
+  // every slot's start to the next slot's start, so shift them back after.
+  _sortedX.resize(count);
+  _sortedY.resize(count);
+  for (unsigned k = 0; k < count; ++k) {
+    const unsigned to = _slotStart[_sortKeys[k]]++;
+    _sortedX[to] = _x[k];
+    _sortedY[to] = _y[k];
+  }
+  std::copy_backward(_slotStart.begin(), _slotStart.end() - 1,
+		     _slotStart.end());
+  _slotStart[0] = 0;
+
+  _x.swap(_sortedX);
+  _y.swap(_sortedY);
+  _rangesCurrent = true;
+}
+
+
+bool ParticleSystem::hasCellRanges() const
+{
+  return _rangesCurrent;
+}
+
+
+void ParticleSystem::buildCellSlots(unsigned width, unsigned height,
+				    CellOrder order)
+{
+  _cellWidth = width;
+  _cellHeight = height;
+  _cellOrder = order;
+  _cellSlot.resize(width * height);
+
+  if (order == MORTON) {
+    // Rank the cells by their position along the curve.  This only runs
+    // when the domain or order changes.
+    std::vector< std::pair<unsigned, unsigned> > codes(width * height);
+    for (unsigned y = 0; y < height; ++y)
+      for (unsigned x = 0; x < width; ++x)
+	codes[y * width + x] = std::make_pair(mortonCode(x, y), y * width + x);
+    std::sort(codes.begin(), codes.end());
+    for (unsigned slot = 0; slot < codes.size(); ++slot)
+      _cellSlot[codes[slot].second] = slot;
+  }
+  else {
+    for (unsigned cell = 0; cell < _cellSlot.size(); ++cell)
+      _cellSlot[cell] = cell;
+  }
+}
@@ -0,0 +1,255 @@
+#ifndef __PARTICLE_SYSTEM_H__
+#define __PARTICLE_SYSTEM_H__
+
+#include <vector>
+#include "Grid.h"
+#include "ThreadPool.h"
+#include "Vector2.h"
+
+
+// The marker particles that track where the fluid is.  Positions are kept as
+// a structure of arrays, one contiguous array of X coordinates and one of Y
+// coordinates, so they can be handed straight to Grid's batch velocity
+// sampling and streamed through by vectorized loops.
+//
+// advect() moves every particle through a Grid's velocity field with the
+// selected explicit integrator.  Particles are independent, so blocks of them
+// are advected in parallel on a ThreadPool; results do not depend on the
+// number of threads.
+//
+// Particles are created in no useful order, and flow scatters them further,
+// so neighbouring particles end up sampling distant grid cells.
+// sortByCell() reorders them with a stable counting sort so that particles
+// sharing a cell are contiguous, and records the range of particles in each
+// cell.  Until the particles next move, getCellRange() answers "which
+// particles are in this cell" without a search.
+class ParticleSystem
+{
+public:
+  // Time integration schemes for advect().
+  enum Integrator {
+    FORWARD_EULER = 0, // First order; one velocity sample per particle.
+    RK2,               // Midpoint method; two samples per particle.
+    RK3,               // Ralston's third order method; three samples.
+    INTEGRATOR_COUNT
+  };
+
+  // Orders in which sortByCell() visits the cells.
+  enum CellOrder {
+    ROW_MAJOR = 0, // Row by row, bottom to top.
+    MORTON,        // Along a Z-order curve, keeping 2D neighbours closer.
+    CELL_ORDER_COUNT
+  };
+
+  // Constructs an empty particle system.
+  //
+  // Arguments:
+  //   None
+  ParticleSystem();
+
+  // Copy constructs a particle system.  Positions and the cell range table
+  // are copied; scratch space used for sorting is not.
+  //
+  // Arguments:
+  //   ParticleSystem &particles - The particles to duplicate.
+  ParticleSystem(const ParticleSystem &particles);
+
+  // Assignment operator, copying as the copy constructor does.  Existing
+  // storage is reused where it is large enough.
+  //
+  // Arguments:
+  //   ParticleSystem &particles - The particles to assign.
+  // Returns:
+  //   ParticleSystem & - A reference to this ParticleSystem.
+  ParticleSystem & operator=(const ParticleSystem &particles);
+
+  // Returns the number of particles.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of particles.
+  unsigned size() const;
+
+  // Removes all particles.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void clear();
+
+  // Reserves storage for a number of particles.
+  //
+  // Arguments:
+  //   unsigned count - The number of particles to make room for.
+  //
+  // Returns:
+  //   None
+  void reserve(unsigned count);
+
+  // Changes the number of particles.  Particles past the old size are left
+  // at the origin, to be placed through xData() and yData().
+  //
+  // Arguments:
+  //   unsigned count - The new number of particles.
+  //
+  // Returns:
+  //   None
+  void resize(unsigned count);
+
+  // Adds a particle.
+  //
+  // Arguments:
+  //   float x - The particle's X position, in world coordinates.
+  //   float y - The particle's Y position, in world coordinates.
+  //
+  // Returns:
+  //   None
+  void add(float x, float y);
+
+  // Replaces all particles with copies of the given coordinates.
+  //
+  // Arguments:
+  //   float *x - The particles' X positions, in world coordinates.
+  //   float *y - The particles' Y positions, in world coordinates.
+  //   unsigned count - The number of particles.
+  //
+  // Returns:
+  //   None
+  void assign(const float *x, const float *y, unsigned count);
+
+  // Returns the position of a particle.
+  //
+  // Arguments:
+  //   unsigned i - The index of the particle.
+  //
+  // Returns:
+  //   Vector2 - The particle's position.
+  Vector2 getPosition(unsigned i) const;
+
+  // Returns the particles' X or Y coordinates, one entry per particle.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float * - The coordinate array.
+  inline float * xData();
+  inline const float * xData() const;
+  inline float * yData();
+  inline const float * yData() const;
+
+  // Moves every particle through a velocity field.
+  //
+  // Arguments:
+  //   Grid &grid - The grid holding the velocity field.
+  //   float timeStepSec - The amount of time to move the particles for.
+  //   Integrator integrator - The time integration scheme.
+  //   ThreadPool &threadPool - The threads that share the work.
+  //
+  // Returns:
+  //   None
+  void advect(const Grid &grid, float timeStepSec, Integrator integrator,
+	      ThreadPool &threadPool);
+
+  // Reorders the particles so that those in the same unit cell of a
+  // width x height domain are contiguous, with cells visited in the given
+  // order, and builds the cell-to-particle range table.  Particles outside
+  // the domain are moved to the end.  The sort is stable.
+  //
+  // Arguments:
+  //   unsigned width - The domain width, in cells.
+  //   unsigned height - The domain height, in cells.
+  //   CellOrder order - The order in which cells are laid out.
+  //
+  // Returns:
+  //   None
+  void sortByCell(unsigned width, unsigned height,
+		  CellOrder order = ROW_MAJOR);
+
+  // Returns true if the cell range table matches the particles, that is,
+  // if no particle has been added, removed or moved since sortByCell().
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   bool - True if getCellRange() may be used.
+  bool hasCellRanges() const;
+
+  // Returns the particles inside a cell, as of the last sortByCell().  Only
+  // valid while hasCellRanges() is true.
+  //
+  // Arguments:
+  //   unsigned x - The cell's column, less than the sorted width.
+  //   unsigned y - The cell's row, less than the sorted height.
+  //   unsigned &begin - Receives the index of the cell's first particle.
+  //   unsigned &end - Receives one past the index of its last particle.
+  //
+  // Returns:
+  //   None
+  inline void getCellRange(unsigned x, unsigned y, unsigned &begin,
+			   unsigned &end) const;
+
+private:
+  // Rebuilds _cellSlot for a domain size and cell order.
+  void buildCellSlots(unsigned width, unsigned height, CellOrder order);
+
+  std::vector<float> _x; // X coordinate of each particle.
+  std::vector<float> _y; // Y coordinate of each particle.
+
+  // Cell range table.  Cells are numbered row-major; _cellSlot maps each to
+  // its position in the sort order, and the particles of the cell in slot s
+  // are [_slotStart[s], _slotStart[s + 1]).  The slot after the last cell
+  // holds the particles outside the domain.
+  bool _rangesCurrent;               // True if the table matches _x and _y.
+  unsigned _cellWidth;               // Domain width of the table.
+  unsigned _cellHeight;              // Domain height of the table.
+  CellOrder _cellOrder;              // Cell order of the table.
+  std::vector<unsigned> _cellSlot;   // Sort position of each cell.
+  std::vector<unsigned> _slotStart;  // First particle of each slot.
+  std::vector<unsigned> _sortKeys;   // Scratch: slot of each particle.
+  std::vector<float> _sortedX;       // Scratch: reordered X coordinates.
+  std::vector<float> _sortedY;       // Scratch: reordered Y coordinates.
+};
+
+
+float * ParticleSystem::xData()
+{
+  // Writable access may move particles.
+  _rangesCurrent = false;
+  return _x.empty() ? NULL : &_x[0];
+}
+
+
+const float * ParticleSystem::xData() const
+{
+  return _x.empty() ? NULL : &_x[0];
+}
+
+
+float * ParticleSystem::yData()
+{
+  _rangesCurrent = false;
+  return _y.empty() ? NULL : &_y[0];
+}
+
+
+const float * ParticleSystem::yData() const
+{
+  return _y.empty() ? NULL : &_y[0];
+}
+
+
+void ParticleSystem::getCellRange(unsigned x, unsigned y, unsigned &begin,
+				  unsigned &end) const
+{
+  const unsigned slot = _cellSlot[y * _cellWidth + x];
+  begin = _slotStart[slot];
+  end   = _slotStart[slot + 1];
+}
+
+#endif // __PARTICLE_SYSTEM_H__
@@ -0,0 +1,103 @@
+#include "PressureOperator.h"
+#include "Cell.h"
+
+
+PressureOperator::InnerIterator::InnerIterator(const PressureOperator &op,
+					       Eigen::Index row)
+  : _row(row),
+    _count(0),
+    _entry(0)
+{
+  const unsigned x = row % op._width;
+  const unsigned y = row / op._width;
+  const int c = y * op._stride + x;
+  const unsigned char *types = op._types;
+
+  // Non-FLUID cells have identity rows.
+  if (types[c] != Cell::FLUID) {
+    _cols[0] = row;
+    _values[0] = 1.0;
+    _count = 1;
+    return;
+  }
+
+  // Generate the off-diagonal entries in column order (-Y, -X, +X, +Y),
+  // leaving a slot for the diagonal between -X and +X.
+  const int offsets[4] = { -op._stride, -1, 1, op._stride };           // grid
+  const Eigen::Index neighbors[4] = { -Eigen::Index(op._width), -1, 1,
+				      Eigen::Index(op._width) };        // A
+  double diag = 0.0;
+  unsigned diagEntry = 0;
+  for (unsigned n = 0; n < 4; ++n) {
+    if (n == 2)
+      diagEntry = _count++;
+    const unsigned char type = types[c + offsets[n]];
+    if (type == Cell::SOLID)
+      continue;
+    diag += op._scale;
+    if (type == Cell::FLUID) {
+      _cols[_count] = row + neighbors[n];
+      _values[_count] = -op._scale;
+      ++_count;
+    }
+  }
+  _cols[diagEntry] = row;
+  _values[diagEntry] = diag;
+}
+
+
+PressureOperator::PressureOperator()
+  : _types(NULL),
+    _stride(0),
+    _width(0),
+    _height(0),
+    _scale(0.0)
+{}
+
+
+void PressureOperator::setup(const Grid &grid, double scale)
+{
+  _types  = grid.cellTypeData() + grid.index(0, 0);
+  _stride = grid.getStride();
+  _width  = grid.getColCount() - 1;
+  _height = grid.getRowCount() - 1;
+  _scale  = scale;
+}
+
+
+void PressureOperator::apply(const double *x, double *y, double alpha) const
+{
+  const double a = alpha * _scale;
+  const int stride = _stride;
+  const int width = _width;
+
+  for (unsigned j = 0; j < _height; ++j) {
+    const unsigned char *types = _types + j * stride;
+    const double *xRow = x + j * width;
+    double *yRow = y + j * width;
+    for (int i = 0; i < width; ++i) {
+      if (types[i] != Cell::FLUID) {
+	yRow[i] += alpha * xRow[i];
+	continue;
+      }
+
+      // Every non-SOLID neighbor adds to the diagonal; only FLUID neighbors
+      // are unknowns (AIR holds p = 0).  Ghost cells are SOLID, so FLUID
+      // neighbors always lie inside the vector.
+      double diag = 0.0, sum = 0.0;
+      const unsigned char left  = types[i - 1];
+      const unsigned char right = types[i + 1];
+      const unsigned char down  = types[i - stride];
+      const unsigned char up    = types[i + stride];
+      diag += (left  != Cell::SOLID);
+      diag += (right != Cell::SOLID);
+      diag += (down  != Cell::SOLID);
+      diag += (up    != Cell::SOLID);
+      if (left  == Cell::FLUID) sum += xRow[i - 1];
+      if (right == Cell::FLUID) sum += xRow[i + 1];
+      if (down  == Cell::FLUID) sum += xRow[i - width];
+      if (up    == Cell::FLUID) sum += xRow[i + width];
+      yRow[i] += a * (diag * xRow[i] - sum);
+    }
+  }
+}
@@ -0,0 +1,148 @@
+#ifndef __PRESSURE_OPERATOR_H__
+#define __PRESSURE_OPERATOR_H__
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/SparseCore>
+#include "Grid.h"
+
+class PressureOperator;
+
+namespace Eigen {
+namespace internal {
+  // PressureOperator behaves like a sparse matrix of doubles as far as
+  // Eigen's expression templates are concerned.
+  template<>
+  struct traits<PressureOperator>
+    : public traits< SparseMatrix<double> >
+  {};
+}
+}
+
+
+// A matrix-free form of the pressure matrix A, applying the 5-point
+// Laplacian stencil directly from a Grid's cell types.  Unknowns are ordered
+// row-major over the simulation's cells: entry y * width + x holds cell
+// (x, y).  Each FLUID cell couples to its non-SOLID neighbors, with AIR
+// neighbors contributing only to the diagonal (p = 0 in AIR).  AIR and SOLID
+// cells have identity rows, which pins their pressure to 0 and keeps A
+// symmetric positive definite.
+//
+// The operator plugs into Eigen's iterative solvers through the matrix-free
+// wrapper interface:
+//
+//   ConjugateGradient<PressureOperator, Lower|Upper, Preconditioner> cg;
+//   PressureOperator A;
+//   A.setup(grid, scale);
+//   cg.compute(A);
+//
+// Preconditioners that need the coefficients of A (DiagonalPreconditioner,
+// MICPreconditioner) read them through InnerIterator, which generates each
+// row's entries from the stencil on the fly.  The grid must outlive any use
+// of the operator and its cell types must not change in between.
+class PressureOperator : public Eigen::EigenBase<PressureOperator>
+{
+public:
+  typedef double Scalar;
+  typedef double RealScalar;
+  typedef int StorageIndex;
+  enum {
+    ColsAtCompileTime = Eigen::Dynamic,
+    MaxColsAtCompileTime = Eigen::Dynamic,
+    IsRowMajor = true
+  };
+
+  // Iterates over the nonzero entries of one row of A, in column order.
+  class InnerIterator
+  {
+  public:
+    InnerIterator(const PressureOperator &op, Eigen::Index row);
+
+    operator bool() const { return _entry < _count; }
+    InnerIterator& operator++() { ++_entry; return *this; }
+
+    Scalar value() const { return _values[_entry]; }
+    Eigen::Index index() const { return _cols[_entry]; }
+    Eigen::Index row() const { return _row; }
+    Eigen::Index col() const { return _cols[_entry]; }
+
+  private:
+    Eigen::Index _row;       // The row being iterated.
+    unsigned _count;         // Number of nonzeros in the row.
+    unsigned _entry;         // Current nonzero.
+    Eigen::Index _cols[5];   // Column of each nonzero.
+    Scalar _values[5];       // Value of each nonzero.
+  };
+
+  // Constructs an empty operator.  setup() must be called before use.
+  //
+  // Arguments:
+  //   None
+  PressureOperator();
+
+  // Binds the operator to a grid's cell types.
+  //
+  // Arguments:
+  //   Grid &grid - The grid whose cell types define the stencil.
+  //   double scale - The coefficient of the stencil, e.g. the timestep.
+  //
+  // Returns:
+  //   None
+  void setup(const Grid &grid, double scale);
+
+  Eigen::Index rows() const { return _width * _height; }
+  Eigen::Index cols() const { return _width * _height; }
+  Eigen::Index outerSize() const { return _width * _height; }
+
+  // Computes y += alpha * A x.
+  //
+  // Arguments:
+  //   double *x - The vector to multiply, one entry per cell.
+  //   double *y - The vector to accumulate into, one entry per cell.
+  //   double alpha - The factor applied to A x.
+  //
+  // Returns:
+  //   None
+  void apply(const double *x, double *y, double alpha) const;
+
+  // Returns an expression for A x, evaluated by apply().
+  template<typename Rhs>
+  Eigen::Product<PressureOperator, Rhs, Eigen::AliasFreeProduct>
+  operator*(const Eigen::MatrixBase<Rhs> &x) const
+  {
+    return Eigen::Product<PressureOperator, Rhs, Eigen::AliasFreeProduct>
+      (*this, x.derived());
+  }
+
+private:
+  const unsigned char *_types; // The grid's cell types, from cell (0, 0).
+  int _stride;                 // Row stride of the padded cell types.
+  unsigned _width;             // Number of cells along X.
+  unsigned _height;            // Number of cells along Y.
+  double _scale;               // Coefficient of the stencil.
+};
+
+
+namespace Eigen {
+namespace internal {
+  // Evaluates PressureOperator * vector products with PressureOperator::apply.
+  template<typename Rhs>
+  struct generic_product_impl<PressureOperator, Rhs,
+			      SparseShape, DenseShape, GemvProduct>
+    : generic_product_impl_base<PressureOperator, Rhs,
+				generic_product_impl<PressureOperator, Rhs> >
+  {
+    typedef typename Product<PressureOperator, Rhs>::Scalar Scalar;
+
+    template<typename Dest>
+    static void scaleAndAddTo(Dest &dst, const PressureOperator &lhs,
+			      const Rhs &rhs, const Scalar &alpha)
+    {
+      // Plain vectors are used in place; other expressions are evaluated.
+      typename nested_eval<Rhs, 1>::type x(rhs);
+      lhs.apply(x.data(), dst.data(), alpha);
+    }
+  };
+}
+}
+
+#endif // __PRESSURE_OPERATOR_H__
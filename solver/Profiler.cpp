@@ -0,0 +1,197 @@
+#include "Profiler.h"
+#include <QElapsedTimer>
+#include <cstring>
+#include <ostream>
+
+
+Profiler::ScopedStage::ScopedStage(Profiler &profiler, Stage stage)
+  : _profiler(profiler),
+    _stage(stage),
+    _startUsec(profiler.now()),
+    _iterations(0),
+    _particles(0)
+{}
+
+
+Profiler::ScopedStage::~ScopedStage()
+{
+  _profiler.recordStage(_stage, _startUsec, _profiler.now(),
+			_iterations, _particles);
+}
+
+
+Profiler::Profiler(unsigned eventCapacity)
+  : _clock(new QElapsedTimer()),
+    _eventCapacity(eventCapacity)
+{
+  _clock->start();
+  clear();
+}
+
+
+Profiler::~Profiler()
+{
+  delete _clock;
+}
+
+
+const char *Profiler::getStageName(Stage stage)
+{
+  static const char *names[STAGE_COUNT] = {
+    "advect", "gravity", "collide", "pressure", "moveParticles",
+    "sortParticles", "markCells"
+  };
+  return names[stage];
+}
+
+
+double Profiler::now() const
+{
+  return _clock->nsecsElapsed() * 1.0e-3;
+}
+
+
+void Profiler::recordStage(Stage stage, double startUsec, double endUsec,
+			   unsigned iterations, unsigned particles)
+{
+  const double seconds = (endUsec - startUsec) * 1.0e-6;
+  StageStats *stats[2] = { &_totals[stage], &_currentFrame.stages[stage] };
+  for (unsigned i = 0; i < 2; ++i) {
+    ++stats[i]->calls;
+    stats[i]->seconds += seconds;
+    stats[i]->iterations += iterations;
+    stats[i]->particles += particles;
+  }
+
+  Event event;
+  event.stage = stage;
+  event.startUsec = startUsec;
+  event.durationUsec = endUsec - startUsec;
+  event.frame = _frameCount;
+  event.iterations = iterations;
+  event.particles = particles;
+  addEvent(event);
+}
+
+
+void Profiler::beginFrame()
+{
+  memset(&_currentFrame, 0, sizeof(_currentFrame));
+  _currentFrame.frame = _frameCount;
+  _frameStartUsec = now();
+}
+
+
+void Profiler::endFrame()
+{
+  const double endUsec = now();
+  _currentFrame.seconds = (endUsec - _frameStartUsec) * 1.0e-6;
+  _lastFrame = _currentFrame;
+
+  Event event;
+  event.stage = -1;
+  event.startUsec = _frameStartUsec;
+  event.durationUsec = endUsec - _frameStartUsec;
+  event.frame = _frameCount;
+  event.iterations = 0;
+  event.particles = 0;
+  addEvent(event);
+
+  ++_frameCount;
+}
+
+
+const Profiler::StageStats &Profiler::getStageStats(Stage stage) const
+{
+  return _totals[stage];
+}
+
+
+const Profiler::FrameStats &Profiler::getLastFrameStats() const
+{
+  return _lastFrame;
+}
+
+
+unsigned long Profiler::getFrameCount() const
+{
+  return _frameCount;
+}
+
+
+unsigned Profiler::getEventCount() const
+{
+  return _events.size();
+}
+
+
+unsigned long Profiler::getDroppedEventCount() const
+{
+  return _droppedEvents;
+}
+
+
+void Profiler::clear()
+{
+  _events.clear();
+  _droppedEvents = 0;
+  memset(_totals, 0, sizeof(_totals));
+  memset(&_currentFrame, 0, sizeof(_currentFrame));
+  memset(&_lastFrame, 0, sizeof(_lastFrame));
+  _frameStartUsec = now();
+  _frameCount = 0;
+}
+
+
+void Profiler::writeChromeTrace(std::ostream &out) const
+{
+  const std::streamsize precision = out.precision(3);
+  const std::ios_base::fmtflags flags =
+    out.setf(std::ios_base::fixed, std::ios_base::floatfield);
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  for (unsigned i = 0; i < _events.size(); ++i) {
+    const Event &e = _events[i];
+    out << (i ? ",\n" : "") << "{\"name\":\"";
+    if (e.stage < 0)
+      out << "frame\",\"cat\":\"frame\"";
+    else
+      out << getStageName(Stage(e.stage)) << "\",\"cat\":\"stage\"";
+    out << ",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+	<< ",\"ts\":" << e.startUsec
+	<< ",\"dur\":" << e.durationUsec
+	<< ",\"args\":{\"frame\":" << e.frame;
+    if (e.stage >= 0)
+      out << ",\"iterations\":" << e.iterations
+	  << ",\"particles\":" << e.particles;
+    out << "}}";
+  }
+  out << "\n]}\n";
+
+  out.precision(precision);
+  out.flags(flags);
+}
+
+
+void Profiler::dump(std::ostream &out) const
+{
+  for (unsigned s = 0; s < STAGE_COUNT; ++s) {
+    const StageStats &stats = _totals[s];
+    out << getStageName(Stage(s))
+	<< " calls " << stats.calls
+	<< " ms " << stats.seconds * 1.0e3
+	<< " mean_ms " << (stats.calls ? stats.seconds * 1.0e3 / stats.calls
+			   : 0.0)
+	<< " iterations " << stats.iterations
+	<< " particles " << stats.particles << '\n';
+  }
+}
+
+
+void Profiler::addEvent(const Event &event)
+{
+  if (_events.size() < _eventCapacity)
+    _events.push_back(event);
+  else
+    ++_droppedEvents;
+}
@@ -0,0 +1,254 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <iosfwd>
+#include <vector>
+
+class QElapsedTimer;
+
+
+// Per-stage timing instrumentation for the fluid solver.  Each stage of a
+// substep is wrapped in a ScopedStage, and each frame in a ScopedFrame; on
+// scope exit they record their wall time here, along with the pressure
+// iterations and particle counts they report.  The profiler keeps running
+// totals per stage, the totals of the most recent frame, and a bounded list
+// of timed events that can be exported in Chrome's trace event format (load
+// the file in chrome://tracing or https://ui.perfetto.dev).
+//
+// The solver only instruments itself when built with FLUID_PROFILING
+// defined (qmake CONFIG+=profiling).  Otherwise the PROFILE_* macros below
+// expand to nothing, so disabled builds contain no timing code at all.
+class Profiler
+{
+public:
+  // The instrumented stages of a substep, in execution order.
+  enum Stage {
+    STAGE_ADVECT = 0,      // Velocity advection.
+    STAGE_GRAVITY,         // Body forces.
+    STAGE_COLLIDE,         // Boundary enforcement (twice per substep).
+    STAGE_PRESSURE,        // Pressure solve and projection.
+    STAGE_MOVE_PARTICLES,  // Particle advection.
+    STAGE_SORT_PARTICLES,  // Reordering particles by cell.
+    STAGE_MARK_CELLS,      // FLUID/AIR classification from particles.
+    STAGE_COUNT
+  };
+
+  // Accumulated measurements of one stage.
+  struct StageStats {
+    unsigned long calls;      // Number of times the stage ran.
+    double        seconds;    // Total wall time spent in the stage.
+    unsigned long iterations; // Total solver iterations reported.
+    unsigned long particles;  // Total particles processed.
+  };
+
+  // Measurements of a single frame.
+  struct FrameStats {
+    unsigned long frame;              // Frame number since the last clear.
+    double        seconds;            // Wall time of the whole frame.
+    StageStats    stages[STAGE_COUNT]; // Per-stage totals within the frame.
+  };
+
+  // Times a stage from construction to destruction.
+  class ScopedStage
+  {
+  public:
+    ScopedStage(Profiler &profiler, Stage stage);
+    ~ScopedStage();
+
+    // Reports the solver iterations performed by this stage.
+    void setIterations(unsigned iterations) { _iterations = iterations; }
+
+    // Reports the number of particles processed by this stage.
+    void setParticles(unsigned particles) { _particles = particles; }
+
+  private:
+    Profiler &_profiler;  // Where the measurement is recorded.
+    Stage _stage;         // The stage being timed.
+    double _startUsec;    // Start time, in microseconds.
+    unsigned _iterations; // Reported solver iterations.
+    unsigned _particles;  // Reported particle count.
+  };
+
+  // Delimits a frame from construction to destruction.
+  class ScopedFrame
+  {
+  public:
+    ScopedFrame(Profiler &profiler) : _profiler(profiler)
+    { _profiler.beginFrame(); }
+    ~ScopedFrame() { _profiler.endFrame(); }
+
+  private:
+    Profiler &_profiler; // Where the frame is recorded.
+  };
+
+  // Constructs an empty profiler.
+  //
+  // Arguments:
+  //   unsigned eventCapacity - The maximum number of events kept for the
+  //                            trace.  Later events are counted but dropped;
+  //                            the running totals are always updated.
+  Profiler(unsigned eventCapacity = 262144);
+
+  // Destructor
+  //
+  // Arguments:
+  //   None
+  ~Profiler();
+
+  // Returns the name of a stage, as used in traces and summaries.
+  //
+  // Arguments:
+  //   Stage stage - The stage.
+  //
+  // Returns:
+  //   char * - The stage's name.
+  static const char *getStageName(Stage stage);
+
+  // Returns the current time, measured from the profiler's construction.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   double - The current time, in microseconds.
+  double now() const;
+
+  // Records one run of a stage.  Normally called by ScopedStage.
+  //
+  // Arguments:
+  //   Stage stage - The stage that ran.
+  //   double startUsec - When it started, as returned by now().
+  //   double endUsec - When it ended, as returned by now().
+  //   unsigned iterations - The solver iterations it performed.
+  //   unsigned particles - The number of particles it processed.
+  //
+  // Returns:
+  //   None
+  void recordStage(Stage stage, double startUsec, double endUsec,
+		   unsigned iterations, unsigned particles);
+
+  // Marks the start and end of a frame.  Normally called by ScopedFrame.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void beginFrame();
+  void endFrame();
+
+  // Returns the totals of a stage since the last clear.
+  //
+  // Arguments:
+  //   Stage stage - The stage.
+  //
+  // Returns:
+  //   StageStats & - The stage's totals.
+  const StageStats &getStageStats(Stage stage) const;
+
+  // Returns the measurements of the most recently completed frame.  Only
+  // meaningful once getFrameCount() is nonzero.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   FrameStats & - The latest frame's measurements.
+  const FrameStats &getLastFrameStats() const;
+
+  // Returns the number of frames completed since the last clear.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned long - The number of completed frames.
+  unsigned long getFrameCount() const;
+
+  // Returns the number of events held for the trace, and the number that
+  // did not fit.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   The number of held or dropped events.
+  unsigned getEventCount() const;
+  unsigned long getDroppedEventCount() const;
+
+  // Discards all measurements and events.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void clear();
+
+  // Writes all held events as a Chrome trace event JSON document.  Stages
+  // and frames become complete ("X") events; each stage event carries its
+  // frame number, iterations and particle count as arguments.
+  //
+  // Arguments:
+  //   std::ostream &out - The stream to write to.
+  //
+  // Returns:
+  //   None
+  void writeChromeTrace(std::ostream &out) const;
+
+  // Writes a per-stage summary of the totals, one line per stage.
+  //
+  // Arguments:
+  //   std::ostream &out - The stream to write to.
+  //
+  // Returns:
+  //   None
+  void dump(std::ostream &out) const;
+
+private:
+  // A timed event kept for the trace.
+  struct Event {
+    int           stage;      // The Stage, or -1 for a whole frame.
+    double        startUsec;  // Start time, in microseconds.
+    double        durationUsec; // Duration, in microseconds.
+    unsigned long frame;      // Frame the event belongs to.
+    unsigned      iterations; // Reported solver iterations.
+    unsigned      particles;  // Reported particle count.
+  };
+
+  // Not copyable.
+  Profiler(const Profiler &);
+  Profiler &operator=(const Profiler &);
+
+  // Appends an event, or counts it as dropped if the list is full.
+  void addEvent(const Event &event);
+
+  QElapsedTimer *_clock;               // Time origin of all measurements.
+  unsigned _eventCapacity;             // Maximum number of held events.
+  std::vector<Event> _events;          // Events for the trace.
+  unsigned long _droppedEvents;        // Events that did not fit.
+  StageStats _totals[STAGE_COUNT];     // Totals since the last clear.
+  FrameStats _currentFrame;            // The frame being measured.
+  FrameStats _lastFrame;               // The latest completed frame.
+  double _frameStartUsec;              // Start time of the current frame.
+  unsigned long _frameCount;           // Completed frames.
+};
+
+
+// Instrumentation hooks used inside the solver.  With FLUID_PROFILING
+// undefined they expand to nothing and their arguments are not evaluated.
+#ifdef FLUID_PROFILING
+#define PROFILE_FRAME(profiler) \
+  Profiler::ScopedFrame profiledFrame_(profiler)
+#define PROFILE_STAGE(name, profiler, stage) \
+  Profiler::ScopedStage name(profiler, stage)
+#define PROFILE_ITERATIONS(name, iterations) name.setIterations(iterations)
+#define PROFILE_PARTICLES(name, particles) name.setParticles(particles)
+#else
+#define PROFILE_FRAME(profiler)
+#define PROFILE_STAGE(name, profiler, stage)
+#define PROFILE_ITERATIONS(name, iterations)
+#define PROFILE_PARTICLES(name, particles)
+#endif
+
+#endif // __PROFILER_H__
@@ -0,0 +1,291 @@
+#include "Scenario.h"
+#include "FrameLayout.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+
+namespace {
+  // Names of the pressure solvers, in FluidSolver::PressureSolverType order.
+  const unsigned SOLVER_COUNT = 4;
+  const char *const SOLVER_NAMES[SOLVER_COUNT] = {
+    "diagonal", "mic", "multigrid", "mgpcg"
+  };
+
+  // Default pressure solver, FluidSolver::MIC_PCG_SOLVER.
+  const unsigned DEFAULT_SOLVER = 1;
+
+  // Largest simulation side, in cells, keeping padded cell indices within
+  // 32 bits.  The whole domain is further limited to the cells a checkpoint
+  // can hold, FrameLayout::MAX_CELLS.
+  const unsigned MAX_SIZE = 32768;
+
+  // Largest number of particles per cell side.
+  const unsigned MAX_PARTICLES_PER_SIDE = 16;
+
+  // Clamps a cell coordinate to [0, limit].
+  unsigned clampCell(double value, unsigned limit)
+  {
+    if (!(value > 0.0))
+      return 0;
+    return value >= limit ? limit : unsigned(value);
+  }
+}
+
+
+Scenario::Scenario(unsigned width, unsigned height)
+  : _width(width),
+    _height(height),
+    _frameRate(30.0f),
+    _cflNumber(2.0f),
+    _gravity(0.0f, -9.8f),
+    _pressureSolver(DEFAULT_SOLVER),
+    _particlesPerSide(4),
+    _regions(),
+    _error()
+{}
+
+
+Scenario Scenario::makeDefault(unsigned width, unsigned height)
+{
+  Scenario scenario(width, height);
+  Region fluid;
+  fluid.type = Cell::FLUID;
+  fluid.shape = BOX;
+  fluid.x0 = width / 2;
+  fluid.y0 = height / 2;
+  fluid.x1 = width;
+  fluid.y1 = height;
+  scenario.addRegion(fluid);
+  return scenario;
+}
+
+
+bool Scenario::load(const std::string &path)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    _error = "unable to open " + path;
+    return false;
+  }
+  std::string text;
+  char buffer[65536];
+  size_t bytes;
+  while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    text.append(buffer, bytes);
+  const bool ok = !ferror(file);
+  fclose(file);
+  if (!ok) {
+    _error = "unable to read " + path;
+    return false;
+  }
+  return parse(text);
+}
+
+
+bool Scenario::parse(const std::string &text)
+{
+  // Parse into a fresh scenario, so that this one is only replaced once the
+  // whole text has been accepted.
+  Scenario parsed(0, 0);
+  bool sizeFound = false;
+  std::istringstream lines(text);
+  std::string line;
+  for (unsigned number = 1; std::getline(lines, line); ++number) {
+    if (!parsed.parseLine(line, sizeFound)) {
+      char prefix[32];
+      snprintf(prefix, sizeof(prefix), "line %u: ", number);
+      _error = prefix + parsed._error;
+      return false;
+    }
+  }
+  if (!sizeFound) {
+    _error = "no size given";
+    return false;
+  }
+  // A domain full of fluid must also fit in a checkpoint.
+  const double particlesPerSide = parsed._particlesPerSide;
+  if (double(parsed._width) * parsed._height * particlesPerSide *
+      particlesPerSide > FrameLayout::MAX_PARTICLES) {
+    char error[96];
+    snprintf(error, sizeof(error), "too many particles for the size; at "
+	     "most %lu can be checkpointed", FrameLayout::MAX_PARTICLES);
+    _error = error;
+    return false;
+  }
+  *this = parsed;
+  return true;
+}
+
+
+bool Scenario::parseLine(const std::string &line, bool &sizeFound)
+{
+  std::istringstream fields(line.substr(0, line.find('#')));
+  std::string key;
+  if (!(fields >> key))
+    return true;
+
+  bool ok = true;
+  if (key == "size") {
+    ok = (fields >> _width >> _height) && _width > 0 && _height > 0 &&
+      _width <= MAX_SIZE && _height <= MAX_SIZE;
+    if (ok && double(_width) * _height > FrameLayout::MAX_CELLS) {
+      char error[96];
+      snprintf(error, sizeof(error), "size must be at most %lu cells, so "
+	       "that frames can be checkpointed", FrameLayout::MAX_CELLS);
+      _error = error;
+      return false;
+    }
+    sizeFound = ok;
+  }
+  else if (key == "frame_rate")
+    ok = (fields >> _frameRate) && _frameRate > 0.0f;
+  else if (key == "cfl")
+    ok = (fields >> _cflNumber) && _cflNumber > 0.0f;
+  else if (key == "gravity")
+    ok = !(fields >> _gravity.x >> _gravity.y).fail();
+  else if (key == "solver") {
+    std::string name;
+    ok = !(fields >> name).fail();
+    _pressureSolver = 0;
+    while (_pressureSolver < SOLVER_COUNT &&
+	   name != SOLVER_NAMES[_pressureSolver])
+      ++_pressureSolver;
+    if (ok && _pressureSolver == SOLVER_COUNT) {
+      _error = "unknown solver " + name;
+      return false;
+    }
+  }
+  else if (key == "particles_per_cell") {
+    unsigned count = 0;
+    ok = !(fields >> count).fail();
+    _particlesPerSide = unsigned(std::sqrt(double(count)) + 0.5);
+    if (ok && (count == 0 || _particlesPerSide > MAX_PARTICLES_PER_SIDE ||
+	       _particlesPerSide * _particlesPerSide != count)) {
+      _error = "particles_per_cell must be a square from 1 to 256";
+      return false;
+    }
+  }
+  else if (key == "fluid" || key == "solid" || key == "air") {
+    Region region;
+    region.type = key == "fluid" ? Cell::FLUID :
+      (key == "solid" ? Cell::SOLID : Cell::AIR);
+    std::string shape;
+    fields >> shape;
+    if (shape == "box") {
+      region.shape = BOX;
+      ok = !(fields >> region.x0 >> region.y0 >> region.x1 >>
+	     region.y1).fail();
+    }
+    else if (shape == "circle") {
+      region.shape = CIRCLE;
+      region.y1 = 0.0f;
+      ok = (fields >> region.x0 >> region.y0 >> region.x1) &&
+	region.x1 >= 0.0f;
+    }
+    else {
+      _error = "unknown shape " + shape;
+      return false;
+    }
+    if (ok)
+      _regions.push_back(region);
+  }
+  else {
+    _error = "unknown setting " + key;
+    return false;
+  }
+
+  std::string extra;
+  if (!ok || fields >> extra) {
+    _error = "invalid " + key;
+    return false;
+  }
+  return true;
+}
+
+
+const std::string &Scenario::getError() const
+{
+  return _error;
+}
+
+
+unsigned Scenario::getWidth() const
+{
+  return _width;
+}
+
+
+unsigned Scenario::getHeight() const
+{
+  return _height;
+}
+
+
+float Scenario::getFrameRate() const
+{
+  return _frameRate;
+}
+
+
+float Scenario::getCFLNumber() const
+{
+  return _cflNumber;
+}
+
+
+Vector2 Scenario::getGravity() const
+{
+  return _gravity;
+}
+
+
+unsigned Scenario::getPressureSolver() const
+{
+  return _pressureSolver;
+}
+
+
+unsigned Scenario::getParticlesPerSide() const
+{
+  return _particlesPerSide;
+}
+
+
+const std::vector<Scenario::Region> &Scenario::getRegions() const
+{
+  return _regions;
+}
+
+
+void Scenario::addRegion(const Region &region)
+{
+  _regions.push_back(region);
+}
+
+
+void Scenario::getRegionSpan(const Region &region, unsigned y,
+			     unsigned &begin, unsigned &end) const
+{
+  // Cells are covered when their centers are, so the span runs from the
+  // first center at or past the left edge to the last one before the right.
+  const double center = y + 0.5;
+  begin = end = 0;
+  if (region.shape == BOX) {
+    if (center < region.y0 || center >= region.y1)
+      return;
+    begin = clampCell(std::ceil(region.x0 - 0.5), _width);
+    end = clampCell(std::ceil(region.x1 - 0.5), _width);
+  }
+  else {
+    const double dy = center - region.y0;
+    const double r2 = double(region.x1) * region.x1 - dy * dy;
+    if (r2 < 0.0)
+      return;
+    const double half = std::sqrt(r2);
+    begin = clampCell(std::ceil(region.x0 - half - 0.5), _width);
+    end = clampCell(std::floor(region.x0 + half - 0.5) + 1.0, _width);
+  }
+  end = std::max(begin, end);
+}
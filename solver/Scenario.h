@@ -0,0 +1,219 @@
+#ifndef __SCENARIO_H__
+#define __SCENARIO_H__
+
+#include <string>
+#include <vector>
+#include "Cell.h"
+#include "Vector2.h"
+
+
+// A description of a simulation's starting state and settings, so that runs
+// can be set up and reproduced without recompiling.  Scenarios are read from
+// text files, one setting per line:
+//
+//   # A column of water falling past a post.
+//   size 256 128
+//   frame_rate 30
+//   cfl 2
+//   gravity 0 -9.8
+//   solver mic
+//   particles_per_cell 16
+//   fluid box 0 64 64 128
+//   solid circle 128 32 12
+//
+// Blank lines and anything after a '#' are ignored.  The settings are:
+//
+//   size W H                 - Simulation size in cells.  Required; at most
+//                              32768 per side, and no more cells or
+//                              particles than a Checkpoint can hold.
+//   frame_rate F             - Frames per simulated second (default 30).
+//   cfl C                    - Largest distance, in cells, that the fastest
+//                              fluid may travel in one substep (default 2).
+//   gravity X Y              - Acceleration of every fluid cell, in cells per
+//                              second squared (default 0 -9.8).
+//   solver NAME              - Pressure solver: diagonal, mic, multigrid or
+//                              mgpcg (default mic).
+//   particles_per_cell N     - Marker particles seeded in each fluid cell, on
+//                              a square lattice; a square number (default 16).
+//   TYPE box X0 Y0 X1 Y1     - Sets every cell whose center lies within
+//                              [X0, X1) x [Y0, Y1) to TYPE.
+//   TYPE circle X Y R        - Sets every cell whose center lies within R of
+//                              (X, Y) to TYPE.
+//
+// TYPE is fluid, solid or air.  Regions are applied in order, each replacing
+// the cells it covers, on a domain that starts out as air.  SOLID cells are
+// fixed obstacles: fluid never enters them, and particles are only seeded in
+// FLUID cells.
+class Scenario
+{
+public:
+  // The shape of a region.
+  enum Shape {
+    BOX = 0, // Axis-aligned rectangle from (x0, y0) to (x1, y1).
+    CIRCLE,  // Disc centered on (x0, y0) with radius x1.
+    SHAPE_COUNT
+  };
+
+  // An area of cells set to one type.
+  struct Region
+  {
+    Cell::Type type; // FLUID, SOLID or AIR.
+    Shape shape;     // How the coordinates below are interpreted.
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+  };
+
+  // Constructs an empty scenario: all air, with default settings.
+  //
+  // Arguments:
+  //   unsigned width - The simulation width, in cells.
+  //   unsigned height - The simulation height, in cells.
+  Scenario(unsigned width = 64, unsigned height = 64);
+
+  // Returns the solver's built-in scene: the upper right quadrant full of
+  // still fluid, with default settings.
+  //
+  // Arguments:
+  //   unsigned width - The simulation width, in cells.
+  //   unsigned height - The simulation height, in cells.
+  //
+  // Returns:
+  //   Scenario - The scenario.
+  static Scenario makeDefault(unsigned width, unsigned height);
+
+  // Reads a scenario file, replacing this scenario.
+  //
+  // Arguments:
+  //   std::string &path - The file to read.
+  //
+  // Returns:
+  //   bool - True on success.  On failure the scenario is unchanged, and
+  //          getError() describes the problem.
+  bool load(const std::string &path);
+
+  // Parses scenario text, replacing this scenario.
+  //
+  // Arguments:
+  //   std::string &text - The scenario, in the format described above.
+  //
+  // Returns:
+  //   bool - True on success.  On failure the scenario is unchanged, and
+  //          getError() describes the problem.
+  bool parse(const std::string &text);
+
+  // Returns why the last load() or parse() failed.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   std::string & - The error, with its line number, or an empty string.
+  const std::string &getError() const;
+
+  // Returns the simulation size.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The width or height, in cells.
+  unsigned getWidth() const;
+  unsigned getHeight() const;
+
+  // Returns the number of frames per simulated second.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float - The frame rate.
+  float getFrameRate() const;
+
+  // Returns the CFL number used to choose substeps.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float - The largest distance in cells fluid may move per substep.
+  float getCFLNumber() const;
+
+  // Returns the acceleration applied to all fluid.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   Vector2 - The acceleration, in cells per second squared.
+  Vector2 getGravity() const;
+
+  // Returns the pressure solver to use, as a FluidSolver::PressureSolverType.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The pressure solver.
+  unsigned getPressureSolver() const;
+
+  // Returns the number of marker particles seeded per side of each fluid
+  // cell; each cell receives the square of this.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The particles per side.
+  unsigned getParticlesPerSide() const;
+
+  // Returns the regions, in the order they are applied.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   std::vector<Region> & - The regions.
+  const std::vector<Region> &getRegions() const;
+
+  // Appends a region.
+  //
+  // Arguments:
+  //   Region &region - The region to apply after the existing ones.
+  //
+  // Returns:
+  //   None
+  void addRegion(const Region &region);
+
+  // Finds the cells of a row that a region covers.
+  //
+  // Arguments:
+  //   Region &region - The region.
+  //   unsigned y - The row.
+  //   unsigned &begin - Receives the first covered cell.
+  //   unsigned &end - Receives one past the last covered cell, no more than
+  //                   the width; equal to begin if none are covered.
+  //
+  // Returns:
+  //   None
+  void getRegionSpan(const Region &region, unsigned y, unsigned &begin,
+		     unsigned &end) const;
+
+private:
+  // Parses one line into this scenario, returning false with _error set on
+  // failure.
+  bool parseLine(const std::string &line, bool &sizeFound);
+
+  unsigned _width;            // Simulation width, in cells.
+  unsigned _height;           // Simulation height, in cells.
+  float _frameRate;           // Frames per simulated second.
+  float _cflNumber;           // Cells fluid may move per substep.
+  Vector2 _gravity;           // Acceleration of all fluid.
+  unsigned _pressureSolver;   // A FluidSolver::PressureSolverType.
+  unsigned _particlesPerSide; // Particles per cell, per side.
+  std::vector<Region> _regions; // Regions, in order.
+  std::string _error;         // Why the last parse failed.
+};
+
+#endif // __SCENARIO_H__
@@ -0,0 +1,79 @@
+#include "SolverDiagnostics.h"
+#include <ostream>
+
+
+SolverDiagnostics::SolverDiagnostics(unsigned capacity)
+  : _verbosity(DIAGNOSTICS_OFF),
+    _records(capacity < 1 ? 1 : capacity),
+    _next(0),
+    _count(0)
+{}
+
+
+void SolverDiagnostics::setVerbosity(Verbosity verbosity)
+{
+  _verbosity = verbosity;
+}
+
+
+SolverDiagnostics::Verbosity SolverDiagnostics::getVerbosity() const
+{
+  return _verbosity;
+}
+
+
+void SolverDiagnostics::record(const StepRecord &record)
+{
+  _records[_next] = record;
+  _next = (_next + 1) % _records.size();
+  if (_count < _records.size())
+    ++_count;
+}
+
+
+unsigned SolverDiagnostics::getRecordCount() const
+{
+  return _count;
+}
+
+
+const SolverDiagnostics::StepRecord &
+SolverDiagnostics::getRecord(unsigned i) const
+{
+  // The oldest record sits just after the newest one once the buffer wraps.
+  const unsigned capacity = _records.size();
+  const unsigned oldest = (_next + capacity - _count) % capacity;
+  return _records[(oldest + i) % capacity];
+}
+
+
+const SolverDiagnostics::StepRecord &SolverDiagnostics::getLatestRecord() const
+{
+  return getRecord(_count - 1);
+}
+
+
+void SolverDiagnostics::clear()
+{
+  _next = 0;
+  _count = 0;
+}
+
+
+void SolverDiagnostics::dump(std::ostream &out) const
+{
+  for (unsigned i = 0; i < _count; ++i) {
+    const StepRecord &r = getRecord(i);
+    out << "step " << r.step
+	<< " dt " << r.timeStepSec
+	<< " pressure " << (r.pressureConverged ? "converged" : "FAILED")
+	<< " iterations " << r.pressureIterations
+	<< " error " << r.pressureError
+	<< " initial " << r.pressureInitialError
+	<< (r.pressureWarmStarted ? " warm" : " cold")
+	<< (r.pressureReusedSetup ? " reused" : " setup");
+    if (r.maxDivergence >= 0.0f)
+      out << " divergence " << r.maxDivergence;
+    out << '\n';
+  }
+}
@@ -0,0 +1,140 @@
+#ifndef __SOLVER_DIAGNOSTICS_H__
+#define __SOLVER_DIAGNOSTICS_H__
+
+#include <iosfwd>
+#include <vector>
+
+
+// A low-overhead diagnostics channel for the fluid solver.  Rather than
+// printing from the simulation loop, the solver hands one record per substep
+// to this class, which keeps the most recent records in a fixed-size ring
+// buffer.  Records can be queried or dumped to a stream on demand.
+//
+// The verbosity can be changed at any time.  When diagnostics are off the
+// solver skips building records entirely, so the disabled path costs a
+// single branch per substep.
+class SolverDiagnostics
+{
+public:
+  // How much information is collected each substep.
+  enum Verbosity {
+    DIAGNOSTICS_OFF = 0,  // Nothing is recorded.
+    DIAGNOSTICS_STEPS,    // One record per substep with solver statistics.
+    DIAGNOSTICS_DETAILED, // Adds measurements that need an extra grid pass.
+    VERBOSITY_COUNT
+  };
+
+  // The information recorded for a single substep.
+  struct StepRecord {
+    unsigned long step;           // Substep number since construction.
+    float    timeStepSec;         // Length of the substep.
+    unsigned pressureIterations;  // Iterations used by the pressure solve.
+    double   pressureError;       // Relative residual at termination.
+    double   pressureInitialError;// Relative residual of the initial guess.
+    bool     pressureConverged;   // True if the pressure solve converged.
+    bool     pressureWarmStarted; // True if seeded with the last pressure.
+    bool     pressureReusedSetup; // True if the solver setup was reused.
+    float    maxDivergence;       // Max |divergence| after projection, or
+				  // -1 if not measured (DETAILED only).
+  };
+
+  // Constructs a diagnostics channel holding up to capacity records, with
+  // diagnostics off.
+  //
+  // Arguments:
+  //   unsigned capacity - The number of most recent records kept.
+  SolverDiagnostics(unsigned capacity = 256);
+
+  // Sets how much information is collected from now on.
+  //
+  // Arguments:
+  //   Verbosity verbosity - The new verbosity.
+  //
+  // Returns:
+  //   None
+  void setVerbosity(Verbosity verbosity);
+
+  // Returns how much information is currently collected.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   Verbosity - The current verbosity.
+  Verbosity getVerbosity() const;
+
+  // Returns true if information at the given verbosity should be collected.
+  // Callers check this before doing any work to build a record.
+  //
+  // Arguments:
+  //   Verbosity level - The verbosity the information belongs to.
+  //
+  // Returns:
+  //   bool - True if the level is enabled.
+  inline bool isEnabled(Verbosity level = DIAGNOSTICS_STEPS) const
+  {
+    return _verbosity >= level;
+  }
+
+  // Appends a record, overwriting the oldest one if the buffer is full.
+  //
+  // Arguments:
+  //   StepRecord &record - The record to append.
+  //
+  // Returns:
+  //   None
+  void record(const StepRecord &record);
+
+  // Returns the number of records currently held.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of records, at most the capacity.
+  unsigned getRecordCount() const;
+
+  // Returns a held record, oldest first.
+  //
+  // Arguments:
+  //   unsigned i - The index of the record, 0 being the oldest.
+  //
+  // Returns:
+  //   StepRecord & - The record.
+  const StepRecord &getRecord(unsigned i) const;
+
+  // Returns the most recent record.  There must be at least one record.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   StepRecord & - The most recent record.
+  const StepRecord &getLatestRecord() const;
+
+  // Discards all held records.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void clear();
+
+  // Writes all held records to a stream, oldest first, one line each.
+  //
+  // Arguments:
+  //   std::ostream &out - The stream to write to.
+  //
+  // Returns:
+  //   None
+  void dump(std::ostream &out) const;
+
+private:
+  Verbosity _verbosity;            // What is currently collected.
+  std::vector<StepRecord> _records; // Ring buffer storage.
+  unsigned _next;                  // Slot the next record is written to.
+  unsigned _count;                 // Number of valid records.
+};
+
+#endif // __SOLVER_DIAGNOSTICS_H__
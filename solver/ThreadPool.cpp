@@ -0,0 +1,98 @@
+#include "ThreadPool.h"
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+
+
+namespace {
+  // Runs one block of a parallelFor() on a worker thread.
+  class BlockRunnable : public QRunnable
+  {
+  public:
+    BlockRunnable(const ThreadPool::Task &task, unsigned begin, unsigned end,
+		  QSemaphore &done)
+      : _task(task), _begin(begin), _end(end), _done(done)
+    {}
+
+    void run()
+    {
+      _task.run(_begin, _end);
+      _done.release();
+    }
+
+  private:
+    const ThreadPool::Task &_task; // The task being run.
+    unsigned _begin;               // First index of the block.
+    unsigned _end;                 // One past the last index of the block.
+    QSemaphore &_done;             // Released once the block is done.
+  };
+}
+
+
+ThreadPool::ThreadPool(unsigned threadCount)
+  : _workers(new QThreadPool()),
+    _threadCount(1)
+{
+  setThreadCount(threadCount);
+}
+
+
+ThreadPool::~ThreadPool()
+{
+  _workers->waitForDone();
+  delete _workers;
+}
+
+
+unsigned ThreadPool::getIdealThreadCount()
+{
+  const int count = QThread::idealThreadCount();
+  return count > 0 ? count : 1;
+}
+
+
+void ThreadPool::setThreadCount(unsigned threadCount)
+{
+  _threadCount = threadCount > 0 ? threadCount : getIdealThreadCount();
+
+  // The calling thread always runs one block itself.
+  _workers->setMaxThreadCount(_threadCount > 1 ? _threadCount - 1 : 1);
+}
+
+
+unsigned ThreadPool::getThreadCount() const
+{
+  return _threadCount;
+}
+
+
+void ThreadPool::parallelFor(unsigned begin, unsigned end, const Task &task,
+			     unsigned minBlockSize)
+{
+  if (end <= begin)
+    return;
+
+  const unsigned count = end - begin;
+  unsigned blocks = count / (minBlockSize > 0 ? minBlockSize : 1);
+  if (blocks > _threadCount)
+    blocks = _threadCount;
+  if (blocks <= 1) {
+    task.run(begin, end);
+    return;
+  }
+
+  // The first count % blocks blocks get one extra index, so block sizes
+  // differ by at most one.
+  const unsigned size = count / blocks;
+  const unsigned extra = count % blocks;
+  QSemaphore done(0);
+  unsigned blockBegin = begin + size + (extra > 0);
+  for (unsigned k = 1; k < blocks; ++k) {
+    const unsigned blockEnd = blockBegin + size + (k < extra);
+    _workers->start(new BlockRunnable(task, blockBegin, blockEnd, done));
+    blockBegin = blockEnd;
+  }
+  task.run(begin, begin + size + (extra > 0));
+  done.acquire(blocks - 1);
+}
@@ -0,0 +1,110 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+class QThreadPool;
+
+
+// A pool of worker threads for data-parallel loops over grid rows or
+// particles.  parallelFor() splits an index range into one contiguous block
+// per thread, runs the blocks concurrently (the calling thread takes the
+// first block) and returns once all of them are done.  The partitioning
+// depends only on the range and the thread count, and tasks are expected to
+// write disjoint outputs per index, so results never depend on scheduling.
+//
+// Tasks derive from ThreadPool::Task:
+//
+//   class ScaleTask : public ThreadPool::Task {
+//   public:
+//     void run(unsigned begin, unsigned end) const
+//     { for (unsigned i = begin; i < end; ++i) data[i] *= 2.0f; }
+//     float *data;
+//   };
+//
+//   pool.parallelFor(0, count, task);
+class ThreadPool
+{
+public:
+  // A unit of work applied to a block of indices.
+  class Task
+  {
+  public:
+    virtual ~Task() {}
+
+    // Processes indices [begin, end).  Called concurrently from several
+    // threads, each with a different block.
+    //
+    // Arguments:
+    //   unsigned begin - The first index of the block.
+    //   unsigned end - One past the last index of the block.
+    //
+    // Returns:
+    //   None
+    virtual void run(unsigned begin, unsigned end) const = 0;
+  };
+
+  // Constructs a pool.
+  //
+  // Arguments:
+  //   unsigned threadCount - The number of threads used by parallelFor(),
+  //                          including the caller's, or 0 to use one per
+  //                          processor core.
+  ThreadPool(unsigned threadCount = 0);
+
+  // Destructor.  Waits for any worker threads to exit.
+  //
+  // Arguments:
+  //   None
+  ~ThreadPool();
+
+  // Returns the number of threads that can run truly concurrently.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of processor cores, at least 1.
+  static unsigned getIdealThreadCount();
+
+  // Sets the number of threads used by parallelFor().
+  //
+  // Arguments:
+  //   unsigned threadCount - The number of threads including the caller's,
+  //                          or 0 to use one per processor core.
+  //
+  // Returns:
+  //   None
+  void setThreadCount(unsigned threadCount);
+
+  // Returns the number of threads used by parallelFor().
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   unsigned - The number of threads, including the caller's.
+  unsigned getThreadCount() const;
+
+  // Runs a task over the indices [begin, end), split into contiguous
+  // blocks of at least minBlockSize indices, one block per thread.
+  //
+  // Arguments:
+  //   unsigned begin - The first index.
+  //   unsigned end - One past the last index.
+  //   Task &task - The task to run on each block.
+  //   unsigned minBlockSize - The smallest block worth handing to a thread.
+  //
+  // Returns:
+  //   None
+  void parallelFor(unsigned begin, unsigned end, const Task &task,
+		   unsigned minBlockSize = 1);
+
+private:
+  // Not copyable.
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+
+  QThreadPool *_workers;  // Runs every block but the caller's.
+  unsigned _threadCount;  // Threads used per parallelFor(), incl. caller.
+};
+
+#endif // __THREAD_POOL_H__
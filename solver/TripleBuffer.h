@@ -0,0 +1,132 @@
+#ifndef __TRIPLE_BUFFER_H__
+#define __TRIPLE_BUFFER_H__
+
+#include <QAtomicInt>
+#include <vector>
+
+
+// Hands the latest of a stream of values from one producer thread to one
+// consumer thread without locks or waiting.  Three buffers rotate between
+// the roles of the producer's back buffer, the consumer's front buffer and
+// a middle buffer holding the latest published value:
+//
+//   Producer                         Consumer
+//     T &next = buffer.getWriteBuffer();
+//     ...fill in next...
+//     buffer.publish();                if (buffer.update())
+//                                        draw(buffer.getReadBuffer());
+//
+// publish() and update() each swap a buffer with the middle one in a single
+// atomic exchange, so neither side ever blocks the other.  Values published
+// faster than the consumer reads them are overwritten, so the consumer always
+// sees the newest one.  Buffers are reused rather than reallocated, which
+// makes the hand-off free of allocations once the values have reached their
+// steady size.
+template <class T>
+class TripleBuffer
+{
+public:
+  // Constructs a triple buffer with every buffer a copy of a value.
+  //
+  // Arguments:
+  //   T &initial - The value initially read by the consumer.
+  TripleBuffer(const T &initial);
+
+  // Returns the buffer the producer fills in next.  Only the producer
+  // thread may call this.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   T & - The producer's back buffer.
+  T &getWriteBuffer();
+
+  // Publishes the write buffer as the latest value, and hands the producer
+  // another buffer to fill in.  Only the producer thread may call this.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void publish();
+
+  // Makes the latest published value the read buffer, if one has been
+  // published since the last update.  Only the consumer thread may call this.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   bool - True if the read buffer changed.
+  bool update();
+
+  // Returns the consumer's current value, which stays unchanged until the
+  // next update().  Only the consumer thread may call this.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   T & - The consumer's front buffer.
+  const T &getReadBuffer() const;
+
+private:
+  // Not copyable.
+  TripleBuffer(const TripleBuffer &);
+  TripleBuffer &operator=(const TripleBuffer &);
+
+  // The middle state holds the middle buffer's index, plus FRESH if it has
+  // been published but not yet read.
+  enum { INDEX_MASK = 3, FRESH = 4 };
+
+  std::vector<T> _buffers; // The three buffers.
+  unsigned _write;         // Index of the producer's buffer.
+  unsigned _read;          // Index of the consumer's buffer.
+  QAtomicInt _middle;      // Index and state of the middle buffer.
+};
+
+
+template <class T>
+TripleBuffer<T>::TripleBuffer(const T &initial)
+  : _buffers(3, initial),
+    _write(0),
+    _read(1),
+    _middle(2)
+{}
+
+
+template <class T>
+T &TripleBuffer<T>::getWriteBuffer()
+{
+  return _buffers[_write];
+}
+
+
+template <class T>
+void TripleBuffer<T>::publish()
+{
+  // The ordered exchange makes the buffer's contents visible to the consumer
+  // before the consumer can see its index.
+  _write = _middle.fetchAndStoreOrdered(_write | FRESH) & INDEX_MASK;
+}
+
+
+template <class T>
+bool TripleBuffer<T>::update()
+{
+  if (!(_middle.fetchAndAddAcquire(0) & FRESH))
+    return false;
+  _read = _middle.fetchAndStoreOrdered(_read) & INDEX_MASK;
+  return true;
+}
+
+
+template <class T>
+const T &TripleBuffer<T>::getReadBuffer() const
+{
+  return _buffers[_read];
+}
+
+#endif // __TRIPLE_BUFFER_H__
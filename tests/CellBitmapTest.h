@@ -0,0 +1,50 @@
+#ifndef __CELL_BITMAP_TEST__
+#define __CELL_BITMAP_TEST__
+
+#include <gtest/gtest.h>
+#include "CellBitmap.h"
+
+TEST(CellBitmapTest, SetAndTest)
+{
+  // Rows span more than one word, and each starts on a new word.
+  CellBitmap bitmap(70, 3);
+  EXPECT_EQ(2u, bitmap.getRowWords());
+  EXPECT_EQ(0u, bitmap.count());
+
+  bitmap.set(0, 0);
+  bitmap.set(63, 1);
+  bitmap.set(64, 1);
+  bitmap.set(69, 2);
+  bitmap.set(69, 2);
+  EXPECT_EQ(4u, bitmap.count());
+  EXPECT_TRUE(bitmap.test(0, 0));
+  EXPECT_TRUE(bitmap.test(63, 1));
+  EXPECT_TRUE(bitmap.test(64, 1));
+  EXPECT_TRUE(bitmap.test(69, 2));
+  EXPECT_FALSE(bitmap.test(1, 0));
+  EXPECT_FALSE(bitmap.test(0, 1));
+  EXPECT_FALSE(bitmap.test(69, 1));
+
+  EXPECT_EQ(CellBitmap::Word(1) << 63, bitmap.rowData(1)[0]);
+  EXPECT_EQ(CellBitmap::Word(1), bitmap.rowData(1)[1]);
+  EXPECT_EQ(CellBitmap::Word(0), bitmap.rowData(2)[0]);
+
+  bitmap.clear();
+  EXPECT_EQ(0u, bitmap.count());
+}
+
+TEST(CellBitmapTest, Equality)
+{
+  CellBitmap a(10, 10), b(10, 10), c(10, 11);
+  EXPECT_TRUE(a == b);
+  EXPECT_FALSE(a == c);
+  a.set(3, 4);
+  EXPECT_FALSE(a == b);
+  b.set(3, 4);
+  EXPECT_TRUE(a == b);
+
+  b.resize(10, 11);
+  EXPECT_TRUE(b == c);
+}
+
+#endif // __CELL_BITMAP_TEST__
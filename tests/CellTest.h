@@ -23,7 +23,6 @@ class CellTest : public testing::Test {
     testCell.stagedVel[Cell::X] = 3.0f;
     testCell.stagedVel[Cell::Y] = 5.0f;
     testCell.cellType = Cell::FLUID;
-    testCell.allNeighbors = true;
     return;
   }
 
@@ -41,10 +40,6 @@ TEST_F(CellTest, DefaultConstructor)
     EXPECT_EQ(0.0f, defaultCell.stagedVel[i]);
   }
   EXPECT_EQ(Cell::AIR, defaultCell.cellType);
-  EXPECT_FALSE(defaultCell.allNeighbors);
-  for (int i = 0; i < Cell::NEIGHBOR_COUNT; ++i) {
-    EXPECT_EQ(NULL, defaultCell.neighbors[i]);
-  }
 }
 
 TEST_F(CellTest, CopyConstructor)
@@ -57,10 +52,6 @@ TEST_F(CellTest, CopyConstructor)
     EXPECT_EQ(testCell.stagedVel[i], newCell.stagedVel[i]);
   }
   EXPECT_EQ(testCell.cellType, newCell.cellType);
-  EXPECT_EQ(testCell.allNeighbors, newCell.allNeighbors);
-  for (int i = 0; i < Cell::NEIGHBOR_COUNT; ++i) {
-    EXPECT_EQ(testCell.neighbors[i], newCell.neighbors[i]);
-  }
 }
 
 TEST_F(CellTest, Assignment)
@@ -73,10 +64,6 @@ TEST_F(CellTest, Assignment)
     EXPECT_EQ(testCell.stagedVel[i], newCell.stagedVel[i]);
   }
   EXPECT_EQ(testCell.cellType, newCell.cellType);
-  EXPECT_EQ(testCell.allNeighbors, newCell.allNeighbors);
-  for (int i = 0; i < Cell::NEIGHBOR_COUNT; ++i) {
-    EXPECT_EQ(testCell.neighbors[i], newCell.neighbors[i]);
-  }
 }
 
 TEST_F(CellTest, CommitStagedVel)
@@ -0,0 +1,190 @@
+#ifndef __CHECKPOINT_TEST__
+#define __CHECKPOINT_TEST__
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Checkpoint.h"
+#include "FluidSolver.h"
+#include "FrameSnapshot.h"
+#include "TestFrames.h"
+
+// Returns a path for a test's checkpoint file.
+static std::string checkpointTestPath(const char *name)
+{
+  return testing::TempDir() + name;
+}
+
+// Flips one byte of a file.
+static void corruptCheckpointByte(const std::string &path, long offset)
+{
+  FILE *file = fopen(path.c_str(), "r+b");
+  ASSERT_TRUE(file != NULL);
+  fseek(file, offset, SEEK_SET);
+  const int byte = fgetc(file);
+  fseek(file, offset, SEEK_SET);
+  fputc(byte ^ 0xFF, file);
+  fclose(file);
+}
+
+// Cuts a file short.
+static void truncateCheckpoint(const std::string &path, unsigned bytes)
+{
+  std::vector<char> data(bytes);
+  FILE *file = fopen(path.c_str(), "rb");
+  ASSERT_TRUE(file != NULL);
+  ASSERT_EQ(bytes, fread(&data[0], 1, bytes, file));
+  fclose(file);
+  file = fopen(path.c_str(), "wb");
+  ASSERT_TRUE(file != NULL);
+  fwrite(&data[0], 1, bytes, file);
+  fclose(file);
+}
+
+TEST(CheckpointTest, RoundTripsFrame)
+{
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeTestFrame(pool, 5, 4, 50, 42);
+  const std::string path = checkpointTestPath("RoundTripsFrame.ckp");
+  ASSERT_EQ(Checkpoint::OK, Checkpoint::write(*frame, path));
+
+  Checkpoint checkpoint;
+  ASSERT_EQ(Checkpoint::OK, checkpoint.open(path));
+  ASSERT_TRUE(checkpoint.isOpen());
+  EXPECT_EQ(5u, checkpoint.getWidth());
+  EXPECT_EQ(4u, checkpoint.getHeight());
+  EXPECT_EQ(42ul, checkpoint.getFrame());
+  EXPECT_EQ(0, memcmp(frame->uData(), checkpoint.uData(),
+		      6 * 4 * sizeof(float)));
+  EXPECT_EQ(0, memcmp(frame->vData(), checkpoint.vData(),
+		      5 * 5 * sizeof(float)));
+  EXPECT_EQ(0, memcmp(frame->pressureData(), checkpoint.pressureData(),
+		      5 * 4 * sizeof(float)));
+  EXPECT_EQ(0, memcmp(frame->cellTypeData(), checkpoint.cellTypeData(),
+		      5 * 4));
+  ASSERT_EQ(50u, checkpoint.getParticleCount());
+  EXPECT_EQ(0, memcmp(frame->particleXData(), checkpoint.particleXData(),
+		      50 * sizeof(float)));
+  EXPECT_EQ(0, memcmp(frame->particleYData(), checkpoint.particleYData(),
+		      50 * sizeof(float)));
+
+  // The arrays are read in place, and are page aligned within the file.
+  EXPECT_EQ(0u, (checkpoint.particleXData() - checkpoint.uData()) %
+	    (4096 / sizeof(float)));
+
+  checkpoint.close();
+  EXPECT_FALSE(checkpoint.isOpen());
+  remove(path.c_str());
+}
+
+TEST(CheckpointTest, RejectsDamagedFiles)
+{
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeTestFrame(pool, 5, 4, 50, 42);
+  const std::string path = checkpointTestPath("RejectsDamagedFiles.ckp");
+  Checkpoint checkpoint;
+
+  EXPECT_EQ(Checkpoint::OPEN_FAILED, checkpoint.open(path + ".missing"));
+
+  // A damaged array is only found when the checksums are verified.
+  ASSERT_EQ(Checkpoint::OK, Checkpoint::write(*frame, path));
+  corruptCheckpointByte(path, 5 * 4096 + 17);
+  EXPECT_EQ(Checkpoint::BAD_CHECKSUM, checkpoint.open(path));
+  EXPECT_FALSE(checkpoint.isOpen());
+  EXPECT_EQ(Checkpoint::OK, checkpoint.open(path, false));
+
+  ASSERT_EQ(Checkpoint::OK, Checkpoint::write(*frame, path));
+  corruptCheckpointByte(path, 20);
+  EXPECT_EQ(Checkpoint::BAD_HEADER, checkpoint.open(path));
+
+  ASSERT_EQ(Checkpoint::OK, Checkpoint::write(*frame, path));
+  corruptCheckpointByte(path, 0);
+  EXPECT_EQ(Checkpoint::BAD_MAGIC, checkpoint.open(path));
+
+  ASSERT_EQ(Checkpoint::OK, Checkpoint::write(*frame, path));
+  corruptCheckpointByte(path, 8);
+  EXPECT_EQ(Checkpoint::BAD_VERSION, checkpoint.open(path));
+
+  // Cut the file short, in the middle of the particles.
+  ASSERT_EQ(Checkpoint::OK, Checkpoint::write(*frame, path));
+  truncateCheckpoint(path, 6 * 4096);
+  EXPECT_EQ(Checkpoint::TRUNCATED, checkpoint.open(path));
+  EXPECT_FALSE(checkpoint.isOpen());
+  remove(path.c_str());
+}
+
+TEST(CheckpointTest, WriterWritesInBackground)
+{
+  FrameSnapshotPool pool;
+  const std::string path = checkpointTestPath("WriterWritesInBackground");
+  {
+    CheckpointWriter writer;
+    for (unsigned k = 0; k < 4; ++k) {
+      char suffix[16];
+      snprintf(suffix, sizeof(suffix), "%u.ckp", k);
+      writer.write(makeTestFrame(pool, 5, 4, 50, 42), path + suffix);
+    }
+    EXPECT_EQ(Checkpoint::OK, writer.finish());
+
+    // Failures are reported by the next finish().
+    writer.write(makeTestFrame(pool, 5, 4, 50, 42), path + ".missing/0.ckp");
+    EXPECT_EQ(Checkpoint::OPEN_FAILED, writer.finish());
+    EXPECT_EQ(Checkpoint::OK, writer.finish());
+  }
+
+  // No more than one frame was held by the writer while another was queued.
+  EXPECT_LE(pool.getSnapshotCount(), 3u);
+
+  Checkpoint checkpoint;
+  for (unsigned k = 0; k < 4; ++k) {
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "%u.ckp", k);
+    EXPECT_EQ(Checkpoint::OK, checkpoint.open(path + suffix));
+    EXPECT_EQ(42ul, checkpoint.getFrame());
+    remove((path + suffix).c_str());
+  }
+}
+
+TEST(CheckpointTest, RestoredSolverResumesExactly)
+{
+  FrameSnapshotPool pool;
+  const std::string path = checkpointTestPath("Restore.ckp");
+
+  // One run straight through, and one saved part way.
+  FluidSolver expected(40.0f, 32.0f);
+  FluidSolver saved(40.0f, 32.0f);
+  for (unsigned frame = 0; frame < 12; ++frame) {
+    expected.advanceFrame();
+    if (frame < 5)
+      saved.advanceFrame();
+  }
+  ASSERT_EQ(Checkpoint::OK,
+	    Checkpoint::write(*pool.capture(saved.getGrid(),
+					    saved.getParticles(), 5), path));
+
+  Checkpoint checkpoint;
+  ASSERT_EQ(Checkpoint::OK, checkpoint.open(path));
+  FluidSolver wrongSize(32.0f, 32.0f);
+  EXPECT_FALSE(wrongSize.restore(checkpoint));
+
+  FluidSolver restored(40.0f, 32.0f);
+  ASSERT_TRUE(restored.restore(checkpoint));
+  for (unsigned frame = 5; frame < 12; ++frame)
+    restored.advanceFrame();
+
+  // Every field matches exactly.  Particles are sorted on a schedule that
+  // counts substeps from construction, so only their count is compared.
+  const FrameSnapshotPtr a =
+    pool.capture(expected.getGrid(), expected.getParticles(), 12);
+  const FrameSnapshotPtr b =
+    pool.capture(restored.getGrid(), restored.getParticles(), 12);
+  EXPECT_EQ(0, memcmp(a->uData(), b->uData(),
+		      (41 * 32 + 40 * 33 + 40 * 32) * sizeof(float)));
+  EXPECT_EQ(0, memcmp(a->cellTypeData(), b->cellTypeData(), 40 * 32));
+  EXPECT_EQ(a->getParticleCount(), b->getParticleCount());
+  remove(path.c_str());
+}
+
+#endif // __CHECKPOINT_TEST__
@@ -0,0 +1,216 @@
+#ifndef __FIELD_CODEC_TEST__
+#define __FIELD_CODEC_TEST__
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include "FieldCodec.h"
+#include "FrameSnapshot.h"
+#include "Grid.h"
+#include "ParticleSystem.h"
+
+// Captures a 300x250 frame, large enough for u, v, pressure and the
+// particles to span several chunks, with smooth fields plus a few values
+// that only a bit exact encoding keeps.
+static FrameSnapshotPtr makeCodecTestFrame(FrameSnapshotPool &pool)
+{
+  const unsigned width = 300, height = 250;
+  Grid grid(300.0f, 250.0f);
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x <= width; ++x)
+      grid.u(x, y) = std::sin(0.05f * x) * std::cos(0.03f * y);
+  for (unsigned y = 0; y <= height; ++y)
+    for (unsigned x = 0; x < width; ++x)
+      grid.v(x, y) = -0.5f * std::cos(0.02f * x + 0.04f * y);
+  for (unsigned y = 0; y < height; ++y) {
+    for (unsigned x = 0; x < width; ++x) {
+      grid.pressure(x, y) = 9.81f * (height - y) + 0.001f * x;
+      grid.cellType(x, y) = (x < 5 || y < 5) ? 2 : (y < 120 ? 1 : 0);
+    }
+  }
+  grid.u(3, 4) = -0.0f;
+  grid.u(7, 8) = std::numeric_limits<float>::quiet_NaN();
+  grid.v(9, 10) = std::numeric_limits<float>::infinity();
+  grid.v(11, 12) = std::numeric_limits<float>::denorm_min();
+
+  ParticleSystem particles;
+  for (unsigned k = 0; k < 70000; ++k)
+    particles.add(0.5f + (k % width), 0.5f + 0.25f * (k / width));
+  return pool.capture(grid, particles, 17);
+}
+
+// Returns true if two arrays hold the same bits.
+template <typename T>
+static bool sameBits(const T *expected, const std::vector<T> &actual,
+		     size_t count)
+{
+  return actual.size() == count &&
+    memcmp(expected, &actual[0], count * sizeof(T)) == 0;
+}
+
+TEST(FieldCodecTest, LosslessRoundTripIsBitExact)
+{
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeCodecTestFrame(pool);
+  FieldCodec codec(FieldCodec::LOSSLESS, 0.0f, 2);
+  std::vector<unsigned char> bytes;
+  codec.encode(*frame, bytes);
+
+  FieldCodec::Frame decoded;
+  ASSERT_TRUE(codec.decode(&bytes[0], bytes.size(), decoded));
+  EXPECT_EQ(17ul, decoded.frame);
+  EXPECT_EQ(300u, decoded.width);
+  EXPECT_EQ(250u, decoded.height);
+  EXPECT_TRUE(sameBits(frame->uData(), decoded.u, 301 * 250));
+  EXPECT_TRUE(sameBits(frame->vData(), decoded.v, 300 * 251));
+  EXPECT_TRUE(sameBits(frame->pressureData(), decoded.pressure, 300 * 250));
+  EXPECT_TRUE(sameBits(frame->cellTypeData(), decoded.cellTypes, 300 * 250));
+  EXPECT_TRUE(sameBits(frame->particleXData(), decoded.particleX, 70000));
+  EXPECT_TRUE(sameBits(frame->particleYData(), decoded.particleY, 70000));
+
+  // Smooth fields compress well.
+  const size_t rawBytes = (301 * 250 + 300 * 251 + 300 * 250 + 2 * 70000) *
+    sizeof(float) + 300 * 250;
+  EXPECT_LT(bytes.size(), rawBytes / 2);
+}
+
+TEST(FieldCodecTest, LossyVelocityStaysWithinTolerance)
+{
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeCodecTestFrame(pool);
+  const float tolerance = 1.0e-3f;
+  FieldCodec lossless(FieldCodec::LOSSLESS);
+  FieldCodec lossy(FieldCodec::LOSSY_VELOCITY, tolerance);
+  std::vector<unsigned char> losslessBytes, lossyBytes;
+  lossless.encode(*frame, losslessBytes);
+  lossy.encode(*frame, lossyBytes);
+  EXPECT_LT(lossyBytes.size(), losslessBytes.size());
+
+  FieldCodec::Frame decoded;
+  ASSERT_TRUE(lossy.decode(&lossyBytes[0], lossyBytes.size(), decoded));
+  const float *u = frame->uData();
+  for (unsigned k = 0; k < 301 * 250; ++k) {
+    if (std::isnan(u[k]))
+      EXPECT_TRUE(std::isnan(decoded.u[k])) << k;
+    else
+      EXPECT_LE(std::fabs(decoded.u[k] - u[k]), tolerance) << k;
+  }
+  const float *v = frame->vData();
+  for (unsigned k = 0; k < 300 * 251; ++k) {
+    if (std::isinf(v[k]))
+      EXPECT_EQ(v[k], decoded.v[k]) << k;
+    else
+      EXPECT_LE(std::fabs(decoded.v[k] - v[k]), tolerance) << k;
+  }
+
+  // Everything but velocity is exact.
+  EXPECT_TRUE(sameBits(frame->pressureData(), decoded.pressure, 300 * 250));
+  EXPECT_TRUE(sameBits(frame->cellTypeData(), decoded.cellTypes, 300 * 250));
+  EXPECT_TRUE(sameBits(frame->particleXData(), decoded.particleX, 70000));
+  EXPECT_TRUE(sameBits(frame->particleYData(), decoded.particleY, 70000));
+}
+
+TEST(FieldCodecTest, EncodingDoesNotDependOnThreadCount)
+{
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeCodecTestFrame(pool);
+  FieldCodec one(FieldCodec::LOSSY_VELOCITY, 1.0e-4f, 1);
+  FieldCodec three(FieldCodec::LOSSY_VELOCITY, 1.0e-4f, 3);
+  std::vector<unsigned char> a, b;
+  one.encode(*frame, a);
+  three.encode(*frame, b);
+  EXPECT_TRUE(a == b);
+}
+
+TEST(FieldCodecTest, RejectsDamagedFrames)
+{
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeCodecTestFrame(pool);
+  FieldCodec codec;
+  std::vector<unsigned char> bytes;
+  codec.encode(*frame, bytes);
+  FieldCodec::Frame decoded;
+
+  std::vector<unsigned char> damaged(bytes);
+  damaged[0] ^= 0xFF;
+  EXPECT_FALSE(codec.decode(&damaged[0], damaged.size(), decoded));
+
+  // Flip a byte in the middle of the particles' compressed data.
+  damaged = bytes;
+  damaged[damaged.size() - 1000] ^= 0xFF;
+  EXPECT_FALSE(codec.decode(&damaged[0], damaged.size(), decoded));
+
+  EXPECT_FALSE(codec.decode(&bytes[0], bytes.size() - 1, decoded));
+  EXPECT_FALSE(codec.decode(&bytes[0], 100, decoded));
+  EXPECT_TRUE(codec.decode(&bytes[0], bytes.size(), decoded));
+}
+
+// Builds a frame file whose header describes a frame of the given size,
+// with every array claiming 16 bytes of zeros after the header.
+static std::vector<unsigned char> makeCodecTestHeader(unsigned long width,
+						      unsigned long height)
+{
+  char text[1024];
+  snprintf(text, sizeof(text),
+	   "FLUIDFRAMEZ 1\nframe 0\nwidth %lu\nheight %lu\nparticles 0\n"
+	   "array u float32 %lu %lu 1000 16\n"
+	   "array v float32 %lu %lu 1016 16\n"
+	   "array pressure float32 %lu %lu 1032 16\n"
+	   "array cell_type uint8 %lu %lu 1048 16\n"
+	   "array particle_x float32 0 1064 16\n"
+	   "array particle_y float32 0 1080 16\n"
+	   "end\n", width, height, width + 1, height, width, height + 1,
+	   width, height, width, height);
+  std::vector<unsigned char> bytes(1096, 0);
+  memcpy(&bytes[0], text, strlen(text));
+  return bytes;
+}
+
+TEST(FieldCodecTest, RejectsOversizedHeaders)
+{
+  // Headers asking for more memory than the file could describe must be
+  // rejected before anything is allocated.
+  FieldCodec codec;
+  FieldCodec::Frame decoded;
+  std::vector<unsigned char> bytes = makeCodecTestHeader(4000000000ul, 3);
+  EXPECT_FALSE(codec.decode(&bytes[0], bytes.size(), decoded));
+  bytes = makeCodecTestHeader(30000, 30000);
+  EXPECT_FALSE(codec.decode(&bytes[0], bytes.size(), decoded));
+  EXPECT_TRUE(decoded.u.empty());
+}
+
+TEST(FieldCodecTest, RejectsBadChunkSizes)
+{
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeCodecTestFrame(pool);
+  FieldCodec codec;
+  std::vector<unsigned char> bytes;
+  codec.encode(*frame, bytes);
+  FieldCodec::Frame decoded;
+
+  // The first chunk starts the u array; its compressed data, after the 16
+  // byte chunk header, starts with the big-endian size it decompresses to.
+  const std::string text(bytes.begin(), bytes.begin() + 1024);
+  unsigned long offset = 0;
+  ASSERT_EQ(1, sscanf(text.c_str() + text.find("array u "),
+		      "array u float32 301 250 %lu", &offset));
+  const unsigned long prefix = offset + 16;
+
+  // Sizes that would make the decompressor allocate more, or less, than
+  // the chunk holds are rejected before decompressing.
+  const unsigned char sizes[][4] = {
+    { 0x7F, 0xFF, 0xFF, 0xFF }, { 0x00, 0x00, 0x00, 0x00 }
+  };
+  for (unsigned i = 0; i < 2; ++i) {
+    std::vector<unsigned char> damaged(bytes);
+    memcpy(&damaged[prefix], sizes[i], 4);
+    EXPECT_FALSE(codec.decode(&damaged[0], damaged.size(), decoded)) << i;
+  }
+  EXPECT_TRUE(codec.decode(&bytes[0], bytes.size(), decoded));
+}
+
+#endif // __FIELD_CODEC_TEST__
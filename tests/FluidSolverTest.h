@@ -0,0 +1,233 @@
+#ifndef __FLUID_SOLVER_TEST__
+#define __FLUID_SOLVER_TEST__
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "FluidSolver.h"
+#include "Grid.h"
+
+// Exposes FluidSolver's individual simulation stages.
+class TestFluidSolver : public FluidSolver
+{
+public:
+  TestFluidSolver(float width, float height) : FluidSolver(width, height) {}
+
+  using FluidSolver::advanceTimeStep;
+  using FluidSolver::advectVelocity;
+  using FluidSolver::applyGlobalVelocity;
+};
+
+// Copies the u and v faces of a grid into a single array.
+static std::vector<float> velocities(const Grid &grid)
+{
+  const unsigned width  = grid.getColCount() - 1;
+  const unsigned height = grid.getRowCount() - 1;
+  std::vector<float> result;
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x <= width; ++x)
+      result.push_back(grid.u(x, y));
+  for (unsigned y = 0; y <= height; ++y)
+    for (unsigned x = 0; x < width; ++x)
+      result.push_back(grid.v(x, y));
+  return result;
+}
+
+// Advects a nontrivial velocity field with the given number of threads and
+// returns the result.
+static std::vector<float> advectWithThreads(unsigned threadCount)
+{
+  // The frames leading up to the advection run serially.
+  TestFluidSolver solver(96.0f, 80.0f);
+  solver.setThreadCount(1);
+  for (unsigned frame = 0; frame < 3; ++frame)
+    solver.advanceFrame();
+  solver.applyGlobalVelocity(Vector2(3.0f, -2.0f));
+
+  solver.setThreadCount(threadCount);
+  solver.advectVelocity(0.05f);
+  return velocities(solver.getGrid());
+}
+
+TEST(FluidSolverTest, ParallelAdvectionMatchesSerial)
+{
+  const std::vector<float> expected = advectWithThreads(1);
+  const unsigned threadCounts[] = { 2, 3, 5, 64 };
+  for (unsigned t = 0; t < sizeof(threadCounts) / sizeof(unsigned); ++t)
+    EXPECT_TRUE(expected == advectWithThreads(threadCounts[t]))
+      << threadCounts[t] << " threads";
+}
+
+TEST(FluidSolverTest, ProjectionFindsMaxFaceVelocity)
+{
+  // The largest velocities found during each projection must match a full
+  // sweep over the faces once the walls have been enforced.
+  FluidSolver solver(40.0f, 30.0f);
+  for (unsigned frame = 0; frame < 5; ++frame) {
+    solver.advanceFrame();
+    const Vector2 expected = solver.getGrid().getMaxFaceVelocity();
+    EXPECT_LT(0.0f, expected.magnitude());
+    EXPECT_EQ(expected, solver.getMaxFaceVelocity());
+  }
+
+  solver.reset();
+  EXPECT_EQ(Vector2(0.0f, 0.0f), solver.getMaxFaceVelocity());
+}
+
+TEST(FluidSolverTest, ParticleSortingPreservesResults)
+{
+  // Reordering particles must not change the simulation.
+  FluidSolver unsorted(48.0f, 40.0f);
+  FluidSolver rowMajor(48.0f, 40.0f);
+  FluidSolver morton(48.0f, 40.0f);
+  unsorted.setParticleSorting(0);
+  rowMajor.setParticleSorting(1, ParticleSystem::ROW_MAJOR);
+  morton.setParticleSorting(3, ParticleSystem::MORTON);
+  for (unsigned frame = 0; frame < 5; ++frame) {
+    unsorted.advanceFrame();
+    rowMajor.advanceFrame();
+    morton.advanceFrame();
+  }
+
+  const std::vector<float> expected = velocities(unsorted.getGrid());
+  EXPECT_TRUE(expected == velocities(rowMajor.getGrid()));
+  EXPECT_TRUE(expected == velocities(morton.getGrid()));
+  for (unsigned y = 0; y < 40; ++y)
+    for (unsigned x = 0; x < 48; ++x) {
+      EXPECT_EQ(unsorted.getGrid().cellType(x, y),
+		rowMajor.getGrid().cellType(x, y));
+      EXPECT_EQ(unsorted.getGrid().cellType(x, y),
+		morton.getGrid().cellType(x, y));
+    }
+}
+
+// Runs a few frames with the given number of threads and particle sorting
+// interval, and returns the resulting cell types.
+static std::vector<unsigned char> markWithThreads(unsigned threadCount,
+						  unsigned sortInterval)
+{
+  // Enough particles to be marked in several chunks.
+  FluidSolver solver(128.0f, 96.0f);
+  solver.setThreadCount(threadCount);
+  solver.setParticleSorting(sortInterval);
+  for (unsigned frame = 0; frame < 3; ++frame)
+    solver.advanceFrame();
+
+  // The FLUID bitmap must agree with the cell types.
+  const Grid &grid = solver.getGrid();
+  const CellBitmap &fluid = solver.getFluidCells();
+  std::vector<unsigned char> types;
+  for (unsigned y = 0; y < 96; ++y)
+    for (unsigned x = 0; x < 128; ++x) {
+      EXPECT_EQ(grid.cellType(x, y) == Cell::FLUID, fluid.test(x, y));
+      types.push_back(grid.cellType(x, y));
+    }
+  EXPECT_LT(0u, fluid.count());
+  return types;
+}
+
+TEST(FluidSolverTest, ParallelMarkCellsMatchesSerial)
+{
+  const std::vector<unsigned char> expected = markWithThreads(1, 0);
+  const unsigned threadCounts[] = { 2, 3, 8 };
+  for (unsigned t = 0; t < sizeof(threadCounts) / sizeof(unsigned); ++t) {
+    EXPECT_TRUE(expected == markWithThreads(threadCounts[t], 0))
+      << threadCounts[t] << " threads";
+    EXPECT_TRUE(expected == markWithThreads(threadCounts[t], 1))
+      << threadCounts[t] << " threads, sorted";
+  }
+}
+
+// Copies the cell types of a grid.
+static std::vector<unsigned char> cellTypes(const Grid &grid)
+{
+  std::vector<unsigned char> result;
+  for (unsigned y = 0; y + 1 < grid.getRowCount(); ++y)
+    for (unsigned x = 0; x + 1 < grid.getColCount(); ++x)
+      result.push_back(grid.cellType(x, y));
+  return result;
+}
+
+TEST(FluidSolverTest, ReusedPressureSetupMatchesFreshSetup)
+{
+  for (unsigned type = 0; type < FluidSolver::PRESSURE_SOLVER_COUNT; ++type) {
+    // Two solvers run the same substeps, but one sets its pressure solver up
+    // afresh before every solve.
+    TestFluidSolver reused(48.0f, 40.0f), fresh(48.0f, 40.0f);
+    reused.setThreadCount(1);
+    fresh.setThreadCount(1);
+    reused.setPressureSolver(FluidSolver::PressureSolverType(type));
+    std::vector<unsigned char> solvedTypes = cellTypes(reused.getGrid());
+    unsigned reuseCount = 0, changeCount = 0;
+    for (unsigned step = 0; step < 40; ++step) {
+      const std::vector<unsigned char> types = cellTypes(reused.getGrid());
+      reused.advanceTimeStep(0.03f);
+      fresh.setPressureSolver(FluidSolver::PressureSolverType(type));
+      fresh.advanceTimeStep(0.03f);
+
+      // The setup is reused exactly when the cell types are those of the
+      // previous solve, and never right after selecting a solver.
+      const FluidSolver::PressureSolveStats stats =
+	reused.getLastPressureSolveStats();
+      EXPECT_EQ(step > 0 && types == solvedTypes, stats.reusedSetup)
+	<< "solver " << type << ", step " << step;
+      EXPECT_FALSE(fresh.getLastPressureSolveStats().reusedSetup);
+      EXPECT_TRUE(stats.converged);
+      EXPECT_TRUE(fresh.getLastPressureSolveStats().converged);
+      changeCount += (step > 0 && types != solvedTypes);
+      solvedTypes = types;
+      if (!stats.reusedSetup)
+	continue;
+      ++reuseCount;
+
+      // Both solves reached the tolerance, so their pressures agree to
+      // within it.
+      const Grid &a = reused.getGrid();
+      const Grid &b = fresh.getGrid();
+      double difference = 0.0, norm = 0.0;
+      for (unsigned y = 0; y + 1 < a.getRowCount(); ++y)
+	for (unsigned x = 0; x + 1 < a.getColCount(); ++x) {
+	  const double d = a.pressure(x, y) - b.pressure(x, y);
+	  difference += d * d;
+	  norm += double(b.pressure(x, y)) * b.pressure(x, y);
+	}
+      EXPECT_LT(0.0, norm);
+      EXPECT_LE(std::sqrt(difference), 1.0e-4 * std::sqrt(norm))
+	<< "solver " << type << ", step " << step;
+    }
+    EXPECT_LT(0u, reuseCount) << "solver " << type;
+    EXPECT_LT(0u, changeCount) << "solver " << type;
+  }
+}
+
+TEST(FluidSolverTest, WarmStartSavesIterations)
+{
+  // The same scene runs with and without warm starts; both must reach the
+  // tolerance, and the warm run must need no more iterations.
+  unsigned totalIterations[2] = { 0, 0 };
+  for (unsigned warm = 0; warm < 2; ++warm) {
+    FluidSolver solver(48.0f, 40.0f);
+    solver.setThreadCount(1);
+    solver.setWarmStartPressure(warm == 1);
+    EXPECT_EQ(warm == 1, solver.getWarmStartPressure());
+    bool solved = false;
+    for (unsigned frame = 0; frame < 20; ++frame) {
+      solver.advanceFrame();
+      const std::vector<FluidSolver::PressureSolveStats> &solves =
+	solver.getFramePressureSolveStats();
+      for (unsigned i = 0; i < solves.size(); ++i) {
+	EXPECT_EQ(warm == 1, solves[i].warmStarted);
+	EXPECT_TRUE(solves[i].converged);
+	EXPECT_GE(1.0e-6, solves[i].error);
+	if (warm && solved) {
+	  EXPECT_GT(1.0, solves[i].initialError) << "frame " << frame;
+	}
+	totalIterations[warm] += solves[i].iterations;
+	solved = true;
+      }
+    }
+  }
+  EXPECT_LE(totalIterations[1], totalIterations[0]);
+}
+
+#endif // __FLUID_SOLVER_TEST__
@@ -0,0 +1,212 @@
+#ifndef __FRAME_EXPORTER_TEST__
+#define __FRAME_EXPORTER_TEST__
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "FrameExporter.h"
+#include "FrameSnapshot.h"
+#include "TestFrames.h"
+
+// An array listed in an exported frame's header.
+struct ExportedArray {
+  std::string type;
+  std::vector<unsigned long> dimensions;
+  unsigned long offset;
+};
+
+// Reads an exported frame, splitting it into its header's properties and
+// arrays, and the file's bytes.
+static void readExportedFrame(const std::string &path,
+			      std::map<std::string, unsigned long> &properties,
+			      std::map<std::string, ExportedArray> &arrays,
+			      std::vector<unsigned char> &bytes)
+{
+  bytes.clear();
+  FILE *file = fopen(path.c_str(), "rb");
+  ASSERT_TRUE(file != NULL) << path;
+  int c;
+  while ((c = fgetc(file)) != EOF)
+    bytes.push_back(c);
+  fclose(file);
+
+  std::istringstream header(std::string(bytes.begin(), bytes.end()));
+  std::string line;
+  ASSERT_TRUE(std::getline(header, line));
+  ASSERT_EQ("FLUIDFRAME 1", line);
+  while (std::getline(header, line) && line != "end") {
+    std::istringstream fields(line);
+    std::string key;
+    fields >> key;
+    if (key == "array") {
+      std::string name;
+      ExportedArray array;
+      fields >> name >> array.type;
+      unsigned long value;
+      while (fields >> value)
+	array.dimensions.push_back(value);
+      ASSERT_FALSE(array.dimensions.empty());
+      array.offset = array.dimensions.back();
+      array.dimensions.pop_back();
+      arrays[name] = array;
+    }
+    else
+      fields >> properties[key];
+  }
+  ASSERT_EQ("end", line);
+}
+
+// Decodes a little-endian float.
+static float exportedFloat(const std::vector<unsigned char> &bytes,
+			   unsigned long offset)
+{
+  const uint32_t bits = bytes[offset] | (bytes[offset + 1] << 8) |
+    (bytes[offset + 2] << 16) | (uint32_t(bytes[offset + 3]) << 24);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Returns the path of an exported frame.
+static std::string exportedFramePath(unsigned long frame)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "/frame_%05lu.fld", frame);
+  return testing::TempDir() + name;
+}
+
+TEST(FrameExporterTest, WritesSelfDescribingFrames)
+{
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeTestFrame(pool, 6, 5, 7, 3);
+  const std::string path = exportedFramePath(3);
+  ASSERT_TRUE(FrameExporter::writeFrame(*frame, path));
+
+  std::map<std::string, unsigned long> properties;
+  std::map<std::string, ExportedArray> arrays;
+  std::vector<unsigned char> bytes;
+  readExportedFrame(path, properties, arrays, bytes);
+  EXPECT_EQ(3ul, properties["frame"]);
+  EXPECT_EQ(6ul, properties["width"]);
+  EXPECT_EQ(5ul, properties["height"]);
+  EXPECT_EQ(7ul, properties["particles"]);
+  ASSERT_EQ(6u, arrays.size());
+
+  // Every array matches the snapshot, wherever the header says it is.
+  const char *names[] = { "u", "v", "pressure", "particle_x", "particle_y" };
+  const float *data[] = { frame->uData(), frame->vData(),
+			  frame->pressureData(), frame->particleXData(),
+			  frame->particleYData() };
+  const unsigned long counts[] = { 7 * 5, 6 * 6, 6 * 5, 7, 7 };
+  for (unsigned a = 0; a < 5; ++a) {
+    const ExportedArray &array = arrays[names[a]];
+    EXPECT_EQ("float32", array.type) << names[a];
+    EXPECT_EQ(0u, array.offset % 64) << names[a];
+    unsigned long count = 1;
+    for (unsigned d = 0; d < array.dimensions.size(); ++d)
+      count *= array.dimensions[d];
+    ASSERT_EQ(counts[a], count) << names[a];
+    ASSERT_LE(array.offset + 4 * count, bytes.size()) << names[a];
+    for (unsigned long k = 0; k < count; ++k)
+      EXPECT_EQ(data[a][k], exportedFloat(bytes, array.offset + 4 * k))
+	<< names[a] << "[" << k << "]";
+  }
+  EXPECT_EQ(7u, arrays["u"].dimensions[0]);
+  EXPECT_EQ(5u, arrays["u"].dimensions[1]);
+
+  const ExportedArray &cellTypes = arrays["cell_type"];
+  EXPECT_EQ("uint8", cellTypes.type);
+  ASSERT_LE(cellTypes.offset + 30, bytes.size());
+  EXPECT_EQ(0, memcmp(frame->cellTypeData(), &bytes[cellTypes.offset], 30));
+  remove(path.c_str());
+}
+
+TEST(FrameExporterTest, BlockingPolicyWritesEveryFrame)
+{
+  FrameSnapshotPool pool;
+  {
+    FrameExporter exporter(testing::TempDir(), 2,
+			   FrameExporter::BLOCK_WHEN_FULL);
+    for (unsigned long frame = 0; frame < 20; ++frame)
+      EXPECT_TRUE(exporter.submit(makeTestFrame(pool, 6, 5, 7, frame)));
+    EXPECT_TRUE(exporter.finish());
+    EXPECT_EQ(20ul, exporter.getWrittenCount());
+    EXPECT_EQ(0ul, exporter.getDroppedCount());
+  }
+
+  // The queue never held more than its capacity, plus the frame being
+  // written and the one being submitted.
+  EXPECT_LE(pool.getSnapshotCount(), 4u);
+
+  std::map<std::string, unsigned long> properties;
+  std::map<std::string, ExportedArray> arrays;
+  std::vector<unsigned char> bytes;
+  for (unsigned long frame = 0; frame < 20; ++frame) {
+    readExportedFrame(exportedFramePath(frame), properties, arrays, bytes);
+    EXPECT_EQ(frame, properties["frame"]);
+    remove(exportedFramePath(frame).c_str());
+  }
+}
+
+TEST(FrameExporterTest, DroppingPolicyNeverBlocks)
+{
+  FrameSnapshotPool pool;
+  FrameExporter exporter(testing::TempDir(), 1,
+			 FrameExporter::DROP_WHEN_FULL);
+  unsigned long queued = 0;
+  for (unsigned long frame = 0; frame < 50; ++frame)
+    queued += exporter.submit(makeTestFrame(pool, 6, 5, 7, frame));
+  EXPECT_TRUE(exporter.finish());
+
+  // Every frame was either written or dropped, without waiting.
+  EXPECT_GE(queued, 1ul);
+  EXPECT_EQ(queued, exporter.getWrittenCount());
+  EXPECT_EQ(50 - queued, exporter.getDroppedCount());
+  EXPECT_EQ(0.0, exporter.getBlockedSec());
+  for (unsigned long frame = 0; frame < 50; ++frame)
+    remove(exportedFramePath(frame).c_str());
+}
+
+TEST(FrameExporterTest, CompressesFrames)
+{
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr frame = makeTestFrame(pool, 6, 5, 7, 4);
+  const std::string path = testing::TempDir() + "/frame_00004.fldz";
+  {
+    FrameExporter exporter(testing::TempDir());
+    exporter.setCompression(FieldCodec::LOSSLESS);
+    exporter.submit(frame);
+    EXPECT_TRUE(exporter.finish());
+    EXPECT_EQ(1ul, exporter.getWrittenCount());
+    EXPECT_LT(0ull, exporter.getWrittenBytes());
+  }
+
+  FieldCodec codec;
+  FieldCodec::Frame decoded;
+  ASSERT_TRUE(codec.readFrame(path, decoded));
+  EXPECT_EQ(4ul, decoded.frame);
+  ASSERT_EQ(7u * 5, decoded.u.size());
+  EXPECT_EQ(0, memcmp(frame->uData(), &decoded.u[0], 7 * 5 * sizeof(float)));
+  EXPECT_EQ(0, memcmp(frame->cellTypeData(), &decoded.cellTypes[0], 30));
+  remove(path.c_str());
+}
+
+TEST(FrameExporterTest, ReportsFailedWrites)
+{
+  FrameSnapshotPool pool;
+  const std::string directory = testing::TempDir() + "/missing";
+  FrameExporter exporter(directory, 4);
+  exporter.submit(makeTestFrame(pool, 6, 5, 7, 1));
+  exporter.submit(makeTestFrame(pool, 6, 5, 7, 2));
+  EXPECT_FALSE(exporter.finish());
+  EXPECT_EQ(0ul, exporter.getWrittenCount());
+  EXPECT_EQ(2ul, exporter.getFailedCount());
+  EXPECT_EQ(directory + "/frame_00001.fld", exporter.getFirstFailedPath());
+}
+
+#endif // __FRAME_EXPORTER_TEST__
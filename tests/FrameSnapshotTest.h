@@ -0,0 +1,93 @@
+#ifndef __FRAME_SNAPSHOT_TEST__
+#define __FRAME_SNAPSHOT_TEST__
+
+#include <gtest/gtest.h>
+#include "FrameSnapshot.h"
+#include "Grid.h"
+#include "ParticleSystem.h"
+#include "TestFrames.h"
+
+TEST(FrameSnapshotTest, CapturesFields)
+{
+  Grid grid(4.0f, 3.0f);
+  ParticleSystem particles;
+  fillTestFrameState(4, 3, 3, grid, particles);
+
+  FrameSnapshotPool pool;
+  const FrameSnapshotPtr snapshot = pool.capture(grid, particles, 7);
+  ASSERT_FALSE(snapshot.isNull());
+  EXPECT_EQ(4u, snapshot->getWidth());
+  EXPECT_EQ(3u, snapshot->getHeight());
+  EXPECT_EQ(7ul, snapshot->getFrame());
+
+  for (unsigned y = 0; y < 3; ++y)
+    for (unsigned x = 0; x <= 4; ++x)
+      EXPECT_EQ(grid.u(x, y), snapshot->u(x, y));
+  for (unsigned y = 0; y <= 3; ++y)
+    for (unsigned x = 0; x < 4; ++x)
+      EXPECT_EQ(grid.v(x, y), snapshot->v(x, y));
+  for (unsigned y = 0; y < 3; ++y) {
+    for (unsigned x = 0; x < 4; ++x) {
+      EXPECT_EQ(grid.pressure(x, y), snapshot->pressure(x, y));
+      EXPECT_EQ(grid.cellType(x, y), snapshot->cellType(x, y));
+    }
+  }
+
+  // The cell center velocity matches the grid's interpolation.
+  const Vector2 expected = grid.getVelocity(Vector2(2.5f, 1.5f));
+  const Vector2 actual = snapshot->getCellVelocity(2, 1);
+  EXPECT_FLOAT_EQ(expected.x, actual.x);
+  EXPECT_FLOAT_EQ(expected.y, actual.y);
+
+  ASSERT_EQ(particles.size(), snapshot->getParticleCount());
+  for (unsigned k = 0; k < particles.size(); ++k) {
+    EXPECT_EQ(particles.xData()[k], snapshot->particleXData()[k]);
+    EXPECT_EQ(particles.yData()[k], snapshot->particleYData()[k]);
+  }
+
+  // Later changes to the grid do not reach the snapshot.
+  grid.u(1, 1) = 1000.0f;
+  EXPECT_EQ(11.0f, snapshot->u(1, 1));
+}
+
+TEST(FrameSnapshotTest, PoolReusesReleasedSnapshots)
+{
+  Grid grid(4.0f, 3.0f);
+  ParticleSystem particles;
+  fillTestFrameState(4, 3, 3, grid, particles);
+
+  FrameSnapshotPool pool;
+  FrameSnapshotPtr first = pool.capture(grid, particles, 0);
+  const FrameSnapshot *storage = &*first;
+  const float *u = first->uData();
+
+  // A snapshot is not reused while any handle to it remains.
+  FrameSnapshotPtr copy = first;
+  first.reset();
+  EXPECT_TRUE(first.isNull());
+  FrameSnapshotPtr second = pool.capture(grid, particles, 1);
+  EXPECT_NE(storage, &*second);
+  EXPECT_EQ(2u, pool.getSnapshotCount());
+  EXPECT_EQ(0ul, copy->getFrame());
+
+  // Once released, its snapshot and arrays are reused.
+  copy.reset();
+  FrameSnapshotPtr third = pool.capture(grid, particles, 2);
+  EXPECT_EQ(storage, &*third);
+  EXPECT_EQ(u, third->uData());
+  EXPECT_EQ(2ul, third->getFrame());
+  EXPECT_EQ(2u, pool.getSnapshotCount());
+
+  // Assigning over a handle releases its old snapshot, so a steady stream of
+  // captures needs no new ones.
+  second = third;
+  for (unsigned frame = 3; frame < 10; ++frame) {
+    third.reset();
+    third = pool.capture(grid, particles, frame);
+    EXPECT_EQ(frame, third->getFrame());
+  }
+  EXPECT_EQ(2u, pool.getSnapshotCount());
+  EXPECT_EQ(2ul, second->getFrame());
+}
+
+#endif // __FRAME_SNAPSHOT_TEST__
@@ -24,48 +24,66 @@ protected:
   {
     // Initialize a velocity field for testing.
     // The simulation area is [0.0f, 3.0] in each dimension, resulting in
-    // a grid that internally stores 4 rows and 4 cols of MAC cells.
-    // All cells contain liquid and 1.0f pressure.
+    // a grid of 3x3 MAC cells, with 4x3 X-velocity faces and 3x4
+    // Y-velocity faces.  All cells contain liquid and 1.0f pressure.
     // The grid's origin is in the bottom left corner, (x,y) == (0,0).
-    // Initial velocity is given to grid cells such that the X and Y 
-    // velocity components are equal to the cell's position within the grid.
-    // For example, cell (0,0) has an X velocity of 0, and Y velocity of 0.
-    // Cell (1, 2) has an X velocity of 1, and Y velocity of 2.
-    for (unsigned y = 0; y < testGrid.getRowCount(); ++y) {
-      for (unsigned x = 0; x < testGrid.getColCount(); ++x) {
-	testGrid(x, y).cellType = Cell::FLUID;
-	testGrid(x, y).pressure = 1.0f;
-	testGrid(x, y).vel[Cell::X] = static_cast<float>(x);
-	testGrid(x, y).vel[Cell::Y] = static_cast<float>(y);
+    // Initial velocity is given to the faces such that the X and Y 
+    // velocity components are equal to the face's position within the grid.
+    // For example, faces u(0,0) and v(0,0) have a velocity of 0.
+    // Faces u(1,2) and v(1,2) have velocities of 1 and 2 respectively.
+    const unsigned width  = testGrid.getColCount() - 1;
+    const unsigned height = testGrid.getRowCount() - 1;
+    for (unsigned y = 0; y < height; ++y) {
+      for (unsigned x = 0; x < width; ++x) {
+	testGrid.cellType(x, y) = Cell::FLUID;
+	testGrid.pressure(x, y) = 1.0f;
+      }
+    }
+    for (unsigned y = 0; y < height; ++y) {
+      for (unsigned x = 0; x <= width; ++x) {
+	testGrid.u(x, y) = static_cast<float>(x);
+      }
+    }
+    for (unsigned y = 0; y <= height; ++y) {
+      for (unsigned x = 0; x < width; ++x) {
+	testGrid.v(x, y) = static_cast<float>(y);
       }
     }
 
     // Copy the above testGrid into edgeTestGrid, but modify some values.
-    // Specifically, set the y-velocities in the far right column to 0,
-    // and set the x-velocities in the top row to 0.
+    // Specifically, set the x-velocities on the right wall to 0,
+    // and set the y-velocities on the top wall to 0.
     edgeTestGrid = testGrid;
-    unsigned rightCol = edgeTestGrid.getColCount() - 1;
-    unsigned topRow   = edgeTestGrid.getRowCount() - 1;
-    for (unsigned y = 0; y < edgeTestGrid.getRowCount(); ++y) {
-      edgeTestGrid(rightCol, y).vel[Cell::Y] = 0.0f;
+    for (unsigned y = 0; y < height; ++y) {
+      edgeTestGrid.u(width, y) = 0.0f;
     }
-    for (unsigned x = 0; x < edgeTestGrid.getColCount(); ++x) {
-      edgeTestGrid(x, topRow).vel[Cell::X] = 0.0f;
+    for (unsigned x = 0; x < width; ++x) {
+      edgeTestGrid.v(x, height) = 0.0f;
     }
   }
 
-  // Compares data values in two cells; doesn't consider neighbor pointers.
-  bool sameCellData(const Cell &a, const Cell &b)
+  // Compares all face velocities, pressures, and cell types in two grids.
+  bool sameGridData(const Grid &a, const Grid &b)
   {
+    const unsigned width  = a.getColCount() - 1;
+    const unsigned height = a.getRowCount() - 1;
     bool result = true;
-    result = result &&
-      (a.pressure == b.pressure) &&
-      (a.cellType == b.cellType) &&
-      (a.allNeighbors == b.allNeighbors);
-    for (int i = 0; i < Cell::DIM_COUNT; ++i) {
-      result = result && 
-	(a.vel[i] == b.vel[i]) &&
-	(a.stagedVel[i] == b.stagedVel[i]);
+    for (unsigned y = 0; y < height; ++y) {
+      for (unsigned x = 0; x < width; ++x) {
+	result = result &&
+	  (a.pressure(x, y) == b.pressure(x, y)) &&
+	  (a.cellType(x, y) == b.cellType(x, y));
+      }
+    }
+    for (unsigned y = 0; y < height; ++y) {
+      for (unsigned x = 0; x <= width; ++x) {
+	result = result && (a.u(x, y) == b.u(x, y));
+      }
+    }
+    for (unsigned y = 0; y <= height; ++y) {
+      for (unsigned x = 0; x < width; ++x) {
+	result = result && (a.v(x, y) == b.v(x, y));
+      }
     }
     return result;
   }
@@ -98,10 +116,7 @@ TEST_F(GridTest, CopyConstructor)
   Grid copyGrid(testGrid);
   ASSERT_EQ(testGrid.getRowCount(), copyGrid.getRowCount());
   ASSERT_EQ(testGrid.getColCount(), copyGrid.getColCount());
-  const unsigned size = testGrid.getRowCount() & testGrid.getColCount();
-  for (unsigned i = 0; i < size; ++i) {
-    EXPECT_TRUE(sameCellData(testGrid[i], copyGrid[i]));
-  }
+  EXPECT_TRUE(sameGridData(testGrid, copyGrid));
 }
 
 TEST_F(GridTest, Assignment)
@@ -109,60 +124,61 @@ TEST_F(GridTest, Assignment)
   Grid assignGrid = testGrid;
   ASSERT_EQ(testGrid.getRowCount(), assignGrid.getRowCount());
   ASSERT_EQ(testGrid.getColCount(), assignGrid.getColCount());
-  const unsigned size = testGrid.getRowCount() & testGrid.getColCount();
-  for (unsigned i = 0; i < size; ++i) {
-    EXPECT_TRUE(sameCellData(testGrid[i], assignGrid[i]));
-  }
+  EXPECT_TRUE(sameGridData(testGrid, assignGrid));
 }
 
 TEST_F(GridTest, Accessors)
 {
-  const unsigned x = 2;
+  // Every quantity is stored in its own padded array sharing one layout.
+  const unsigned x = 1;
   const unsigned y = 1;
-  const unsigned i = testGrid.getColCount() * y + x;
-  EXPECT_EQ(&testGrid[i], &testGrid(x, y));
+  const unsigned i = testGrid.index(x, y);
+  const unsigned stride = testGrid.getStride();
+  EXPECT_EQ(i + 1,      testGrid.index(x+1, y));
+  EXPECT_EQ(i + stride, testGrid.index(x, y+1));
+  EXPECT_EQ(&testGrid.uData()[i],        &testGrid.u(x, y));
+  EXPECT_EQ(&testGrid.vData()[i],        &testGrid.v(x, y));
+  EXPECT_EQ(&testGrid.pressureData()[i], &testGrid.pressure(x, y));
+  EXPECT_EQ(&testGrid.cellTypeData()[i], &testGrid.cellType(x, y));
+  EXPECT_EQ(&testGrid.u(x, y) + 1,      &testGrid.u(x+1, y));
+  EXPECT_EQ(&testGrid.u(x, y) + stride, &testGrid.u(x, y+1));
 }
 
-TEST_F(GridTest, SetCellLinkage)
+TEST_F(GridTest, GhostLayer)
 {
-  unsigned x, y;
-
-  // All cells other than the far right column and top row will have a 
-  // complete set of neighbors.  Verify that all linkage was created correctly.
-  for (y = 0; y < testGrid.getRowCount() - 1; ++y) {
-    for (x = 0; x < testGrid.getColCount() - 1; ++x) {
-      EXPECT_TRUE(testGrid(x, y).allNeighbors);
-      EXPECT_EQ(&testGrid(x+1, y),   testGrid(x, y).neighbors[Cell::POS_X]);
-      EXPECT_EQ(&testGrid(x,   y+1), testGrid(x, y).neighbors[Cell::POS_Y]);
-      EXPECT_EQ(&testGrid(x+1, y+1), testGrid(x, y).neighbors[Cell::POS_XY]);
-    }
-  }
-
-  // Test the far right column, except for the top right corner.
-  for (y = 0; y < testGrid.getRowCount() - 1; ++y) {
-    x = testGrid.getColCount() - 1;
-    EXPECT_FALSE(testGrid(x, y).allNeighbors);
-    EXPECT_EQ(NULL,              testGrid(x, y).neighbors[Cell::POS_X]);
-    EXPECT_EQ(&testGrid(x, y+1), testGrid(x, y).neighbors[Cell::POS_Y]);
-    EXPECT_EQ(NULL,              testGrid(x, y).neighbors[Cell::POS_XY]);
+  // All cells surrounding the simulation are SOLID, and all faces beyond
+  // the simulation walls have 0 velocity.
+  const unsigned width  = testGrid.getColCount() - 1;
+  const unsigned height = testGrid.getRowCount() - 1;
+  const unsigned stride = testGrid.getStride();
+  const unsigned char *types = testGrid.cellTypeData();
+  const float *u = testGrid.uData();
+  const float *v = testGrid.vData();
+  for (unsigned x = 0; x < width; ++x) {
+    EXPECT_EQ(Cell::SOLID, types[testGrid.index(x, 0) - stride]);
+    EXPECT_EQ(Cell::SOLID, types[testGrid.index(x, height)]);
+    EXPECT_EQ(0.0f, u[testGrid.index(x, 0) - stride]);
+    EXPECT_EQ(0.0f, u[testGrid.index(x, height)]);
+    EXPECT_EQ(0.0f, v[testGrid.index(x, 0) - stride]);
+    EXPECT_EQ(0.0f, v[testGrid.index(x, height) + stride]);
   }
-
-  // Test the far top row, except for the top right corner.
-  for (x = 0; x < testGrid.getColCount() - 1; ++x) {
-    y = testGrid.getRowCount() - 1;
-    EXPECT_FALSE(testGrid(x, y).allNeighbors);
-    EXPECT_EQ(&testGrid(x+1, y), testGrid(x, y).neighbors[Cell::POS_X]);
-    EXPECT_EQ(NULL,              testGrid(x, y).neighbors[Cell::POS_Y]);
-    EXPECT_EQ(NULL,              testGrid(x, y).neighbors[Cell::POS_XY]);
+  for (unsigned y = 0; y < height; ++y) {
+    EXPECT_EQ(Cell::SOLID, types[testGrid.index(0, y) - 1]);
+    EXPECT_EQ(Cell::SOLID, types[testGrid.index(width, y)]);
+    EXPECT_EQ(0.0f, u[testGrid.index(0, y) - 1]);
+    EXPECT_EQ(0.0f, u[testGrid.index(width, y) + 1]);
+    EXPECT_EQ(0.0f, v[testGrid.index(0, y) - 1]);
+    EXPECT_EQ(0.0f, v[testGrid.index(width, y)]);
   }
+}
 
-  // Test the top right corner.
-  y = testGrid.getColCount() - 1;
-  y = testGrid.getRowCount() - 1;
-  EXPECT_FALSE(testGrid(x, y).allNeighbors);
-  EXPECT_EQ(NULL, testGrid(x, y).neighbors[Cell::POS_X]);
-  EXPECT_EQ(NULL, testGrid(x, y).neighbors[Cell::POS_Y]);
-  EXPECT_EQ(NULL, testGrid(x, y).neighbors[Cell::POS_XY]);
+TEST_F(GridTest, CommitStagedVel)
+{
+  testGrid.stagedU(1, 2) = 5.0f;
+  testGrid.stagedV(2, 1) = 7.0f;
+  testGrid.commitStagedVel();
+  EXPECT_EQ(5.0f, testGrid.u(1, 2));
+  EXPECT_EQ(7.0f, testGrid.v(2, 1));
 }
 
 TEST_F(GridTest, GetVelocity)
@@ -186,26 +202,63 @@ TEST_F(GridTest, GetVelocity)
   // Test velocity at (0.0, 3.0)
   EXPECT_EQ(Vector2(0.0f, 3.0f), testGrid.getVelocity(Vector2(0.0f, 3.0f)));
   
-  // Test velocity at (2.5, 3.0)
-  EXPECT_EQ(Vector2(2.5f, 3.0f), testGrid.getVelocity(Vector2(2.5f, 3.0f)));
+  // Test velocity at (2.5, 3.0). Faces above the top wall have 0 velocity.
+  EXPECT_EQ(Vector2(1.25f, 3.0f), testGrid.getVelocity(Vector2(2.5f, 3.0f)));
   
   // Test velocity at (3.0, 3.0)
-  EXPECT_EQ(Vector2(3.0f, 3.0f), testGrid.getVelocity(Vector2(3.0f, 3.0f)));
+  EXPECT_EQ(Vector2(1.5f, 1.5f), testGrid.getVelocity(Vector2(3.0f, 3.0f)));
   
   // Test velocity at (-5.0, -5.0)
   EXPECT_EQ(Vector2(0.0f, 0.0f), testGrid.getVelocity(Vector2(-5.0f, -5.0f)));
   
   // Test velocity at (100.0, 100.0)
-  EXPECT_EQ(Vector2(3.0, 3.0f), testGrid.getVelocity(Vector2(100.0f, 100.0f)));
+  EXPECT_EQ(Vector2(1.5f, 1.5f), testGrid.getVelocity(Vector2(100.0f, 100.0f)));
   
   // Use edgeTestGrid to test velocity at (3.0, 1.25)
-  EXPECT_EQ(Vector2(3.0f, 0.625f), edgeTestGrid.getVelocity(Vector2(3.0f, 1.25f)));
+  EXPECT_EQ(Vector2(0.0f, 0.625f), edgeTestGrid.getVelocity(Vector2(3.0f, 1.25f)));
   
   // Use edgeTestGrid to test velocity at (3.0, 2.0)
-  EXPECT_EQ(Vector2(3.0f, 1.0f), edgeTestGrid.getVelocity(Vector2(3.0f, 2.0f)));
+  EXPECT_EQ(Vector2(0.0f, 1.0f), edgeTestGrid.getVelocity(Vector2(3.0f, 2.0f)));
   
   // Use edgeTestGrid to test velocity at (3.0, 3.0)
-  EXPECT_EQ(Vector2(1.5f, 1.5f), edgeTestGrid.getVelocity(Vector2(3.0f, 3.0f)));
+  EXPECT_EQ(Vector2(0.0f, 0.0f), edgeTestGrid.getVelocity(Vector2(3.0f, 3.0f)));
+}
+
+TEST_F(GridTest, GetVelocities)
+{
+  // Sample a spread of positions, including some beyond every edge, and
+  // compare against single-point sampling.  37 positions leave a partial
+  // SIMD batch at the end.
+  const unsigned count = 37;
+  float x[count], y[count], u[count], v[count], uOnly[count], vOnly[count];
+  for (unsigned k = 0; k < count; ++k) {
+    x[k] = -1.0f + 0.137f * k;
+    y[k] =  4.2f - 0.121f * k;
+  }
+
+  const Grid *grids[2] = { &testGrid, &edgeTestGrid };
+  for (unsigned g = 0; g < 2; ++g) {
+    grids[g]->getVelocities(x, y, u, v, count);
+    grids[g]->sampleU(x, y, uOnly, count);
+    grids[g]->sampleV(x, y, vOnly, count);
+    for (unsigned k = 0; k < count; ++k) {
+      const Vector2 expected = grids[g]->getVelocity(Vector2(x[k], y[k]));
+      EXPECT_FLOAT_EQ(expected.x, u[k]) << "at " << x[k] << ", " << y[k];
+      EXPECT_FLOAT_EQ(expected.y, v[k]) << "at " << x[k] << ", " << y[k];
+      EXPECT_EQ(u[k], uOnly[k]);
+      EXPECT_EQ(v[k], vOnly[k]);
+    }
+  }
+
+  // Splitting a batch never changes its results.
+  float whole[count], split[count];
+  testGrid.sampleU(x, y, whole, count);
+  testGrid.sampleU(x, y, split, 5);
+  testGrid.sampleU(x + 5, y + 5, split + 5, count - 5);
+  for (unsigned k = 0; k < count; ++k)
+    EXPECT_EQ(whole[k], split[k]);
+
+  EXPECT_LE(1u, Grid::vectorWidth());
 }
 
 TEST_F(GridTest, GetMaxVelocity)
@@ -215,6 +268,30 @@ TEST_F(GridTest, GetMaxVelocity)
   EXPECT_EQ(maxVel, testGrid.getMaxVelocity());
 }
 
+TEST_F(GridTest, GetMaxFaceVelocity)
+{
+  // The largest faces are u(3, y) = 3 and v(x, 3) = 3; edgeTestGrid zeroes
+  // those, leaving 2.
+  EXPECT_EQ(Vector2(3.0f, 3.0f), testGrid.getMaxFaceVelocity());
+  EXPECT_EQ(Vector2(2.0f, 2.0f), edgeTestGrid.getMaxFaceVelocity());
+  edgeTestGrid.v(1, 2) = -7.5f;
+  EXPECT_EQ(Vector2(2.0f, 7.5f), edgeTestGrid.getMaxFaceVelocity());
+}
+
+TEST_F(GridTest, MaxAbs)
+{
+  // Cover partial SIMD batches and the maximum in every position.
+  float values[37];
+  for (unsigned count = 0; count <= 37; ++count)
+    for (unsigned peak = 0; peak < count; ++peak) {
+      for (unsigned k = 0; k < count; ++k)
+	values[k] = (k % 2 ? -0.5f : 0.25f) * (k % 5);
+      values[peak] = (peak % 2) ? -9.0f : 9.0f;
+      EXPECT_EQ(9.0f, Grid::maxAbs(values, count));
+    }
+  EXPECT_EQ(0.0f, Grid::maxAbs(values, 0));
+}
+
 TEST_F(GridTest, GetPressureGradient)
 {
   // TODO, pass test by default.
@@ -224,8 +301,10 @@ TEST_F(GridTest, GetVelocityDivergence)
 {
   EXPECT_EQ( 2.0f, testGrid.getVelocityDivergence(0, 0));
   EXPECT_EQ( 2.0f, testGrid.getVelocityDivergence(1, 0));
-  EXPECT_EQ(-2.0f, testGrid.getVelocityDivergence(3, 1));
-  EXPECT_EQ(-6.0f, testGrid.getVelocityDivergence(3, 3));
+  EXPECT_EQ( 2.0f, testGrid.getVelocityDivergence(2, 2));
+  EXPECT_EQ( 2.0f, edgeTestGrid.getVelocityDivergence(0, 0));
+  EXPECT_EQ(-1.0f, edgeTestGrid.getVelocityDivergence(2, 1));
+  EXPECT_EQ(-4.0f, edgeTestGrid.getVelocityDivergence(2, 2));
 }
 
 #endif // __GRID_TEST__
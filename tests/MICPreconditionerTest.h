@@ -0,0 +1,104 @@
+#ifndef __MIC_PRECONDITIONER_TEST__
+#define __MIC_PRECONDITIONER_TEST__
+
+#include <gtest/gtest.h>
+#include <vector>
+#include <eigen3/Eigen/Sparse>
+#include <eigen3/Eigen/IterativeLinearSolvers>
+#include "MICPreconditioner.h"
+
+#define TEST_LAPLACIAN_SIZE 32
+
+// Test fixture for the MICPreconditioner test.
+class MICPreconditionerTest : public testing::Test {
+protected:
+  typedef Eigen::SparseMatrix<double, Eigen::RowMajor> Matrix;
+
+  const unsigned size;
+  Matrix A;
+  Eigen::VectorXd b;
+
+  // Builds the 5-point Laplacian of a square grid of fluid, with AIR
+  // (Dirichlet) boundaries along the top row and SOLID walls elsewhere.
+  MICPreconditionerTest()
+    : size(TEST_LAPLACIAN_SIZE),
+      A(size * size, size * size),
+      b(size * size)
+  {
+    std::vector< Eigen::Triplet<double> > vals;
+    for (unsigned y = 0; y < size; ++y)
+      for (unsigned x = 0; x < size; ++x) {
+	const int i = y * size + x;
+	double diag = 0.0;
+	if (x > 0) {
+	  vals.push_back(Eigen::Triplet<double>(i, i - 1, -1.0));
+	  diag += 1.0;
+	}
+	if (x + 1 < size) {
+	  vals.push_back(Eigen::Triplet<double>(i, i + 1, -1.0));
+	  diag += 1.0;
+	}
+	if (y > 0) {
+	  vals.push_back(Eigen::Triplet<double>(i, i - size, -1.0));
+	  diag += 1.0;
+	}
+	// The row above the grid is AIR.
+	diag += 1.0;
+	if (y + 1 < size)
+	  vals.push_back(Eigen::Triplet<double>(i, i + size, -1.0));
+	vals.push_back(Eigen::Triplet<double>(i, i, diag));
+	b(i) = (x + y) % 3 == 0 ? 1.0 : -0.5;
+      }
+    A.setFromTriplets(vals.begin(), vals.end());
+  }
+};
+
+TEST_F(MICPreconditionerTest, Converges)
+{
+  Eigen::ConjugateGradient<Matrix, Eigen::Lower|Eigen::Upper,
+			   MICPreconditioner<double> > cg;
+  cg.preconditioner().setGridWidth(size);
+  cg.setTolerance(1.0e-8);
+  cg.compute(A);
+  Eigen::VectorXd p = cg.solve(b);
+
+  EXPECT_EQ(Eigen::Success, cg.info());
+  EXPECT_LT((A * p - b).norm() / b.norm(), 1.0e-7);
+}
+
+TEST_F(MICPreconditionerTest, FewerIterationsThanDiagonal)
+{
+  Eigen::ConjugateGradient<Matrix, Eigen::Lower|Eigen::Upper,
+			   MICPreconditioner<double> > mic;
+  mic.preconditioner().setGridWidth(size);
+  mic.setTolerance(1.0e-8);
+  mic.compute(A);
+  Eigen::VectorXd micP = mic.solve(b);
+
+  Eigen::ConjugateGradient<Matrix, Eigen::Lower|Eigen::Upper,
+			   Eigen::DiagonalPreconditioner<double> > diag;
+  diag.setTolerance(1.0e-8);
+  diag.compute(A);
+  Eigen::VectorXd diagP = diag.solve(b);
+
+  EXPECT_EQ(Eigen::Success, mic.info());
+  EXPECT_EQ(Eigen::Success, diag.info());
+  EXPECT_LT(mic.iterations(), diag.iterations());
+}
+
+TEST_F(MICPreconditionerTest, IdentityRows)
+{
+  // A pure identity matrix should be left unchanged by the preconditioner.
+  Matrix identity(size, size);
+  identity.setIdentity();
+  MICPreconditioner<double> precon;
+  precon.setGridWidth(size);
+  precon.compute(identity);
+
+  Eigen::VectorXd r = Eigen::VectorXd::LinSpaced(size, -1.0, 1.0);
+  Eigen::VectorXd z = precon.solve(r);
+  for (unsigned i = 0; i < size; ++i)
+    EXPECT_DOUBLE_EQ(r(i), z(i));
+}
+
+#endif // __MIC_PRECONDITIONER_TEST__
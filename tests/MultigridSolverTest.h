@@ -0,0 +1,164 @@
+#ifndef __MULTIGRID_SOLVER_TEST__
+#define __MULTIGRID_SOLVER_TEST__
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "Cell.h"
+#include "Grid.h"
+#include "MultigridSolver.h"
+
+// Test fixture for the MultigridSolver test.
+class MultigridSolverTest : public testing::Test {
+protected:
+  // Fills the bottom three quarters of a grid with fluid, leaving AIR above.
+  // A SOLID obstacle is placed in the middle of the fluid.
+  static void makeTank(Grid &grid)
+  {
+    const unsigned width  = grid.getColCount() - 1;
+    const unsigned height = grid.getRowCount() - 1;
+    for (unsigned y = 0; y < height * 3 / 4; ++y)
+      for (unsigned x = 0; x < width; ++x)
+	grid.cellType(x, y) = Cell::FLUID;
+    for (unsigned y = height / 4; y < height / 2; ++y)
+      for (unsigned x = width / 4; x < width / 2; ++x)
+	grid.cellType(x, y) = Cell::SOLID;
+  }
+
+  // Builds a right-hand side with both smooth and oscillatory components.
+  static std::vector<double> makeRhs(const Grid &grid)
+  {
+    const unsigned width  = grid.getColCount() - 1;
+    const unsigned height = grid.getRowCount() - 1;
+    std::vector<double> b(width * height, 0.0);
+    for (unsigned y = 0; y < height; ++y)
+      for (unsigned x = 0; x < width; ++x)
+	if (grid.cellType(x, y) == Cell::FLUID)
+	  b[y * width + x] = std::sin(0.3 * x) + ((x + y) % 2 ? 0.5 : -0.5);
+    return b;
+  }
+
+  // Computes |b - Ap| / |b| for the 5-point stencil over the grid's FLUID
+  // cells, with unit scale.
+  static double relativeResidual(const Grid &grid,
+				 const std::vector<double> &b,
+				 const std::vector<double> &p)
+  {
+    const unsigned width  = grid.getColCount() - 1;
+    const unsigned height = grid.getRowCount() - 1;
+    const unsigned char *types = grid.cellTypeData();
+    const int stride = grid.getStride();
+    const int gridOffsets[4] = { -1, 1, -stride, stride };
+    const int vecOffsets[4]  = { -1, 1, -int(width), int(width) };
+    double r2 = 0.0, b2 = 0.0;
+    for (unsigned y = 0; y < height; ++y)
+      for (unsigned x = 0; x < width; ++x) {
+	const unsigned c = grid.index(x, y);
+	const int i = y * width + x;
+	if (types[c] != Cell::FLUID)
+	  continue;
+	double Ap = 0.0;
+	for (unsigned n = 0; n < 4; ++n) {
+	  const unsigned char type = types[c + gridOffsets[n]];
+	  if (type == Cell::SOLID)
+	    continue;
+	  Ap += p[i];
+	  if (type == Cell::FLUID)
+	    Ap -= p[i + vecOffsets[n]];
+	}
+	r2 += (b[i] - Ap) * (b[i] - Ap);
+	b2 += b[i] * b[i];
+      }
+    return std::sqrt(r2 / b2);
+  }
+
+  // Solves the tank problem at the given resolution, returning the number
+  // of V-cycles required.
+  static unsigned cyclesToSolve(unsigned size)
+  {
+    Grid grid(size, size);
+    makeTank(grid);
+    std::vector<double> b = makeRhs(grid);
+    std::vector<double> p(b.size(), 0.0);
+    MultigridSolver multigrid;
+    multigrid.setup(grid, 1.0);
+    multigrid.solve(&b[0], &p[0], 1.0e-8, 100);
+    return multigrid.iterations();
+  }
+};
+
+TEST_F(MultigridSolverTest, LevelCount)
+{
+  Grid grid(64, 64);
+  MultigridSolver multigrid;
+  multigrid.setup(grid, 1.0);
+
+  // 64, 32, 16, 8, 4 cells per side.
+  EXPECT_EQ(5u, multigrid.getLevelCount());
+}
+
+TEST_F(MultigridSolverTest, Solve)
+{
+  Grid grid(64, 48);
+  makeTank(grid);
+  std::vector<double> b = makeRhs(grid);
+  std::vector<double> p(b.size(), 0.0);
+
+  MultigridSolver multigrid;
+  multigrid.setup(grid, 1.0);
+  EXPECT_TRUE(multigrid.solve(&b[0], &p[0], 1.0e-8, 100));
+  EXPECT_LT(multigrid.error(), 1.0e-8);
+  EXPECT_LT(relativeResidual(grid, b, p), 1.0e-8);
+
+  // Pressure outside of the fluid is 0.
+  EXPECT_EQ(0.0, p[(grid.getRowCount() - 2) * 64]);
+}
+
+TEST_F(MultigridSolverTest, ResolutionIndependence)
+{
+  // The number of V-cycles should not grow appreciably with resolution:
+  // an 8x finer grid may take at most twice as many cycles.
+  const unsigned coarseCycles = cyclesToSolve(32);
+  const unsigned fineCycles   = cyclesToSolve(256);
+  EXPECT_LT(fineCycles, 100u);
+  EXPECT_LE(fineCycles, 2 * coarseCycles);
+}
+
+TEST_F(MultigridSolverTest, Precondition)
+{
+  // A V-cycle from zero should substantially reduce the residual.
+  Grid grid(64, 64);
+  makeTank(grid);
+  std::vector<double> b = makeRhs(grid);
+  std::vector<double> z(b.size(), 0.0);
+
+  MultigridSolver multigrid;
+  multigrid.setup(grid, 1.0);
+  multigrid.precondition(&b[0], &z[0]);
+  EXPECT_LT(relativeResidual(grid, b, z), 0.5);
+}
+
+TEST_F(MultigridSolverTest, SetScale)
+{
+  // Rescaling an existing hierarchy should match building it from scratch.
+  Grid grid(40, 40);
+  makeTank(grid);
+  std::vector<double> b = makeRhs(grid);
+  std::vector<double> rescaledP(b.size(), 0.0);
+  std::vector<double> p(b.size(), 0.0);
+
+  MultigridSolver rescaled;
+  rescaled.setup(grid, 1.0);
+  rescaled.setScale(0.25);
+  rescaled.solve(&b[0], &rescaledP[0], 1.0e-8, 100);
+
+  MultigridSolver multigrid;
+  multigrid.setup(grid, 0.25);
+  multigrid.solve(&b[0], &p[0], 1.0e-8, 100);
+
+  EXPECT_EQ(multigrid.iterations(), rescaled.iterations());
+  for (unsigned i = 0; i < p.size(); ++i)
+    EXPECT_DOUBLE_EQ(p[i], rescaledP[i]);
+}
+
+#endif // __MULTIGRID_SOLVER_TEST__
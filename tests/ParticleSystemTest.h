@@ -0,0 +1,171 @@
+#ifndef __PARTICLE_SYSTEM_TEST__
+#define __PARTICLE_SYSTEM_TEST__
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "Grid.h"
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+// Fills a grid with rigid rotation about its center, at one radian per second.
+static void rotationField(Grid &grid)
+{
+  const unsigned width  = grid.getColCount() - 1;
+  const unsigned height = grid.getRowCount() - 1;
+  const float cx = 0.5f * width;
+  const float cy = 0.5f * height;
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x <= width; ++x)
+      grid.u(x, y) = -(y + 0.5f - cy);
+  for (unsigned y = 0; y <= height; ++y)
+    for (unsigned x = 0; x < width; ++x)
+      grid.v(x, y) = x + 0.5f - cx;
+}
+
+// Rotates a particle 10 times by 0.3 radians with the given integrator and
+// returns its distance from the exact result.
+static float rotationError(ParticleSystem::Integrator integrator)
+{
+  Grid grid(32.0f, 32.0f);
+  rotationField(grid);
+  ThreadPool pool(1);
+  ParticleSystem particles;
+  particles.add(22.0f, 16.0f);
+  for (unsigned step = 0; step < 10; ++step)
+    particles.advect(grid, 0.3f, integrator, pool);
+
+  const Vector2 exact(16.0f + 6.0f * std::cos(3.0f),
+		      16.0f + 6.0f * std::sin(3.0f));
+  return (particles.getPosition(0) - exact).magnitude();
+}
+
+TEST(ParticleSystemTest, Storage)
+{
+  ParticleSystem particles;
+  EXPECT_EQ(0u, particles.size());
+  EXPECT_TRUE(particles.xData() == NULL);
+
+  particles.add(1.0f, 2.0f);
+  particles.add(3.0f, 4.0f);
+  EXPECT_EQ(2u, particles.size());
+  EXPECT_EQ(Vector2(3.0f, 4.0f), particles.getPosition(1));
+  EXPECT_EQ(1.0f, particles.xData()[0]);
+  EXPECT_EQ(4.0f, particles.yData()[1]);
+
+  particles.clear();
+  EXPECT_EQ(0u, particles.size());
+}
+
+TEST(ParticleSystemTest, IntegratorAccuracy)
+{
+  // Bilinear interpolation reproduces a rotation field exactly, so the
+  // remaining error comes from time integration alone.
+  const float euler = rotationError(ParticleSystem::FORWARD_EULER);
+  const float rk2 = rotationError(ParticleSystem::RK2);
+  const float rk3 = rotationError(ParticleSystem::RK3);
+  EXPECT_LT(rk2, 0.25f * euler);
+  EXPECT_LT(rk3, 0.5f * rk2);
+  EXPECT_LT(rk3, 0.05f);
+}
+
+TEST(ParticleSystemTest, ParallelAdvectionMatchesSerial)
+{
+  Grid grid(64.0f, 48.0f);
+  rotationField(grid);
+  ThreadPool pool;
+
+  // An uneven particle count, so that blocks end mid-batch.
+  ParticleSystem initial;
+  for (unsigned k = 0; k < 30001; ++k)
+    initial.add(1.0f + (k % 613) * 0.1f, 1.0f + (k % 457) * 0.1f);
+
+  for (unsigned n = 0; n < ParticleSystem::INTEGRATOR_COUNT; ++n) {
+    const ParticleSystem::Integrator integrator =
+      static_cast<ParticleSystem::Integrator>(n);
+    ParticleSystem expected = initial;
+    pool.setThreadCount(1);
+    expected.advect(grid, 0.7f, integrator, pool);
+
+    const unsigned threadCounts[] = { 2, 3, 8 };
+    for (unsigned t = 0; t < sizeof(threadCounts) / sizeof(unsigned); ++t) {
+      ParticleSystem result = initial;
+      pool.setThreadCount(threadCounts[t]);
+      result.advect(grid, 0.7f, integrator, pool);
+      const unsigned count = initial.size();
+      EXPECT_TRUE(std::vector<float>(expected.xData(),
+				     expected.xData() + count) ==
+		  std::vector<float>(result.xData(), result.xData() + count) &&
+		  std::vector<float>(expected.yData(),
+				     expected.yData() + count) ==
+		  std::vector<float>(result.yData(), result.yData() + count))
+	<< threadCounts[t] << " threads, integrator " << n;
+    }
+  }
+}
+
+TEST(ParticleSystemTest, SortByCell)
+{
+  const float positions[][2] = {
+    { 2.5f, 1.5f }, { 0.5f, 0.5f }, { -1.0f, 0.5f }, { 2.25f, 1.25f },
+    { 1.5f, 0.5f }, { 0.5f, 9.0f }, { 0.25f, 0.75f }
+  };
+  ParticleSystem particles;
+  for (unsigned k = 0; k < sizeof(positions) / sizeof(positions[0]); ++k)
+    particles.add(positions[k][0], positions[k][1]);
+  EXPECT_FALSE(particles.hasCellRanges());
+
+  // Cells in row-major order, equal cells in their original order, and
+  // particles outside the 3 x 2 domain last.
+  particles.sortByCell(3, 2);
+  ASSERT_TRUE(particles.hasCellRanges());
+  const float expectedX[] = { 0.5f, 0.25f, 1.5f, 2.5f, 2.25f, -1.0f, 0.5f };
+  for (unsigned k = 0; k < particles.size(); ++k)
+    EXPECT_EQ(expectedX[k], particles.getPosition(k).x) << k;
+
+  unsigned begin, end;
+  particles.getCellRange(0, 0, begin, end);
+  EXPECT_EQ(0u, begin);
+  EXPECT_EQ(2u, end);
+  particles.getCellRange(2, 1, begin, end);
+  EXPECT_EQ(3u, begin);
+  EXPECT_EQ(5u, end);
+  particles.getCellRange(1, 1, begin, end);
+  EXPECT_EQ(begin, end);
+
+  // Moving the particles invalidates the ranges.
+  Grid grid(3.0f, 2.0f);
+  ThreadPool pool(1);
+  particles.advect(grid, 0.1f, ParticleSystem::RK2, pool);
+  EXPECT_FALSE(particles.hasCellRanges());
+}
+
+TEST(ParticleSystemTest, SortByMortonOrder)
+{
+  // One particle per cell of a 4 x 4 domain, added row by row.
+  ParticleSystem particles;
+  for (unsigned y = 0; y < 4; ++y)
+    for (unsigned x = 0; x < 4; ++x)
+      particles.add(x + 0.5f, y + 0.5f);
+  particles.sortByCell(4, 4, ParticleSystem::MORTON);
+
+  // The Z-order curve visits each 2 x 2 block before moving on.
+  const float expected[][2] = {
+    { 0.5f, 0.5f }, { 1.5f, 0.5f }, { 0.5f, 1.5f }, { 1.5f, 1.5f },
+    { 2.5f, 0.5f }, { 3.5f, 0.5f }, { 2.5f, 1.5f }, { 3.5f, 1.5f },
+    { 0.5f, 2.5f }
+  };
+  for (unsigned k = 0; k < sizeof(expected) / sizeof(expected[0]); ++k)
+    EXPECT_EQ(Vector2(expected[k][0], expected[k][1]),
+	      particles.getPosition(k)) << k;
+
+  for (unsigned y = 0; y < 4; ++y)
+    for (unsigned x = 0; x < 4; ++x) {
+      unsigned begin, end;
+      particles.getCellRange(x, y, begin, end);
+      ASSERT_EQ(begin + 1, end);
+      EXPECT_EQ(Vector2(x + 0.5f, y + 0.5f), particles.getPosition(begin));
+    }
+}
+
+#endif // __PARTICLE_SYSTEM_TEST__
@@ -0,0 +1,127 @@
+#ifndef __PRESSURE_OPERATOR_TEST__
+#define __PRESSURE_OPERATOR_TEST__
+
+#include <gtest/gtest.h>
+#include <vector>
+#include <eigen3/Eigen/Sparse>
+#include <eigen3/Eigen/IterativeLinearSolvers>
+#include "Cell.h"
+#include "Grid.h"
+#include "MICPreconditioner.h"
+#include "PressureOperator.h"
+
+// Test fixture for the PressureOperator test.
+class PressureOperatorTest : public testing::Test {
+protected:
+  typedef Eigen::SparseMatrix<double, Eigen::RowMajor> Matrix;
+
+  Grid grid;
+  const unsigned width;
+  const unsigned height;
+  const double scale;
+  Matrix A;
+  Eigen::VectorXd x;
+
+  // Builds a grid with fluid in its lower half, a SOLID block inside the
+  // fluid, and AIR above, along with the equivalent assembled matrix.
+  PressureOperatorTest()
+    : grid(12, 10),
+      width(grid.getColCount() - 1),
+      height(grid.getRowCount() - 1),
+      scale(0.5),
+      A(width * height, width * height),
+      x(width * height)
+  {
+    for (unsigned y = 0; y < height / 2; ++y)
+      for (unsigned j = 0; j < width; ++j)
+	grid.cellType(j, y) = Cell::FLUID;
+    grid.cellType(4, 2) = Cell::SOLID;
+    grid.cellType(5, 2) = Cell::SOLID;
+
+    std::vector< Eigen::Triplet<double> > vals;
+    for (unsigned y = 0; y < height; ++y)
+      for (unsigned j = 0; j < width; ++j) {
+	const int i = y * width + j;
+	x(i) = 0.25 * j - 0.5 * y + ((i % 3) ? 1.0 : 0.0);
+	if (grid.cellType(j, y) != Cell::FLUID) {
+	  vals.push_back(Eigen::Triplet<double>(i, i, 1.0));
+	  continue;
+	}
+	const int dx[4] = { -1, 1, 0, 0 };
+	const int dy[4] = { 0, 0, -1, 1 };
+	double diag = 0.0;
+	for (unsigned n = 0; n < 4; ++n) {
+	  const int nx = int(j) + dx[n];
+	  const int ny = int(y) + dy[n];
+	  if (nx < 0 || ny < 0 || nx >= int(width) || ny >= int(height) ||
+	      grid.cellType(nx, ny) == Cell::SOLID)
+	    continue;
+	  diag += scale;
+	  if (grid.cellType(nx, ny) == Cell::FLUID)
+	    vals.push_back(Eigen::Triplet<double>(i, ny * width + nx, -scale));
+	}
+	vals.push_back(Eigen::Triplet<double>(i, i, diag));
+      }
+    A.setFromTriplets(vals.begin(), vals.end());
+  }
+};
+
+TEST_F(PressureOperatorTest, Product)
+{
+  PressureOperator op;
+  op.setup(grid, scale);
+  ASSERT_EQ(A.rows(), op.rows());
+  ASSERT_EQ(A.cols(), op.cols());
+
+  Eigen::VectorXd expected = A * x;
+  Eigen::VectorXd actual = op * x;
+  for (int i = 0; i < x.size(); ++i)
+    EXPECT_DOUBLE_EQ(expected(i), actual(i));
+}
+
+TEST_F(PressureOperatorTest, InnerIterator)
+{
+  // Every row should generate exactly the assembled row, in column order.
+  PressureOperator op;
+  op.setup(grid, scale);
+  for (int row = 0; row < A.outerSize(); ++row) {
+    Matrix::InnerIterator expected(A, row);
+    PressureOperator::InnerIterator actual(op, row);
+    for (; expected && actual; ++expected, ++actual) {
+      EXPECT_EQ(expected.row(), actual.row());
+      EXPECT_EQ(expected.col(), actual.col());
+      EXPECT_DOUBLE_EQ(expected.value(), actual.value());
+    }
+    EXPECT_FALSE(expected);
+    EXPECT_FALSE(actual);
+  }
+}
+
+TEST_F(PressureOperatorTest, ConjugateGradient)
+{
+  // The matrix-free solve should match the assembled solve.
+  PressureOperator op;
+  op.setup(grid, scale);
+  Eigen::VectorXd b = A * x;
+
+  Eigen::ConjugateGradient<PressureOperator, Eigen::Lower|Eigen::Upper,
+			   MICPreconditioner<double> > freeCg;
+  freeCg.preconditioner().setGridWidth(width);
+  freeCg.setTolerance(1.0e-10);
+  freeCg.compute(op);
+  Eigen::VectorXd freeP = freeCg.solve(b);
+
+  Eigen::ConjugateGradient<Matrix, Eigen::Lower|Eigen::Upper,
+			   MICPreconditioner<double> > cg;
+  cg.preconditioner().setGridWidth(width);
+  cg.setTolerance(1.0e-10);
+  cg.compute(A);
+  Eigen::VectorXd p = cg.solve(b);
+
+  EXPECT_EQ(Eigen::Success, freeCg.info());
+  EXPECT_EQ(cg.iterations(), freeCg.iterations());
+  for (int i = 0; i < x.size(); ++i)
+    EXPECT_NEAR(x(i), freeP(i), 1.0e-8);
+}
+
+#endif // __PRESSURE_OPERATOR_TEST__
@@ -0,0 +1,93 @@
+#ifndef __PROFILER_TEST__
+#define __PROFILER_TEST__
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include "Profiler.h"
+
+TEST(ProfilerTest, StageTotals)
+{
+  Profiler profiler;
+  for (unsigned i = 0; i < 3; ++i) {
+    Profiler::ScopedStage stage(profiler, Profiler::STAGE_PRESSURE);
+    stage.setIterations(10);
+  }
+  profiler.recordStage(Profiler::STAGE_MARK_CELLS, 0.0, 2000.0, 0, 50);
+
+  const Profiler::StageStats &pressure =
+    profiler.getStageStats(Profiler::STAGE_PRESSURE);
+  EXPECT_EQ(3u, pressure.calls);
+  EXPECT_EQ(30u, pressure.iterations);
+  EXPECT_LE(0.0, pressure.seconds);
+
+  const Profiler::StageStats &mark =
+    profiler.getStageStats(Profiler::STAGE_MARK_CELLS);
+  EXPECT_EQ(1u, mark.calls);
+  EXPECT_EQ(50u, mark.particles);
+  EXPECT_DOUBLE_EQ(0.002, mark.seconds);
+
+  EXPECT_EQ(0u, profiler.getStageStats(Profiler::STAGE_ADVECT).calls);
+  EXPECT_EQ(4u, profiler.getEventCount());
+
+  profiler.clear();
+  EXPECT_EQ(0u, profiler.getStageStats(Profiler::STAGE_PRESSURE).calls);
+  EXPECT_EQ(0u, profiler.getEventCount());
+}
+
+TEST(ProfilerTest, Frames)
+{
+  Profiler profiler;
+  for (unsigned frame = 0; frame < 2; ++frame) {
+    Profiler::ScopedFrame scope(profiler);
+    for (unsigned step = 0; step <= frame; ++step)
+      profiler.recordStage(Profiler::STAGE_COLLIDE, 0.0, 1.0, 0, 0);
+  }
+
+  // Frame totals only cover the latest frame; stage totals cover all.
+  EXPECT_EQ(2u, profiler.getFrameCount());
+  EXPECT_EQ(1u, profiler.getLastFrameStats().frame);
+  EXPECT_EQ(2u, profiler.getLastFrameStats()
+	    .stages[Profiler::STAGE_COLLIDE].calls);
+  EXPECT_EQ(3u, profiler.getStageStats(Profiler::STAGE_COLLIDE).calls);
+  EXPECT_EQ(5u, profiler.getEventCount());
+}
+
+TEST(ProfilerTest, EventCapacity)
+{
+  Profiler profiler(2);
+  for (unsigned i = 0; i < 5; ++i)
+    profiler.recordStage(Profiler::STAGE_ADVECT, 0.0, 1.0, 0, 0);
+
+  // Events beyond the capacity are dropped, but still counted in totals.
+  EXPECT_EQ(2u, profiler.getEventCount());
+  EXPECT_EQ(3u, profiler.getDroppedEventCount());
+  EXPECT_EQ(5u, profiler.getStageStats(Profiler::STAGE_ADVECT).calls);
+}
+
+TEST(ProfilerTest, ChromeTrace)
+{
+  Profiler profiler;
+  {
+    Profiler::ScopedFrame frame(profiler);
+    profiler.recordStage(Profiler::STAGE_PRESSURE, 10.0, 35.5, 7, 0);
+    profiler.recordStage(Profiler::STAGE_MOVE_PARTICLES, 40.0, 50.0, 0, 128);
+  }
+
+  std::ostringstream out;
+  profiler.writeChromeTrace(out);
+  const std::string trace = out.str();
+  EXPECT_EQ(0u, trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_EQ("]}\n", trace.substr(trace.size() - 3));
+  EXPECT_NE(std::string::npos, trace.find(
+    "{\"name\":\"pressure\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,"
+    "\"tid\":1,\"ts\":10.000,\"dur\":25.500,"
+    "\"args\":{\"frame\":0,\"iterations\":7,\"particles\":0}}"));
+  EXPECT_NE(std::string::npos, trace.find(
+    "\"name\":\"moveParticles\""));
+  EXPECT_NE(std::string::npos, trace.find("\"particles\":128"));
+  EXPECT_NE(std::string::npos, trace.find(
+    "{\"name\":\"frame\",\"cat\":\"frame\""));
+}
+
+#endif // __PROFILER_TEST__
@@ -0,0 +1,202 @@
+#ifndef __SCENARIO_TEST__
+#define __SCENARIO_TEST__
+
+#include <gtest/gtest.h>
+#include <string>
+#include "Cell.h"
+#include "FluidSolver.h"
+#include "Grid.h"
+#include "ParticleSystem.h"
+#include "Scenario.h"
+
+// A scenario with a block of fluid falling onto a solid post.
+static const char *const SCENARIO_TEST_POST =
+  "# A block of water falling onto a post.\n"
+  "size 32 32\n"
+  "frame_rate 60\n"
+  "cfl 1.5\n"
+  "gravity 1 -20\n"
+  "solver multigrid\n"
+  "particles_per_cell 9\n"
+  "\n"
+  "fluid box 8 16 24 32   # The block.\n"
+  "solid circle 16 8 4.5\n";
+
+
+TEST(ScenarioTest, ParsesSettings)
+{
+  Scenario scenario;
+  ASSERT_TRUE(scenario.parse(SCENARIO_TEST_POST)) << scenario.getError();
+  EXPECT_EQ(32u, scenario.getWidth());
+  EXPECT_EQ(32u, scenario.getHeight());
+  EXPECT_EQ(60.0f, scenario.getFrameRate());
+  EXPECT_EQ(1.5f, scenario.getCFLNumber());
+  EXPECT_EQ(1.0f, scenario.getGravity().x);
+  EXPECT_EQ(-20.0f, scenario.getGravity().y);
+  EXPECT_EQ(unsigned(FluidSolver::MULTIGRID_SOLVER),
+	    scenario.getPressureSolver());
+  EXPECT_EQ(3u, scenario.getParticlesPerSide());
+
+  ASSERT_EQ(2u, scenario.getRegions().size());
+  const Scenario::Region &fluid = scenario.getRegions()[0];
+  EXPECT_EQ(Cell::FLUID, fluid.type);
+  EXPECT_EQ(Scenario::BOX, fluid.shape);
+  EXPECT_EQ(24.0f, fluid.x1);
+  const Scenario::Region &post = scenario.getRegions()[1];
+  EXPECT_EQ(Cell::SOLID, post.type);
+  EXPECT_EQ(Scenario::CIRCLE, post.shape);
+  EXPECT_EQ(4.5f, post.x1);
+
+  // Cells are covered when their centers are.
+  unsigned begin, end;
+  scenario.getRegionSpan(fluid, 15, begin, end);
+  EXPECT_EQ(begin, end);
+  scenario.getRegionSpan(fluid, 16, begin, end);
+  EXPECT_EQ(8u, begin);
+  EXPECT_EQ(24u, end);
+  scenario.getRegionSpan(post, 8, begin, end);
+  EXPECT_EQ(12u, begin);
+  EXPECT_EQ(20u, end);
+  scenario.getRegionSpan(post, 3, begin, end);
+  EXPECT_EQ(begin, end);
+}
+
+
+TEST(ScenarioTest, ReportsErrors)
+{
+  const char *const texts[] = {
+    "frame_rate 30\n",
+    "size 8 8\nparticles_per_cell 10\n",
+    "size 8 8\n\nviscosity 1\n",
+    "size 8 8\nsolver jacobi\n",
+    "size 8 8\nfluid box 0 0 4\n",
+    "size 8 8\ncfl 2 3\n",
+    "size 0 8\n",
+    "size 32768 32768\n",
+    "size 16384 16384\n"
+  };
+  const char *const errors[] = {
+    "no size given",
+    "line 2: particles_per_cell must be a square from 1 to 256",
+    "line 3: unknown setting viscosity",
+    "line 2: unknown solver jacobi",
+    "line 2: invalid fluid",
+    "line 2: invalid cfl",
+    "line 1: invalid size",
+    "line 1: size must be at most 1073741823 cells, so that frames can be "
+    "checkpointed",
+    "too many particles for the size; at most 1073741823 can be checkpointed"
+  };
+
+  for (unsigned i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+    Scenario scenario = Scenario::makeDefault(4, 4);
+    EXPECT_FALSE(scenario.parse(texts[i])) << texts[i];
+    EXPECT_EQ(std::string(errors[i]), scenario.getError());
+
+    // A failed parse leaves the scenario as it was.
+    EXPECT_EQ(4u, scenario.getWidth());
+    EXPECT_EQ(1u, scenario.getRegions().size());
+  }
+
+  Scenario scenario;
+  EXPECT_FALSE(scenario.load("no_such_scenario.txt"));
+  EXPECT_EQ(std::string("unable to open no_such_scenario.txt"),
+	    scenario.getError());
+}
+
+
+// The default scenario reproduces the solver's original scene: the upper
+// right quadrant filled with fluid, seeded with 16 particles per cell.
+TEST(ScenarioTest, DefaultMatchesBuiltInScene)
+{
+  const unsigned width = 7, height = 5;
+  FluidSolver solver(width, height);
+  const Grid &grid = solver.getGrid();
+  const ParticleSystem &particles = solver.getParticles();
+
+  unsigned p = 0;
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x < width; ++x) {
+      const bool fluid = (x >= width / 2 && y >= height / 2);
+      EXPECT_EQ(fluid ? Cell::FLUID : Cell::AIR, grid.cellType(x, y));
+      if (!fluid)
+	continue;
+      for (unsigned i = 0; i < 4; ++i)
+	for (unsigned j = 0; j < 4; ++j, ++p) {
+	  ASSERT_LT(p, particles.size());
+	  EXPECT_EQ(x + 0.20f * (i + 1), particles.xData()[p]);
+	  EXPECT_EQ(y + 0.20f * (j + 1), particles.yData()[p]);
+	}
+    }
+  EXPECT_EQ(p, particles.size());
+  EXPECT_EQ(FluidSolver::MIC_PCG_SOLVER, solver.getPressureSolver());
+  EXPECT_FLOAT_EQ(1.0f / 30.0f, solver.getFrameTimeSec());
+}
+
+
+TEST(ScenarioTest, AppliesSettings)
+{
+  Scenario scenario;
+  ASSERT_TRUE(scenario.parse(SCENARIO_TEST_POST)) << scenario.getError();
+  FluidSolver solver(scenario);
+  EXPECT_EQ(33u, solver.getGrid().getColCount());
+  EXPECT_EQ(FluidSolver::MULTIGRID_SOLVER, solver.getPressureSolver());
+  EXPECT_FLOAT_EQ(1.0f / 60.0f, solver.getFrameTimeSec());
+  EXPECT_EQ(1.5f, solver.getCFLNumber());
+  EXPECT_EQ(-20.0f, solver.getGravity().y);
+  EXPECT_EQ(16u * 16u * 9u, solver.getParticles().size());
+
+  // reset() keeps the solver's settings; reset(scenario) replaces them, but
+  // only with a scenario of the same size.
+  solver.setCFLNumber(3.0f);
+  solver.reset();
+  EXPECT_EQ(3.0f, solver.getCFLNumber());
+  EXPECT_FALSE(solver.reset(Scenario::makeDefault(16, 32)));
+  EXPECT_EQ(3.0f, solver.getCFLNumber());
+  EXPECT_TRUE(solver.reset(Scenario::makeDefault(32, 32)));
+  EXPECT_EQ(2.0f, solver.getCFLNumber());
+  EXPECT_EQ(FluidSolver::MIC_PCG_SOLVER, solver.getPressureSolver());
+  EXPECT_EQ(16u * 16u * 16u, solver.getParticles().size());
+}
+
+
+// Fluid falling onto a solid obstacle flows around it: the obstacle's cells
+// stay SOLID and no fluid moves through its faces.
+TEST(ScenarioTest, SolidObstacle)
+{
+  Scenario scenario;
+  ASSERT_TRUE(scenario.parse(SCENARIO_TEST_POST)) << scenario.getError();
+  FluidSolver solver(scenario);
+  const Grid &grid = solver.getGrid();
+  const ParticleSystem &particles = solver.getParticles();
+
+  // No particles are seeded in the obstacle.
+  for (unsigned p = 0; p < particles.size(); ++p)
+    EXPECT_NE(Cell::SOLID, grid.cellType(unsigned(particles.xData()[p]),
+					 unsigned(particles.yData()[p])));
+
+  for (unsigned frame = 0; frame < 60; ++frame)
+    solver.advanceFrame();
+
+  unsigned solidCount = 0;
+  for (unsigned y = 0; y < 32; ++y) {
+    unsigned begin, end;
+    scenario.getRegionSpan(scenario.getRegions()[1], y, begin, end);
+    for (unsigned x = 0; x < 32; ++x) {
+      const bool solid = (x >= begin && x < end);
+      if (!solid) {
+	EXPECT_NE(Cell::SOLID, grid.cellType(x, y));
+	continue;
+      }
+      ++solidCount;
+      EXPECT_EQ(Cell::SOLID, grid.cellType(x, y));
+      EXPECT_EQ(0.0f, grid.u(x, y));
+      EXPECT_EQ(0.0f, grid.u(x + 1, y));
+      EXPECT_EQ(0.0f, grid.v(x, y));
+      EXPECT_EQ(0.0f, grid.v(x, y + 1));
+    }
+  }
+  EXPECT_GT(solidCount, 50u);
+}
+
+#endif // __SCENARIO_TEST__
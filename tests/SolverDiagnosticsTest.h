@@ -0,0 +1,89 @@
+#ifndef __SOLVER_DIAGNOSTICS_TEST__
+#define __SOLVER_DIAGNOSTICS_TEST__
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include "SolverDiagnostics.h"
+
+// Test fixture for the SolverDiagnostics test.
+class SolverDiagnosticsTest : public testing::Test {
+protected:
+  // Builds a record for the given substep.
+  static SolverDiagnostics::StepRecord makeRecord(unsigned long step)
+  {
+    SolverDiagnostics::StepRecord record;
+    record.step = step;
+    record.timeStepSec = 0.01f;
+    record.pressureIterations = 10 + step;
+    record.pressureError = 1.0e-7;
+    record.pressureInitialError = 1.0;
+    record.pressureConverged = true;
+    record.pressureWarmStarted = false;
+    record.pressureReusedSetup = false;
+    record.maxDivergence = -1.0f;
+    return record;
+  }
+};
+
+TEST_F(SolverDiagnosticsTest, Verbosity)
+{
+  SolverDiagnostics diagnostics;
+  EXPECT_EQ(SolverDiagnostics::DIAGNOSTICS_OFF, diagnostics.getVerbosity());
+  EXPECT_FALSE(diagnostics.isEnabled());
+
+  diagnostics.setVerbosity(SolverDiagnostics::DIAGNOSTICS_STEPS);
+  EXPECT_TRUE(diagnostics.isEnabled());
+  EXPECT_FALSE(diagnostics.isEnabled(SolverDiagnostics::DIAGNOSTICS_DETAILED));
+
+  diagnostics.setVerbosity(SolverDiagnostics::DIAGNOSTICS_DETAILED);
+  EXPECT_TRUE(diagnostics.isEnabled());
+  EXPECT_TRUE(diagnostics.isEnabled(SolverDiagnostics::DIAGNOSTICS_DETAILED));
+}
+
+TEST_F(SolverDiagnosticsTest, RingBuffer)
+{
+  SolverDiagnostics diagnostics(4);
+  EXPECT_EQ(0u, diagnostics.getRecordCount());
+
+  diagnostics.record(makeRecord(1));
+  diagnostics.record(makeRecord(2));
+  EXPECT_EQ(2u, diagnostics.getRecordCount());
+  EXPECT_EQ(1u, diagnostics.getRecord(0).step);
+  EXPECT_EQ(2u, diagnostics.getLatestRecord().step);
+
+  // Once full, the oldest records are overwritten.
+  for (unsigned long step = 3; step <= 6; ++step)
+    diagnostics.record(makeRecord(step));
+  EXPECT_EQ(4u, diagnostics.getRecordCount());
+  for (unsigned i = 0; i < 4; ++i)
+    EXPECT_EQ(3u + i, diagnostics.getRecord(i).step);
+  EXPECT_EQ(6u, diagnostics.getLatestRecord().step);
+  EXPECT_EQ(16u, diagnostics.getLatestRecord().pressureIterations);
+
+  diagnostics.clear();
+  EXPECT_EQ(0u, diagnostics.getRecordCount());
+}
+
+TEST_F(SolverDiagnosticsTest, Dump)
+{
+  SolverDiagnostics diagnostics(8);
+  diagnostics.record(makeRecord(1));
+  SolverDiagnostics::StepRecord detailed = makeRecord(2);
+  detailed.maxDivergence = 0.5f;
+  diagnostics.record(detailed);
+
+  std::ostringstream out;
+  diagnostics.dump(out);
+  const std::string dump = out.str();
+
+  // One line per record, with divergence only where it was measured.
+  EXPECT_EQ(2, std::count(dump.begin(), dump.end(), '\n'));
+  EXPECT_EQ(0u, dump.find("step 1 "));
+  EXPECT_NE(std::string::npos, dump.find("iterations 12"));
+  EXPECT_EQ(dump.find("divergence"), dump.rfind("divergence"));
+  EXPECT_NE(std::string::npos, dump.find("divergence 0.5"));
+}
+
+#endif // __SOLVER_DIAGNOSTICS_TEST__
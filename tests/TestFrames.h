@@ -0,0 +1,48 @@
+#ifndef __TEST_FRAMES__
+#define __TEST_FRAMES__
+
+#include <cmath>
+#include "Cell.h"
+#include "FrameSnapshot.h"
+#include "Grid.h"
+#include "ParticleSystem.h"
+
+// Fills a width x height grid with distinct values in every field:
+// u(x, y) = x + 10y, v(x, y) = -(x + 10y) and pressure(x, y) = 100 + x + 10y,
+// with the cell types cycling through AIR, FLUID and SOLID.  The particles
+// are replaced with particleCount of them, spread over the grid.
+static void fillTestFrameState(unsigned width, unsigned height,
+			       unsigned particleCount, Grid &grid,
+			       ParticleSystem &particles)
+{
+  for (unsigned y = 0; y < height; ++y)
+    for (unsigned x = 0; x <= width; ++x)
+      grid.u(x, y) = x + 10.0f * y;
+  for (unsigned y = 0; y <= height; ++y)
+    for (unsigned x = 0; x < width; ++x)
+      grid.v(x, y) = -(x + 10.0f * y);
+  for (unsigned y = 0; y < height; ++y) {
+    for (unsigned x = 0; x < width; ++x) {
+      grid.pressure(x, y) = 100.0f + x + 10.0f * y;
+      grid.cellType(x, y) = (x + y) % Cell::TYPE_COUNT;
+    }
+  }
+  particles.clear();
+  for (unsigned k = 0; k < particleCount; ++k)
+    particles.add(std::fmod(0.5f + 0.75f * k, float(width)),
+		  std::fmod(0.25f + 0.5f * k, float(height)));
+}
+
+// Captures a frame filled by fillTestFrameState().
+static FrameSnapshotPtr makeTestFrame(FrameSnapshotPool &pool,
+				      unsigned width, unsigned height,
+				      unsigned particleCount,
+				      unsigned long frame)
+{
+  Grid grid((float)width, (float)height);
+  ParticleSystem particles;
+  fillTestFrameState(width, height, particleCount, grid, particles);
+  return pool.capture(grid, particles, frame);
+}
+
+#endif // __TEST_FRAMES__
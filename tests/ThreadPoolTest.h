@@ -0,0 +1,73 @@
+#ifndef __THREAD_POOL_TEST__
+#define __THREAD_POOL_TEST__
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "ThreadPool.h"
+
+// Counts how many times each index is visited, and which block visits it.
+class VisitTask : public ThreadPool::Task
+{
+public:
+  VisitTask(unsigned size) : visits(size, 0), blocks(size, 0) {}
+
+  void run(unsigned begin, unsigned end) const
+  {
+    for (unsigned i = begin; i < end; ++i) {
+      ++visits[i];
+      blocks[i] = begin;
+    }
+  }
+
+  mutable std::vector<unsigned> visits;
+  mutable std::vector<unsigned> blocks;
+};
+
+TEST(ThreadPoolTest, ThreadCount)
+{
+  ThreadPool pool;
+  EXPECT_EQ(ThreadPool::getIdealThreadCount(), pool.getThreadCount());
+  EXPECT_LE(1u, pool.getThreadCount());
+
+  pool.setThreadCount(5);
+  EXPECT_EQ(5u, pool.getThreadCount());
+  pool.setThreadCount(0);
+  EXPECT_EQ(ThreadPool::getIdealThreadCount(), pool.getThreadCount());
+}
+
+TEST(ThreadPoolTest, VisitsEachIndexOnce)
+{
+  const unsigned threadCounts[] = { 1, 2, 3, 7, 64 };
+  for (unsigned t = 0; t < sizeof(threadCounts) / sizeof(unsigned); ++t) {
+    ThreadPool pool(threadCounts[t]);
+    VisitTask task(1000);
+    pool.parallelFor(3, 998, task);
+    for (unsigned i = 0; i < 1000; ++i)
+      EXPECT_EQ((i >= 3 && i < 998) ? 1u : 0u, task.visits[i]);
+  }
+}
+
+TEST(ThreadPoolTest, Blocks)
+{
+  // 10 indices over 4 threads are split into contiguous blocks of 3, 3, 2
+  // and 2 indices.
+  ThreadPool pool(4);
+  VisitTask task(10);
+  pool.parallelFor(0, 10, task);
+  const unsigned expected[10] = { 0, 0, 0, 3, 3, 3, 6, 6, 8, 8 };
+  for (unsigned i = 0; i < 10; ++i)
+    EXPECT_EQ(expected[i], task.blocks[i]);
+
+  // Blocks are never smaller than the minimum block size.
+  VisitTask large(10);
+  pool.parallelFor(0, 10, large, 4);
+  for (unsigned i = 0; i < 10; ++i)
+    EXPECT_EQ(i < 5 ? 0u : 5u, large.blocks[i]);
+
+  // Empty ranges do nothing.
+  VisitTask empty(1);
+  pool.parallelFor(1, 1, empty);
+  EXPECT_EQ(0u, empty.visits[0]);
+}
+
+#endif // __THREAD_POOL_TEST__
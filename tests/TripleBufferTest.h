@@ -0,0 +1,83 @@
+#ifndef __TRIPLE_BUFFER_TEST__
+#define __TRIPLE_BUFFER_TEST__
+
+#include <gtest/gtest.h>
+#include <QThread>
+#include <vector>
+#include "TripleBuffer.h"
+
+TEST(TripleBufferTest, LatestValueWins)
+{
+  TripleBuffer<int> buffer(-1);
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(-1, buffer.getReadBuffer());
+
+  buffer.getWriteBuffer() = 1;
+  buffer.publish();
+  EXPECT_TRUE(buffer.update());
+  EXPECT_EQ(1, buffer.getReadBuffer());
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(1, buffer.getReadBuffer());
+
+  // Values the reader missed are skipped.
+  for (int value = 2; value <= 4; ++value) {
+    buffer.getWriteBuffer() = value;
+    buffer.publish();
+  }
+  EXPECT_TRUE(buffer.update());
+  EXPECT_EQ(4, buffer.getReadBuffer());
+
+  // The reader's value is never handed back to the writer.
+  buffer.getWriteBuffer() = 5;
+  EXPECT_EQ(4, buffer.getReadBuffer());
+}
+
+// Publishes vectors whose entries all hold the same, increasing value.
+class TripleBufferWriter : public QThread
+{
+public:
+  TripleBufferWriter(TripleBuffer< std::vector<int> > &buffer, int count)
+    : _buffer(buffer), _count(count)
+  {}
+
+protected:
+  void run()
+  {
+    for (int value = 1; value <= _count; ++value) {
+      std::vector<int> &values = _buffer.getWriteBuffer();
+      for (unsigned i = 0; i < values.size(); ++i)
+	values[i] = value;
+      _buffer.publish();
+    }
+  }
+
+private:
+  TripleBuffer< std::vector<int> > &_buffer;
+  int _count;
+};
+
+TEST(TripleBufferTest, ConcurrentReader)
+{
+  // The reader must only ever see whole values, in increasing order.
+  const int count = 20000;
+  TripleBuffer< std::vector<int> > buffer(std::vector<int>(256, 0));
+  TripleBufferWriter writer(buffer, count);
+  writer.start();
+
+  int last = 0;
+  bool torn = false, backwards = false;
+  while (last < count) {
+    if (!buffer.update())
+      continue;
+    const std::vector<int> &values = buffer.getReadBuffer();
+    for (unsigned i = 1; i < values.size(); ++i)
+      torn = torn || values[i] != values[0];
+    backwards = backwards || values[0] <= last;
+    last = values[0];
+  }
+  writer.wait();
+  EXPECT_FALSE(torn);
+  EXPECT_FALSE(backwards);
+}
+
+#endif // __TRIPLE_BUFFER_TEST__
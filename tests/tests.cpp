@@ -8,10 +8,22 @@
 // Include test headers here:
 #include "Vector2Test.h"
 #include "CellTest.h"
+#include "CellBitmapTest.h"
+#include "CheckpointTest.h"
+#include "FieldCodecTest.h"
+#include "FluidSolverTest.h"
+#include "FrameExporterTest.h"
+#include "FrameSnapshotTest.h"
 #include "GridTest.h"
-
-// TODO - YUCK - This global variable is a temporary hack!!!
-FluidSolver *solver = NULL;
+#include "MICPreconditionerTest.h"
+#include "MultigridSolverTest.h"
+#include "ParticleSystemTest.h"
+#include "PressureOperatorTest.h"
+#include "ProfilerTest.h"
+#include "ScenarioTest.h"
+#include "SolverDiagnosticsTest.h"
+#include "ThreadPoolTest.h"
+#include "TripleBufferTest.h"
 
 GTEST_API_ int main(int argc, char *argv[])
 {
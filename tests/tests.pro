@@ -1,4 +1,6 @@
-include(../sources.pri)
+include(../solver.pri)
+
+QT      -= gui opengl
 
 TEMPLATE = app
 TARGET   = solver-tests
@@ -8,7 +10,23 @@ CONFIG(release, debug|release) {
 
 HEADERS += Vector2Test.h \
 	   CellTest.h \
-	   GridTest.h
+	   CellBitmapTest.h \
+	   CheckpointTest.h \
+	   FieldCodecTest.h \
+	   FluidSolverTest.h \
+	   FrameExporterTest.h \
+	   FrameSnapshotTest.h \
+	   GridTest.h \
+	   MICPreconditionerTest.h \
+	   MultigridSolverTest.h \
+	   ParticleSystemTest.h \
+	   PressureOperatorTest.h \
+	   ProfilerTest.h \
+	   ScenarioTest.h \
+	   SolverDiagnosticsTest.h \
+	   TestFrames.h \
+	   ThreadPoolTest.h \
+	   TripleBufferTest.h
 
 SOURCES += tests.cpp
 
@@ -0,0 +1,53 @@
+#include "QFluidSolver.h"
+#include "SignalRelay.h"
+
+
+QFluidSolver::QFluidSolver(const Scenario &scenario)
+  : QObject(),
+    _simulation(scenario)
+{
+  // Connect ourselves to the 'resetSimulation' signal, and pass on each
+  // published frame.  The latter crosses threads, so it is queued.
+  QObject::connect(SignalRelay::getInstance(), SIGNAL(resetSimulation()),
+		   this, SLOT(reset()));
+  QObject::connect(&_simulation, SIGNAL(framePublished()),
+		   SignalRelay::getInstance(), SIGNAL(frameAvailable()));
+
+  _simulation.start();
+}
+
+
+QFluidSolver::~QFluidSolver()
+{
+  // Disconnect from receiving any signals.
+  SignalRelay::getInstance()->disconnect(this);
+  _simulation.disconnect();
+  _simulation.stop();
+}
+
+
+float QFluidSolver::getSimulationWidth() const
+{
+  return _simulation.getSimulationWidth();
+}
+
+
+float QFluidSolver::getSimulationHeight() const
+{
+  return _simulation.getSimulationHeight();
+}
+
+
+void QFluidSolver::draw(IFluidRenderer *renderer)
+{
+  // Always draw the newest frame; if none has been published since the last
+  // draw, the previous one is drawn again.
+  const FrameSnapshotPtr frame = _simulation.latestFrame();
+  renderer->drawGrid(*frame);
+}
+
+
+void QFluidSolver::reset()
+{
+  _simulation.requestReset();
+}
@@ -0,0 +1,67 @@
+#ifndef __Q_FLUID_SOLVER_H__
+#define __Q_FLUID_SOLVER_H__
+
+#include <QObject>
+#include "IFluidRenderer.h"
+#include "SimulationThread.h"
+
+// This serves as a Qt wrapper around a FluidSolver instance, connecting the
+// simulation to the GUI's signals and renderers.  The FluidSolver itself has
+// no knowledge of Qt, so that it can also run headless.
+//
+// The simulation runs on a SimulationThread, started on construction.  The
+// GUI thread only ever reads the frames it publishes, and is told of each
+// new one through SignalRelay's frameAvailable() signal.
+class QFluidSolver : public QObject
+{
+  Q_OBJECT
+
+public:
+  // Constructs a 2D fluid simulation of a scenario.
+  //
+  // Arguments:
+  //   Scenario &scenario - The scene and settings to simulate.
+  explicit QFluidSolver(const Scenario &scenario);
+
+  // Destructor
+  //
+  // Arguments:
+  //   None
+  virtual ~QFluidSolver();
+
+  // Returns the simulation size.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float - The width or height of the simulation, in world coordinates.
+  float getSimulationWidth() const;
+  float getSimulationHeight() const;
+
+  // Draws the latest frame published by the simulation using the provided
+  // renderer.  Never waits for the simulation.
+  //
+  // Arguments:
+  //   IFluidRenderer *renderer - The FluidRenderer that will draw all sim data.
+  //
+  // Returns:
+  //   None
+  void draw(IFluidRenderer *renderer);
+
+public slots:
+  // Resets the simulation to a default starting grid.  The reset takes
+  // effect on the simulation thread before its next frame.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void reset();
+
+private:
+  SimulationThread _simulation; // Runs the wrapped simulation.
+};
+
+#endif // __Q_FLUID_SOLVER_H__
@@ -1,9 +1,12 @@
 #include "QRendererWidget.h"
 #include "CompatibilityRenderer.h"
+#include "CoreProfileRenderer.h"
+#include "SignalRelay.h"
+#include "VertexBufferRenderer.h"
 
 // TODO - YUCK - This global variable is a temporary hack!!!
-#include "FluidSolver.h"
-extern FluidSolver *solver;
+#include "QFluidSolver.h"
+extern QFluidSolver *solver;
 
 QRendererWidget * QRendererWidget::rendererWidget(QWidget *parent,
 						  Renderers renderer)
@@ -18,6 +21,12 @@ QRendererWidget * QRendererWidget::rendererWidget(QWidget *parent,
   case COMPATIBILITY_RENDERER:
     rendPtr = new CompatibilityRenderer();
     break;
+  case VERTEX_BUFFER_RENDERER:
+    rendPtr = new VertexBufferRenderer();
+    break;
+  case CORE_PROFILE_RENDERER:
+    rendPtr = new CoreProfileRenderer();
+    break;
   default:
     // Shouldn't get here...
     break;
@@ -33,11 +42,17 @@ QRendererWidget::QRendererWidget(const QGLFormat &format,
 				 IFluidRenderer *renderer)
   : QGLWidget(format, parent),
     _renderer(renderer)
-{}
+{
+  // Redraw whenever the simulation publishes a new frame.
+  QObject::connect(SignalRelay::getInstance(), SIGNAL(frameAvailable()),
+		   this, SLOT(update()));
+}
 
 
 QRendererWidget::~QRendererWidget()
 {
+  // The renderer may free OpenGL objects, which needs its context current.
+  makeCurrent();
   delete _renderer;
   _renderer = NULL;
 }
@@ -70,5 +85,4 @@ void QRendererWidget::resizeGL(int width, int height)
 void QRendererWidget::paintGL()
 {
   solver->draw(_renderer);
-  update();
 }
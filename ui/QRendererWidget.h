@@ -14,6 +14,8 @@ public:
   // Enumerated type listing all implemented renderers to choose from.
   enum Renderers {
     COMPATIBILITY_RENDERER = 0,
+    VERTEX_BUFFER_RENDERER,
+    CORE_PROFILE_RENDERER,
     RENDERER_COUNT
   };
   
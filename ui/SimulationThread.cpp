@@ -0,0 +1,100 @@
+#include "SimulationThread.h"
+#include <QElapsedTimer>
+
+
+SimulationThread::SimulationThread(const Scenario &scenario)
+  : QThread(),
+    _solver(scenario),
+    _snapshots(),
+    _frames(_snapshots.capture(_solver.getGrid(), _solver.getParticles(), 0)),
+    _frameCount(0),
+    _stopRequested(0),
+    _resetRequested(0)
+{}
+
+
+SimulationThread::~SimulationThread()
+{
+  stop();
+}
+
+
+void SimulationThread::stop()
+{
+  _stopRequested.fetchAndStoreOrdered(1);
+  wait();
+}
+
+
+void SimulationThread::requestReset()
+{
+  _resetRequested.fetchAndStoreOrdered(1);
+}
+
+
+FrameSnapshotPtr SimulationThread::latestFrame()
+{
+  _frames.update();
+  return _frames.getReadBuffer();
+}
+
+
+float SimulationThread::getSimulationWidth() const
+{
+  return _solver.getSimulationWidth();
+}
+
+
+float SimulationThread::getSimulationHeight() const
+{
+  return _solver.getSimulationHeight();
+}
+
+
+void SimulationThread::run()
+{
+  const double frameMs = _solver.getFrameTimeSec() * 1000.0;
+  QElapsedTimer clock;
+  clock.start();
+  double nextFrameMs = 0.0;
+
+  while (!_stopRequested.fetchAndAddAcquire(0)) {
+    if (_resetRequested.fetchAndStoreAcquire(0)) {
+      _solver.reset();
+      _frameCount = 0;
+      publishFrame();
+      clock.restart();
+      nextFrameMs = 0.0;
+    }
+
+    // Sleep until the next frame is due.  Sleeps are short enough that stop
+    // and reset requests are still picked up promptly.
+    const double nowMs = clock.elapsed();
+    if (nowMs < nextFrameMs) {
+      msleep(static_cast<unsigned long>(nextFrameMs - nowMs) + 1);
+      continue;
+    }
+
+    _solver.advanceFrame();
+    ++_frameCount;
+    publishFrame();
+
+    // A frame that took longer than real time is not made up for later.
+    nextFrameMs += frameMs;
+    if (nextFrameMs < clock.elapsed())
+      nextFrameMs = clock.elapsed();
+  }
+}
+
+
+void SimulationThread::publishFrame()
+{
+  // Releasing the write buffer's old snapshot first lets the capture reuse
+  // it, so publishing does not allocate.
+  FrameSnapshotPtr &next = _frames.getWriteBuffer();
+  next.reset();
+  next = _snapshots.capture(_solver.getGrid(), _solver.getParticles(),
+			    _frameCount);
+  _frames.publish();
+  emit framePublished();
+}
@@ -0,0 +1,106 @@
+#ifndef __SIMULATION_THREAD_H__
+#define __SIMULATION_THREAD_H__
+
+#include <QAtomicInt>
+#include <QThread>
+#include "FluidSolver.h"
+#include "FrameSnapshot.h"
+#include "TripleBuffer.h"
+
+// Runs a FluidSolver on a thread of its own, so that simulating never blocks
+// rendering or input on the GUI thread.  Frames are paced to real time: each
+// one advances the simulation by the solver's frame time, and the thread
+// sleeps if it gets ahead.
+//
+// Every completed frame is captured in a pooled FrameSnapshot and published
+// through a TripleBuffer.  The GUI thread picks up the newest snapshot with
+// latestFrame() whenever it draws; it never waits for the simulation, and
+// the simulation never waits for it.  The solver itself must not be touched
+// from any other thread while this one is running.
+class SimulationThread : public QThread
+{
+  Q_OBJECT
+
+public:
+  // Constructs a simulation of a scenario.  The thread does not run until
+  // start() is called.
+  //
+  // Arguments:
+  //   Scenario &scenario - The scene and settings to simulate.
+  explicit SimulationThread(const Scenario &scenario);
+
+  // Destructor.  Stops the thread and waits for it to exit.
+  //
+  // Arguments:
+  //   None
+  virtual ~SimulationThread();
+
+  // Asks the thread to exit after its current frame, and waits for it.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void stop();
+
+  // Asks the thread to reset the simulation before its next frame.  May be
+  // called from any thread.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  void requestReset();
+
+  // Returns the most recently published frame.  Only one thread may call
+  // this, but the returned handle may be kept and passed to other threads;
+  // the snapshot stays valid and unchanged for as long as it is held.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   FrameSnapshotPtr - The latest frame.
+  FrameSnapshotPtr latestFrame();
+
+  // Returns the simulation size, which never changes.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   float - The width or height of the simulation.
+  float getSimulationWidth() const;
+  float getSimulationHeight() const;
+
+signals:
+  // Emitted from the simulation thread after each frame is published.
+  void framePublished();
+
+protected:
+  // Simulates and publishes frames until stopped.
+  //
+  // Inherited from QThread.
+  //
+  // Arguments:
+  //   None
+  //
+  // Returns:
+  //   None
+  virtual void run();
+
+private:
+  // Captures the solver's state and publishes it.
+  void publishFrame();
+
+  FluidSolver _solver;          // The simulation; owned by this thread.
+  FrameSnapshotPool _snapshots; // Recycled frame snapshots.
+  TripleBuffer<FrameSnapshotPtr> _frames; // Frames handed to the reader.
+  unsigned long _frameCount;    // Frames simulated since the last reset.
+  QAtomicInt _stopRequested;    // Nonzero once stop() is called.
+  QAtomicInt _resetRequested;   // Nonzero if a reset is pending.
+};
+
+#endif // __SIMULATION_THREAD_H__